@@ -5,36 +5,137 @@
 /// \brief  Implementation of the AMDTActivityLogger lib
 //==============================================================================
 
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <iomanip>
+#include <list>
 #include <map>
 #include <sstream>
+#include <vector>
 #include <mutex>
+#include <atomic>
+#include <thread>
+
+#ifndef _WIN32
+    #include <pthread.h>
+#endif
 
 #include <AMDTOSWrappers/Include/osProcess.h>
 #include <AMDTOSWrappers/Include/osThread.h>
 #include <AMDTOSWrappers/Include/osFile.h>
 
+#define AL_BUILD_ACTIVITY_LOGGER
 #include "CXLActivityLogger.h"
 #include "AMDTActivityLoggerProfileControl.h"
 #include "AMDTGPUProfilerDefs.h"
 #include "AMDTActivityLoggerTimeStamp.h"
+#include "AMDTActivityLoggerEventBuffer.h"
+#include "AMDTActivityLoggerMarkerTable.h"
+#include "AMDTActivityLoggerMarkerArgs.h"
+#include "AMDTActivityLoggerTextWriter.h"
+#include "AMDTActivityLoggerBinaryFormat.h"
+#include "AMDTActivityLoggerOutputFile.h"
+#include "AMDTActivityLoggerWorkerPool.h"
+#include "AMDTActivityLoggerStatistics.h"
+#include "AMDTActivityLoggerBackgroundWriter.h"
+#include "AMDTActivityLoggerChromeTrace.h"
+#include "AMDTActivityLoggerTriggers.h"
 
 using namespace std;
 
 #define INDENT "   "
 #define DEFAULT_GROUP "Default"
 
+const size_t s_INITIAL_MARKER_STACK_SIZE = 64; ///< number of nested markers a thread can open before its marker stack grows
+const unsigned int s_DEFAULT_FLUSH_PERIOD_MS = 100; ///< default period of the flushes of the temp files in timeout mode
+const unsigned long long s_STATS_TIMING_INTERVAL = 16; ///< 1 in s_STATS_TIMING_INTERVAL begin and end calls of a thread is timed for amdtGetActivityLoggerStats
+
+/// A marker opened by a thread and not yet closed
+struct PerfMarkerStackEntry
+{
+    unsigned int m_markerHandle;   ///< the handle of the marker in g_markerTable
+    bool m_recorded;               ///< flag indicating if the begin event was recorded, the end event is only recorded if it was
+    unsigned long long m_beginTimeStamp; ///< timestamp of the begin of the marker, only set in statistics mode
+    unsigned int m_triggerId;      ///< the id of the profiling trigger of the marker in g_triggers, 0 for none
+    unsigned long long m_triggerInstance; ///< the instance number returned by PerfMarkerTriggerList::OnBegin, 0 if the instance did not arm the trigger
+};
+
+/// Sampling state of a sampled marker for a thread
+struct PerfMarkerSamplingState
+{
+    unsigned long long m_numInstances;      ///< number of instances since the last recorded instance, including it
+    unsigned int m_intervalPosition;        ///< position of the next instance in the sample interval, it is recorded at position 0
+    unsigned int m_numWindowSamples;        ///< number of instances recorded in the current millisecond window
+    unsigned long long m_windowStart;       ///< timestamp of the start of the current millisecond window
+};
+
+/// Counter updated by a single thread at a time and read by any thread, for amdtGetActivityLoggerStats.
+/// An update is a plain load and store, which costs no more than updating an ordinary variable.
+class PerfMarkerThreadCounter
+{
+public:
+    /// Constructor
+    PerfMarkerThreadCounter()
+    {
+        m_value.store(0, std::memory_order_relaxed);
+    }
+
+    /// Adds to the counter
+    /// \param value the value to add
+    void Add(unsigned long long value) { m_value.store(m_value.load(std::memory_order_relaxed) + value, std::memory_order_relaxed); }
+
+    /// Sets the counter
+    /// \param value the value
+    void Set(unsigned long long value) { m_value.store(value, std::memory_order_relaxed); }
+
+    /// Gets the counter
+    /// \return the value
+    unsigned long long Get() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    /// Disabled copy contructor
+    PerfMarkerThreadCounter(const PerfMarkerThreadCounter& obj);
+
+    /// Disabled assignment operator
+    PerfMarkerThreadCounter& operator = (const PerfMarkerThreadCounter& obj);
+
+    std::atomic<unsigned long long> m_value; ///< the value of the counter
+};
+
+/// The marker entrypoints whose calls are counted and timed for amdtGetActivityLoggerStats
+enum PerfMarkerCallType
+{
+    PERF_MARKER_CALL_BEGIN = 0,    ///< amdtBeginMarker, amdtBeginMarkerArgs and amdtBeginMarkerById
+    PERF_MARKER_CALL_END = 1,      ///< amdtEndMarker, amdtEndMarkerEx and amdtEndMarkerById
+    PERF_MARKER_CALL_OTHER = 2     ///< the other entrypoints recording events, which are not timed, also the number of timed call types
+};
+
+/// The counters of the calls of a thread to a type of marker entrypoints
+struct PerfMarkerCallCounters
+{
+    PerfMarkerThreadCounter m_numCalls;         ///< number of calls
+    PerfMarkerThreadCounter m_numTimedCalls;    ///< number of calls which were timed, 1 in s_STATS_TIMING_INTERVAL
+    PerfMarkerThreadCounter m_timedDuration;    ///< total duration of the timed calls, in timestamp units
+};
+
 /// Class to track a perf marker
-class PerfMarkerItem
+class PerfMarkerItem : public PerfMarkerSpillTarget
 {
 public:
     /// Constructor
     PerfMarkerItem()
     {
         m_pOstream = nullptr;
-        m_depth = 0;
+        m_isTempFileCreated = false;
+        m_tempFileAdjustment = ios_base::fmtflags();
+        m_numWrittenLines = 0;
+        m_numAccountedBytes = 0;
+        m_numDroppedMarkers = 0;
+        m_inUse = false;
+        m_isSealed = false;
+        m_markerStack.reserve(s_INITIAL_MARKER_STACK_SIZE);
     }
 
     /// Destructor
@@ -44,8 +145,44 @@ public:
         m_pOstream = nullptr;
     }
 
-    ostream* m_pOstream; ///< output stream used to write the perf marker data
-    int m_depth;         ///< depth of this perf marker
+    /// Writes events of the thread to its temp file, called on the background writer thread
+    /// \param pChunks the list of chunks holding the events, in recording order
+    void WriteSpilledEvents(PerfMarkerEventChunk* pChunks);
+
+    /// Takes all the events recorded by the thread so far and writes them to its temp file, called periodically on the background writer thread
+    void FlushBufferedEvents();
+
+    PerfMarkerEventBuffer m_events;             ///< the perf marker events recorded by the thread
+    PerfMarkerEventBuffer m_flushedEvents;      ///< the events being written by the background writer in timeout mode, swapped with m_events
+    std::mutex m_eventsMtx;                     ///< mutex to protect m_events when the background writer flushes it in timeout mode
+    PerfMarkerTableCache m_markerTableCache;    ///< cache of the handles of the marker names used by the thread
+    TimeStampConverter m_timeStampConverter;    ///< converter of the recorded timestamps to nanoseconds
+    string m_tempFileName;                      ///< name of the temp file the perf marker data is written to in timeout mode or when the events are spilled to disk, empty if none
+    ofstream* m_pOstream;                       ///< output stream of the temp file while it is open, nullptr if it is closed
+    bool m_isTempFileCreated;                   ///< flag indicating if the temp file was created, it is reopened in append mode
+    ios_base::fmtflags m_tempFileAdjustment;    ///< adjustment of m_pOstream when it was closed, restored when the temp file is reopened
+    list<PerfMarkerItem*>::iterator m_openTempFileIt; ///< position of the item in g_openTempFiles while its temp file is open, when the number of open temp files is capped
+    unsigned long long m_numWrittenLines;       ///< number of lines written to m_pOstream, or of events in the binary format
+    PerfMarkerBinaryEncoder m_binaryEncoder;    ///< encoder of the events written in the binary format, its timestamps are delta encoded
+    size_t m_numAccountedBytes;                 ///< size of the chunks of m_events accounted by the background writer
+    unsigned long long m_numDroppedMarkers;     ///< number of markers dropped because the memory budget was exceeded, not yet recorded as a dropped event
+    vector<PerfMarkerSamplingState> m_samplingStates; ///< the sampling state of the sampled markers, indexed by marker handle - 1
+    PerfMarkerStatisticsList m_statistics;      ///< the statistics of the durations of the markers, in statistics mode
+    vector<PerfMarkerStackEntry> m_markerStack; ///< the markers opened by the thread, the size is the depth of the current marker
+    vector<PerfMarkerArg> m_args;               ///< the arguments of the marker being begun followed by their string values, kept to reuse its memory
+    std::atomic<bool> m_inUse;                  ///< flag indicating that the owning thread is currently recording a marker
+    bool m_isSealed;                            ///< flag indicating that the owning thread has exited and the item was sealed, protected by g_mtx
+
+    // counters for amdtGetActivityLoggerStats, only updated by the owning thread unless noted
+    PerfMarkerCallCounters m_callCounters[PERF_MARKER_CALL_OTHER]; ///< counters of the begin and end calls, indexed by PerfMarkerCallType
+    PerfMarkerThreadCounter m_numRecordedMarkers;       ///< number of markers whose begin was recorded
+    PerfMarkerThreadCounter m_numRecordedEvents;        ///< number of events recorded by the entrypoints
+    PerfMarkerThreadCounter m_numEventBufferBytes;      ///< size of the chunks of m_events
+    PerfMarkerThreadCounter m_numSpilledBytes;          ///< size of the temp file, updated by the thread writing it
+    PerfMarkerThreadCounter m_numAllDroppedMarkers;     ///< number of markers dropped when they began, unlike m_numDroppedMarkers it is not reset once recorded
+    PerfMarkerThreadCounter m_numSampledOutMarkers;     ///< number of instances of sampled markers which were not recorded
+    PerfMarkerThreadCounter m_numLockContentions;       ///< number of times m_eventsMtx was held by the background writer when the thread recorded an event
+    PerfMarkerThreadCounter m_lockWaitNanos;            ///< time spent waiting for m_eventsMtx
 
 private:
     /// Disabled copy contructor
@@ -55,27 +192,70 @@ private:
     PerfMarkerItem& operator = (const PerfMarkerItem& obj);
 };
 
-std::mutex g_mtx;                                      ///< mutex to protect access to marker API
-bool g_bInit = false;                                  ///< global flag indicating if the library has been initialized
-bool g_bFinalized = false;                             ///< global flag indicating if the library has been finalized
+std::mutex g_mtx;                                      ///< mutex to protect initialization, finalization and the perf marker item registry
+std::atomic<bool> g_bInit(false);                      ///< global flag indicating if the library has been initialized
+std::atomic<bool> g_bFinalized(false);                 ///< global flag indicating if the library has been finalized
 
 bool g_isTimeoutMode = false;                          ///< global flag indicating if timeout mode is being used
+bool g_isBinaryFormat = false;                         ///< global flag indicating if the perf marker file is written in the compact binary layout
+bool g_isStatisticsMode = false;                       ///< global flag indicating if marker durations are aggregated instead of recorded
+string g_statisticsFileName;                           ///< name of the statistics file written in statistics mode
+string g_chromeTraceFileName;                          ///< name of the Chrome trace file exported from the perf marker file, empty to not export it
+unsigned int g_flushPeriodMs = s_DEFAULT_FLUSH_PERIOD_MS; ///< period of the flushes of the temp files in timeout mode, 0 to write each event when it is recorded
+bool g_useTickCounter = false;                         ///< global flag indicating if the CPU tick counter should be used to timestamp the markers
+size_t g_maxThreadBufferBytes = 0;                     ///< memory budget of the events recorded by a thread, 0 for no limit
+size_t g_maxTotalBufferBytes = 0;                      ///< memory budget of the events recorded by all the threads, 0 for no limit
+PerfMarkerOverflowPolicy g_overflowPolicy = PERF_MARKER_OVERFLOW_BLOCK; ///< what a thread does when the memory budget is exceeded
+AMDTActivityLoggerBackgroundWriter* g_pBackgroundWriter = nullptr; ///< the background writer spilling or flushing the events to the temp files, nullptr if it is not used
+unsigned int g_maxOpenTempFiles = 0;                   ///< maximum number of temp files open at a time, 0 for no limit
+std::mutex g_tempFilesMtx;                             ///< mutex to protect the temp files and g_openTempFiles when the number of open temp files is capped
+list<PerfMarkerItem*> g_openTempFiles;                 ///< the items whose temp file is open, most recently written first, only used when the number of open temp files is capped
+AMDTActivityLoggerTimeStamp* g_pTimeStamp = nullptr;   ///< the timestamp singleton, cached to avoid its lookup when recording markers
 string g_tempPerfMarkerFile;                           ///< name of the temp perf marker file
 string g_perfFileName;                                 ///< name of the perf marker file
-map<osThreadId, PerfMarkerItem*> g_perfMarkerItemMap;  ///< map from thread id to permarker items
-
-/// ofstream descendant which specifies a file name
-class ofstream_with_filename : public ofstream
+PerfMarkerTable g_markerTable;                         ///< table of the registered marker and group names
+PerfMarkerTriggerList g_triggers;                      ///< the profiling triggers of the markers
+vector<string> g_triggerParams;                        ///< the values of the PerfMarkerTrigger parameters, added to g_triggers once the timestamps are set up
+map<osThreadId, PerfMarkerItem*> g_perfMarkerItemMap;  ///< registry from thread id to permarker items, only used when a thread records its first marker and by amdtFinalizeActivityLogger
+std::atomic<unsigned long long> g_numRegistryLockContentions(0); ///< number of times g_mtx was held by another thread when a thread locked it
+std::atomic<unsigned long long> g_registryLockWaitNanos(0); ///< time spent waiting for g_mtx
+unsigned long long g_finalizeNanos = 0;                ///< time spent in amdtFinalizeActivityLogger, protected by g_mtx
+bool g_isBackgroundWriterNeeded = false;               ///< flag indicating that a forked child process needs its own background writer, started when a thread first records a marker, protected by g_mtx
+
+volatile int amdtActivityLoggerEnabled = 0;               ///< exported flag tested inline by the marker macros of CXLActivityLogger.h
+
+thread_local PerfMarkerItem* t_pPerfMarkerItem = nullptr; ///< the perf marker item of the current thread
+thread_local bool t_isThreadExiting = false;              ///< flag indicating that the thread-local objects of the current thread are being destroyed
+thread_local PerfMarkerItem* t_pForkedPerfMarkerItem = nullptr; ///< in a forked child process, the item of the forking thread in the parent, whose open markers the thread continues
+
+/// Locks g_mtx for the scope of the object, counting the times it was held by another thread
+class ScopedRegistryLock
 {
 public:
     /// Constructor
-    ofstream_with_filename(const char* file)
-        : ofstream(file)
+    ScopedRegistryLock()
     {
-        m_fileName = file;
+        if (!g_mtx.try_lock())
+        {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            g_mtx.lock();
+            g_numRegistryLockContentions.fetch_add(1, std::memory_order_relaxed);
+            g_registryLockWaitNanos.fetch_add(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+        }
+    }
+
+    /// Destructor
+    ~ScopedRegistryLock()
+    {
+        g_mtx.unlock();
     }
 
-    string m_fileName; ///< the filename
+private:
+    /// Disabled copy contructor
+    ScopedRegistryLock(const ScopedRegistryLock& obj);
+
+    /// Disabled assignment operator
+    ScopedRegistryLock& operator = (const ScopedRegistryLock& obj);
 };
 
 /// Gets the name of the temp file used to pass params betwee the GPU profiler and the ActivityLogger
@@ -93,6 +273,34 @@ void GetTempActivityLoggerParamsFile(osFilePath& tempParamsFile)
 #endif
 }
 
+/// Enables or disables the groups of a comma separated list of group names
+/// \param groupNames the list of group names
+/// \param enabled true to enable the groups, false to disable them
+void SetPerfMarkerGroupsEnabled(const gtASCIIString& groupNames, bool enabled)
+{
+    string names = groupNames.asCharArray();
+    size_t start = 0;
+
+    while (start < names.length())
+    {
+        size_t end = names.find(',', start);
+
+        if (end == string::npos)
+        {
+            end = names.length();
+        }
+
+        string groupName = names.substr(start, end - start);
+
+        if (!groupName.empty())
+        {
+            g_markerTable.SetGroupEnabled(groupName.c_str(), enabled);
+        }
+
+        start = end + 1;
+    }
+}
+
 /// Reads the temp params file and sets the global vars
 /// \return true on success
 bool GetParametersFromFile()
@@ -109,6 +317,9 @@ bool GetParametersFromFile()
         bool timeoutParamFound = false;
         bool tempFileParamFound = false;
         bool outputFileParamFound = false;
+        gtASCIIString enabledGroups;
+        gtASCIIString disabledGroups;
+        bool enabledGroupsParamFound = false;
 
         while (tempFile.readLine(line))
         {
@@ -131,365 +342,2192 @@ bool GetParametersFromFile()
                 outputFileParamFound = true;
                 g_perfFileName = value.asCharArray();
             }
+            else if (paramName == "PerfMarkerOutputFormat")
+            {
+                g_isBinaryFormat = value == "Binary";
+            }
+            else if (paramName == "PerfMarkerStatistics")
+            {
+                g_isStatisticsMode = value == "True";
+            }
+            else if (paramName == "PerfMarkerStatisticsFileName")
+            {
+                g_statisticsFileName = value.asCharArray();
+            }
+            else if (paramName == "PerfMarkerChromeTraceFileName")
+            {
+                g_chromeTraceFileName = value.asCharArray();
+            }
+            else if (paramName == "EnabledPerfMarkerGroups")
+            {
+                enabledGroupsParamFound = true;
+                enabledGroups = value;
+            }
+            else if (paramName == "DisabledPerfMarkerGroups")
+            {
+                disabledGroups = value;
+            }
+            else if (paramName == "TimeStampSource")
+            {
+                g_useTickCounter = value == "TSC";
+            }
+            else if (paramName == "PerfMarkerFlushPeriodMs")
+            {
+                g_flushPeriodMs = static_cast<unsigned int>(strtoul(value.asCharArray(), nullptr, 10));
+            }
+            else if (paramName == "PerfMarkerThreadBufferSizeMB")
+            {
+                g_maxThreadBufferBytes = static_cast<size_t>(strtoul(value.asCharArray(), nullptr, 10)) * 1024 * 1024;
+            }
+            else if (paramName == "PerfMarkerTotalBufferSizeMB")
+            {
+                g_maxTotalBufferBytes = static_cast<size_t>(strtoul(value.asCharArray(), nullptr, 10)) * 1024 * 1024;
+            }
+            else if (paramName == "PerfMarkerTrigger")
+            {
+                g_triggerParams.push_back(value.asCharArray());
+            }
+            else if (paramName == "PerfMarkerMaxOpenTempFiles")
+            {
+                g_maxOpenTempFiles = static_cast<unsigned int>(strtoul(value.asCharArray(), nullptr, 10));
+            }
+            else if (paramName == "PerfMarkerOverflowPolicy")
+            {
+                if (value == "DropNewest")
+                {
+                    g_overflowPolicy = PERF_MARKER_OVERFLOW_DROP_NEWEST;
+                }
+                else if (value == "DropOldest")
+                {
+                    g_overflowPolicy = PERF_MARKER_OVERFLOW_DROP_OLDEST;
+                }
+                else
+                {
+                    g_overflowPolicy = PERF_MARKER_OVERFLOW_BLOCK;
+                }
+            }
         }
 
         tempFile.close();
+
+        if (enabledGroupsParamFound)
+        {
+            // only the listed groups are recorded
+            g_markerTable.SetAllGroupsEnabled(false);
+            SetPerfMarkerGroupsEnabled(enabledGroups, true);
+        }
+
+        SetPerfMarkerGroupsEnabled(disabledGroups, false);
+
+        if (g_statisticsFileName.empty())
+        {
+            g_statisticsFileName = g_perfFileName + ".stats";
+        }
+
         retVal = timeoutParamFound && tempFileParamFound && outputFileParamFound;
     }
 
     return retVal;
 }
 
-/// Gets the current perf marker item
-/// \param[out] ppItem the current perf marker item
-/// \return the status code
-int GetPerfMarkerItem(PerfMarkerItem** ppItem)
+void SealPerfMarkerItem(PerfMarkerItem* pItem);
+
+/// Seals the perf marker item of the current thread when the thread exits
+class PerfMarkerThreadExitHook
 {
-    if (ppItem == NULL)
+public:
+    /// Constructor
+    PerfMarkerThreadExitHook()
     {
-        return AL_INTERNAL_ERROR;
+        m_pItem = nullptr;
     }
 
-    ostream* os = NULL;
-    osThreadId tid = osGetUniqueCurrentThreadId();
-    map<osThreadId, PerfMarkerItem*>::const_iterator it;
-    it = g_perfMarkerItemMap.find(tid);
-
-    if (it != g_perfMarkerItemMap.end())
-    {
-        *ppItem = it->second;
-        return AL_SUCCESS;
-    }
-    else
+    /// Destructor, called when the thread exits
+    ~PerfMarkerThreadExitHook()
     {
-        if (g_isTimeoutMode)
-        {
-            stringstream ss;
-            // Timeout mode, create a tmp file
-            string path;
-            osProcessId pid = osGetCurrentProcessId();
+        // a marker recorded by a thread-local destructor run after this one continues the item until finalization
+        t_isThreadExiting = true;
 
-            path = g_tempPerfMarkerFile;
-            ss << path << pid << "_" << tid << "." << AL_PERFMARKER_EXT_NARROW;
-            os = new(nothrow) ofstream_with_filename(ss.str().c_str());
-        }
-        else
+        if (m_pItem != nullptr)
         {
-            os = new(nothrow) stringstream();
+            SealPerfMarkerItem(m_pItem);
         }
+    }
 
-        if (os == NULL)
-        {
-            return AL_OUT_OF_MEMORY;
-        }
+    PerfMarkerItem* m_pItem; ///< the perf marker item of the thread, nullptr if the thread has not recorded a marker
+
+private:
+    /// Disabled copy contructor
+    PerfMarkerThreadExitHook(const PerfMarkerThreadExitHook& obj);
 
-        PerfMarkerItem* pItem = new(nothrow) PerfMarkerItem();
+    /// Disabled assignment operator
+    PerfMarkerThreadExitHook& operator = (const PerfMarkerThreadExitHook& obj);
+};
 
-        if (pItem == NULL)
-        {
-            delete os;
-            return AL_OUT_OF_MEMORY;
-        }
+thread_local PerfMarkerThreadExitHook t_threadExitHook; ///< seals the perf marker item of the current thread when it exits, armed when the item is registered
 
-        pItem->m_depth = 0;
-        pItem->m_pOstream = os;
-        g_perfMarkerItemMap.insert(pair<osThreadId, PerfMarkerItem*>(tid, pItem));
+/// Makes a perf marker item the item of the current thread, and arms the thread exit hook
+/// \param pItem the perf marker item
+void SetCurrentPerfMarkerItem(PerfMarkerItem* pItem)
+{
+    t_pPerfMarkerItem = pItem;
 
-        *ppItem = pItem;
-        return AL_SUCCESS;
+    if (!t_isThreadExiting)
+    {
+        t_threadExitHook.m_pItem = pItem;
     }
 }
 
-extern "C"
-int AL_API_CALL amdtInitializeActivityLogger()
+void StartPerfMarkerBackgroundWriter(AMDTActivityLoggerBackgroundWriter* pBackgroundWriter);
+
+/// Creates the perf marker item of a thread and adds it to the registry. g_mtx must be held.
+/// \param tid the thread id
+/// \return the perf marker item, nullptr if it could not be allocated
+PerfMarkerItem* CreatePerfMarkerItem(osThreadId tid)
 {
-    std::lock_guard<std::mutex> lock(g_mtx);
+    PerfMarkerItem* pItem = new(nothrow) PerfMarkerItem();
 
-    if (g_bInit)
+    if (pItem == NULL)
     {
-        return AL_SUCCESS;
+        return nullptr;
     }
 
-    if (g_bFinalized)
+    if (g_isTimeoutMode || g_pBackgroundWriter != nullptr)
     {
-        return AL_FINALIZED_ACTIVITY_LOGGER;
+        // Timeout mode or events spilled to disk, the tmp file is created when the first events are written to it
+        stringstream ss;
+        osProcessId pid = osGetCurrentProcessId();
+        ss << g_tempPerfMarkerFile << pid << "_" << tid << "." << AL_PERFMARKER_EXT_NARROW;
+        pItem->m_tempFileName = ss.str();
     }
 
+    g_perfMarkerItemMap.insert(pair<osThreadId, PerfMarkerItem*>(tid, pItem));
 
-    gtString envVarValue;
-    bool envVarFound = osGetCurrentProcessEnvVariableValue(AL_CL_AGENT, envVarValue);
+    if (g_pBackgroundWriter != nullptr)
+    {
+        g_pBackgroundWriter->AddTarget(*pItem);
+    }
 
-    bool isTraceAgentFound = false;
+    return pItem;
+}
 
-    if (envVarFound && !envVarValue.isEmpty())
+/// Gets the perf marker item for the current thread from the registry, creating it if needed
+/// Called once per thread, the first time the thread records a marker
+/// \param[out] ppItem the current perf marker item
+/// \return the status code
+int RegisterPerfMarkerItem(PerfMarkerItem** ppItem)
+{
+    ScopedRegistryLock lock;
+
+    if (g_bFinalized)
     {
-        isTraceAgentFound = -1 != envVarValue.find(AL_CL_TRACE_AGENT_DLL);
+        return AL_FINALIZED_ACTIVITY_LOGGER;
     }
 
-    if (!isTraceAgentFound)
+    if (g_isBackgroundWriterNeeded)
     {
-        envVarFound = osGetCurrentProcessEnvVariableValue(AL_HSA_TOOLS_LIB, envVarValue);
+        // first marker of a forked child process, the thread of the background writer of the parent does not exist in the child
+        g_isBackgroundWriterNeeded = false;
+        StartPerfMarkerBackgroundWriter(new(nothrow) AMDTActivityLoggerBackgroundWriter());
+    }
 
-        if (envVarFound && !envVarValue.isEmpty())
+    osThreadId tid = osGetUniqueCurrentThreadId();
+    map<osThreadId, PerfMarkerItem*>::const_iterator it;
+    it = g_perfMarkerItemMap.find(tid);
+
+    if (it != g_perfMarkerItemMap.end())
+    {
+        // the thread id has been recycled from a thread that has exited, continue its perf marker item
+        PerfMarkerItem* pItem = it->second;
+
+        if (pItem->m_isSealed)
         {
-            isTraceAgentFound = -1 != envVarValue.find(AL_HSA_TRACE_AGENT_DLL);
+            pItem->m_isSealed = false;
+            pItem->m_markerStack.reserve(s_INITIAL_MARKER_STACK_SIZE);
+
+            if (g_pBackgroundWriter != nullptr)
+            {
+                g_pBackgroundWriter->AddTarget(*pItem);
+            }
         }
+
+        SetCurrentPerfMarkerItem(pItem);
+        *ppItem = pItem;
+        return AL_SUCCESS;
     }
 
-    if (!isTraceAgentFound)
+    PerfMarkerItem* pItem = CreatePerfMarkerItem(tid);
+
+    if (pItem == nullptr)
     {
-        return AL_GPU_PROFILER_NOT_DETECTED;
+        return AL_OUT_OF_MEMORY;
     }
 
-    g_bInit = true;
-
-    if (!GetParametersFromFile())
+    if (t_pForkedPerfMarkerItem != nullptr)
     {
-        return AL_GPU_PROFILER_MISMATCH;
+        // the child continues the markers opened by the forking thread, their ends are not recorded as their begins are in the trace of the parent
+        pItem->m_markerStack = t_pForkedPerfMarkerItem->m_markerStack;
+        t_pForkedPerfMarkerItem = nullptr;
+
+        for (size_t i = 0; i < pItem->m_markerStack.size(); i++)
+        {
+            pItem->m_markerStack[i].m_recorded = false;
+            pItem->m_markerStack[i].m_triggerInstance = 0;
+        }
     }
 
+    SetCurrentPerfMarkerItem(pItem);
+
+    *ppItem = pItem;
     return AL_SUCCESS;
 }
 
-const size_t s_DEFAULT_MARKER_NAME_WIDTH = 50; ///< default marker name width
-
-extern "C"
-int AL_API_CALL amdtBeginMarker(const char* szMarkerName, const char* szGroupName, const char* szUserString)
+/// Gives the current thread exclusive use of its perf marker item for the duration of one marker call.
+/// amdtFinalizeActivityLogger waits for all items to be released before reading them, so the
+/// marker entry points never need to take g_mtx once the thread's item is registered.
+class ScopedPerfMarkerItem
 {
-    // TODO: szUserString is currently unused. Need to use it.
-    (void)(szUserString);
+public:
+    /// Constructor
+    /// \param callType the type of the entrypoint, its begin and end calls are counted and 1 in s_STATS_TIMING_INTERVAL is timed
+    ScopedPerfMarkerItem(PerfMarkerCallType callType = PERF_MARKER_CALL_OTHER)
+    {
+        m_pItem = t_pPerfMarkerItem;
+        m_status = AL_SUCCESS;
+        m_pCallCounters = nullptr;
+        m_startTimeStamp = 0;
 
-    std::lock_guard<std::mutex> lock(g_mtx);
+        if (m_pItem == nullptr)
+        {
+            m_status = RegisterPerfMarkerItem(&m_pItem);
 
-    if (!g_bInit)
-    {
-        return AL_UNINITIALIZED_ACTIVITY_LOGGER;
-    }
+            if (m_status != AL_SUCCESS)
+            {
+                m_pItem = nullptr;
+                return;
+            }
+        }
 
-    if (g_bFinalized)
-    {
-        return AL_FINALIZED_ACTIVITY_LOGGER;
-    }
+        // this store and the load of g_bFinalized pair with the store of g_bFinalized and the load of
+        // m_inUse in amdtFinalizeActivityLogger: at least one side is guaranteed to see the other
+        m_pItem->m_inUse.store(true);
 
-    if (szMarkerName == NULL)
-    {
-        return AL_NULL_MARKER_NAME;
-    }
+        if (g_bFinalized.load())
+        {
+            m_pItem->m_inUse.store(false, std::memory_order_release);
+            m_pItem = nullptr;
+            m_status = AL_FINALIZED_ACTIVITY_LOGGER;
+            return;
+        }
 
-    gtASCIIString strGroupName;
+        if (callType != PERF_MARKER_CALL_OTHER)
+        {
+            PerfMarkerCallCounters& counters = m_pItem->m_callCounters[callType];
 
-    if (szGroupName == NULL)
-    {
-        strGroupName = DEFAULT_GROUP;
-    }
-    else
-    {
-        strGroupName = szGroupName;
+            if (counters.m_numCalls.Get() % s_STATS_TIMING_INTERVAL == 0)
+            {
+                m_pCallCounters = &counters;
+                m_startTimeStamp = g_pTimeStamp->GetTimeStamp();
+            }
+
+            counters.m_numCalls.Add(1);
+        }
     }
 
-    if (strGroupName.isEmpty())
+    /// Destructor
+    ~ScopedPerfMarkerItem()
     {
-        strGroupName = DEFAULT_GROUP;
+        if (m_pItem != nullptr)
+        {
+            if (m_pCallCounters != nullptr)
+            {
+                m_pCallCounters->m_timedDuration.Add(g_pTimeStamp->GetTimeStamp() - m_startTimeStamp);
+                m_pCallCounters->m_numTimedCalls.Add(1);
+            }
+
+            m_pItem->m_inUse.store(false, std::memory_order_release);
+        }
     }
 
-    gtASCIIString strMarkerName(szMarkerName);
+    /// Gets the perf marker item of the current thread
+    /// \return the perf marker item, nullptr if GetStatus() is not AL_SUCCESS
+    PerfMarkerItem* GetItem() const { return m_pItem; }
 
-    PerfMarkerItem* pItem;
-    int ret = GetPerfMarkerItem(&pItem);
+    /// Gets the status of the acquisition of the perf marker item
+    /// \return the status code
+    int GetStatus() const { return m_status; }
 
-    if (ret != AL_SUCCESS)
-    {
-        return ret;
-    }
+private:
+    /// Disabled copy contructor
+    ScopedPerfMarkerItem(const ScopedPerfMarkerItem& obj);
 
-    strMarkerName.replace(" ", AL_SPACE);
-    strGroupName.replace(" ", AL_SPACE);
+    /// Disabled assignment operator
+    ScopedPerfMarkerItem& operator = (const ScopedPerfMarkerItem& obj);
 
-    bool fit = static_cast<size_t>(strMarkerName.length()) < s_DEFAULT_MARKER_NAME_WIDTH;
+    PerfMarkerItem* m_pItem;                    ///< the perf marker item of the current thread
+    int m_status;                               ///< the status of the acquisition
+    PerfMarkerCallCounters* m_pCallCounters;    ///< the counters of the call if it is timed, nullptr otherwise
+    unsigned long long m_startTimeStamp;        ///< the timestamp of the start of the call if it is timed
+};
 
-    if (fit)
+/// Converts the timestamps of events recorded by a thread to nanoseconds, when the tick counter is used
+/// \param pItem the perf marker item of the thread
+/// \param pFirstChunk the first of the chunks holding the events
+void ConvertPerfMarkerEventTimeStamps(PerfMarkerItem* pItem, PerfMarkerEventChunk* pFirstChunk)
+{
+    if (g_pTimeStamp->GetNumCalibrationPoints() == 0)
     {
-        (*pItem->m_pOstream) << left << setw(20) << "clBeginPerfMarker" << left << setw(s_DEFAULT_MARKER_NAME_WIDTH) << strMarkerName.asCharArray() << setw(20) << AMDTActivityLoggerTimeStamp::Instance()->GetTimeNanos() << "   " << strGroupName.asCharArray() << endl;
+        return;
     }
-    else
+
+    TimeStampConverter& converter = pItem->m_timeStampConverter;
+
+    if (converter.GetNumCalibrationPoints() != g_pTimeStamp->GetNumCalibrationPoints())
     {
-        // super long marker name
-        (*pItem->m_pOstream) << "clBeginPerfMarker   " << strMarkerName.asCharArray() << "   " << AMDTActivityLoggerTimeStamp::Instance()->GetTimeNanos() << "   " << strGroupName.asCharArray() << endl;
+        g_pTimeStamp->GetConverter(converter);
     }
 
-    pItem->m_depth++;
+    for (PerfMarkerEventChunk* pChunk = pFirstChunk; pChunk != nullptr; pChunk = pChunk->m_pNext)
+    {
+        size_t slot = 0;
 
-    return AL_SUCCESS;
+        while (slot < pChunk->m_usedSlots)
+        {
+            PerfMarkerEvent& event = pChunk->m_pSlots[slot];
+            event.m_timestamp = converter.ConvertToNanos(event.m_timestamp);
+            slot += event.GetNumSlots();
+        }
+    }
 }
 
-extern "C"
-int AL_API_CALL amdtEndMarker()
+/// Writes events of a thread in the output layout
+/// \param pItem the perf marker item of the thread
+/// \param os the stream to write to
+/// \param pFirstChunk the first of the chunks holding the events
+/// \return the number of lines written, or of events in the binary format
+unsigned long long WritePerfMarkerItemChunks(PerfMarkerItem* pItem, ostream& os, const PerfMarkerEventChunk* pFirstChunk)
 {
-    return amdtEndMarkerEx("", "", "");
+    if (g_isBinaryFormat)
+    {
+        pItem->m_binaryEncoder.Write(os, pFirstChunk);
+        return GetPerfMarkerEventChunksNumEvents(pFirstChunk);
+    }
+
+    WritePerfMarkerEventChunksText(os, pFirstChunk, g_markerTable);
+    return GetPerfMarkerEventChunksNumLines(pFirstChunk);
 }
 
-extern "C"
-int AL_API_CALL amdtEndMarkerEx(const char* szMarkerName, const char* szGroupName, const char* szUserString)
+/// Closes the temp file of a thread if it is open, keeping the adjustment of its stream for when it is reopened.
+/// Called with g_tempFilesMtx locked when the number of open temp files is capped
+/// \param pItem the perf marker item of the thread
+void ReleasePerfMarkerItemTempFile(PerfMarkerItem* pItem)
 {
-    // TODO: szUserString is currently unused. Need to use it.
-    (void)(szUserString);
-
-    std::lock_guard<std::mutex> lock(g_mtx);
-
-    if (!g_bInit)
+    if (pItem->m_pOstream == nullptr)
     {
-        return AL_UNINITIALIZED_ACTIVITY_LOGGER;
+        return;
     }
 
-    if (g_bFinalized)
+    pItem->m_tempFileAdjustment = pItem->m_pOstream->flags() & ios_base::adjustfield;
+    delete pItem->m_pOstream;
+    pItem->m_pOstream = nullptr;
+
+    if (g_maxOpenTempFiles != 0)
     {
-        return AL_FINALIZED_ACTIVITY_LOGGER;
+        g_openTempFiles.erase(pItem->m_openTempFileIt);
     }
+}
 
-    if (szMarkerName == NULL)
+/// Closes the temp file of a thread if it is open
+/// \param pItem the perf marker item of the thread
+void ClosePerfMarkerItemTempFile(PerfMarkerItem* pItem)
+{
+    std::unique_lock<std::mutex> lock(g_tempFilesMtx, std::defer_lock);
+
+    if (g_maxOpenTempFiles != 0)
     {
-        return AL_NULL_MARKER_NAME;
+        lock.lock();
     }
 
-    string strGroupName(DEFAULT_GROUP);
+    ReleasePerfMarkerItemTempFile(pItem);
+}
 
-    if (szGroupName != NULL)
+/// Opens the temp file of a thread if it is closed, in append mode if it was created before. When the number of
+/// open temp files is capped, the least recently written temp files are closed to stay within the cap.
+/// Called with g_tempFilesMtx locked when the number of open temp files is capped
+/// \param pItem the perf marker item of the thread
+/// \return the stream of the temp file, nullptr if it could not be allocated
+ofstream* OpenPerfMarkerItemTempFile(PerfMarkerItem* pItem)
+{
+    if (pItem->m_pOstream != nullptr)
     {
-        strGroupName = szGroupName;
-
-        if (strGroupName.empty())
+        if (g_maxOpenTempFiles != 0 && pItem->m_openTempFileIt != g_openTempFiles.begin())
         {
-            strGroupName = DEFAULT_GROUP;
+            g_openTempFiles.splice(g_openTempFiles.begin(), g_openTempFiles, pItem->m_openTempFileIt);
         }
-    }
 
-    string strMarkerName(szMarkerName);
+        return pItem->m_pOstream;
+    }
 
-    PerfMarkerItem* pItem;
-    int ret = GetPerfMarkerItem(&pItem);
+    while (g_maxOpenTempFiles != 0 && g_openTempFiles.size() >= g_maxOpenTempFiles)
+    {
+        ReleasePerfMarkerItemTempFile(g_openTempFiles.back());
+    }
+
+    ios_base::openmode mode = g_isBinaryFormat ? ios_base::out | ios_base::binary : ios_base::out;
+
+    if (pItem->m_isTempFileCreated)
+    {
+        mode |= ios_base::app;
+    }
+
+    pItem->m_pOstream = new(nothrow) ofstream(pItem->m_tempFileName.c_str(), mode);
+
+    if (pItem->m_pOstream == nullptr)
+    {
+        return nullptr;
+    }
+
+    // the text writer continues the lines written before the file was closed with the same adjustment
+    pItem->m_pOstream->setf(pItem->m_tempFileAdjustment, ios_base::adjustfield);
+    pItem->m_isTempFileCreated = true;
+
+    if (g_maxOpenTempFiles != 0)
+    {
+        g_openTempFiles.push_front(pItem);
+        pItem->m_openTempFileIt = g_openTempFiles.begin();
+    }
+
+    return pItem->m_pOstream;
+}
+
+/// Gives access to the temp file of a thread for the duration of a write, opening it if it is closed.
+/// When the number of open temp files is capped, g_tempFilesMtx is held for the duration of the write.
+class ScopedPerfMarkerTempFile
+{
+public:
+    /// Constructor
+    /// \param pItem the perf marker item of the thread
+    ScopedPerfMarkerTempFile(PerfMarkerItem* pItem)
+    {
+        if (g_maxOpenTempFiles != 0)
+        {
+            m_lock = std::unique_lock<std::mutex>(g_tempFilesMtx);
+        }
+
+        m_pStream = OpenPerfMarkerItemTempFile(pItem);
+    }
+
+    /// Gets the stream of the temp file
+    /// \return the stream, nullptr if the temp file could not be opened
+    ofstream* GetStream() const { return m_pStream; }
+
+private:
+    /// Disabled copy contructor
+    ScopedPerfMarkerTempFile(const ScopedPerfMarkerTempFile& obj);
+
+    /// Disabled assignment operator
+    ScopedPerfMarkerTempFile& operator = (const ScopedPerfMarkerTempFile& obj);
+
+    std::unique_lock<std::mutex> m_lock;    ///< the lock of g_tempFilesMtx when the number of open temp files is capped
+    ofstream* m_pStream;                    ///< the stream of the temp file
+};
+
+/// Flushes the temp file of a thread and publishes its size for amdtGetActivityLoggerStats
+/// \param pItem the perf marker item of the thread
+void FlushPerfMarkerItemStream(PerfMarkerItem* pItem)
+{
+    pItem->m_pOstream->flush();
+    streampos size = pItem->m_pOstream->tellp();
+
+    if (size != streampos(-1))
+    {
+        pItem->m_numSpilledBytes.Set(static_cast<unsigned long long>(size));
+    }
+}
+
+void PerfMarkerItem::WriteSpilledEvents(PerfMarkerEventChunk* pChunks)
+{
+    // the owning thread keeps recording to its event buffer, only the background writer uses the temp file until the thread exits
+    ConvertPerfMarkerEventTimeStamps(this, pChunks);
+    ScopedPerfMarkerTempFile tempFile(this);
+
+    if (tempFile.GetStream() != nullptr)
+    {
+        m_numWrittenLines += WritePerfMarkerItemChunks(this, *tempFile.GetStream(), pChunks);
+        FlushPerfMarkerItemStream(this);
+    }
+}
+
+void PerfMarkerItem::FlushBufferedEvents()
+{
+    {
+        // the owning thread only holds the lock while appending an event
+        std::lock_guard<std::mutex> lock(m_eventsMtx);
+        m_events.Swap(m_flushedEvents);
+    }
+
+    if (m_flushedEvents.IsEmpty())
+    {
+        // the temp file of an idle thread is not reopened
+        return;
+    }
+
+    ConvertPerfMarkerEventTimeStamps(this, m_flushedEvents.GetFirstChunk());
+    ScopedPerfMarkerTempFile tempFile(this);
+
+    if (tempFile.GetStream() != nullptr)
+    {
+        m_numWrittenLines += WritePerfMarkerItemChunks(this, *tempFile.GetStream(), m_flushedEvents.GetFirstChunk());
+        FlushPerfMarkerItemStream(this);
+    }
+
+    m_flushedEvents.Clear();
+}
+
+/// Writes the events recorded by a thread to its temp file and clears its event buffer, in timeout mode or when the thread exits
+/// \param pItem the perf marker item of the thread
+void WritePerfMarkerItemEvents(PerfMarkerItem* pItem)
+{
+    if (pItem->m_events.IsEmpty())
+    {
+        return;
+    }
+
+    ConvertPerfMarkerEventTimeStamps(pItem, pItem->m_events.GetFirstChunk());
+    ScopedPerfMarkerTempFile tempFile(pItem);
+
+    if (tempFile.GetStream() != nullptr)
+    {
+        pItem->m_numWrittenLines += WritePerfMarkerItemChunks(pItem, *tempFile.GetStream(), pItem->m_events.GetFirstChunk());
+        FlushPerfMarkerItemStream(pItem);
+    }
+
+    pItem->m_events.Clear();
+}
+
+/// Records the markers of a thread dropped since its last recorded event, if any
+/// \param pItem the perf marker item of the thread
+/// \return false if the buffer could not be grown to hold the dropped event
+bool RecordDroppedPerfMarkers(PerfMarkerItem* pItem)
+{
+    if (pItem->m_numDroppedMarkers != 0)
+    {
+        if (!pItem->m_events.AddEvent(PERF_MARKER_EVENT_DROPPED, g_pTimeStamp->GetTimeStamp(), 0, &pItem->m_numDroppedMarkers, sizeof(pItem->m_numDroppedMarkers)))
+        {
+            return false;
+        }
+
+        pItem->m_numDroppedMarkers = 0;
+    }
+
+    return true;
+}
+
+/// Records a perf marker event for the current thread
+/// In timeout mode the event is written to the thread's temp file by the next periodic flush of the
+/// background writer, or immediately without periodic flushes. Otherwise it is kept in the thread's
+/// event buffer until amdtFinalizeActivityLogger or until the background writer spills it to the
+/// thread's temp file
+/// \param pItem the perf marker item of the current thread
+/// \param type the PerfMarkerEventType of the event
+/// \param markerHandle the handle of the marker in g_markerTable, 0 for events without names
+/// \param pPayload the payload of the event, nullptr for events without payload
+/// \param payloadSize the size of the payload in bytes
+/// \param szUserString the user string passed with a begin or end event, nullptr or empty for none
+/// \param pArgs the arguments passed with a begin event followed by their string values, nullptr for none
+/// \param argsSize the size in bytes of the arguments and their string values
+/// \return the status code
+int RecordPerfMarkerEvent(PerfMarkerItem* pItem, PerfMarkerEventType type, unsigned int markerHandle, const void* pPayload = nullptr, size_t payloadSize = 0,
+                          const char* szUserString = nullptr, const PerfMarkerArg* pArgs = nullptr, size_t argsSize = 0)
+{
+    std::unique_lock<std::mutex> lock(pItem->m_eventsMtx, std::defer_lock);
+
+    if (g_isTimeoutMode && g_pBackgroundWriter != nullptr && !lock.try_lock())
+    {
+        // the background writer is flushing the events of the thread
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        lock.lock();
+        pItem->m_numLockContentions.Add(1);
+        pItem->m_lockWaitNanos.Add(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+    }
+
+    if (!RecordDroppedPerfMarkers(pItem))
+    {
+        return AL_OUT_OF_MEMORY;
+    }
+
+    unsigned long long timeStamp = g_pTimeStamp->GetTimeStamp();
+    bool added;
+
+    if (pPayload == nullptr)
+    {
+        added = pItem->m_events.AddEvent(type, timeStamp, markerHandle);
+    }
+    else
+    {
+        added = pItem->m_events.AddEvent(type, timeStamp, markerHandle, pPayload, payloadSize);
+    }
+
+    if (!added)
+    {
+        return AL_OUT_OF_MEMORY;
+    }
+
+    pItem->m_numRecordedEvents.Add(1);
+
+    if (argsSize != 0)
+    {
+        // one slot per argument then the string values, the event is kept without its arguments if they do not fit
+        pItem->m_events.AddEvent(PERF_MARKER_EVENT_ARGS, timeStamp, 0, pArgs, argsSize);
+    }
+
+    if (szUserString != nullptr && szUserString[0] != '\0')
+    {
+        // the user string is only copied, it is parsed when the events are written.
+        // The event is kept without its user string if the user string does not fit.
+        pItem->m_events.AddEvent(PERF_MARKER_EVENT_USER_STRING, timeStamp, 0, szUserString, strlen(szUserString) + 1);
+    }
+
+    if (pItem->m_events.GetNumBytes() != pItem->m_numEventBufferBytes.Get())
+    {
+        pItem->m_numEventBufferBytes.Set(pItem->m_events.GetNumBytes());
+    }
+
+    if (g_isTimeoutMode)
+    {
+        if (g_pBackgroundWriter == nullptr)
+        {
+            WritePerfMarkerItemEvents(pItem);
+        }
+    }
+    else if (g_pBackgroundWriter != nullptr && pItem->m_events.GetNumBytes() != pItem->m_numAccountedBytes)
+    {
+        // a chunk was added, hand the full chunks over to the background writer
+        g_pBackgroundWriter->OnBufferGrown(*pItem, pItem->m_events, pItem->m_events.GetNumBytes() - pItem->m_numAccountedBytes);
+        pItem->m_numAccountedBytes = pItem->m_events.GetNumBytes();
+    }
+
+    return AL_SUCCESS;
+}
+
+/// Decides whether to record an instance of a sampled marker and records its begin event if so.
+/// The decision only uses the state of the current thread.
+/// \param pItem the perf marker item of the current thread
+/// \param markerHandle the handle of the marker in g_markerTable
+/// \param sampleInterval only 1 in sampleInterval instances is recorded, 0 or 1 to record all instances
+/// \param maxSamplesPerMillisecond maximum number of instances recorded per millisecond, 0 for no limit
+/// \param szUserString the user string passed to amdtBeginMarker, nullptr for none
+/// \param pArgs the arguments passed to amdtBeginMarkerArgs followed by their string values, nullptr for none
+/// \param argsSize the size in bytes of the arguments and their string values
+/// \param[out] recorded true if the instance was recorded
+/// \return the status code
+int BeginSampledPerfMarker(PerfMarkerItem* pItem, unsigned int markerHandle, unsigned int sampleInterval, unsigned int maxSamplesPerMillisecond,
+                           const char* szUserString, const PerfMarkerArg* pArgs, size_t argsSize, bool& recorded)
+{
+    recorded = false;
+
+    if (pItem->m_samplingStates.size() < markerHandle)
+    {
+        PerfMarkerSamplingState initialState = { 0, 0, 0, 0 };
+        pItem->m_samplingStates.resize(markerHandle, initialState);
+    }
+
+    PerfMarkerSamplingState& state = pItem->m_samplingStates[markerHandle - 1];
+    state.m_numInstances++;
+
+    if (sampleInterval > 1)
+    {
+        unsigned int position = state.m_intervalPosition;
+        state.m_intervalPosition = position + 1 < sampleInterval ? position + 1 : 0;
+
+        if (position != 0)
+        {
+            pItem->m_numSampledOutMarkers.Add(1);
+            return AL_SUCCESS;
+        }
+    }
+
+    if (maxSamplesPerMillisecond != 0)
+    {
+        unsigned long long timeStamp = g_pTimeStamp->GetTimeStamp();
+
+        if (timeStamp - state.m_windowStart >= g_pTimeStamp->GetTimeStampsPerMillisecond())
+        {
+            state.m_windowStart = timeStamp;
+            state.m_numWindowSamples = 0;
+        }
+
+        if (state.m_numWindowSamples >= maxSamplesPerMillisecond)
+        {
+            pItem->m_numSampledOutMarkers.Add(1);
+            return AL_SUCCESS;
+        }
+
+        state.m_numWindowSamples++;
+    }
+
+    // the sample represents the instances skipped since the previous sample
+    int ret = RecordPerfMarkerEvent(pItem, PERF_MARKER_EVENT_SAMPLED_BEGIN, markerHandle, &state.m_numInstances, sizeof(state.m_numInstances), szUserString, pArgs, argsSize);
+
+    if (ret != AL_SUCCESS)
+    {
+        return ret;
+    }
+
+    state.m_numInstances = 0;
+    recorded = true;
+
+    return AL_SUCCESS;
+}
+
+/// Records the instances of the sampled markers of a thread that were skipped after their last sample
+/// \param pItem the perf marker item of the thread
+void RecordSkippedPerfMarkers(PerfMarkerItem* pItem)
+{
+    for (size_t i = 0; i < pItem->m_samplingStates.size(); i++)
+    {
+        PerfMarkerSamplingState& state = pItem->m_samplingStates[i];
+
+        if (state.m_numInstances != 0)
+        {
+            pItem->m_events.AddEvent(PERF_MARKER_EVENT_SKIPPED, g_pTimeStamp->GetTimeStamp(), static_cast<unsigned int>(i + 1), &state.m_numInstances, sizeof(state.m_numInstances));
+            state.m_numInstances = 0;
+        }
+    }
+}
+
+/// Seals the perf marker item of a thread which exits. Its remaining events are written to its temp file, or kept
+/// in a single chunk of their exact size, and its temp file, recording buffers and sampling states are released.
+/// The item stays in g_perfMarkerItemMap for amdtFinalizeActivityLogger, and is continued if the thread id is recycled.
+/// \param pItem the perf marker item of the exiting thread
+void SealPerfMarkerItem(PerfMarkerItem* pItem)
+{
+    ScopedRegistryLock lock;
+    t_pPerfMarkerItem = nullptr;
+
+    if (!g_bInit || g_bFinalized || pItem->m_isSealed)
+    {
+        return;
+    }
+
+    if (g_pBackgroundWriter != nullptr)
+    {
+        // wait for the background writer to be done with the item, its queued events are written first
+        g_pBackgroundWriter->RemoveTarget(*pItem);
+    }
+
+    RecordSkippedPerfMarkers(pItem);
+    RecordDroppedPerfMarkers(pItem);
+
+    if (!pItem->m_tempFileName.empty())
+    {
+        WritePerfMarkerItemEvents(pItem);
+        ClosePerfMarkerItemTempFile(pItem);
+    }
+
+    pItem->m_events.Compact();
+    pItem->m_flushedEvents.Compact();
+
+    if (g_pBackgroundWriter != nullptr && !g_isTimeoutMode)
+    {
+        // the events recorded since the last chunk was accounted are not accounted either
+        g_pBackgroundWriter->OnChunksFreed(*pItem, pItem->m_numAccountedBytes - pItem->m_events.GetNumBytes());
+        pItem->m_numAccountedBytes = pItem->m_events.GetNumBytes();
+    }
+
+    pItem->m_numEventBufferBytes.Set(pItem->m_events.GetNumBytes());
+    vector<PerfMarkerSamplingState>().swap(pItem->m_samplingStates);
+
+    if (pItem->m_markerStack.empty())
+    {
+        vector<PerfMarkerStackEntry>().swap(pItem->m_markerStack);
+    }
+
+    pItem->m_isSealed = true;
+}
+
+/// Opens a marker for the current thread, recording its begin event if the marker's group is enabled
+/// and, for a sampled marker, if the instance is sampled. In statistics mode only the begin timestamp is kept.
+/// \param pItem the perf marker item of the current thread
+/// \param markerHandle the handle of the marker in g_markerTable
+/// \param szUserString the user string passed to amdtBeginMarker, nullptr for none
+/// \param pArgs the arguments passed to amdtBeginMarkerArgs followed by their string values, nullptr for none
+/// \param argsSize the size in bytes of the arguments and their string values
+/// \return the status code
+int BeginPerfMarker(PerfMarkerItem* pItem, unsigned int markerHandle, const char* szUserString, const PerfMarkerArg* pArgs = nullptr, size_t argsSize = 0)
+{
+    PerfMarkerStackEntry entry;
+    entry.m_markerHandle = markerHandle;
+    entry.m_recorded = g_markerTable.IsEnabled(markerHandle);
+    entry.m_beginTimeStamp = 0;
+    entry.m_triggerId = g_markerTable.Get(markerHandle).m_triggerId.load(std::memory_order_acquire);
+    entry.m_triggerInstance = 0;
+
+    if (g_triggers.HasDeadline())
+    {
+        g_triggers.CheckDeadlines(g_pTimeStamp->GetTimeStamp());
+    }
+
+    if (g_isStatisticsMode)
+    {
+        // all the instances are aggregated, sampling does not apply
+        if (entry.m_recorded)
+        {
+            entry.m_beginTimeStamp = g_pTimeStamp->GetTimeStamp();
+        }
+    }
+    else if (entry.m_recorded && g_pBackgroundWriter != nullptr && g_pBackgroundWriter->IsOverBudget(*pItem) && !g_pBackgroundWriter->MakeRoom(*pItem))
+    {
+        // the marker is dropped, its end event is not recorded either
+        entry.m_recorded = false;
+        pItem->m_numDroppedMarkers++;
+        pItem->m_numAllDroppedMarkers.Add(1);
+    }
+    else if (entry.m_recorded)
+    {
+        const PerfMarkerInfo& info = g_markerTable.Get(markerHandle);
+        unsigned int sampleInterval = info.m_sampleInterval.load(std::memory_order_relaxed);
+        unsigned int maxSamplesPerMillisecond = info.m_maxSamplesPerMillisecond.load(std::memory_order_relaxed);
+        int ret;
+
+        if (sampleInterval > 1 || maxSamplesPerMillisecond != 0)
+        {
+            ret = BeginSampledPerfMarker(pItem, markerHandle, sampleInterval, maxSamplesPerMillisecond, szUserString, pArgs, argsSize, entry.m_recorded);
+        }
+        else
+        {
+            ret = RecordPerfMarkerEvent(pItem, PERF_MARKER_EVENT_BEGIN, markerHandle, nullptr, 0, szUserString, pArgs, argsSize);
+        }
+
+        if (ret != AL_SUCCESS)
+        {
+            return ret;
+        }
+    }
+
+    if (entry.m_triggerId != 0)
+    {
+        // triggers apply to all the instances, whether they are recorded or not
+        entry.m_triggerInstance = g_triggers.OnBegin(entry.m_triggerId, g_pTimeStamp->GetTimeStamp());
+    }
+
+    pItem->m_markerStack.push_back(entry);
+
+    if (entry.m_recorded)
+    {
+        pItem->m_numRecordedMarkers.Add(1);
+    }
+
+    return AL_SUCCESS;
+}
+
+/// Opens a marker whose names could not be registered because the marker table is full or out of memory.
+/// The marker is dropped, but it is pushed on the marker stack so that its end does not close the enclosing marker.
+/// \param pItem the perf marker item of the current thread
+/// \return the status code
+int BeginUnregisteredPerfMarker(PerfMarkerItem* pItem)
+{
+    PerfMarkerStackEntry entry;
+    entry.m_markerHandle = 0;
+    entry.m_recorded = false;
+    entry.m_beginTimeStamp = 0;
+    entry.m_triggerId = 0;
+    entry.m_triggerInstance = 0;
+
+    if (!g_isStatisticsMode)
+    {
+        pItem->m_numDroppedMarkers++;
+        pItem->m_numAllDroppedMarkers.Add(1);
+    }
+
+    pItem->m_markerStack.push_back(entry);
+
+    return AL_SUCCESS;
+}
+
+/// Closes the innermost marker of the current thread, recording its end event if its begin event was recorded.
+/// In statistics mode the duration of the marker is added to the thread's statistics instead.
+/// \param pItem the perf marker item of the current thread
+/// \param type the PerfMarkerEventType of the end event
+/// \param markerHandle the handle of the marker in g_markerTable to record with the end event
+/// \param szUserString the user string passed to amdtEndMarkerEx, nullptr for none
+/// \return the status code
+int EndPerfMarker(PerfMarkerItem* pItem, PerfMarkerEventType type, unsigned int markerHandle, const char* szUserString)
+{
+    if (pItem->m_markerStack.empty())
+    {
+        return AL_UNBALANCED_MARKER;
+    }
+
+    const PerfMarkerStackEntry& entry = pItem->m_markerStack.back();
+
+    if (g_isStatisticsMode)
+    {
+        if (entry.m_recorded)
+        {
+            unsigned long long duration = g_pTimeStamp->GetTimeStamp() - entry.m_beginTimeStamp;
+
+            // the name passed to amdtEndMarkerEx replaces the name passed to amdtBeginMarker
+            PerfMarkerStatistics* pStatistics = pItem->m_statistics.Get(markerHandle != 0 ? markerHandle : entry.m_markerHandle);
+
+            if (pStatistics == nullptr)
+            {
+                return AL_OUT_OF_MEMORY;
+            }
+
+            pStatistics->Add(g_pTimeStamp->ConvertDurationToNanos(duration));
+        }
+    }
+    else if (entry.m_recorded)
+    {
+        int ret = RecordPerfMarkerEvent(pItem, type, markerHandle, nullptr, 0, szUserString);
+
+        if (ret != AL_SUCCESS)
+        {
+            return ret;
+        }
+    }
+
+    if (entry.m_triggerInstance != 0)
+    {
+        g_triggers.OnEnd(entry.m_triggerId, entry.m_triggerInstance);
+    }
+
+    // checked after the end of the instance, whose window does not open when it ends
+    if (g_triggers.HasDeadline())
+    {
+        g_triggers.CheckDeadlines(g_pTimeStamp->GetTimeStamp());
+    }
+
+    pItem->m_markerStack.pop_back();
+
+    return AL_SUCCESS;
+}
+
+/// Records an event of the current thread which neither opens nor closes a marker, a counter value or an instant marker.
+/// Like the begin of a marker, it is ignored if its group is disabled and dropped if the memory budget is exceeded.
+/// \param szName the counter or marker name
+/// \param szGroupName the group name, NULL or empty for the default group
+/// \param type the PerfMarkerEventType of the event
+/// \param pPayload the payload of the event, nullptr for events without payload
+/// \param payloadSize the size of the payload in bytes
+/// \return the status code
+int RecordNamedPerfMarkerEvent(const char* szName, const char* szGroupName, PerfMarkerEventType type, const void* pPayload, size_t payloadSize)
+{
+    if (!g_bInit.load(std::memory_order_acquire))
+    {
+        return AL_UNINITIALIZED_ACTIVITY_LOGGER;
+    }
+
+    if (g_bFinalized)
+    {
+        return AL_FINALIZED_ACTIVITY_LOGGER;
+    }
+
+    if (szName == NULL)
+    {
+        return AL_NULL_MARKER_NAME;
+    }
+
+    if (g_isStatisticsMode)
+    {
+        // only the durations of the markers are aggregated
+        return AL_SUCCESS;
+    }
+
+    if (szGroupName == NULL || szGroupName[0] == '\0')
+    {
+        szGroupName = DEFAULT_GROUP;
+    }
+
+    ScopedPerfMarkerItem scopedItem;
+
+    if (scopedItem.GetStatus() != AL_SUCCESS)
+    {
+        return scopedItem.GetStatus();
+    }
+
+    PerfMarkerItem* pItem = scopedItem.GetItem();
+    unsigned int markerHandle = pItem->m_markerTableCache.GetHandle(g_markerTable, szName, szGroupName);
+
+    if (markerHandle == 0)
+    {
+        return AL_OUT_OF_MEMORY;
+    }
+
+    if (!g_markerTable.IsEnabled(markerHandle))
+    {
+        return AL_SUCCESS;
+    }
+
+    if (g_pBackgroundWriter != nullptr && g_pBackgroundWriter->IsOverBudget(*pItem) && !g_pBackgroundWriter->MakeRoom(*pItem))
+    {
+        pItem->m_numDroppedMarkers++;
+        pItem->m_numAllDroppedMarkers.Add(1);
+        return AL_SUCCESS;
+    }
+
+    return RecordPerfMarkerEvent(pItem, type, markerHandle, pPayload, payloadSize);
+}
+
+/// Adds a profiling trigger to a marker. Called with g_mtx locked, once the timestamps are set up
+/// \param szMarkerName the marker name
+/// \param szGroupName the group name
+/// \param trigger the trigger
+/// \return the status code
+int AddPerfMarkerTrigger(const char* szMarkerName, const char* szGroupName, const amdtProfilingTrigger& trigger)
+{
+    if (trigger.m_profilingControlMode == 0 || (trigger.m_profilingControlMode & ~AMDT_ALL_PROFILING) != 0)
+    {
+        return AL_INVALID_ARGUMENT;
+    }
+
+    unsigned int markerHandle = g_markerTable.Register(szMarkerName, szGroupName);
+
+    if (markerHandle == 0)
+    {
+        return AL_OUT_OF_MEMORY;
+    }
+
+    if (g_markerTable.Get(markerHandle).m_triggerId.load(std::memory_order_relaxed) != 0)
+    {
+        return AL_INVALID_ARGUMENT;
+    }
+
+    PerfMarkerTriggerSettings settings;
+    settings.m_profilingControlMode = trigger.m_profilingControlMode;
+    settings.m_startInstance = trigger.m_startInstance;
+    settings.m_maxWindows = trigger.m_maxWindows;
+    settings.m_minDuration = trigger.m_minDurationMs * g_pTimeStamp->GetTimeStampsPerMillisecond();
+    settings.m_maxDuration = trigger.m_maxDurationMs * g_pTimeStamp->GetTimeStampsPerMillisecond();
+
+    unsigned int triggerId = g_triggers.Add(settings);
+
+    if (triggerId == 0)
+    {
+        return AL_OUT_OF_MEMORY;
+    }
+
+    g_markerTable.SetTriggerId(markerHandle, triggerId);
+
+    return AL_SUCCESS;
+}
+
+/// Sets the flag tested inline by the marker macros, atomically as the macros read it while it is set
+/// \param enabled the value of the flag
+void SetActivityLoggerEnabled(int enabled)
+{
+#ifdef _WIN32
+    amdtActivityLoggerEnabled = enabled;
+#else
+    __atomic_store_n(&amdtActivityLoggerEnabled, enabled, __ATOMIC_RELAXED);
+#endif
+}
+
+/// Adds the profiling triggers of the PerfMarkerTrigger parameters, "MarkerName,GroupName,Modes,StartInstance,MaxWindows,MinDurationMs,MaxDurationMs".
+/// Called with g_mtx locked, once the timestamps are set up
+void AddPerfMarkerTriggersFromParams()
+{
+    for (size_t i = 0; i < g_triggerParams.size(); i++)
+    {
+        vector<string> fields;
+        size_t start = 0;
+
+        for (;;)
+        {
+            size_t end = g_triggerParams[i].find(',', start);
+            fields.push_back(g_triggerParams[i].substr(start, end == string::npos ? string::npos : end - start));
+
+            if (end == string::npos)
+            {
+                break;
+            }
+
+            start = end + 1;
+        }
+
+        amdtProfilingTrigger trigger;
+        memset(&trigger, 0, sizeof(trigger));
+        unsigned int mode = 0;
+        bool valid = fields.size() >= 3 && fields.size() <= 7 && !fields[0].empty();
+
+        for (size_t modeStart = 0; valid && modeStart <= fields[2].length();)
+        {
+            size_t modeEnd = fields[2].find('|', modeStart);
+            string modeName = fields[2].substr(modeStart, modeEnd == string::npos ? string::npos : modeEnd - modeStart);
+
+            if (modeName == "Trace")
+            {
+                mode |= AMDT_TRACE_PROFILING;
+            }
+            else if (modeName == "PerfCounter")
+            {
+                mode |= AMDT_PERF_COUNTER_PROFILING;
+            }
+            else if (modeName == "CPU")
+            {
+                mode |= AMDT_CPU_PROFILING;
+            }
+            else if (modeName == "All")
+            {
+                mode |= AMDT_ALL_PROFILING;
+            }
+            else
+            {
+                valid = false;
+            }
+
+            modeStart = modeEnd == string::npos ? string::npos : modeEnd + 1;
+        }
+
+        if (valid)
+        {
+            trigger.m_profilingControlMode = static_cast<amdtProfilingControlMode>(mode);
+            trigger.m_startInstance = fields.size() > 3 ? strtoull(fields[3].c_str(), nullptr, 10) : 0;
+            trigger.m_maxWindows = fields.size() > 4 ? static_cast<unsigned int>(strtoul(fields[4].c_str(), nullptr, 10)) : 0;
+            trigger.m_minDurationMs = fields.size() > 5 ? static_cast<unsigned int>(strtoul(fields[5].c_str(), nullptr, 10)) : 0;
+            trigger.m_maxDurationMs = fields.size() > 6 ? static_cast<unsigned int>(strtoul(fields[6].c_str(), nullptr, 10)) : 0;
+            valid = AddPerfMarkerTrigger(fields[0].c_str(), fields[1].empty() ? DEFAULT_GROUP : fields[1].c_str(), trigger) == AL_SUCCESS;
+        }
+
+        if (!valid)
+        {
+            cout << "Ignoring the PerfMarkerTrigger parameter " << g_triggerParams[i] << ".\n";
+        }
+    }
+}
+
+/// Starts the background writer if the parameters need it, and sets g_pBackgroundWriter. g_mtx must be held.
+/// \param pBackgroundWriter the background writer to start, not started yet
+void StartPerfMarkerBackgroundWriter(AMDTActivityLoggerBackgroundWriter* pBackgroundWriter)
+{
+    // in timeout mode the temp files are flushed periodically, with a memory budget the events are spilled to the temp files while recording
+    bool periodicFlush = g_isTimeoutMode && g_flushPeriodMs != 0;
+    bool spill = !g_isTimeoutMode && !g_isStatisticsMode && (g_maxThreadBufferBytes != 0 || g_maxTotalBufferBytes != 0);
+
+    if (pBackgroundWriter == nullptr || (!periodicFlush && !spill))
+    {
+        return;
+    }
+
+    if (periodicFlush && pBackgroundWriter->Start(0, 0, PERF_MARKER_OVERFLOW_BLOCK, g_flushPeriodMs))
+    {
+        g_pBackgroundWriter = pBackgroundWriter;
+    }
+    else if (spill && pBackgroundWriter->Start(g_maxThreadBufferBytes, g_maxTotalBufferBytes, g_overflowPolicy, 0))
+    {
+        g_pBackgroundWriter = pBackgroundWriter;
+    }
+}
+
+int FinalizeActivityLogger(size_t maxThreads, bool waitForThreads);
+
+/// Finalizes the activity logger when the process exits, or the library is unloaded, if amdtFinalizeActivityLogger was not called
+class PerfMarkerExitFinalizer
+{
+public:
+    /// Constructor
+    PerfMarkerExitFinalizer()
+    {
+    }
+
+    /// Destructor, called when the process exits, after the thread-local objects of the exiting thread are destroyed
+    ~PerfMarkerExitFinalizer()
+    {
+        if (g_bInit && !g_bFinalized)
+        {
+#ifdef _WIN32
+            // called under the loader lock: the other threads have been killed by ExitProcess, or cannot run until FreeLibrary returns,
+            // so they are not waited for and the exiting thread writes all the sections
+            FinalizeActivityLogger(1, false);
+#else
+            FinalizeActivityLogger(0, true);
+#endif
+        }
+    }
+
+private:
+    /// Disabled copy contructor
+    PerfMarkerExitFinalizer(const PerfMarkerExitFinalizer& obj);
+
+    /// Disabled assignment operator
+    PerfMarkerExitFinalizer& operator = (const PerfMarkerExitFinalizer& obj);
+};
+
+#ifndef _WIN32
+
+/// Gets the name of a file written by a forked child process, the pid is inserted before the extension
+/// \param fileName the name of the file written by the parent process
+/// \param pid the id of the child process
+/// \return the name of the file of the child process
+string GetForkedPerfMarkerFileName(const string& fileName, osProcessId pid)
+{
+    stringstream ss;
+    size_t extPos = fileName.rfind('.');
+    size_t dirPos = fileName.find_last_of("/\\");
+
+    if (extPos == string::npos || (dirPos != string::npos && extPos < dirPos))
+    {
+        ss << fileName << "_" << pid;
+    }
+    else
+    {
+        ss << fileName.substr(0, extPos) << "_" << pid << fileName.substr(extPos);
+    }
+
+    return ss.str();
+}
+
+/// Locks the mutexes of the activity logger before the process forks, so that the child inherits none of them in the middle of an update.
+/// The order is the order in which the other code paths nest them.
+void PreparePerfMarkerFork()
+{
+    g_mtx.lock();
+    g_tempFilesMtx.lock();
+    g_markerTable.LockForFork();
+    g_triggers.LockForFork();
+    AMDTActivityLoggerProfileControl::Instance()->LockForFork();
+    g_pTimeStamp->LockForFork();
+    PerfMarkerEventBuffer::LockChunkPoolForFork();
+}
+
+/// Unlocks the mutexes locked by PreparePerfMarkerFork, except g_mtx
+void UnlockPerfMarkerForkMutexes()
+{
+    PerfMarkerEventBuffer::UnlockChunkPoolAfterFork();
+    g_pTimeStamp->UnlockAfterFork();
+    AMDTActivityLoggerProfileControl::Instance()->UnlockAfterFork();
+    g_triggers.UnlockAfterFork();
+    g_markerTable.UnlockAfterFork();
+    g_tempFilesMtx.unlock();
+}
+
+/// Resumes the parent process after it forked
+void ResumePerfMarkerParentAfterFork()
+{
+    UnlockPerfMarkerForkMutexes();
+    g_mtx.unlock();
+}
+
+/// Gives the child process its own perf marker items, temp files and output files after it forked.
+/// The items of the parent are abandoned as they are: their events are written by the parent,
+/// and the child only has the forking thread. Freeing them would copy their pages into the child.
+/// Only the state is reset here, the background writer and the item of the forking thread are created when the child first records a marker.
+void ResumePerfMarkerChildAfterFork()
+{
+    UnlockPerfMarkerForkMutexes();
+
+    if (g_bInit && !g_bFinalized)
+    {
+        PerfMarkerItem* pParentItem = t_pPerfMarkerItem;
+        g_perfMarkerItemMap.clear();
+        g_openTempFiles.clear();
+        t_pPerfMarkerItem = nullptr;
+        t_threadExitHook.m_pItem = nullptr;
+        g_numRegistryLockContentions.store(0);
+        g_registryLockWaitNanos.store(0);
+
+        // one trace per process
+        osProcessId pid = osGetCurrentProcessId();
+        g_perfFileName = GetForkedPerfMarkerFileName(g_perfFileName, pid);
+        g_statisticsFileName = GetForkedPerfMarkerFileName(g_statisticsFileName, pid);
+
+        if (!g_chromeTraceFileName.empty())
+        {
+            g_chromeTraceFileName = GetForkedPerfMarkerFileName(g_chromeTraceFileName, pid);
+        }
+
+        if (g_pBackgroundWriter != nullptr)
+        {
+            g_pBackgroundWriter = nullptr;
+            g_isBackgroundWriterNeeded = true;
+        }
+
+        if (pParentItem != nullptr && !pParentItem->m_markerStack.empty())
+        {
+            t_pForkedPerfMarkerItem = pParentItem;
+        }
+    }
+
+    g_mtx.unlock();
+}
+
+#endif
+
+/// Installs the handlers finalizing the activity logger at exit and, on Linux, giving forked child processes their own trace. g_mtx must be held.
+void InstallPerfMarkerProcessHandlers()
+{
+    // constructed after the static objects of the library, so that it is destroyed before them
+    static PerfMarkerExitFinalizer s_exitFinalizer;
+
+#ifndef _WIN32
+    pthread_atfork(PreparePerfMarkerFork, ResumePerfMarkerParentAfterFork, ResumePerfMarkerChildAfterFork);
+#endif
+}
+
+extern "C"
+int AL_API_CALL amdtInitializeActivityLogger()
+{
+    ScopedRegistryLock lock;
+
+    if (g_bInit)
+    {
+        return AL_SUCCESS;
+    }
+
+    if (g_bFinalized)
+    {
+        return AL_FINALIZED_ACTIVITY_LOGGER;
+    }
+
+
+    gtString envVarValue;
+    bool envVarFound = osGetCurrentProcessEnvVariableValue(AL_CL_AGENT, envVarValue);
+
+    bool isTraceAgentFound = false;
+
+    if (envVarFound && !envVarValue.isEmpty())
+    {
+        isTraceAgentFound = -1 != envVarValue.find(AL_CL_TRACE_AGENT_DLL);
+    }
+
+    if (!isTraceAgentFound)
+    {
+        envVarFound = osGetCurrentProcessEnvVariableValue(AL_HSA_TOOLS_LIB, envVarValue);
+
+        if (envVarFound && !envVarValue.isEmpty())
+        {
+            isTraceAgentFound = -1 != envVarValue.find(AL_HSA_TRACE_AGENT_DLL);
+        }
+    }
+
+    if (!isTraceAgentFound)
+    {
+        return AL_GPU_PROFILER_NOT_DETECTED;
+    }
+
+    bool paramsFound = GetParametersFromFile();
+    g_pTimeStamp = AMDTActivityLoggerTimeStamp::Instance();
+
+    if (g_useTickCounter && !g_pTimeStamp->EnableTickCounter())
+    {
+        cout << "The CPU has no invariant tick counter, using the OS clock for the PerfMarker timestamps.\n";
+    }
+
+    AddPerfMarkerTriggersFromParams();
+    StartPerfMarkerBackgroundWriter(AMDTActivityLoggerBackgroundWriter::Instance());
+    InstallPerfMarkerProcessHandlers();
+
+    // publish the parameters to the threads recording markers
+    g_bInit.store(true, std::memory_order_release);
+    SetActivityLoggerEnabled(1);
+
+    if (!paramsFound)
+    {
+        return AL_GPU_PROFILER_MISMATCH;
+    }
+
+    return AL_SUCCESS;
+}
+
+extern "C"
+int AL_API_CALL amdtBeginMarker(const char* szMarkerName, const char* szGroupName, const char* szUserString)
+{
+    if (!g_bInit.load(std::memory_order_acquire))
+    {
+        return AL_UNINITIALIZED_ACTIVITY_LOGGER;
+    }
+
+    if (g_bFinalized)
+    {
+        return AL_FINALIZED_ACTIVITY_LOGGER;
+    }
+
+    if (szMarkerName == NULL)
+    {
+        return AL_NULL_MARKER_NAME;
+    }
+
+    if (szGroupName == NULL || szGroupName[0] == '\0')
+    {
+        szGroupName = DEFAULT_GROUP;
+    }
+
+    ScopedPerfMarkerItem scopedItem(PERF_MARKER_CALL_BEGIN);
+
+    if (scopedItem.GetStatus() != AL_SUCCESS)
+    {
+        return scopedItem.GetStatus();
+    }
+
+    PerfMarkerItem* pItem = scopedItem.GetItem();
+    unsigned int markerHandle = pItem->m_markerTableCache.GetHandle(g_markerTable, szMarkerName, szGroupName);
+
+    if (markerHandle == 0)
+    {
+        return BeginUnregisteredPerfMarker(pItem);
+    }
+
+    return BeginPerfMarker(pItem, markerHandle, szUserString);
+}
+
+/// Checks the arguments passed to amdtBeginMarkerArgs and converts them to their recorded form, interning their names.
+/// The string values are copied after the arguments, they are not interned.
+/// \param pItem the perf marker item of the current thread, whose m_args receives the recorded form of the arguments
+/// \param pArgs the arguments
+/// \param numArgs the number of arguments, at most s_MAX_PERF_MARKER_ARGS
+/// \param convert false to only check the arguments, when the marker is not recorded
+/// \param[out] argsSize the size in bytes of the arguments and their string values, 0 if they are not recorded
+/// \return the status code
+int ConvertPerfMarkerArgs(PerfMarkerItem* pItem, const amdtArg* pArgs, unsigned int numArgs, bool convert, size_t& argsSize)
+{
+    argsSize = 0;
+
+    for (unsigned int i = 0; i < numArgs; i++)
+    {
+        const amdtArg& arg = pArgs[i];
+
+        if (arg.m_szName == NULL || (arg.m_type != AL_ARG_INT64 && arg.m_type != AL_ARG_DOUBLE && arg.m_type != AL_ARG_STRING) ||
+            (arg.m_type == AL_ARG_STRING && arg.m_value.m_szString == NULL))
+        {
+            return AL_INVALID_ARGUMENT;
+        }
+    }
+
+    if (!convert)
+    {
+        return AL_SUCCESS;
+    }
+
+    vector<PerfMarkerArg>& convertedArgs = pItem->m_args;
+    size_t size = numArgs * sizeof(PerfMarkerArg);
+    convertedArgs.resize(numArgs);
+
+    for (unsigned int i = 0; i < numArgs; i++)
+    {
+        const amdtArg& arg = pArgs[i];
+        PerfMarkerArg& convertedArg = convertedArgs[i];
+        convertedArg.m_nameHandle = pItem->m_markerTableCache.GetHandle(g_markerTable, arg.m_szName, s_PERF_MARKER_ARG_STRING_GROUP);
+        convertedArg.m_type = static_cast<unsigned int>(arg.m_type);
+
+        if (convertedArg.m_nameHandle == 0)
+        {
+            // the marker is recorded without its arguments if their names cannot be interned
+            return AL_SUCCESS;
+        }
+
+        if (arg.m_type == AL_ARG_STRING)
+        {
+            AppendPerfMarkerArgString(convertedArgs, size, i, arg.m_value.m_szString, strlen(arg.m_value.m_szString));
+        }
+        else if (arg.m_type == AL_ARG_DOUBLE)
+        {
+            memcpy(&convertedArg.m_value, &arg.m_value.m_double, sizeof(convertedArg.m_value));
+        }
+        else
+        {
+            convertedArg.m_value = static_cast<unsigned long long>(arg.m_value.m_int64);
+        }
+    }
+
+    argsSize = size;
+
+    return AL_SUCCESS;
+}
+
+extern "C"
+int AL_API_CALL amdtBeginMarkerArgs(const char* szMarkerName, const char* szGroupName, const amdtArg* pArgs, unsigned int numArgs)
+{
+    if (!g_bInit.load(std::memory_order_acquire))
+    {
+        return AL_UNINITIALIZED_ACTIVITY_LOGGER;
+    }
+
+    if (g_bFinalized)
+    {
+        return AL_FINALIZED_ACTIVITY_LOGGER;
+    }
+
+    if (szMarkerName == NULL)
+    {
+        return AL_NULL_MARKER_NAME;
+    }
+
+    if ((pArgs == NULL && numArgs != 0) || numArgs > s_MAX_PERF_MARKER_ARGS)
+    {
+        return AL_INVALID_ARGUMENT;
+    }
+
+    if (szGroupName == NULL || szGroupName[0] == '\0')
+    {
+        szGroupName = DEFAULT_GROUP;
+    }
+
+    ScopedPerfMarkerItem scopedItem(PERF_MARKER_CALL_BEGIN);
+
+    if (scopedItem.GetStatus() != AL_SUCCESS)
+    {
+        return scopedItem.GetStatus();
+    }
+
+    PerfMarkerItem* pItem = scopedItem.GetItem();
+    unsigned int markerHandle = pItem->m_markerTableCache.GetHandle(g_markerTable, szMarkerName, szGroupName);
+
+    if (markerHandle == 0)
+    {
+        return BeginUnregisteredPerfMarker(pItem);
+    }
+
+    // the arguments are only converted if the marker can be recorded, statistics only aggregate the durations
+    size_t argsSize;
+    int ret = ConvertPerfMarkerArgs(pItem, pArgs, numArgs, !g_isStatisticsMode && g_markerTable.IsEnabled(markerHandle), argsSize);
+
+    if (ret != AL_SUCCESS)
+    {
+        return ret;
+    }
+
+    return BeginPerfMarker(pItem, markerHandle, nullptr, argsSize != 0 ? pItem->m_args.data() : nullptr, argsSize);
+}
+
+extern "C"
+int AL_API_CALL amdtEndMarker()
+{
+    return amdtEndMarkerEx("", "", "");
+}
+
+extern "C"
+int AL_API_CALL amdtEndMarkerEx(const char* szMarkerName, const char* szGroupName, const char* szUserString)
+{
+    if (!g_bInit.load(std::memory_order_acquire))
+    {
+        return AL_UNINITIALIZED_ACTIVITY_LOGGER;
+    }
+
+    if (g_bFinalized)
+    {
+        return AL_FINALIZED_ACTIVITY_LOGGER;
+    }
+
+    if (szMarkerName == NULL)
+    {
+        return AL_NULL_MARKER_NAME;
+    }
+
+    if (szGroupName == NULL || szGroupName[0] == '\0')
+    {
+        szGroupName = DEFAULT_GROUP;
+    }
+
+    ScopedPerfMarkerItem scopedItem(PERF_MARKER_CALL_END);
+
+    if (scopedItem.GetStatus() != AL_SUCCESS)
+    {
+        return scopedItem.GetStatus();
+    }
+
+    PerfMarkerItem* pItem = scopedItem.GetItem();
+
+    if (pItem->m_markerStack.empty())
+    {
+        return AL_UNBALANCED_MARKER;
+    }
+
+    if (szMarkerName[0] == '\0' && strcmp(szGroupName, DEFAULT_GROUP) == 0)
+    {
+        return EndPerfMarker(pItem, PERF_MARKER_EVENT_END, 0, szUserString);
+    }
+    else
+    {
+        /// the marker name must not be an empty string
+        if (szMarkerName[0] == '\0')
+        {
+            return AL_NULL_MARKER_NAME;
+        }
+
+        unsigned int markerHandle = pItem->m_markerTableCache.GetHandle(g_markerTable, szMarkerName, szGroupName);
+
+        if (markerHandle == 0)
+        {
+            // the marker still ends, under the name it began with
+            return EndPerfMarker(pItem, PERF_MARKER_EVENT_END, 0, szUserString);
+        }
+
+        return EndPerfMarker(pItem, PERF_MARKER_EVENT_END_EX, markerHandle, szUserString);
+    }
+}
+
+extern "C"
+int AL_API_CALL amdtRegisterMarker(const char* szMarkerName, const char* szGroupName, amdtMarkerHandle* pMarkerHandle)
+{
+    if (pMarkerHandle == NULL)
+    {
+        return AL_INTERNAL_ERROR;
+    }
+
+    *pMarkerHandle = AL_NULL_MARKER_HANDLE;
+
+    if (szMarkerName == NULL)
+    {
+        return AL_NULL_MARKER_NAME;
+    }
+
+    if (szGroupName == NULL || szGroupName[0] == '\0')
+    {
+        szGroupName = DEFAULT_GROUP;
+    }
+
+    unsigned int markerHandle = g_markerTable.Register(szMarkerName, szGroupName);
+
+    if (markerHandle == 0)
+    {
+        return AL_OUT_OF_MEMORY;
+    }
+
+    *pMarkerHandle = markerHandle;
+
+    return AL_SUCCESS;
+}
+
+extern "C"
+int AL_API_CALL amdtBeginMarkerById(amdtMarkerHandle markerHandle)
+{
+    if (!g_bInit.load(std::memory_order_acquire))
+    {
+        return AL_UNINITIALIZED_ACTIVITY_LOGGER;
+    }
+
+    if (g_bFinalized)
+    {
+        return AL_FINALIZED_ACTIVITY_LOGGER;
+    }
+
+    if (!g_markerTable.IsValid(markerHandle))
+    {
+        return AL_INVALID_MARKER_HANDLE;
+    }
+
+    ScopedPerfMarkerItem scopedItem(PERF_MARKER_CALL_BEGIN);
 
-    if (ret != AL_SUCCESS)
+    if (scopedItem.GetStatus() != AL_SUCCESS)
     {
-        return ret;
+        return scopedItem.GetStatus();
     }
 
-    if (pItem->m_depth <= 0)
+    PerfMarkerItem* pItem = scopedItem.GetItem();
+
+    return BeginPerfMarker(pItem, markerHandle, nullptr);
+}
+
+extern "C"
+int AL_API_CALL amdtEndMarkerById(amdtMarkerHandle markerHandle)
+{
+    if (!g_bInit.load(std::memory_order_acquire))
     {
-        return AL_UNBALANCED_MARKER;
+        return AL_UNINITIALIZED_ACTIVITY_LOGGER;
     }
 
-    if (strMarkerName.empty() && strGroupName == DEFAULT_GROUP)
+    if (g_bFinalized)
     {
-        (*pItem->m_pOstream) << left << setw(20) << "clEndPerfMarker" << left << setw(20) << AMDTActivityLoggerTimeStamp::Instance()->GetTimeNanos() << endl;
+        return AL_FINALIZED_ACTIVITY_LOGGER;
     }
-    else
+
+    if (!g_markerTable.IsValid(markerHandle))
     {
-        /// the marker name must not be an empty string
-        if (strMarkerName.empty())
-        {
-            return AL_NULL_MARKER_NAME;
-        }
+        return AL_INVALID_MARKER_HANDLE;
+    }
 
-        bool fit = strMarkerName.length() < s_DEFAULT_MARKER_NAME_WIDTH;
+    ScopedPerfMarkerItem scopedItem(PERF_MARKER_CALL_END);
 
-        if (fit)
-        {
-            (*pItem->m_pOstream) << left << setw(20) << "clEndPerfMarkerEx" << setw(20) << AMDTActivityLoggerTimeStamp::Instance()->GetTimeNanos() << left << setw(s_DEFAULT_MARKER_NAME_WIDTH) << strMarkerName << "   " << strGroupName << endl;
-        }
-        else
+    if (scopedItem.GetStatus() != AL_SUCCESS)
+    {
+        return scopedItem.GetStatus();
+    }
+
+    PerfMarkerItem* pItem = scopedItem.GetItem();
+
+    // the handle is kept with the event, but it is written as a plain clEndPerfMarker
+    return EndPerfMarker(pItem, PERF_MARKER_EVENT_END, markerHandle, nullptr);
+}
+
+extern "C"
+int AL_API_CALL amdtRecordCounter(const char* szCounterName, const char* szGroupName, long long value)
+{
+    return RecordNamedPerfMarkerEvent(szCounterName, szGroupName, PERF_MARKER_EVENT_COUNTER, &value, sizeof(value));
+}
+
+extern "C"
+int AL_API_CALL amdtRecordCounterDouble(const char* szCounterName, const char* szGroupName, double value)
+{
+    return RecordNamedPerfMarkerEvent(szCounterName, szGroupName, PERF_MARKER_EVENT_COUNTER_DOUBLE, &value, sizeof(value));
+}
+
+extern "C"
+int AL_API_CALL amdtInstantMarker(const char* szMarkerName, const char* szGroupName)
+{
+    return RecordNamedPerfMarkerEvent(szMarkerName, szGroupName, PERF_MARKER_EVENT_INSTANT, nullptr, 0);
+}
+
+/// A thread's section of the perf marker output file
+struct PerfMarkerOutputSection
+{
+    PerfMarkerItem* m_pItem;            ///< the perf marker item of the thread
+    string m_header;                    ///< the thread id and number of markers lines
+    unsigned long long m_offset;        ///< offset of the section in the output file
+    unsigned long long m_spilledSize;   ///< size of the marker lines written to the thread's temp file
+    unsigned long long m_contentSize;   ///< size of the marker lines of the section
+};
+
+/// Writes a thread's section of the perf marker output file and releases the thread's events
+/// \param outputFile the output file
+/// \param section the section to write
+/// \return true on success
+bool WritePerfMarkerOutputSection(PerfMarkerOutputFile& outputFile, PerfMarkerOutputSection& section)
+{
+    PerfMarkerItem* pItem = section.m_pItem;
+    bool retVal = outputFile.Write(section.m_offset, section.m_header.c_str(), section.m_header.length());
+    unsigned long long contentOffset = section.m_offset + section.m_header.length();
+
+    if (pItem->m_isTempFileCreated)
+    {
+        // lines written in timeout mode, spilled by the background writer or written when the thread exited
+        retVal &= outputFile.CopyFrom(contentOffset, pItem->m_tempFileName.c_str(), section.m_spilledSize);
+        remove(pItem->m_tempFileName.c_str());
+        contentOffset += section.m_spilledSize;
+    }
+
+    if (!g_isTimeoutMode)
+    {
+        PerfMarkerOutputFileStreamBuf streamBuf(outputFile, contentOffset);
+        ostream os(&streamBuf);
+
+        if (pItem->m_isTempFileCreated)
         {
-            // super long marker name
-            (*pItem->m_pOstream) << "clEndPerfMarkerEx   " << setw(20) << AMDTActivityLoggerTimeStamp::Instance()->GetTimeNanos() << "   " << strMarkerName << "   " << strGroupName << endl;
+            // continue the spilled lines with the same adjustment
+            os.setf(pItem->m_tempFileAdjustment, ios_base::adjustfield);
         }
+
+        WritePerfMarkerItemChunks(pItem, os, pItem->m_events.GetFirstChunk());
+        os.flush();
+        retVal &= streamBuf.Succeeded();
+    }
+
+    // the item itself is kept alive as its thread may still hold a pointer to it
+    pItem->m_events.Clear();
+    pItem->m_numEventBufferBytes.Set(pItem->m_events.GetNumBytes());
+
+    return retVal;
+}
+
+extern "C"
+int AL_API_CALL amdtSetGroupEnabled(const char* szGroupName, int bEnabled)
+{
+    if (szGroupName == NULL || szGroupName[0] == '\0')
+    {
+        szGroupName = DEFAULT_GROUP;
+    }
+
+    if (!g_markerTable.SetGroupEnabled(szGroupName, bEnabled != 0))
+    {
+        return AL_OUT_OF_MEMORY;
+    }
+
+    return AL_SUCCESS;
+}
+
+extern "C"
+int AL_API_CALL amdtSetMarkerSampling(const char* szMarkerName, const char* szGroupName, unsigned int sampleInterval, unsigned int maxSamplesPerMillisecond)
+{
+    if (szMarkerName == NULL)
+    {
+        return AL_NULL_MARKER_NAME;
+    }
+
+    if (szGroupName == NULL || szGroupName[0] == '\0')
+    {
+        szGroupName = DEFAULT_GROUP;
+    }
+
+    if (!g_markerTable.SetMarkerSampling(szMarkerName, szGroupName, sampleInterval, maxSamplesPerMillisecond))
+    {
+        return AL_OUT_OF_MEMORY;
+    }
+
+    return AL_SUCCESS;
+}
+
+extern "C"
+int AL_API_CALL amdtSetGroupSampling(const char* szGroupName, unsigned int sampleInterval, unsigned int maxSamplesPerMillisecond)
+{
+    if (szGroupName == NULL || szGroupName[0] == '\0')
+    {
+        szGroupName = DEFAULT_GROUP;
     }
 
-    pItem->m_depth--;
+    if (!g_markerTable.SetGroupSampling(szGroupName, sampleInterval, maxSamplesPerMillisecond))
+    {
+        return AL_OUT_OF_MEMORY;
+    }
 
     return AL_SUCCESS;
 }
 
-/// Helper function to count the number of newlines in a string
-/// \param str the input string
-/// \return the number of newlines in the string
-int GetNumLines(const string& str)
+extern "C"
+int AL_API_CALL amdtGetMarkerStatistics(const char* szMarkerName, const char* szGroupName, amdtMarkerStatistics* pStatistics)
 {
-    int ret = 0;
+    if (pStatistics == NULL)
+    {
+        return AL_INTERNAL_ERROR;
+    }
+
+    memset(pStatistics, 0, sizeof(amdtMarkerStatistics));
+
+    if (!g_bInit.load(std::memory_order_acquire))
+    {
+        return AL_UNINITIALIZED_ACTIVITY_LOGGER;
+    }
+
+    if (!g_isStatisticsMode)
+    {
+        return AL_STATISTICS_NOT_ENABLED;
+    }
+
+    if (szMarkerName == NULL)
+    {
+        return AL_NULL_MARKER_NAME;
+    }
+
+    if (szGroupName == NULL || szGroupName[0] == '\0')
+    {
+        szGroupName = DEFAULT_GROUP;
+    }
+
+    unsigned int markerHandle = g_markerTable.Find(szMarkerName, szGroupName);
+
+    if (markerHandle == 0)
+    {
+        return AL_SUCCESS;
+    }
+
+    PerfMarkerStatisticsSummary summary;
 
-    for (size_t i = 0; i < str.length(); i++)
     {
-        if (str[i] == '\n')
+        ScopedRegistryLock lock;
+
+        for (map<osThreadId, PerfMarkerItem*>::iterator it = g_perfMarkerItemMap.begin(); it != g_perfMarkerItemMap.end(); ++it)
         {
-            ret++;
+            for (const PerfMarkerStatistics* pThreadStatistics = it->second->m_statistics.GetFirst(); pThreadStatistics != nullptr; pThreadStatistics = pThreadStatistics->m_pNext)
+            {
+                if (pThreadStatistics->m_markerHandle == markerHandle)
+                {
+                    summary.Merge(*pThreadStatistics);
+                    break;
+                }
+            }
         }
     }
 
-    return ret;
+    if (summary.m_count != 0)
+    {
+        pStatistics->m_count = summary.m_count;
+        pStatistics->m_totalNanos = summary.m_totalNanos;
+        pStatistics->m_minNanos = summary.m_minNanos;
+        pStatistics->m_maxNanos = summary.m_maxNanos;
+        pStatistics->m_meanNanos = summary.m_totalNanos / summary.m_count;
+        pStatistics->m_p50Nanos = summary.GetPercentile(0.5);
+        pStatistics->m_p90Nanos = summary.GetPercentile(0.9);
+        pStatistics->m_p99Nanos = summary.GetPercentile(0.99);
+    }
+
+    return AL_SUCCESS;
 }
 
+/// Adds the counters of a thread to an amdtActivityLoggerStats
+/// \param pItem the perf marker item of the thread
+/// \param[in,out] stats the counters to add to
+void AddPerfMarkerItemStats(const PerfMarkerItem* pItem, amdtActivityLoggerStats& stats)
+{
+    stats.m_numRecordedMarkers += pItem->m_numRecordedMarkers.Get();
+    stats.m_numRecordedEvents += pItem->m_numRecordedEvents.Get();
+    stats.m_numSpilledBytes += pItem->m_numSpilledBytes.Get();
+    stats.m_numDroppedMarkers += pItem->m_numAllDroppedMarkers.Get() + pItem->m_numDroppedQueuedMarkers.load(std::memory_order_relaxed);
+    stats.m_numSampledOutMarkers += pItem->m_numSampledOutMarkers.Get();
+    stats.m_numLockContentions += pItem->m_numLockContentions.Get();
+    stats.m_lockWaitNanos += pItem->m_lockWaitNanos.Get();
+
+    if (g_pBackgroundWriter != nullptr && !g_isTimeoutMode && !g_bFinalized)
+    {
+        // includes the chunks queued for the background writer
+        stats.m_numBufferedBytes += pItem->m_numBufferedBytes.load(std::memory_order_relaxed);
+    }
+    else
+    {
+        stats.m_numBufferedBytes += pItem->m_numEventBufferBytes.Get();
+    }
+
+    unsigned long long* const pNumCalls[PERF_MARKER_CALL_OTHER] = { &stats.m_numBeginCalls, &stats.m_numEndCalls };
+    unsigned long long* const pNanos[PERF_MARKER_CALL_OTHER] = { &stats.m_beginNanos, &stats.m_endNanos };
+
+    for (int i = 0; i < PERF_MARKER_CALL_OTHER; i++)
+    {
+        const PerfMarkerCallCounters& counters = pItem->m_callCounters[i];
+        unsigned long long numCalls = counters.m_numCalls.Get();
+        unsigned long long numTimedCalls = counters.m_numTimedCalls.Get();
+        *pNumCalls[i] += numCalls;
+
+        if (numTimedCalls != 0)
+        {
+            // the timed calls are a regular sample of the calls
+            double timedNanos = static_cast<double>(g_pTimeStamp->ConvertDurationToNanos(counters.m_timedDuration.Get()));
+            *pNanos[i] += static_cast<unsigned long long>(timedNanos * numCalls / numTimedCalls);
+        }
+    }
+}
 
 extern "C"
-int AL_API_CALL amdtFinalizeActivityLogger()
+int AL_API_CALL amdtGetActivityLoggerStats(amdtActivityLoggerStats* pStats, amdtActivityLoggerStats* pThreadStats, unsigned int* pNumThreadStats)
+{
+    if (pStats == NULL || (pThreadStats != NULL && pNumThreadStats == NULL))
+    {
+        return AL_INTERNAL_ERROR;
+    }
+
+    unsigned int maxThreadStats = pThreadStats != NULL ? *pNumThreadStats : 0;
+    memset(pStats, 0, sizeof(amdtActivityLoggerStats));
+
+    if (pNumThreadStats != NULL)
+    {
+        *pNumThreadStats = 0;
+    }
+
+    if (!g_bInit.load(std::memory_order_acquire))
+    {
+        return AL_UNINITIALIZED_ACTIVITY_LOGGER;
+    }
+
+    ScopedRegistryLock lock;
+    unsigned int numThreads = 0;
+
+    for (map<osThreadId, PerfMarkerItem*>::const_iterator it = g_perfMarkerItemMap.begin(); it != g_perfMarkerItemMap.end(); ++it, numThreads++)
+    {
+        amdtActivityLoggerStats threadStats;
+        memset(&threadStats, 0, sizeof(threadStats));
+        threadStats.m_threadId = static_cast<unsigned long long>(it->first);
+        AddPerfMarkerItemStats(it->second, threadStats);
+        AddPerfMarkerItemStats(it->second, *pStats);
+
+        if (numThreads < maxThreadStats)
+        {
+            pThreadStats[numThreads] = threadStats;
+        }
+    }
+
+    // the contention of the query itself is included
+    pStats->m_numLockContentions += g_numRegistryLockContentions.load(std::memory_order_relaxed);
+    pStats->m_lockWaitNanos += g_registryLockWaitNanos.load(std::memory_order_relaxed);
+    pStats->m_finalizeNanos = g_finalizeNanos;
+
+    if (pNumThreadStats != NULL)
+    {
+        *pNumThreadStats = numThreads;
+    }
+
+    return AL_SUCCESS;
+}
+
+/// Finalizes the activity logger, writing the perf marker file
+/// \param maxThreads the maximum number of threads writing the sections, 0 to use the number of hardware threads
+/// \param waitForThreads true to wait for the markers being recorded and for the background writer, false if the other threads
+///        may have been killed or cannot run. Only the items which no other thread can be updating are then saved: the sealed items,
+///        and without a background writer the items not being recorded.
+/// \return the status code
+int FinalizeActivityLogger(size_t maxThreads, bool waitForThreads)
 {
-    std::lock_guard<std::mutex> lock(g_mtx);
+    ScopedRegistryLock lock;
 
     if (g_bFinalized)
     {
         return AL_SUCCESS;
     }
 
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
     if (g_bInit)
     {
+        PerfMarkerOutputFile outputFile;
 
-        ofstream fout;
-        fout.open(g_perfFileName.c_str());
-
-        if (!fout.fail())
+        if (outputFile.Open(g_perfFileName.c_str()))
         {
-            // write header
-            fout << "=====Perfmarker Output=====\n";
+            // stop recording and wait for markers being recorded by other threads to complete
+            SetActivityLoggerEnabled(0);
+            g_bFinalized.store(true);
+
+            map<osThreadId, PerfMarkerItem*> savedItems;
 
             for (map<osThreadId, PerfMarkerItem*>::iterator it = g_perfMarkerItemMap.begin(); it != g_perfMarkerItemMap.end(); ++it)
             {
-                string content;
-                // thread ID
-                fout << it->first << endl;
+                if (waitForThreads)
+                {
+                    while (it->second->m_inUse.load())
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+                else if (it->second->m_inUse.load() || (!it->second->m_isSealed && g_pBackgroundWriter != nullptr))
+                {
+                    cout << "[Thread " << it->first << "] PerfMarkers still being recorded at exit are not saved.\n";
+                    continue;
+                }
+
+                savedItems.insert(*it);
+            }
+
+            // bracket the last recorded events with a calibration point and convert the buffered timestamps
+            g_pTimeStamp->AddCalibrationPoint();
+
+            if (g_pBackgroundWriter != nullptr && waitForThreads)
+            {
+                // write the events queued or buffered by the threads, the rest of their events is still in their event buffers
+                g_pBackgroundWriter->Stop();
+            }
+
+            vector<PerfMarkerItem*> items;
+
+            for (map<osThreadId, PerfMarkerItem*>::iterator it = savedItems.begin(); it != savedItems.end(); ++it)
+            {
+                RecordSkippedPerfMarkers(it->second);
+                RecordDroppedPerfMarkers(it->second);
+                items.push_back(it->second);
+            }
+
+            RunPerfMarkerTasks(items.size(), [&items](size_t i)
+            {
+                if (g_isTimeoutMode)
+                {
+                    // events recorded since the last periodic flush
+                    WritePerfMarkerItemEvents(items[i]);
+                }
+                else
+                {
+                    ConvertPerfMarkerEventTimeStamps(items[i], items[i]->m_events.GetFirstChunk());
+                }
+            }, maxThreads);
+
+            // header
+            const string fileHeader(g_isBinaryFormat ? GetPerfMarkerBinaryFileHeader(g_markerTable, savedItems.size()) : "=====Perfmarker Output=====\n");
+
+            // lay out the sections so that they can be written independently
+            vector<PerfMarkerOutputSection> sections;
+            unsigned long long offset = fileHeader.length();
+
+            for (map<osThreadId, PerfMarkerItem*>::iterator it = savedItems.begin(); it != savedItems.end(); ++it)
+            {
+                PerfMarkerItem* pItem = it->second;
 
-                if (it->second->m_depth != 0)
+                if (!pItem->m_markerStack.empty())
                 {
                     cout << "[Thread " << it->first << "] Unbalanced PerfMarker detected.\n";
                 }
 
-                if (g_isTimeoutMode)
+                PerfMarkerOutputSection section;
+                section.m_pItem = pItem;
+                section.m_spilledSize = 0;
+                unsigned long long numMarkers = 0;
+
+                if (pItem->m_isTempFileCreated)
+                {
+                    ClosePerfMarkerItemTempFile(pItem);
+                    numMarkers = pItem->m_numWrittenLines;
+
+                    if (!PerfMarkerOutputFile::GetFileSize(pItem->m_tempFileName.c_str(), section.m_spilledSize))
+                    {
+                        section.m_spilledSize = 0;
+                        numMarkers = 0;
+                    }
+                }
+
+                section.m_contentSize = section.m_spilledSize;
+
+                if (!g_isTimeoutMode && g_isBinaryFormat)
+                {
+                    numMarkers += GetPerfMarkerEventChunksNumEvents(pItem->m_events.GetFirstChunk());
+                    section.m_contentSize += pItem->m_binaryEncoder.GetSize(pItem->m_events.GetFirstChunk());
+                }
+                else if (!g_isTimeoutMode)
+                {
+                    numMarkers += GetPerfMarkerEventBufferNumLines(pItem->m_events);
+                    section.m_contentSize += GetPerfMarkerEventBufferTextLength(pItem->m_events, g_markerTable);
+                }
+
+                // thread ID and num of markers
+                stringstream ss;
+
+                if (g_isBinaryFormat)
                 {
-                    ofstream_with_filename* pOfstream = dynamic_cast<ofstream_with_filename*>(it->second->m_pOstream);
-                    pOfstream->close();
-                    gtString ofstreamFileName;
-                    ofstreamFileName.fromASCIIString(pOfstream->m_fileName.c_str());
-                    osFilePath markerFilePath;
-                    markerFilePath.setFullPathFromString(ofstreamFileName);
-                    osFile markerFile(markerFilePath);
-                    markerFile.open(osChannel::OS_ASCII_TEXT_CHANNEL);
-                    gtASCIIString fileContents;
-                    markerFile.readIntoString(fileContents);
-                    markerFile.close();
-                    content.assign(fileContents.asCharArray());
-                    remove(pOfstream->m_fileName.c_str());
+                    ss << it->first;
+                    section.m_header = GetPerfMarkerBinarySectionHeader(ss.str(), numMarkers, section.m_contentSize);
                 }
                 else
                 {
-                    content = dynamic_cast<stringstream*>(it->second->m_pOstream)->str();
+                    ss << it->first << endl << numMarkers << endl;
+                    section.m_header = ss.str();
+                }
+                section.m_offset = offset;
+                offset += section.m_header.length() + section.m_contentSize;
+                sections.push_back(section);
+            }
+
+            outputFile.Write(0, fileHeader.c_str(), fileHeader.length());
+
+            if (g_isStatisticsMode)
+            {
+                map<unsigned int, PerfMarkerStatisticsSummary> summaries;
+
+                for (map<osThreadId, PerfMarkerItem*>::iterator it = savedItems.begin(); it != savedItems.end(); ++it)
+                {
+                    MergePerfMarkerStatistics(it->second->m_statistics, summaries);
+                }
+
+                WritePerfMarkerStatisticsFile(g_statisticsFileName.c_str(), summaries, g_markerTable);
+            }
+
+            RunPerfMarkerTasks(sections.size(), [&outputFile, &sections](size_t i)
+            {
+                WritePerfMarkerOutputSection(outputFile, sections[i]);
+            }, maxThreads);
+
+            if (g_isBinaryFormat)
+            {
+                // index of the chunks of all the sections, so that readers can seek to a time range
+                vector<PerfMarkerBinaryIndexEntry> entries;
+
+                for (size_t i = 0; i < sections.size(); i++)
+                {
+                    const vector<PerfMarkerBinaryIndexEntry>& chunks = sections[i].m_pItem->m_binaryEncoder.GetChunks();
+
+                    for (size_t j = 0; j < chunks.size(); j++)
+                    {
+                        PerfMarkerBinaryIndexEntry entry = chunks[j];
+                        entry.m_offset += sections[i].m_offset + sections[i].m_header.length();
+                        entry.m_section = static_cast<unsigned int>(i);
+                        entries.push_back(entry);
+                    }
                 }
 
-                // num of markers
-                fout << GetNumLines(content) << endl;
-                fout << content;
-                delete it->second;
+                const string index(GetPerfMarkerBinaryIndex(entries, offset));
+                outputFile.Write(offset, index.c_str(), index.length());
             }
 
-            g_perfMarkerItemMap.clear();
-            fout.close();
+            outputFile.Close();
+
+            if (!g_chromeTraceFileName.empty())
+            {
+                // exported from the complete perf marker file, which is read one part at a time
+                ExportPerfMarkerFileToChromeTrace(g_perfFileName.c_str(), g_chromeTraceFileName.c_str());
+            }
+
+            g_finalizeNanos = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
 
-            g_bFinalized = true;
             return AL_SUCCESS;
         }
         else
@@ -503,6 +2541,12 @@ int AL_API_CALL amdtFinalizeActivityLogger()
     }
 }
 
+extern "C"
+int AL_API_CALL amdtFinalizeActivityLogger()
+{
+    return FinalizeActivityLogger(0, true);
+}
+
 extern "C"
 int AL_API_CALL amdtStopProfiling(amdtProfilingControlMode profilingControlMode)
 {
@@ -534,3 +2578,36 @@ int AL_API_CALL amdtResumeProfilingEx()
 {
     return amdtResumeProfiling(AMDT_CPU_PROFILING);
 }
+
+extern "C"
+int AL_API_CALL amdtAddProfilingTrigger(const char* szMarkerName, const char* szGroupName, const amdtProfilingTrigger* pTrigger)
+{
+    if (pTrigger == NULL)
+    {
+        return AL_INVALID_ARGUMENT;
+    }
+
+    if (szMarkerName == NULL)
+    {
+        return AL_NULL_MARKER_NAME;
+    }
+
+    if (szGroupName == NULL || szGroupName[0] == '\0')
+    {
+        szGroupName = DEFAULT_GROUP;
+    }
+
+    if (!g_bInit.load(std::memory_order_acquire))
+    {
+        return AL_UNINITIALIZED_ACTIVITY_LOGGER;
+    }
+
+    ScopedRegistryLock lock;
+    return AddPerfMarkerTrigger(szMarkerName, szGroupName, *pTrigger);
+}
+
+extern "C"
+int AL_API_CALL amdtRefreshProfilingControl()
+{
+    return AMDTActivityLoggerProfileControl::Instance()->Refresh();
+}
@@ -0,0 +1,375 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Singleton class writing the recorded perf marker events to the
+///        per-thread temp files on a background thread
+//==============================================================================
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "AMDTActivityLoggerBackgroundWriter.h"
+
+using namespace std;
+
+PerfMarkerSpillTarget::PerfMarkerSpillTarget()
+{
+    m_numBufferedBytes = 0;
+    m_numDroppedQueuedMarkers = 0;
+}
+
+PerfMarkerSpillTarget::~PerfMarkerSpillTarget()
+{
+}
+
+AMDTActivityLoggerBackgroundWriter::AMDTActivityLoggerBackgroundWriter()
+{
+    m_maxThreadBytes = 0;
+    m_maxTotalBytes = 0;
+    m_policy = PERF_MARKER_OVERFLOW_BLOCK;
+    m_flushPeriodMs = 0;
+    m_numBufferedBytes = 0;
+    m_bStarted = false;
+    m_bStopping = false;
+    m_bWriting = false;
+    m_pBusyTarget = nullptr;
+}
+
+AMDTActivityLoggerBackgroundWriter::~AMDTActivityLoggerBackgroundWriter()
+{
+    Stop();
+}
+
+bool AMDTActivityLoggerBackgroundWriter::Start(size_t maxThreadBytes, size_t maxTotalBytes, PerfMarkerOverflowPolicy policy, unsigned int flushPeriodMs)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    if (m_bStarted)
+    {
+        return true;
+    }
+
+    const size_t minThreadBytes = 2 * PerfMarkerEventBuffer::s_DEFAULT_CHUNK_SIZE;
+    m_maxThreadBytes = maxThreadBytes != 0 && maxThreadBytes < minThreadBytes ? minThreadBytes : maxThreadBytes;
+    m_maxTotalBytes = maxTotalBytes;
+    m_policy = policy;
+    m_flushPeriodMs = flushPeriodMs;
+    m_bStopping = false;
+
+    try
+    {
+        m_thread = std::thread(&AMDTActivityLoggerBackgroundWriter::WriterThreadMain, this);
+    }
+    catch (...)
+    {
+        return false;
+    }
+
+    m_bStarted = true;
+
+    return true;
+}
+
+void AMDTActivityLoggerBackgroundWriter::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+
+        if (!m_bStarted)
+        {
+            return;
+        }
+
+        m_bStopping = true;
+    }
+
+    m_queuedCv.notify_all();
+    m_thread.join();
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_bStarted = false;
+}
+
+void AMDTActivityLoggerBackgroundWriter::AddTarget(PerfMarkerSpillTarget& target)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+    m_targets.push_back(&target);
+}
+
+void AMDTActivityLoggerBackgroundWriter::RemoveTarget(PerfMarkerSpillTarget& target)
+{
+    std::unique_lock<std::mutex> lock(m_mtx);
+    vector<PerfMarkerSpillTarget*>::iterator it = find(m_targets.begin(), m_targets.end(), &target);
+
+    if (it != m_targets.end())
+    {
+        m_targets.erase(it);
+    }
+
+    while (m_pBusyTarget == &target || IsQueued(target))
+    {
+        m_writtenCv.wait(lock);
+    }
+}
+
+void AMDTActivityLoggerBackgroundWriter::OnBufferGrown(PerfMarkerSpillTarget& target, PerfMarkerEventBuffer& buffer, size_t numAddedBytes)
+{
+    target.m_numBufferedBytes.fetch_add(numAddedBytes, memory_order_relaxed);
+    m_numBufferedBytes.fetch_add(numAddedBytes, memory_order_relaxed);
+
+    Job job;
+    job.m_pTarget = &target;
+    job.m_pChunks = buffer.DetachFullChunks(job.m_numBytes);
+
+    if (job.m_pChunks == nullptr)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        m_jobs.push_back(job);
+    }
+
+    m_queuedCv.notify_one();
+}
+
+bool AMDTActivityLoggerBackgroundWriter::MakeRoom(PerfMarkerSpillTarget& target)
+{
+    std::unique_lock<std::mutex> lock(m_mtx);
+
+    switch (m_policy)
+    {
+        case PERF_MARKER_OVERFLOW_BLOCK:
+            // when nothing is left to write, the thread is over budget on its own and keeps recording
+            while (IsOverBudget(target) && (m_bWriting || !m_jobs.empty()))
+            {
+                m_writtenCv.wait(lock);
+            }
+
+            return true;
+
+        case PERF_MARKER_OVERFLOW_DROP_OLDEST:
+            for (deque<Job>::iterator it = m_jobs.begin(); it != m_jobs.end() && IsOverBudget(target); ++it)
+            {
+                if (it->m_pTarget == &target)
+                {
+                    size_t numBytes = it->m_numBytes;
+                    target.m_numDroppedQueuedMarkers.fetch_add(DropBalancedMarkers(*it), memory_order_relaxed);
+                    target.m_numBufferedBytes.fetch_sub(numBytes - it->m_numBytes, memory_order_relaxed);
+                    m_numBufferedBytes.fetch_sub(numBytes - it->m_numBytes, memory_order_relaxed);
+                }
+            }
+
+            return !IsOverBudget(target);
+
+        case PERF_MARKER_OVERFLOW_DROP_NEWEST:
+        default:
+            return false;
+    }
+}
+
+void AMDTActivityLoggerBackgroundWriter::OnChunksFreed(PerfMarkerSpillTarget& target, size_t numBytes)
+{
+    target.m_numBufferedBytes.fetch_sub(numBytes, memory_order_relaxed);
+    m_numBufferedBytes.fetch_sub(numBytes, memory_order_relaxed);
+}
+
+void AMDTActivityLoggerBackgroundWriter::FlushTargets()
+{
+    std::unique_lock<std::mutex> lock(m_mtx);
+
+    // the targets may be added or removed while one is flushed, a target moved
+    // by the removal of a target flushed before it waits for the next flush
+    for (size_t i = 0; i < m_targets.size(); i++)
+    {
+        PerfMarkerSpillTarget* pTarget = m_targets[i];
+        m_pBusyTarget = pTarget;
+        lock.unlock();
+        pTarget->FlushBufferedEvents();
+        lock.lock();
+        m_pBusyTarget = nullptr;
+        m_writtenCv.notify_all();
+    }
+}
+
+void AMDTActivityLoggerBackgroundWriter::WriterThreadMain()
+{
+    std::unique_lock<std::mutex> lock(m_mtx);
+    std::chrono::steady_clock::time_point nextFlush = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_flushPeriodMs);
+
+    for (;;)
+    {
+        while (m_jobs.empty() && !m_bStopping)
+        {
+            if (m_flushPeriodMs == 0)
+            {
+                m_queuedCv.wait(lock);
+            }
+            else if (m_queuedCv.wait_until(lock, nextFlush) == std::cv_status::timeout)
+            {
+                lock.unlock();
+                FlushTargets();
+                lock.lock();
+                nextFlush = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_flushPeriodMs);
+            }
+        }
+
+        if (m_jobs.empty())
+        {
+            // stopping and all the queued events have been written
+            break;
+        }
+
+        Job job = m_jobs.front();
+        m_jobs.pop_front();
+        m_bWriting = true;
+        m_pBusyTarget = job.m_pTarget;
+        lock.unlock();
+
+        job.m_pTarget->WriteSpilledEvents(job.m_pChunks);
+        PerfMarkerEventBuffer::FreeChunks(job.m_pChunks);
+        OnChunksFreed(*job.m_pTarget, job.m_numBytes);
+
+        lock.lock();
+        m_bWriting = false;
+        m_pBusyTarget = nullptr;
+        m_writtenCv.notify_all();
+    }
+}
+
+bool AMDTActivityLoggerBackgroundWriter::IsQueued(const PerfMarkerSpillTarget& target) const
+{
+    for (deque<Job>::const_iterator it = m_jobs.begin(); it != m_jobs.end(); ++it)
+    {
+        if (it->m_pTarget == &target)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// Helper function to get the number of instances carried by a sampled begin event
+/// \param event the event
+/// \return the number of instances
+static unsigned long long GetEventCount(const PerfMarkerEvent& event)
+{
+    unsigned long long count;
+    memcpy(&count, event.GetPayload(), sizeof(count));
+    return count;
+}
+
+unsigned long long AMDTActivityLoggerBackgroundWriter::DropBalancedMarkers(Job& job)
+{
+    // find the markers which begin and end within the job: the events of the other markers
+    // are kept, so that the markers written before and after the job stay balanced
+    vector<PerfMarkerEvent*> events;
+    vector<bool> keep;
+    vector<size_t> openBegins;
+    unsigned long long numDroppedMarkers = 0;
+    size_t firstDroppedIndex = 0;
+
+    for (PerfMarkerEventChunk* pChunk = job.m_pChunks; pChunk != nullptr; pChunk = pChunk->m_pNext)
+    {
+        size_t slot = 0;
+
+        while (slot < pChunk->m_usedSlots)
+        {
+            PerfMarkerEvent* pEvent = pChunk->m_pSlots + slot;
+            events.push_back(pEvent);
+            keep.push_back(true);
+
+            switch (pEvent->m_type)
+            {
+                case PERF_MARKER_EVENT_BEGIN:
+                case PERF_MARKER_EVENT_SAMPLED_BEGIN:
+                    openBegins.push_back(events.size() - 1);
+                    break;
+
+                case PERF_MARKER_EVENT_END:
+                case PERF_MARKER_EVENT_END_EX:
+                    if (!openBegins.empty())
+                    {
+                        if (numDroppedMarkers == 0 || openBegins.back() < firstDroppedIndex)
+                        {
+                            firstDroppedIndex = openBegins.back();
+                        }
+
+                        const PerfMarkerEvent* pBegin = events[openBegins.back()];
+
+                        // a sampled begin stands for the instances it represents
+                        numDroppedMarkers += pBegin->m_type == PERF_MARKER_EVENT_SAMPLED_BEGIN ? GetEventCount(*pBegin) : 1;
+                        keep[openBegins.back()] = false;
+                        keep[events.size() - 1] = false;
+                        openBegins.pop_back();
+                    }
+
+                    break;
+
+                default:
+                    break;
+            }
+
+            slot += pEvent->GetNumSlots();
+        }
+    }
+
+    if (numDroppedMarkers == 0)
+    {
+        return 0;
+    }
+
+    for (size_t i = 1; i < events.size(); i++)
+    {
+        // the arguments and the user string go with the begin or end before them
+        if ((events[i]->m_type == PERF_MARKER_EVENT_ARGS || events[i]->m_type == PERF_MARKER_EVENT_USER_STRING) && !keep[i - 1])
+        {
+            keep[i] = false;
+        }
+    }
+
+    // the dropped markers are replaced by an event holding their number, in place of the first dropped begin so that the timestamps stay in order
+    size_t numKeptSlots = 2;
+
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        numKeptSlots += keep[i] ? events[i]->GetNumSlots() : 0;
+    }
+
+    PerfMarkerEventChunk* pChunk = PerfMarkerEventBuffer::AllocateChunk(numKeptSlots);
+
+    if (pChunk == nullptr)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        if (i == firstDroppedIndex)
+        {
+            PerfMarkerEvent* pDropped = pChunk->m_pSlots + pChunk->m_usedSlots;
+            pDropped->m_type = PERF_MARKER_EVENT_DROPPED;
+            pDropped->m_reserved = 0;
+            pDropped->m_payloadSlots = 1;
+            pDropped->m_markerHandle = 0;
+            pDropped->m_timestamp = events[i]->m_timestamp;
+            memcpy(pDropped + 1, &numDroppedMarkers, sizeof(numDroppedMarkers));
+            pChunk->m_usedSlots += 2;
+        }
+        else if (keep[i])
+        {
+            memcpy(pChunk->m_pSlots + pChunk->m_usedSlots, events[i], events[i]->GetNumSlots() * sizeof(PerfMarkerEvent));
+            pChunk->m_usedSlots += events[i]->GetNumSlots();
+        }
+    }
+
+    PerfMarkerEventBuffer::FreeChunks(job.m_pChunks);
+    job.m_pChunks = pChunk;
+    job.m_numBytes = PerfMarkerEventBuffer::GetChunkBytes(pChunk);
+
+    return numDroppedMarkers;
+}
@@ -0,0 +1,164 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Singleton class writing the recorded perf marker events to the
+///        per-thread temp files on a background thread
+//==============================================================================
+
+#ifndef _AMDT_ACTIVITY_LOGGER_BACKGROUND_WRITER_H_
+#define _AMDT_ACTIVITY_LOGGER_BACKGROUND_WRITER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "TSingleton.h"
+
+#include "AMDTActivityLoggerEventBuffer.h"
+
+/// What a thread does when its recorded events exceed the memory budget because the background writer falls behind
+enum PerfMarkerOverflowPolicy
+{
+    PERF_MARKER_OVERFLOW_BLOCK = 0,        ///< wait for the background writer to write queued events
+    PERF_MARKER_OVERFLOW_DROP_NEWEST = 1,  ///< drop the markers which begin while over budget
+    PERF_MARKER_OVERFLOW_DROP_OLDEST = 2   ///< drop the oldest markers of the thread which are queued and not yet written
+};
+
+/// Receiver of the events written by the background writer, implemented by the perf marker item of a thread
+class PerfMarkerSpillTarget
+{
+public:
+    /// Constructor
+    PerfMarkerSpillTarget();
+
+    /// Destructor
+    virtual ~PerfMarkerSpillTarget();
+
+    /// Writes events of the thread to its temp file, called on the background writer thread
+    /// \param pChunks the list of chunks holding the events, in recording order
+    virtual void WriteSpilledEvents(PerfMarkerEventChunk* pChunks) = 0;
+
+    /// Takes all the events recorded by the thread so far and writes them to its temp file, called periodically on the background writer thread
+    virtual void FlushBufferedEvents() = 0;
+
+    std::atomic<size_t> m_numBufferedBytes; ///< size of the chunks of the thread, in its event buffer or queued for the background writer
+    std::atomic<unsigned long long> m_numDroppedQueuedMarkers; ///< number of queued markers of the thread dropped by MakeRoom
+
+private:
+    /// Disabled copy contructor
+    PerfMarkerSpillTarget(const PerfMarkerSpillTarget& obj);
+
+    /// Disabled assignment operator
+    PerfMarkerSpillTarget& operator = (const PerfMarkerSpillTarget& obj);
+};
+
+/// Singleton class writing the recorded perf marker events to the per-thread temp files on a background thread.
+/// Threads hand over the full chunks of their event buffer, so that the memory used by the recorded events
+/// stays within a per-thread and a global budget. In timeout mode, the writer instead periodically flushes
+/// the events of all the threads, so that the threads recording markers make no write calls.
+class AMDTActivityLoggerBackgroundWriter : public TSingleton<AMDTActivityLoggerBackgroundWriter>
+{
+public:
+    /// Constructor
+    AMDTActivityLoggerBackgroundWriter();
+
+    /// Destructor
+    ~AMDTActivityLoggerBackgroundWriter();
+
+    /// Sets the memory budget of the recorded events and starts the background thread
+    /// \param maxThreadBytes the maximum size of the chunks of a thread, 0 for no limit, raised to two chunks so that a chunk can be written while the next one is filled
+    /// \param maxTotalBytes the maximum size of the chunks of all the threads, 0 for no limit
+    /// \param policy what a thread does when the budget is exceeded
+    /// \param flushPeriodMs the period in milliseconds of the flushes of the events of the threads, 0 for no periodic flush
+    /// \return false if the background thread could not be started
+    bool Start(size_t maxThreadBytes, size_t maxTotalBytes, PerfMarkerOverflowPolicy policy, unsigned int flushPeriodMs);
+
+    /// Writes all the queued events and stops the background thread, the events recorded since the last periodic flush are left to the caller
+    void Stop();
+
+    /// Adds a thread to the threads whose events are periodically flushed
+    /// \param target the target of the thread
+    void AddTarget(PerfMarkerSpillTarget& target);
+
+    /// Removes a thread from the threads whose events are periodically flushed, and waits until its queued events are written
+    /// and it is not being flushed, after which the background writer no longer uses the target
+    /// \param target the target of the thread
+    void RemoveTarget(PerfMarkerSpillTarget& target);
+
+    /// Checks whether the background writer is running
+    /// \return true if the background thread was started and not stopped
+    bool IsStarted() const { return m_bStarted; }
+
+    /// Accounts for the chunks added to a thread's event buffer and queues the full chunks of the buffer for writing
+    /// \param target the target of the thread
+    /// \param buffer the event buffer of the thread
+    /// \param numAddedBytes the size of the chunks added to the buffer since the last call
+    void OnBufferGrown(PerfMarkerSpillTarget& target, PerfMarkerEventBuffer& buffer, size_t numAddedBytes);
+
+    /// Checks whether a thread exceeds the memory budget
+    /// \param target the target of the thread
+    /// \return true if the thread or all the threads use more memory than allowed
+    bool IsOverBudget(const PerfMarkerSpillTarget& target) const
+    {
+        return (m_maxThreadBytes != 0 && target.m_numBufferedBytes.load(std::memory_order_relaxed) > m_maxThreadBytes) ||
+               (m_maxTotalBytes != 0 && m_numBufferedBytes.load(std::memory_order_relaxed) > m_maxTotalBytes);
+    }
+
+    /// Makes room for a new marker of a thread which exceeds the memory budget, according to the overflow policy.
+    /// The markers dropped from the queued events are replaced by a PERF_MARKER_EVENT_DROPPED event holding their number.
+    /// \param target the target of the thread
+    /// \return false if the new marker must be dropped
+    bool MakeRoom(PerfMarkerSpillTarget& target);
+
+    /// Releases the accounting of chunks freed by a thread
+    /// \param target the target of the thread
+    /// \param numBytes the size of the freed chunks
+    void OnChunksFreed(PerfMarkerSpillTarget& target, size_t numBytes);
+
+private:
+    /// Events of a thread queued for writing
+    struct Job
+    {
+        PerfMarkerSpillTarget* m_pTarget;   ///< the target of the thread
+        PerfMarkerEventChunk* m_pChunks;    ///< the chunks holding the events
+        size_t m_numBytes;                  ///< the size of the chunks
+    };
+
+    /// The function run by the background thread
+    void WriterThreadMain();
+
+    /// Flushes the events of all the threads, called on the background thread with m_mtx unlocked
+    void FlushTargets();
+
+    /// Checks whether events of a thread are queued, called with m_mtx locked
+    /// \param target the target of the thread
+    /// \return true if a job of the thread is queued
+    bool IsQueued(const PerfMarkerSpillTarget& target) const;
+
+    /// Drops the markers which begin and end within a job, keeping the events needed to keep the thread's markers balanced
+    /// \param[in,out] job the job, its chunks are replaced by a single chunk holding the kept events and a dropped event
+    /// \return the number of dropped markers
+    static unsigned long long DropBalancedMarkers(Job& job);
+
+    size_t m_maxThreadBytes;                        ///< the maximum size of the chunks of a thread, 0 for no limit
+    size_t m_maxTotalBytes;                         ///< the maximum size of the chunks of all the threads, 0 for no limit
+    PerfMarkerOverflowPolicy m_policy;              ///< what a thread does when the budget is exceeded
+    unsigned int m_flushPeriodMs;                   ///< the period of the flushes of the events of the threads, 0 for no periodic flush
+    std::atomic<size_t> m_numBufferedBytes;         ///< size of the chunks of all the threads
+    bool m_bStarted;                                ///< flag indicating if the background thread is running
+    bool m_bStopping;                               ///< flag asking the background thread to exit once the queue is empty
+    bool m_bWriting;                                ///< flag indicating if the background thread is writing a job taken from the queue
+    PerfMarkerSpillTarget* m_pBusyTarget;           ///< the target whose events the background thread is writing or flushing, nullptr if none
+    std::mutex m_mtx;                               ///< mutex to protect the queue
+    std::condition_variable m_queuedCv;             ///< notified when a job is queued or the writer is stopped
+    std::condition_variable m_writtenCv;            ///< notified when a job has been written or a target has been flushed
+    std::deque<Job> m_jobs;                         ///< the queued jobs, oldest first
+    std::vector<PerfMarkerSpillTarget*> m_targets;  ///< the threads whose events are periodically flushed
+    std::thread m_thread;                           ///< the background thread
+};
+
+#endif // _AMDT_ACTIVITY_LOGGER_BACKGROUND_WRITER_H_
@@ -0,0 +1,399 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Measures the overhead of the perf marker entrypoints and of amdtFinalizeActivityLogger
+//==============================================================================
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AMDTGPUProfilerDefs.h"
+#include "CXLActivityLogger.h"
+
+using namespace std;
+
+const size_t s_NAME_WIDTH = 28;                 ///< width of the scenario column
+const size_t s_COLUMN_WIDTH = 12;               ///< width of the other columns
+const size_t s_WARMUP_PAIRS = 1000;             ///< begin/end pairs recorded by each thread before it is timed
+const size_t s_DEFAULT_PAIRS = 100000;          ///< default number of timed begin/end pairs per thread and scenario
+const unsigned int s_DEFAULT_MAX_THREADS = 16;  ///< default cap of the thread count, the default is the number of cores up to this
+const size_t s_LONG_NAME_LENGTH = 256;          ///< length of the marker name of the long name scenario
+const char s_GROUP_NAME[] = "Benchmark";        ///< group of the benchmark markers
+
+/// The logger configurations benchmarked, each one is run in its own process as the logger can only be initialized once
+static const char* const s_MODES[] = { "InMemory", "Timeout", "Binary", "Statistics" };
+
+/// The latencies of the begin/end pairs of a scenario, merged from all its threads
+struct BenchmarkResult
+{
+    vector<unsigned long long> m_nanos;     ///< the latency of each sample, in ns per pair
+    double m_wallSeconds;                   ///< the time from the start of the threads to the end of the slowest one
+    size_t m_numPairs;                      ///< the number of timed pairs of all threads
+};
+
+/// Helper function to get the params file lines of a mode
+/// \param mode the mode, one of s_MODES
+/// \param workDir the directory of the temp and output files
+/// \param[out] outputFileName the file written by amdtFinalizeActivityLogger
+/// \return the lines, empty if the mode is unknown
+static string GetModeParams(const string& mode, const string& workDir, string& outputFileName)
+{
+    string params = "PerfMarkerTempFileBaseName=" + workDir + "/benchmark_" + mode + "_\n";
+    string outputFile = workDir + "/benchmark_" + mode + "." + AL_PERFMARKER_EXT_NARROW;
+    outputFileName = outputFile;
+
+    if (mode == "InMemory")
+    {
+        params += "TimeOut=False\n";
+    }
+    else if (mode == "Timeout")
+    {
+        params += "TimeOut=True\n";
+    }
+    else if (mode == "Binary")
+    {
+        params += "TimeOut=False\nPerfMarkerOutputFormat=Binary\n";
+    }
+    else if (mode == "Statistics")
+    {
+        params += "TimeOut=False\nPerfMarkerStatistics=True\n";
+        outputFileName = outputFile + ".stats";
+    }
+    else
+    {
+        return string();
+    }
+
+    return params + "PerfMarkerOutputFileName=" + outputFile + "\n";
+}
+
+/// Helper function to set an environment variable of the process
+/// \param szName the name of the variable
+/// \param value the value
+/// \return true on success
+static bool SetEnvVariable(const char* szName, const string& value)
+{
+#ifdef _WIN32
+    return _putenv_s(szName, value.c_str()) == 0;
+#else
+    return setenv(szName, value.c_str(), 1) == 0;
+#endif
+}
+
+/// Helper function to stand in for the GPU profiler: writes the params file of a mode and points the logger at it
+/// The params file is written in the work directory, which replaces the directory the logger looks it up in,
+/// so that the params file of a profiler session of the user is not overwritten.
+/// \param mode the mode, one of s_MODES
+/// \param workDir the directory of the params, temp and output files
+/// \param[out] outputFileName the file written by amdtFinalizeActivityLogger
+/// \return true on success
+static bool SetupProfilerEnvironment(const string& mode, const string& workDir, string& outputFileName)
+{
+    string params = GetModeParams(mode, workDir, outputFileName);
+
+    if (params.empty())
+    {
+        cerr << "Unknown mode " << mode << "\n";
+        return false;
+    }
+
+#ifdef _WIN32
+    string paramsFileName = workDir + "/rcpdata." + AL_PERFMARKER_EXT_NARROW;
+    bool envSet = SetEnvVariable("TMP", workDir) && SetEnvVariable("TEMP", workDir);
+#else
+    string paramsFileName = workDir + "/.rcpdata." + AL_PERFMARKER_EXT_NARROW;
+    bool envSet = SetEnvVariable("HOME", workDir);
+#endif
+
+    ofstream fout(paramsFileName.c_str());
+    fout << params;
+    fout.close();
+
+    if (fout.fail())
+    {
+        cerr << "Failed to write " << paramsFileName << "\n";
+        return false;
+    }
+
+    // the logger only records markers when it is loaded in an application traced by the GPU profiler
+    return envSet && SetEnvVariable("CL_AGENT", "CLTraceAgent");
+}
+
+/// Helper function to record begin/end pairs and time them
+/// \param szMarkerName the marker name
+/// \param depth the number of markers begun before they are ended, each sample times the whole nest
+/// \param numPairs the number of timed pairs
+/// \param[out] nanos the latency of each sample, in ns per pair
+static void RecordPairs(const char* szMarkerName, size_t depth, size_t numPairs, vector<unsigned long long>& nanos)
+{
+    nanos.reserve(numPairs / depth);
+
+    for (size_t i = 0; i + depth <= numPairs; i += depth)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        for (size_t j = 0; j < depth; j++)
+        {
+            amdtBeginMarker(szMarkerName, s_GROUP_NAME, nullptr);
+        }
+
+        for (size_t j = 0; j < depth; j++)
+        {
+            amdtEndMarker();
+        }
+
+        chrono::steady_clock::duration duration = chrono::steady_clock::now() - start;
+        nanos.push_back(static_cast<unsigned long long>(chrono::duration_cast<chrono::nanoseconds>(duration).count()) / depth);
+    }
+}
+
+/// Helper function to run a scenario on several threads, which start recording at the same time
+/// \param szMarkerName the marker name
+/// \param depth the nesting depth of the markers
+/// \param numThreads the number of threads
+/// \param numPairs the number of timed pairs per thread
+/// \param[in,out] numMarkers the number of markers recorded so far, including the warm up
+/// \return the latencies of all threads
+static BenchmarkResult RunScenario(const char* szMarkerName, size_t depth, unsigned int numThreads, size_t numPairs, size_t& numMarkers)
+{
+    vector<vector<unsigned long long> > threadNanos(numThreads);
+    vector<thread> threads;
+    atomic<unsigned int> numReady(0);
+    atomic<bool> go(false);
+
+    for (unsigned int i = 0; i < numThreads; i++)
+    {
+        vector<unsigned long long>* pNanos = &threadNanos[i];
+
+        threads.push_back(thread([=, &numReady, &go]()
+        {
+            // the first marker of a thread registers it, which is not part of the steady state cost
+            for (size_t j = 0; j < s_WARMUP_PAIRS; j++)
+            {
+                amdtBeginMarker(szMarkerName, s_GROUP_NAME, nullptr);
+                amdtEndMarker();
+            }
+
+            numReady++;
+
+            while (!go.load())
+            {
+                this_thread::yield();
+            }
+
+            RecordPairs(szMarkerName, depth, numPairs, *pNanos);
+        }));
+    }
+
+    while (numReady.load() != numThreads)
+    {
+        this_thread::yield();
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    go = true;
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i].join();
+    }
+
+    BenchmarkResult result;
+    result.m_wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.m_numPairs = 0;
+
+    for (size_t i = 0; i < threadNanos.size(); i++)
+    {
+        result.m_nanos.insert(result.m_nanos.end(), threadNanos[i].begin(), threadNanos[i].end());
+        result.m_numPairs += threadNanos[i].size() * depth;
+    }
+
+    numMarkers += result.m_numPairs + numThreads * s_WARMUP_PAIRS;
+
+    return result;
+}
+
+/// Helper function to get a percentile of sorted latencies
+/// \param nanos the sorted latencies
+/// \param fraction the percentile, between 0 and 1
+/// \return the latency
+static unsigned long long GetPercentile(const vector<unsigned long long>& nanos, double fraction)
+{
+    size_t index = static_cast<size_t>(fraction * nanos.size());
+    return nanos[min(index, nanos.size() - 1)];
+}
+
+/// Helper function to print the header of the scenario table
+static void PrintHeader()
+{
+    cout << left << setw(s_NAME_WIDTH) << "Scenario" << right << setw(s_COLUMN_WIDTH) << "Threads" << setw(s_COLUMN_WIDTH) << "Pairs";
+    cout << setw(s_COLUMN_WIDTH) << "MeanNs" << setw(s_COLUMN_WIDTH) << "P50Ns" << setw(s_COLUMN_WIDTH) << "P90Ns" << setw(s_COLUMN_WIDTH) << "P99Ns";
+    cout << setw(s_COLUMN_WIDTH) << "P99.9Ns" << setw(s_COLUMN_WIDTH) << "MaxNs" << setw(s_COLUMN_WIDTH) << "MPairs/s" << '\n';
+}
+
+/// Helper function to print the latencies of a scenario
+/// \param name the scenario name
+/// \param numThreads the number of threads of the scenario
+/// \param[in,out] result the result of the scenario, its latencies are sorted
+static void PrintResult(const string& name, unsigned int numThreads, BenchmarkResult& result)
+{
+    if (result.m_nanos.empty())
+    {
+        return;
+    }
+
+    sort(result.m_nanos.begin(), result.m_nanos.end());
+
+    double totalNanos = 0;
+
+    for (size_t i = 0; i < result.m_nanos.size(); i++)
+    {
+        totalNanos += static_cast<double>(result.m_nanos[i]);
+    }
+
+    cout << left << setw(s_NAME_WIDTH) << name << right << setw(s_COLUMN_WIDTH) << numThreads << setw(s_COLUMN_WIDTH) << result.m_numPairs;
+    cout << setw(s_COLUMN_WIDTH) << fixed << setprecision(1) << totalNanos / result.m_nanos.size();
+    cout << setw(s_COLUMN_WIDTH) << GetPercentile(result.m_nanos, 0.5) << setw(s_COLUMN_WIDTH) << GetPercentile(result.m_nanos, 0.9);
+    cout << setw(s_COLUMN_WIDTH) << GetPercentile(result.m_nanos, 0.99) << setw(s_COLUMN_WIDTH) << GetPercentile(result.m_nanos, 0.999);
+    cout << setw(s_COLUMN_WIDTH) << result.m_nanos.back();
+    cout << setw(s_COLUMN_WIDTH) << setprecision(2) << (result.m_wallSeconds > 0 ? result.m_numPairs / result.m_wallSeconds / 1e6 : 0.0) << '\n';
+}
+
+/// Helper function to measure the cost of reading the clock, which is included in each sample
+/// \return the median cost, in ns
+static unsigned long long GetClockOverhead()
+{
+    vector<unsigned long long> nanos(s_WARMUP_PAIRS);
+
+    for (size_t i = 0; i < nanos.size(); i++)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        nanos[i] = static_cast<unsigned long long>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+    }
+
+    sort(nanos.begin(), nanos.end());
+
+    return GetPercentile(nanos, 0.5);
+}
+
+/// Helper function to get the size of a file
+/// \param fileName the file name
+/// \return the size in bytes, 0 if the file cannot be read
+static unsigned long long GetFileSize(const string& fileName)
+{
+    ifstream fin(fileName.c_str(), ios_base::in | ios_base::binary | ios_base::ate);
+    return fin.fail() ? 0 : static_cast<unsigned long long>(fin.tellg());
+}
+
+/// Runs the scenarios of a mode in the current process
+/// \param mode the mode, one of s_MODES
+/// \param workDir the directory of the params, temp and output files
+/// \param maxThreads the largest thread count of the scalability scenarios
+/// \param numPairs the number of timed pairs per thread and scenario
+/// \return true on success
+static bool RunMode(const string& mode, const string& workDir, unsigned int maxThreads, size_t numPairs)
+{
+    string outputFileName;
+
+    if (!SetupProfilerEnvironment(mode, workDir, outputFileName))
+    {
+        return false;
+    }
+
+    int status = amdtInitializeActivityLogger();
+
+    if (status != AL_SUCCESS)
+    {
+        cerr << "amdtInitializeActivityLogger failed with " << status << "\n";
+        return false;
+    }
+
+    cout << "Mode " << mode << ", clock overhead " << GetClockOverhead() << " ns per sample\n";
+    PrintHeader();
+
+    size_t numMarkers = 0;
+    string longName(s_LONG_NAME_LENGTH, 'L');
+
+    for (unsigned int numThreads = 1; numThreads <= maxThreads; numThreads = numThreads < maxThreads ? min(numThreads * 2, maxThreads) : numThreads + 1)
+    {
+        BenchmarkResult result = RunScenario("Short", 1, numThreads, numPairs, numMarkers);
+        PrintResult("Begin/end", numThreads, result);
+    }
+
+    static const size_t s_DEPTHS[] = { 8, 64 };
+
+    for (size_t i = 0; i < sizeof(s_DEPTHS) / sizeof(s_DEPTHS[0]); i++)
+    {
+        BenchmarkResult result = RunScenario("Nested", s_DEPTHS[i], 1, numPairs, numMarkers);
+        PrintResult("Nested depth " + to_string(s_DEPTHS[i]), 1, result);
+    }
+
+    BenchmarkResult longNameResult = RunScenario(longName.c_str(), 1, 1, numPairs, numMarkers);
+    PrintResult("Name of " + to_string(s_LONG_NAME_LENGTH) + " chars", 1, longNameResult);
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    status = amdtFinalizeActivityLogger();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (status != AL_SUCCESS)
+    {
+        cerr << "amdtFinalizeActivityLogger failed with " << status << "\n";
+        return false;
+    }
+
+    cout << "Finalize " << numMarkers << " markers in " << fixed << setprecision(1) << seconds * 1e3 << " ms, "
+         << (numMarkers > 0 ? seconds * 1e3 * 1e6 / numMarkers : 0.0) << " ms per million markers, "
+         << GetFileSize(outputFileName) << " bytes written to " << outputFileName << "\n\n";
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 5)
+    {
+        cerr << "Usage: " << argv[0] << " <work directory> [InMemory|Timeout|Binary|Statistics|All [max threads [pairs per thread]]]\n";
+        return 1;
+    }
+
+    string workDir = argv[1];
+    string mode = argc >= 3 ? argv[2] : "All";
+    unsigned int maxThreads = min(max(thread::hardware_concurrency(), 1u), s_DEFAULT_MAX_THREADS);
+    size_t numPairs = s_DEFAULT_PAIRS;
+
+    if (argc >= 4)
+    {
+        maxThreads = max(static_cast<unsigned int>(strtoul(argv[3], nullptr, 10)), 1u);
+    }
+
+    if (argc == 5)
+    {
+        numPairs = max(static_cast<size_t>(strtoul(argv[4], nullptr, 10)), static_cast<size_t>(64));
+    }
+
+    if (mode != "All")
+    {
+        return RunMode(mode, workDir, maxThreads, numPairs) ? 0 : 1;
+    }
+
+    // each mode in its own process, the logger cannot be initialized again after it is finalized
+    bool succeeded = true;
+
+    for (size_t i = 0; i < sizeof(s_MODES) / sizeof(s_MODES[0]); i++)
+    {
+        cout.flush();
+        string command = string("\"") + argv[0] + "\" \"" + workDir + "\" " + s_MODES[i] + " " + to_string(maxThreads) + " " + to_string(numPairs);
+        succeeded = system(command.c_str()) == 0 && succeeded;
+    }
+
+    return succeeded ? 0 : 1;
+}
@@ -0,0 +1,743 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Writes and reads perf marker events in the compact binary .amdtperfmarker layout
+//==============================================================================
+
+#include <algorithm>
+#include <cstring>
+
+#include "AMDTActivityLoggerBinaryFormat.h"
+#include "AMDTActivityLoggerMarkerArgs.h"
+#include "AMDTActivityLoggerUserString.h"
+
+using namespace std;
+
+const unsigned char s_TAG_HAS_MARKER_HANDLE = 0x80; ///< flag of the tag byte of an event followed by a marker handle
+const unsigned char s_TAG_CHUNK = 0x7f;             ///< tag byte starting a chunk
+const size_t s_MAX_VARINT_LENGTH = 10;              ///< maximum length of a 64-bit varint
+
+/// Helper function to check whether events of a type carry a count in their payload
+/// \param type the PerfMarkerEventType
+/// \return true if the payload is a count
+static bool HasEventCount(unsigned int type)
+{
+    return type == PERF_MARKER_EVENT_SAMPLED_BEGIN || type == PERF_MARKER_EVENT_SKIPPED || type == PERF_MARKER_EVENT_DROPPED;
+}
+
+/// Helper function to get the zigzag encoding of a signed value, so that small negative values have short varints
+/// \param value the value
+/// \return the encoded value
+static unsigned long long EncodeZigzag(long long value)
+{
+    unsigned long long bits = static_cast<unsigned long long>(value);
+    return (bits << 1) ^ (value < 0 ? ~0ULL : 0ULL);
+}
+
+/// Helper function to encode a varint
+/// \param value the value
+/// \param[out] pBytes the buffer receiving the varint, at least s_MAX_VARINT_LENGTH bytes
+/// \return the length of the varint
+static size_t EncodeVarint(unsigned long long value, unsigned char* pBytes)
+{
+    size_t length = 0;
+
+    while (value >= 0x80)
+    {
+        pBytes[length++] = static_cast<unsigned char>(value | 0x80);
+        value >>= 7;
+    }
+
+    pBytes[length++] = static_cast<unsigned char>(value);
+    return length;
+}
+
+/// Helper function to encode a little-endian 64-bit value
+/// \param value the value
+/// \param[out] pBytes the buffer receiving the 8 bytes
+/// \return the length of the encoded value
+static size_t EncodeFixed(unsigned long long value, unsigned char* pBytes)
+{
+    for (size_t i = 0; i < sizeof(value); i++)
+    {
+        pBytes[i] = static_cast<unsigned char>((value >> (8 * i)) & 0xff);
+    }
+
+    return sizeof(value);
+}
+
+/// Helper function to append a varint to a string
+/// \param[in,out] str the string
+/// \param value the value
+static void AppendVarint(string& str, unsigned long long value)
+{
+    unsigned char bytes[s_MAX_VARINT_LENGTH];
+    str.append(reinterpret_cast<const char*>(bytes), EncodeVarint(value, bytes));
+}
+
+/// Helper function to append a string and its length to a string
+/// \param[in,out] str the string
+/// \param value the string to append
+static void AppendString(string& str, const string& value)
+{
+    AppendVarint(str, value.length());
+    str.append(value);
+}
+
+/// Helper function to get the zigzag encoding of the difference between a timestamp and the previous one
+/// \param timestamp the timestamp
+/// \param lastTimestamp the previous timestamp
+/// \return the encoded difference
+static unsigned long long GetTimestampDelta(unsigned long long timestamp, unsigned long long lastTimestamp)
+{
+    return timestamp >= lastTimestamp ? (timestamp - lastTimestamp) << 1 : ((lastTimestamp - timestamp) << 1) - 1;
+}
+
+/// Helper function to get the count carried by an event
+/// \param event the event
+/// \return the count
+static unsigned long long GetEventCount(const PerfMarkerEvent& event)
+{
+    unsigned long long count;
+    memcpy(&count, event.GetPayload(), sizeof(count));
+    return count;
+}
+
+PerfMarkerBinaryEncoder::PerfMarkerBinaryEncoder()
+{
+    m_numBytes = 0;
+    m_lastTimestamp = 0;
+    m_depth = 0;
+}
+
+void PerfMarkerBinaryEncoder::Write(ostream& os, const PerfMarkerEventChunk* pFirstChunk)
+{
+    Encode(&os, pFirstChunk);
+}
+
+unsigned long long PerfMarkerBinaryEncoder::GetSize(const PerfMarkerEventChunk* pFirstChunk) const
+{
+    // encode from a copy of the state, the chunks written so far only matter through the current one
+    PerfMarkerBinaryEncoder encoder;
+    encoder.m_numBytes = m_numBytes;
+    encoder.m_lastTimestamp = m_lastTimestamp;
+    encoder.m_depth = m_depth;
+
+    if (!m_chunks.empty())
+    {
+        encoder.m_chunks.push_back(m_chunks.back());
+    }
+
+    encoder.Encode(nullptr, pFirstChunk);
+
+    return encoder.m_numBytes - m_numBytes;
+}
+
+void PerfMarkerBinaryEncoder::Encode(ostream* pOs, const PerfMarkerEventChunk* pFirstChunk)
+{
+    for (const PerfMarkerEventChunk* pChunk = pFirstChunk; pChunk != nullptr; pChunk = pChunk->m_pNext)
+    {
+        size_t slot = 0;
+
+        while (slot < pChunk->m_usedSlots)
+        {
+            const PerfMarkerEvent& event = pChunk->m_pSlots[slot];
+            unsigned char bytes[1 + 3 * s_MAX_VARINT_LENGTH];
+            size_t length = 0;
+
+            if (m_chunks.empty() || m_numBytes - m_chunks.back().m_offset >= s_PERF_MARKER_BINARY_CHUNK_SIZE)
+            {
+                // start a chunk, its first timestamp is encoded in full
+                PerfMarkerBinaryIndexEntry entry = { m_numBytes, event.m_timestamp, event.m_timestamp, 0, 0, m_depth };
+                m_chunks.push_back(entry);
+                m_lastTimestamp = 0;
+                bytes[length++] = s_TAG_CHUNK;
+            }
+
+            bytes[length++] = event.m_type | (event.m_markerHandle != 0 ? s_TAG_HAS_MARKER_HANDLE : 0);
+            length += EncodeVarint(GetTimestampDelta(event.m_timestamp, m_lastTimestamp), bytes + length);
+            m_lastTimestamp = event.m_timestamp;
+
+            if (event.m_markerHandle != 0)
+            {
+                length += EncodeVarint(event.m_markerHandle, bytes + length);
+            }
+
+            if (HasEventCount(event.m_type))
+            {
+                length += EncodeVarint(GetEventCount(event), bytes + length);
+            }
+            else if (event.m_type == PERF_MARKER_EVENT_COUNTER)
+            {
+                long long value;
+                memcpy(&value, event.GetPayload(), sizeof(value));
+                length += EncodeVarint(EncodeZigzag(value), bytes + length);
+            }
+            else if (event.m_type == PERF_MARKER_EVENT_COUNTER_DOUBLE)
+            {
+                // the bits of the double, little-endian
+                length += EncodeFixed(GetEventCount(event), bytes + length);
+            }
+            else if (event.m_type == PERF_MARKER_EVENT_ARGS)
+            {
+                size_t numArgs;
+                GetPerfMarkerEventArgs(event, numArgs);
+                length += EncodeVarint(numArgs, bytes + length);
+            }
+
+            if (pOs != nullptr)
+            {
+                pOs->write(reinterpret_cast<const char*>(bytes), length);
+            }
+
+            if (event.m_type == PERF_MARKER_EVENT_USER_STRING)
+            {
+                // the user string is kept as recorded, it is only parsed when converted to the text layout
+                size_t userStringLength;
+                const char* pUserString = GetPerfMarkerEventUserString(event, userStringLength);
+                size_t lengthLength = EncodeVarint(userStringLength, bytes);
+
+                if (pOs != nullptr)
+                {
+                    pOs->write(reinterpret_cast<const char*>(bytes), lengthLength);
+                    pOs->write(pUserString, userStringLength);
+                }
+
+                length += lengthLength + userStringLength;
+            }
+            else if (event.m_type == PERF_MARKER_EVENT_ARGS)
+            {
+                size_t numArgs;
+                const PerfMarkerArg* pArgs = GetPerfMarkerEventArgs(event, numArgs);
+
+                for (size_t i = 0; i < numArgs; i++)
+                {
+                    // name handle, type byte, and the value as for a counter, or the length of the string
+                    unsigned char argBytes[1 + 2 * s_MAX_VARINT_LENGTH];
+                    size_t argLength = EncodeVarint(pArgs[i].m_nameHandle, argBytes);
+                    argBytes[argLength++] = static_cast<unsigned char>(pArgs[i].m_type);
+
+                    if (pArgs[i].m_type == PERF_MARKER_ARG_INT64)
+                    {
+                        argLength += EncodeVarint(EncodeZigzag(static_cast<long long>(pArgs[i].m_value)), argBytes + argLength);
+                    }
+                    else if (pArgs[i].m_type == PERF_MARKER_ARG_DOUBLE)
+                    {
+                        argLength += EncodeFixed(pArgs[i].m_value, argBytes + argLength);
+                    }
+                    else
+                    {
+                        argLength += EncodeVarint(strlen(GetPerfMarkerEventArgString(event, pArgs[i])), argBytes + argLength);
+                    }
+
+                    if (pOs != nullptr)
+                    {
+                        pOs->write(reinterpret_cast<const char*>(argBytes), argLength);
+                    }
+
+                    length += argLength;
+
+                    if (pArgs[i].m_type == PERF_MARKER_ARG_STRING)
+                    {
+                        // the bytes of the string follow its length
+                        const char* szValue = GetPerfMarkerEventArgString(event, pArgs[i]);
+                        size_t valueLength = strlen(szValue);
+
+                        if (pOs != nullptr)
+                        {
+                            pOs->write(szValue, valueLength);
+                        }
+
+                        length += valueLength;
+                    }
+                }
+            }
+
+            switch (event.m_type)
+            {
+                case PERF_MARKER_EVENT_BEGIN:
+                case PERF_MARKER_EVENT_SAMPLED_BEGIN:
+                    m_depth++;
+                    break;
+
+                case PERF_MARKER_EVENT_END:
+                case PERF_MARKER_EVENT_END_EX:
+                    m_depth = m_depth != 0 ? m_depth - 1 : 0;
+                    break;
+
+                default:
+                    break;
+            }
+
+            m_numBytes += length;
+            m_chunks.back().m_lastTimestamp = event.m_timestamp;
+            m_chunks.back().m_numEvents++;
+            slot += event.GetNumSlots();
+        }
+    }
+}
+
+unsigned long long GetPerfMarkerEventChunksNumEvents(const PerfMarkerEventChunk* pFirstChunk)
+{
+    unsigned long long numEvents = 0;
+
+    for (const PerfMarkerEventChunk* pChunk = pFirstChunk; pChunk != nullptr; pChunk = pChunk->m_pNext)
+    {
+        size_t slot = 0;
+
+        while (slot < pChunk->m_usedSlots)
+        {
+            numEvents++;
+            slot += pChunk->m_pSlots[slot].GetNumSlots();
+        }
+    }
+
+    return numEvents;
+}
+
+string GetPerfMarkerBinaryFileHeader(const PerfMarkerTable& markerTable, unsigned long long numSections)
+{
+    string header(s_PERF_MARKER_BINARY_MAGIC, sizeof(s_PERF_MARKER_BINARY_MAGIC));
+    unsigned int numMarkers = markerTable.GetNumMarkers();
+
+    AppendVarint(header, s_PERF_MARKER_BINARY_VERSION);
+    AppendVarint(header, numMarkers);
+
+    for (unsigned int handle = 1; handle <= numMarkers; handle++)
+    {
+        const PerfMarkerInfo& info = markerTable.Get(handle);
+        AppendString(header, info.m_markerName);
+        AppendString(header, info.m_groupName);
+    }
+
+    AppendVarint(header, numSections);
+
+    return header;
+}
+
+string GetPerfMarkerBinarySectionHeader(const string& threadId, unsigned long long numEvents, unsigned long long eventsSize)
+{
+    string header;
+    AppendString(header, threadId);
+    AppendVarint(header, numEvents);
+    AppendVarint(header, eventsSize);
+    return header;
+}
+
+/// Helper function to append a little-endian integer to a string
+/// \param[in,out] str the string
+/// \param value the value
+/// \param size the number of bytes of the integer
+static void AppendFixed(string& str, unsigned long long value, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        str.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+/// Helper function to read a little-endian integer
+/// \param pBytes the bytes of the integer
+/// \param size the number of bytes of the integer
+/// \return the value
+static unsigned long long ReadFixed(const unsigned char* pBytes, size_t size)
+{
+    unsigned long long value = 0;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        value |= static_cast<unsigned long long>(pBytes[i]) << (8 * i);
+    }
+
+    return value;
+}
+
+string GetPerfMarkerBinaryIndex(const vector<PerfMarkerBinaryIndexEntry>& entries, unsigned long long indexOffset)
+{
+    string index;
+    index.reserve(entries.size() * s_PERF_MARKER_BINARY_INDEX_ENTRY_SIZE + s_PERF_MARKER_BINARY_TRAILER_SIZE);
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        AppendFixed(index, entries[i].m_offset, 8);
+        AppendFixed(index, entries[i].m_firstTimestamp, 8);
+        AppendFixed(index, entries[i].m_lastTimestamp, 8);
+        AppendFixed(index, entries[i].m_section, 4);
+        AppendFixed(index, entries[i].m_numEvents, 4);
+        AppendFixed(index, entries[i].m_depth, 4);
+        AppendFixed(index, 0, 4);
+    }
+
+    AppendFixed(index, indexOffset, 8);
+    AppendFixed(index, entries.size(), 8);
+    index.append(s_PERF_MARKER_BINARY_INDEX_MAGIC, sizeof(s_PERF_MARKER_BINARY_INDEX_MAGIC));
+
+    return index;
+}
+
+void FindPerfMarkerBinaryChunks(const vector<PerfMarkerBinaryIndexEntry>& entries, unsigned int section, unsigned long long startTimestamp, unsigned long long endTimestamp, size_t& first, size_t& last)
+{
+    // entries are sorted by section, then by time within a section
+    vector<PerfMarkerBinaryIndexEntry>::const_iterator sectionBegin = lower_bound(entries.begin(), entries.end(), section,
+                                                                                  [](const PerfMarkerBinaryIndexEntry& entry, unsigned int value) { return entry.m_section < value; });
+    vector<PerfMarkerBinaryIndexEntry>::const_iterator sectionEnd = upper_bound(sectionBegin, entries.end(), section,
+                                                                                [](unsigned int value, const PerfMarkerBinaryIndexEntry& entry) { return value < entry.m_section; });
+
+    // the first chunk ending at or after the start, up to the first chunk starting after the end
+    vector<PerfMarkerBinaryIndexEntry>::const_iterator firstIt = lower_bound(sectionBegin, sectionEnd, startTimestamp,
+                                                                             [](const PerfMarkerBinaryIndexEntry& entry, unsigned long long value) { return entry.m_lastTimestamp < value; });
+    vector<PerfMarkerBinaryIndexEntry>::const_iterator lastIt = upper_bound(firstIt, sectionEnd, endTimestamp,
+                                                                            [](unsigned long long value, const PerfMarkerBinaryIndexEntry& entry) { return value < entry.m_firstTimestamp; });
+
+    first = firstIt - entries.begin();
+    last = lastIt - entries.begin();
+}
+
+PerfMarkerBinaryReader::PerfMarkerBinaryReader(const void* pData, size_t size, unsigned long long baseOffset)
+{
+    m_pData = static_cast<const unsigned char*>(pData);
+    m_size = size;
+    m_pos = 0;
+    m_baseOffset = baseOffset;
+}
+
+bool PerfMarkerBinaryReader::IsBinaryFile(const void* pData, size_t size)
+{
+    return size >= sizeof(s_PERF_MARKER_BINARY_MAGIC) && memcmp(pData, s_PERF_MARKER_BINARY_MAGIC, sizeof(s_PERF_MARKER_BINARY_MAGIC)) == 0;
+}
+
+bool PerfMarkerBinaryReader::ReadFileHeader(PerfMarkerTable& markerTable, unsigned long long& numSections)
+{
+    unsigned long long version;
+    unsigned long long numMarkers;
+
+    if (!IsBinaryFile(m_pData, m_size))
+    {
+        return false;
+    }
+
+    m_pos = sizeof(s_PERF_MARKER_BINARY_MAGIC);
+
+    // older files only lack the events added since: counters, instants and user strings in version 3, arguments in version 4
+    if (!ReadVarint(version) || version < 2 || version > s_PERF_MARKER_BINARY_VERSION || !ReadVarint(numMarkers))
+    {
+        return false;
+    }
+
+    for (unsigned long long i = 1; i <= numMarkers; i++)
+    {
+        string markerName;
+        string groupName;
+
+        if (!ReadString(markerName) || !ReadString(groupName) || markerTable.Register(markerName.c_str(), groupName.c_str()) != i)
+        {
+            return false;
+        }
+    }
+
+    return ReadVarint(numSections);
+}
+
+bool PerfMarkerBinaryReader::ReadSectionHeader(string& threadId, unsigned long long& numEvents, unsigned long long& eventsSize)
+{
+    return ReadString(threadId) && ReadVarint(numEvents) && ReadVarint(eventsSize);
+}
+
+bool PerfMarkerBinaryReader::ReadSection(string& threadId, PerfMarkerEventBuffer& events)
+{
+    unsigned long long numEvents;
+    unsigned long long eventsSize;
+
+    if (!ReadSectionHeader(threadId, numEvents, eventsSize) || eventsSize > m_size - m_pos)
+    {
+        return false;
+    }
+
+    size_t end = m_pos + static_cast<size_t>(eventsSize);
+    unsigned long long timestamp = 0;
+    unsigned long long numReadEvents = 0;
+
+    while (m_pos < end)
+    {
+        bool isEvent;
+
+        if (!ReadEvent(end, timestamp, events, isEvent))
+        {
+            return false;
+        }
+
+        numReadEvents += isEvent ? 1 : 0;
+    }
+
+    return numReadEvents == numEvents;
+}
+
+bool PerfMarkerBinaryReader::ReadIndexOffset(unsigned long long& indexOffset) const
+{
+    if (m_size < s_PERF_MARKER_BINARY_TRAILER_SIZE ||
+        memcmp(m_pData + m_size - sizeof(s_PERF_MARKER_BINARY_INDEX_MAGIC), s_PERF_MARKER_BINARY_INDEX_MAGIC, sizeof(s_PERF_MARKER_BINARY_INDEX_MAGIC)) != 0)
+    {
+        return false;
+    }
+
+    indexOffset = ReadFixed(m_pData + m_size - s_PERF_MARKER_BINARY_TRAILER_SIZE, 8);
+    return true;
+}
+
+bool PerfMarkerBinaryReader::ReadIndex(vector<PerfMarkerBinaryIndexEntry>& entries)
+{
+    unsigned long long indexOffset;
+
+    entries.clear();
+
+    if (!ReadIndexOffset(indexOffset))
+    {
+        return false;
+    }
+
+    unsigned long long numEntries = ReadFixed(m_pData + m_size - s_PERF_MARKER_BINARY_TRAILER_SIZE + 8, 8);
+    size_t indexEnd = m_size - s_PERF_MARKER_BINARY_TRAILER_SIZE;
+
+    if (indexOffset < m_baseOffset || indexOffset - m_baseOffset > indexEnd ||
+        numEntries != (indexEnd - (indexOffset - m_baseOffset)) / s_PERF_MARKER_BINARY_INDEX_ENTRY_SIZE)
+    {
+        return false;
+    }
+
+    entries.resize(static_cast<size_t>(numEntries));
+
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const unsigned char* pEntry = m_pData + (indexOffset - m_baseOffset) + i * s_PERF_MARKER_BINARY_INDEX_ENTRY_SIZE;
+        entries[i].m_offset = ReadFixed(pEntry, 8);
+        entries[i].m_firstTimestamp = ReadFixed(pEntry + 8, 8);
+        entries[i].m_lastTimestamp = ReadFixed(pEntry + 16, 8);
+        entries[i].m_section = static_cast<unsigned int>(ReadFixed(pEntry + 24, 4));
+        entries[i].m_numEvents = static_cast<unsigned int>(ReadFixed(pEntry + 28, 4));
+        entries[i].m_depth = static_cast<unsigned int>(ReadFixed(pEntry + 32, 4));
+
+        if (entries[i].m_offset >= indexOffset)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool PerfMarkerBinaryReader::ReadChunk(const PerfMarkerBinaryIndexEntry& entry, PerfMarkerEventBuffer& events)
+{
+    if (entry.m_offset < m_baseOffset || entry.m_offset - m_baseOffset >= m_size || m_pData[entry.m_offset - m_baseOffset] != s_TAG_CHUNK)
+    {
+        return false;
+    }
+
+    m_pos = static_cast<size_t>(entry.m_offset - m_baseOffset) + 1;
+    unsigned long long timestamp = 0;
+
+    for (unsigned int i = 0; i < entry.m_numEvents; i++)
+    {
+        bool isEvent;
+
+        if (!ReadEvent(m_size, timestamp, events, isEvent) || !isEvent)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool PerfMarkerBinaryReader::ReadEvent(size_t end, unsigned long long& timestamp, PerfMarkerEventBuffer& events, bool& isEvent)
+{
+    isEvent = false;
+
+    if (m_pos >= end)
+    {
+        return false;
+    }
+
+    unsigned char tag = m_pData[m_pos++];
+
+    if (tag == s_TAG_CHUNK)
+    {
+        timestamp = 0;
+        return true;
+    }
+
+    unsigned int type = tag & ~s_TAG_HAS_MARKER_HANDLE;
+    unsigned long long delta;
+    unsigned long long markerHandle = 0;
+    unsigned long long count = 0;
+    string userString;
+    vector<PerfMarkerArg> args;
+    size_t argsSize = 0;
+    bool hasPayload = HasEventCount(type) || type == PERF_MARKER_EVENT_COUNTER || type == PERF_MARKER_EVENT_COUNTER_DOUBLE;
+
+    if (!ReadVarint(delta) ||
+        ((tag & s_TAG_HAS_MARKER_HANDLE) != 0 && !ReadVarint(markerHandle)) ||
+        ((HasEventCount(type) || type == PERF_MARKER_EVENT_COUNTER) && !ReadVarint(count)))
+    {
+        return false;
+    }
+
+    if (type == PERF_MARKER_EVENT_COUNTER)
+    {
+        // the payload holds the signed value
+        count = (count >> 1) ^ (0ULL - (count & 1));
+    }
+    else if (type == PERF_MARKER_EVENT_COUNTER_DOUBLE)
+    {
+        if (m_size - m_pos < sizeof(count))
+        {
+            return false;
+        }
+
+        count = ReadFixed(m_pData + m_pos, sizeof(count));
+        m_pos += sizeof(count);
+    }
+    else if (type == PERF_MARKER_EVENT_USER_STRING && !ReadString(userString))
+    {
+        return false;
+    }
+    else if (type == PERF_MARKER_EVENT_ARGS && !ReadArgs(args, argsSize))
+    {
+        return false;
+    }
+
+    if (m_pos > end)
+    {
+        return false;
+    }
+
+    timestamp = (delta & 1) == 0 ? timestamp + (delta >> 1) : timestamp - ((delta + 1) >> 1);
+
+    bool added;
+
+    if (type == PERF_MARKER_EVENT_USER_STRING)
+    {
+        // recorded with its null terminator
+        added = events.AddEvent(PERF_MARKER_EVENT_USER_STRING, timestamp, static_cast<unsigned int>(markerHandle), userString.c_str(), userString.length() + 1);
+    }
+    else if (type == PERF_MARKER_EVENT_ARGS)
+    {
+        added = events.AddEvent(PERF_MARKER_EVENT_ARGS, timestamp, static_cast<unsigned int>(markerHandle), args.data(), argsSize);
+    }
+    else if (hasPayload)
+    {
+        added = events.AddEvent(static_cast<PerfMarkerEventType>(type), timestamp, static_cast<unsigned int>(markerHandle), &count, sizeof(count));
+    }
+    else
+    {
+        added = events.AddEvent(static_cast<PerfMarkerEventType>(type), timestamp, static_cast<unsigned int>(markerHandle));
+    }
+
+    isEvent = added;
+    return added;
+}
+
+bool PerfMarkerBinaryReader::ReadArgs(vector<PerfMarkerArg>& payload, size_t& payloadSize)
+{
+    unsigned long long count;
+
+    if (!ReadVarint(count) || count == 0 || count > s_MAX_PERF_MARKER_ARGS)
+    {
+        return false;
+    }
+
+    payload.resize(static_cast<size_t>(count));
+    payloadSize = payload.size() * sizeof(PerfMarkerArg);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        unsigned long long nameHandle;
+
+        if (!ReadVarint(nameHandle) || m_pos >= m_size)
+        {
+            return false;
+        }
+
+        unsigned int type = m_pData[m_pos++];
+        payload[i].m_nameHandle = static_cast<unsigned int>(nameHandle);
+        payload[i].m_type = type;
+
+        if (type == PERF_MARKER_ARG_DOUBLE)
+        {
+            if (m_size - m_pos < sizeof(payload[i].m_value))
+            {
+                return false;
+            }
+
+            payload[i].m_value = ReadFixed(m_pData + m_pos, sizeof(payload[i].m_value));
+            m_pos += sizeof(payload[i].m_value);
+        }
+        else if (type == PERF_MARKER_ARG_INT64)
+        {
+            unsigned long long value;
+
+            if (!ReadVarint(value))
+            {
+                return false;
+            }
+
+            payload[i].m_value = (value >> 1) ^ (0ULL - (value & 1));
+        }
+        else if (type == PERF_MARKER_ARG_STRING)
+        {
+            unsigned long long length;
+
+            if (!ReadVarint(length) || length > m_size - m_pos)
+            {
+                return false;
+            }
+
+            // the string values follow the arguments in the payload
+            AppendPerfMarkerArgString(payload, payloadSize, i, reinterpret_cast<const char*>(m_pData + m_pos), static_cast<size_t>(length));
+            m_pos += static_cast<size_t>(length);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool PerfMarkerBinaryReader::ReadVarint(unsigned long long& value)
+{
+    value = 0;
+
+    for (unsigned int shift = 0; shift < 64; shift += 7)
+    {
+        if (m_pos >= m_size)
+        {
+            return false;
+        }
+
+        unsigned char byte = m_pData[m_pos++];
+        value |= static_cast<unsigned long long>(byte & 0x7f) << shift;
+
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool PerfMarkerBinaryReader::ReadString(string& value)
+{
+    unsigned long long length;
+
+    if (!ReadVarint(length) || length > m_size - m_pos)
+    {
+        return false;
+    }
+
+    value.assign(reinterpret_cast<const char*>(m_pData + m_pos), static_cast<size_t>(length));
+    m_pos += static_cast<size_t>(length);
+    return true;
+}
@@ -0,0 +1,203 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Writes and reads perf marker events in the compact binary .amdtperfmarker layout
+//==============================================================================
+
+#ifndef _AMDT_ACTIVITY_LOGGER_BINARY_FORMAT_H_
+#define _AMDT_ACTIVITY_LOGGER_BINARY_FORMAT_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "AMDTActivityLoggerEventBuffer.h"
+#include "AMDTActivityLoggerMarkerArgs.h"
+#include "AMDTActivityLoggerMarkerTable.h"
+
+// Layout of a binary .amdtperfmarker file, integers are unsigned LEB128 varints unless noted:
+//   file header:    magic "AMDTPMB\0", version, number of markers, the marker and group names of each
+//                   marker handle in order (length and bytes), number of sections
+//   section header: thread id (length and bytes of its text form), number of events, size of the events
+//   chunk:          chunk tag byte, then events. The events of a section are split into chunks of about
+//                   s_PERF_MARKER_BINARY_CHUNK_SIZE bytes which can be decoded independently.
+//   event:          tag byte (PerfMarkerEventType, 0x80 if a marker handle follows), zigzag timestamp delta
+//                   from the previous event of the chunk, marker handle, count for the event types with a count,
+//                   zigzag value for integer counters, little-endian 64-bit bits of the value for double counters,
+//                   length and bytes of the user string for user strings, number of arguments then the name handle,
+//                   type byte and value of each argument for arguments (length and bytes of string values)
+//   index:          one fixed-size little-endian PerfMarkerBinaryIndexEntry per chunk, in section order
+//   trailer:        little-endian 64-bit offset of the index and number of entries, magic "AMDTPMIX"
+
+const char s_PERF_MARKER_BINARY_MAGIC[8] = { 'A', 'M', 'D', 'T', 'P', 'M', 'B', '\0' };       ///< the first bytes of a binary file
+const char s_PERF_MARKER_BINARY_INDEX_MAGIC[8] = { 'A', 'M', 'D', 'T', 'P', 'M', 'I', 'X' }; ///< the last bytes of a binary file
+const unsigned int s_PERF_MARKER_BINARY_VERSION = 4;                                          ///< the version of the binary layout, versions 2 and 3 are still read
+const size_t s_PERF_MARKER_BINARY_CHUNK_SIZE = 64 * 1024;                                     ///< size in bytes after which a new chunk is started
+const size_t s_PERF_MARKER_BINARY_INDEX_ENTRY_SIZE = 40;                                      ///< size in bytes of an index entry in the file
+const size_t s_PERF_MARKER_BINARY_TRAILER_SIZE = 24;                                          ///< size in bytes of the trailer
+
+/// Index entry of a chunk of a binary file
+struct PerfMarkerBinaryIndexEntry
+{
+    unsigned long long m_offset;          ///< offset of the chunk, in the file or from the start of the events of the section while writing
+    unsigned long long m_firstTimestamp;  ///< timestamp of the first event of the chunk
+    unsigned long long m_lastTimestamp;   ///< timestamp of the last event of the chunk
+    unsigned int m_section;               ///< index of the section holding the chunk
+    unsigned int m_numEvents;             ///< number of events of the chunk
+    unsigned int m_depth;                 ///< number of markers open at the start of the chunk
+};
+
+/// Encoder of the events of a section, which can be written in several parts to the same stream
+class PerfMarkerBinaryEncoder
+{
+public:
+    /// Constructor
+    PerfMarkerBinaryEncoder();
+
+    /// Writes events following the events already written
+    /// \param os the stream to write to
+    /// \param pFirstChunk the first of the chunks holding the events
+    void Write(std::ostream& os, const PerfMarkerEventChunk* pFirstChunk);
+
+    /// Gets the number of bytes Write would write for events
+    /// \param pFirstChunk the first of the chunks holding the events
+    /// \return the number of bytes
+    unsigned long long GetSize(const PerfMarkerEventChunk* pFirstChunk) const;
+
+    /// Gets the chunks written so far
+    /// \return the index entries of the chunks, with offsets from the start of the section's events and a section index of 0
+    const std::vector<PerfMarkerBinaryIndexEntry>& GetChunks() const { return m_chunks; }
+
+private:
+    /// Encodes events
+    /// \param pOs the stream to write to, nullptr to only update the state
+    /// \param pFirstChunk the first of the chunks holding the events
+    void Encode(std::ostream* pOs, const PerfMarkerEventChunk* pFirstChunk);
+
+    unsigned long long m_numBytes;                  ///< number of bytes written
+    unsigned long long m_lastTimestamp;             ///< timestamp of the last event written to the current chunk
+    unsigned int m_depth;                           ///< number of markers open after the last event written
+    std::vector<PerfMarkerBinaryIndexEntry> m_chunks; ///< the chunks written, the last one is the current chunk
+};
+
+/// Gets the number of events in a list of event buffer chunks
+/// \param pFirstChunk the first chunk of the list
+/// \return the number of events
+unsigned long long GetPerfMarkerEventChunksNumEvents(const PerfMarkerEventChunk* pFirstChunk);
+
+/// Builds the header of a binary file
+/// \param markerTable the table holding the names of all the markers
+/// \param numSections the number of sections of the file
+/// \return the header
+std::string GetPerfMarkerBinaryFileHeader(const PerfMarkerTable& markerTable, unsigned long long numSections);
+
+/// Builds the header of a section of a binary file
+/// \param threadId the thread id, in its text form
+/// \param numEvents the number of events of the section
+/// \param eventsSize the size of the events of the section in bytes
+/// \return the header
+std::string GetPerfMarkerBinarySectionHeader(const std::string& threadId, unsigned long long numEvents, unsigned long long eventsSize);
+
+/// Builds the index and the trailer ending a binary file
+/// \param entries the index entries of all the chunks, with file offsets
+/// \param indexOffset the offset of the index in the file
+/// \return the index and the trailer
+std::string GetPerfMarkerBinaryIndex(const std::vector<PerfMarkerBinaryIndexEntry>& entries, unsigned long long indexOffset);
+
+/// Finds the chunks of a section holding events in a time range, using the index of a binary file
+/// \param entries the index entries of all the chunks
+/// \param section the index of the section
+/// \param startTimestamp the start of the time range
+/// \param endTimestamp the end of the time range
+/// \param[out] first the index of the first entry in the range
+/// \param[out] last the index after the last entry in the range, equal to first if no chunk is in the range
+void FindPerfMarkerBinaryChunks(const std::vector<PerfMarkerBinaryIndexEntry>& entries, unsigned int section, unsigned long long startTimestamp, unsigned long long endTimestamp, size_t& first, size_t& last);
+
+/// Reads a binary file, or a part of it, held in memory
+class PerfMarkerBinaryReader
+{
+public:
+    /// Constructor
+    /// \param pData the contents of the file, or of the part of the file being read
+    /// \param size the size of the data
+    /// \param baseOffset the offset in the file of the data, the index offsets are file offsets
+    PerfMarkerBinaryReader(const void* pData, size_t size, unsigned long long baseOffset = 0);
+
+    /// Checks whether data starts with the magic of a binary file
+    /// \param pData the data
+    /// \param size the size of the data
+    /// \return true if the data is a binary file
+    static bool IsBinaryFile(const void* pData, size_t size);
+
+    /// Reads the file header and registers its markers, in order, so that their handles match the handles of the events
+    /// \param[out] markerTable an empty table receiving the markers
+    /// \param[out] numSections the number of sections of the file
+    /// \return false if the header is malformed or has an unsupported version
+    bool ReadFileHeader(PerfMarkerTable& markerTable, unsigned long long& numSections);
+
+    /// Reads the header of the next section, the section's events follow it
+    /// \param[out] threadId the thread id of the section
+    /// \param[out] numEvents the number of events of the section
+    /// \param[out] eventsSize the size of the events of the section in bytes
+    /// \return false if the header is truncated
+    bool ReadSectionHeader(std::string& threadId, unsigned long long& numEvents, unsigned long long& eventsSize);
+
+    /// Reads the next section
+    /// \param[out] threadId the thread id of the section
+    /// \param[out] events an empty buffer receiving the events of the section
+    /// \return false if the section is malformed or truncated
+    bool ReadSection(std::string& threadId, PerfMarkerEventBuffer& events);
+
+    /// Reads the offset of the index from the trailer, when the data ends with the trailer
+    /// \param[out] indexOffset the offset in the file of the index
+    /// \return false if the data does not end with a trailer
+    bool ReadIndexOffset(unsigned long long& indexOffset) const;
+
+    /// Reads the index of the chunks, when the data ends with the index and the trailer
+    /// \param[out] entries the index entries of all the chunks
+    /// \return false if the file has no index or if it is malformed
+    bool ReadIndex(std::vector<PerfMarkerBinaryIndexEntry>& entries);
+
+    /// Reads the events of a chunk, when the data holds the chunk
+    /// \param entry the index entry of the chunk
+    /// \param[out] events the buffer the events are appended to
+    /// \return false if the chunk is malformed
+    bool ReadChunk(const PerfMarkerBinaryIndexEntry& entry, PerfMarkerEventBuffer& events);
+
+    /// Gets the file offset of the next byte to read
+    /// \return the offset
+    unsigned long long GetOffset() const { return m_baseOffset + m_pos; }
+
+private:
+    /// Reads a varint
+    /// \param[out] value the value
+    /// \return false at the end of the data or if the varint is malformed
+    bool ReadVarint(unsigned long long& value);
+
+    /// Reads a string
+    /// \param[out] value the string
+    /// \return false at the end of the data
+    bool ReadString(std::string& value);
+
+    /// Reads the arguments of an arguments event
+    /// \param[out] payload the payload of the event, the arguments followed by their string values
+    /// \param[out] payloadSize the size in bytes of the payload
+    /// \return false if the arguments are malformed
+    bool ReadArgs(std::vector<PerfMarkerArg>& payload, size_t& payloadSize);
+
+    /// Reads the next event or chunk tag
+    /// \param end the end of the events being read
+    /// \param[in,out] timestamp the timestamp of the previous event of the chunk, updated to the timestamp of the event
+    /// \param[out] events the buffer the event is appended to
+    /// \param[out] isEvent false if a chunk tag was read
+    /// \return false if the event is malformed
+    bool ReadEvent(size_t end, unsigned long long& timestamp, PerfMarkerEventBuffer& events, bool& isEvent);
+
+    const unsigned char* m_pData;       ///< the contents of the file, or of the part of the file being read
+    size_t m_size;                      ///< the size of the data
+    size_t m_pos;                       ///< the position in the data of the next byte to read
+    unsigned long long m_baseOffset;    ///< the offset in the file of the data
+};
+
+#endif // _AMDT_ACTIVITY_LOGGER_BINARY_FORMAT_H_
@@ -0,0 +1,768 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Exports perf marker files to the Chrome trace event JSON format,
+///        read by chrome://tracing and Perfetto
+//==============================================================================
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "AMDTActivityLoggerChromeTrace.h"
+#include "AMDTActivityLoggerBinaryFormat.h"
+#include "AMDTActivityLoggerTextWriter.h"
+#include "AMDTActivityLoggerUserString.h"
+#include "AMDTGPUProfilerDefs.h"
+
+using namespace std;
+
+const unsigned int s_CHROME_TRACE_PROCESS_ID = 1;           ///< the process id of all the events, the perf marker file holds a single process
+const size_t s_MAX_SECTION_HEADER_SIZE = 1024;              ///< maximum size read for the header of a section of a binary file
+const size_t s_TEXT_TAG_WIDTH = 20;                         ///< width of the tag column of the text layout
+
+/// Helper function to get the number of instances carried by a sampled begin, skipped or dropped event
+/// \param event the event
+/// \return the number of instances
+static unsigned long long GetEventCount(const PerfMarkerEvent& event)
+{
+    unsigned long long count;
+    memcpy(&count, event.GetPayload(), sizeof(count));
+    return count;
+}
+
+/// Helper function to append a JSON string
+/// \param[in,out] json the JSON text the string is appended to
+/// \param str the string, appended with its quotes
+static void AppendJsonString(string& json, const string& str)
+{
+    static const char s_HEX_DIGITS[] = "0123456789abcdef";
+
+    json.push_back('"');
+
+    for (string::const_iterator it = str.begin(); it != str.end(); ++it)
+    {
+        unsigned char c = static_cast<unsigned char>(*it);
+
+        if (c == '"' || c == '\\')
+        {
+            json.push_back('\\');
+            json.push_back(*it);
+        }
+        else if (c < 0x20)
+        {
+            json.append("\\u00");
+            json.push_back(s_HEX_DIGITS[c >> 4]);
+            json.push_back(s_HEX_DIGITS[c & 0xf]);
+        }
+        else
+        {
+            json.push_back(*it);
+        }
+    }
+
+    json.push_back('"');
+}
+
+/// Helper function to set an argument of a marker, replacing the value of an argument of the same name
+/// \param[in,out] marker the marker
+/// \param name the name of the argument
+/// \param jsonValue the JSON value of the argument
+static void SetMarkerArg(PerfMarkerChromeTraceSlice& marker, const string& name, const string& jsonValue)
+{
+    for (size_t i = 0; i < marker.m_args.size(); i++)
+    {
+        if (marker.m_args[i].first == name)
+        {
+            marker.m_args[i].second = jsonValue;
+            return;
+        }
+    }
+
+    marker.m_args.push_back(make_pair(name, jsonValue));
+}
+
+PerfMarkerChromeTraceWriter::PerfMarkerChromeTraceWriter(ostream& os) : m_os(os)
+{
+    m_tid = 0;
+    m_lastTimestamp = 0;
+    m_bFirstEvent = true;
+    m_isEndPending = false;
+    m_pArgsMarker = nullptr;
+}
+
+void PerfMarkerChromeTraceWriter::Begin()
+{
+    m_os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+}
+
+void PerfMarkerChromeTraceWriter::BeginThread(const string& threadId)
+{
+    EndThread();
+    CloseEvent();
+
+    m_tid++;
+    m_lastTimestamp = 0;
+
+    m_os << (m_bFirstEvent ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << s_CHROME_TRACE_PROCESS_ID << ",\"tid\":" << m_tid << ",\"args\":{\"name\":";
+    WriteString("Thread " + threadId);
+    m_os << "}}";
+    m_bFirstEvent = false;
+}
+
+void PerfMarkerChromeTraceWriter::WriteBegin(unsigned long long timestamp, const string& markerName, const string& groupName, unsigned long long numSamples)
+{
+    CloseEvent();
+
+    PerfMarkerChromeTraceSlice marker;
+    marker.m_beginTimestamp = timestamp;
+    marker.m_endTimestamp = timestamp;
+    marker.m_markerName = markerName;
+    marker.m_groupName = groupName;
+
+    if (numSamples != 0)
+    {
+        ostringstream samples;
+        samples << numSamples;
+        marker.m_args.push_back(make_pair(string("samples"), samples.str()));
+    }
+
+    // the complete event is written at the end, the arguments of the begin are kept until then
+    m_openMarkers.push_back(marker);
+    m_pArgsMarker = &m_openMarkers.back();
+    m_lastTimestamp = timestamp;
+}
+
+void PerfMarkerChromeTraceWriter::WriteEnd(unsigned long long timestamp)
+{
+    if (!m_openMarkers.empty())
+    {
+        CloseEvent();
+
+        // the complete event is written with the next event, after the arguments of the user string of the end
+        m_endedMarker.m_beginTimestamp = m_openMarkers.back().m_beginTimestamp;
+        m_endedMarker.m_endTimestamp = timestamp;
+        m_endedMarker.m_markerName.swap(m_openMarkers.back().m_markerName);
+        m_endedMarker.m_groupName.swap(m_openMarkers.back().m_groupName);
+        m_endedMarker.m_args.swap(m_openMarkers.back().m_args);
+        m_openMarkers.pop_back();
+        m_isEndPending = true;
+        m_pArgsMarker = &m_endedMarker;
+        m_lastTimestamp = timestamp;
+    }
+}
+
+void PerfMarkerChromeTraceWriter::WriteEnd(unsigned long long timestamp, const string& markerName, const string& groupName)
+{
+    if (!m_openMarkers.empty())
+    {
+        WriteEnd(timestamp);
+        m_endedMarker.m_markerName = markerName;
+        m_endedMarker.m_groupName = groupName;
+    }
+}
+
+void PerfMarkerChromeTraceWriter::WriteInstant(unsigned long long timestamp, const char* szReason, const string& markerName, const string& groupName, unsigned long long count)
+{
+    WriteEventStart("i", timestamp != 0 ? timestamp : m_lastTimestamp);
+    m_os << ",\"s\":\"t\",\"name\":\"" << szReason << "\",\"cat\":";
+    WriteString(groupName);
+    m_os << ",\"args\":{";
+
+    if (!markerName.empty())
+    {
+        m_os << "\"marker\":";
+        WriteString(markerName);
+        m_os << ",";
+    }
+
+    m_os << "\"count\":" << count << "}}";
+}
+
+void PerfMarkerChromeTraceWriter::WriteInstantMarker(unsigned long long timestamp, const string& markerName, const string& groupName)
+{
+    WriteEventStart("i", timestamp);
+    m_os << ",\"s\":\"t\",\"name\":";
+    WriteString(markerName);
+    m_os << ",\"cat\":";
+    WriteString(groupName);
+    m_os << "}";
+}
+
+void PerfMarkerChromeTraceWriter::WriteCounter(unsigned long long timestamp, const string& counterName, const string& groupName, const string& value)
+{
+    // inf and nan are the only values with an n
+    if (value.empty() || value.find('n') != string::npos)
+    {
+        return;
+    }
+
+    WriteEventStart("C", timestamp);
+    m_os << ",\"name\":";
+    WriteString(counterName);
+    m_os << ",\"cat\":";
+    WriteString(groupName);
+    m_os << ",\"args\":{\"value\":" << value << "}}";
+}
+
+void PerfMarkerChromeTraceWriter::WriteArg(const string& name, const string& value, bool isNumber)
+{
+    if (m_pArgsMarker == nullptr)
+    {
+        return;
+    }
+
+    // inf and nan are the only numbers with an n
+    if (isNumber && !value.empty() && value.find('n') == string::npos)
+    {
+        SetMarkerArg(*m_pArgsMarker, name, value);
+    }
+    else
+    {
+        string jsonValue;
+        AppendJsonString(jsonValue, value);
+        SetMarkerArg(*m_pArgsMarker, name, jsonValue);
+    }
+}
+
+void PerfMarkerChromeTraceWriter::WriteEvent(const PerfMarkerEvent& event, const PerfMarkerTable& markerTable)
+{
+    switch (event.m_type)
+    {
+        case PERF_MARKER_EVENT_BEGIN:
+        {
+            const PerfMarkerInfo& info = markerTable.Get(event.m_markerHandle);
+            WriteBegin(event.m_timestamp, info.m_markerName, info.m_groupName, 0);
+            break;
+        }
+
+        case PERF_MARKER_EVENT_SAMPLED_BEGIN:
+        {
+            const PerfMarkerInfo& info = markerTable.Get(event.m_markerHandle);
+            WriteBegin(event.m_timestamp, info.m_markerName, info.m_groupName, GetEventCount(event));
+            break;
+        }
+
+        case PERF_MARKER_EVENT_SKIPPED:
+        {
+            const PerfMarkerInfo& info = markerTable.Get(event.m_markerHandle);
+            WriteInstant(event.m_timestamp, "Skipped markers", info.m_markerName, info.m_groupName, GetEventCount(event));
+            break;
+        }
+
+        case PERF_MARKER_EVENT_DROPPED:
+            WriteInstant(event.m_timestamp, "Dropped markers", string(), string(), GetEventCount(event));
+            break;
+
+        case PERF_MARKER_EVENT_END:
+            WriteEnd(event.m_timestamp);
+            break;
+
+        case PERF_MARKER_EVENT_END_EX:
+        {
+            const PerfMarkerInfo& info = markerTable.Get(event.m_markerHandle);
+            WriteEnd(event.m_timestamp, info.m_markerName, info.m_groupName);
+            break;
+        }
+
+        case PERF_MARKER_EVENT_COUNTER:
+        case PERF_MARKER_EVENT_COUNTER_DOUBLE:
+        {
+            const PerfMarkerInfo& info = markerTable.Get(event.m_markerHandle);
+            char value[s_PERF_MARKER_COUNTER_VALUE_MAX_LENGTH];
+            WriteCounter(event.m_timestamp, info.m_markerName, info.m_groupName, string(value, FormatPerfMarkerCounterValue(event, value)));
+            break;
+        }
+
+        case PERF_MARKER_EVENT_INSTANT:
+        {
+            const PerfMarkerInfo& info = markerTable.Get(event.m_markerHandle);
+            WriteInstantMarker(event.m_timestamp, info.m_markerName, info.m_groupName);
+            break;
+        }
+
+        case PERF_MARKER_EVENT_ARGS:
+        {
+            size_t numArgs;
+            const PerfMarkerArg* pArgs = GetPerfMarkerEventArgs(event, numArgs);
+
+            for (size_t i = 0; i < numArgs; i++)
+            {
+                WriteArg(markerTable.Get(pArgs[i].m_nameHandle).m_markerName, GetPerfMarkerArgValueText(event, pArgs[i]), pArgs[i].m_type != PERF_MARKER_ARG_STRING);
+            }
+
+            break;
+        }
+
+        case PERF_MARKER_EVENT_USER_STRING:
+        {
+            PerfMarkerUserString userString;
+            size_t length;
+            const char* pUserString = GetPerfMarkerEventUserString(event, length);
+
+            if (ParsePerfMarkerUserString(pUserString, length, userString))
+            {
+                if (!userString.m_color.empty())
+                {
+                    WriteArg("color", "#" + userString.m_color);
+                }
+
+                if (!userString.m_comment.empty())
+                {
+                    WriteArg("comment", userString.m_comment);
+                }
+            }
+
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void PerfMarkerChromeTraceWriter::End()
+{
+    EndThread();
+    CloseEvent();
+    m_os << "\n]}\n";
+}
+
+void PerfMarkerChromeTraceWriter::WriteEventStart(const char* szPhase, unsigned long long timestamp)
+{
+    CloseEvent();
+
+    m_os << (m_bFirstEvent ? "\n" : ",\n") << "{\"ph\":\"" << szPhase << "\",\"pid\":" << s_CHROME_TRACE_PROCESS_ID << ",\"tid\":" << m_tid << ",\"ts\":";
+    WriteMicros(timestamp);
+
+    m_lastTimestamp = timestamp;
+    m_bFirstEvent = false;
+}
+
+void PerfMarkerChromeTraceWriter::WriteMicros(unsigned long long nanos)
+{
+    // trace timestamps are in microseconds, the fraction keeps the nanoseconds
+    unsigned long long fraction = nanos % 1000;
+
+    m_os << nanos / 1000 << '.' << static_cast<char>('0' + fraction / 100) << static_cast<char>('0' + fraction / 10 % 10) << static_cast<char>('0' + fraction % 10);
+}
+
+void PerfMarkerChromeTraceWriter::CloseEvent()
+{
+    m_pArgsMarker = nullptr;
+
+    if (!m_isEndPending)
+    {
+        return;
+    }
+
+    m_isEndPending = false;
+
+    // the complete event does not change the timestamp of the previous event of the thread
+    m_os << (m_bFirstEvent ? "\n" : ",\n") << "{\"ph\":\"X\",\"pid\":" << s_CHROME_TRACE_PROCESS_ID << ",\"tid\":" << m_tid << ",\"ts\":";
+    WriteMicros(m_endedMarker.m_beginTimestamp);
+    m_os << ",\"dur\":";
+    WriteMicros(m_endedMarker.m_endTimestamp >= m_endedMarker.m_beginTimestamp ? m_endedMarker.m_endTimestamp - m_endedMarker.m_beginTimestamp : 0);
+    m_os << ",\"name\":";
+    WriteString(m_endedMarker.m_markerName);
+    m_os << ",\"cat\":";
+    WriteString(m_endedMarker.m_groupName);
+
+    for (size_t i = 0; i < m_endedMarker.m_args.size(); i++)
+    {
+        m_os << (i == 0 ? ",\"args\":{" : ",");
+        WriteString(m_endedMarker.m_args[i].first);
+        m_os << ":" << m_endedMarker.m_args[i].second;
+    }
+
+    m_os << (m_endedMarker.m_args.empty() ? "}" : "}}");
+    m_bFirstEvent = false;
+}
+
+void PerfMarkerChromeTraceWriter::WriteString(const string& str)
+{
+    string json;
+    AppendJsonString(json, str);
+    m_os << json;
+}
+
+void PerfMarkerChromeTraceWriter::EndThread()
+{
+    while (!m_openMarkers.empty())
+    {
+        WriteEnd(m_lastTimestamp);
+    }
+}
+
+/// Helper function to replace the AL_SPACE sequences of a name read from the text layout with spaces
+/// \param escaped the escaped name
+/// \return the name
+static string UnescapeSpaces(const string& escaped)
+{
+    const size_t escapeLength = strlen(AL_SPACE);
+    string name;
+    size_t pos = 0;
+    size_t found;
+
+    while ((found = escaped.find(AL_SPACE, pos)) != string::npos)
+    {
+        name.append(escaped, pos, found - pos);
+        name.push_back(' ');
+        pos = found + escapeLength;
+    }
+
+    name.append(escaped, pos, string::npos);
+    return name;
+}
+
+/// Helper function to read a line of the text layout, which has CRLF line ends when written on Windows
+/// \param fin the stream of the perf marker file
+/// \param[out] line the line, without its line end
+/// \return false at the end of the file
+static bool ReadLine(istream& fin, string& line)
+{
+    if (!getline(fin, line))
+    {
+        return false;
+    }
+
+    if (!line.empty() && line[line.length() - 1] == '\r')
+    {
+        line.erase(line.length() - 1);
+    }
+
+    return true;
+}
+
+/// Begin of a marker read from the text layout, kept until the next line tells whether it was sampled
+struct PendingPerfMarkerBegin
+{
+    bool m_isPending;               ///< flag indicating if a begin was read and not yet written
+    unsigned long long m_timestamp; ///< the timestamp of the begin
+    string m_markerName;            ///< the marker name
+    string m_groupName;             ///< the group name
+};
+
+/// Helper function to write the pending begin of a marker
+/// \param writer the trace writer
+/// \param[in,out] begin the pending begin
+/// \param numSamples the number of instances the marker stands for, 0 if it was not sampled
+static void WritePendingBegin(PerfMarkerChromeTraceWriter& writer, PendingPerfMarkerBegin& begin, unsigned long long numSamples)
+{
+    if (begin.m_isPending)
+    {
+        writer.WriteBegin(begin.m_timestamp, begin.m_markerName, begin.m_groupName, numSamples);
+        begin.m_isPending = false;
+    }
+}
+
+/// Helper function to write the number of dropped markers read from the text layout, which has no timestamp for them
+/// \param writer the trace writer
+/// \param timestamp the timestamp of the event following the dropped markers, 0 to use the timestamp of the previous event
+/// \param[in,out] numDropped the number of dropped markers not yet written, reset to 0
+static void WritePendingDropped(PerfMarkerChromeTraceWriter& writer, unsigned long long timestamp, unsigned long long& numDropped)
+{
+    if (numDropped != 0)
+    {
+        writer.WriteInstant(timestamp, "Dropped markers", string(), string(), numDropped);
+        numDropped = 0;
+    }
+}
+
+/// Helper function to export a perf marker file in the text layout, line by line
+/// \param fin the stream of the perf marker file, positioned after the file header line
+/// \param writer the trace writer
+/// \return false if the file is truncated or malformed
+static bool ExportTextPerfMarkerFile(istream& fin, PerfMarkerChromeTraceWriter& writer)
+{
+    string threadId;
+    string line;
+
+    while (ReadLine(fin, threadId) && !threadId.empty())
+    {
+        unsigned long long numLines;
+
+        if (!ReadLine(fin, line) || !(istringstream(line) >> numLines))
+        {
+            return false;
+        }
+
+        writer.BeginThread(threadId);
+
+        PendingPerfMarkerBegin begin;
+        begin.m_isPending = false;
+        unsigned long long numDropped = 0;
+
+        for (unsigned long long i = 0; i < numLines; i++)
+        {
+            if (!ReadLine(fin, line))
+            {
+                return false;
+            }
+
+            // the columns are padded with spaces, the names have their spaces escaped except in clEndPerfMarkerEx lines
+            istringstream columns(line);
+            string tag;
+            columns >> tag;
+
+            if (tag == "clPerfMarkerSamples")
+            {
+                unsigned long long numSamples = 0;
+                columns >> numSamples;
+                WritePendingBegin(writer, begin, numSamples);
+                continue;
+            }
+
+            WritePendingBegin(writer, begin, 0);
+
+            if (tag == "clBeginPerfMarker")
+            {
+                string markerName;
+                string groupName;
+                columns >> markerName >> begin.m_timestamp >> groupName;
+                begin.m_markerName = UnescapeSpaces(markerName);
+                begin.m_groupName = UnescapeSpaces(groupName);
+                begin.m_isPending = true;
+                WritePendingDropped(writer, begin.m_timestamp, numDropped);
+            }
+            else if (tag == "clEndPerfMarker" || tag == "clEndPerfMarkerEx")
+            {
+                unsigned long long timestamp = 0;
+                string markerName;
+                string groupName;
+                columns >> timestamp;
+                WritePendingDropped(writer, timestamp, numDropped);
+
+                // the names of clEndPerfMarkerEx lines are not escaped, they replace the names given at the begin
+                if (tag == "clEndPerfMarkerEx" && ParsePerfMarkerEndExNames(line.data(), line.length(), markerName, groupName))
+                {
+                    writer.WriteEnd(timestamp, markerName, groupName);
+                }
+                else
+                {
+                    writer.WriteEnd(timestamp);
+                }
+            }
+            else if (tag == "clPerfMarkerSkipped")
+            {
+                // the line has the layout of clBeginPerfMarker with the count as value
+                string markerName;
+                string groupName;
+                unsigned long long count = 0;
+                columns >> markerName >> count >> groupName;
+                writer.WriteInstant(0, "Skipped markers", UnescapeSpaces(markerName), UnescapeSpaces(groupName), count);
+            }
+            else if (tag == "clPerfMarkerCounter" || tag == "clPerfMarkerInstant")
+            {
+                // the layout of clBeginPerfMarker, followed by the value for a counter
+                string markerName;
+                string groupName;
+                string value;
+                unsigned long long timestamp = 0;
+                columns >> markerName >> timestamp >> groupName >> value;
+                WritePendingDropped(writer, timestamp, numDropped);
+
+                if (tag == "clPerfMarkerCounter")
+                {
+                    writer.WriteCounter(timestamp, UnescapeSpaces(markerName), UnescapeSpaces(groupName), value);
+                }
+                else
+                {
+                    writer.WriteInstantMarker(timestamp, UnescapeSpaces(markerName), UnescapeSpaces(groupName));
+                }
+            }
+            else if (tag == "clPerfMarkerArg")
+            {
+                // the argument name, type and value columns, the name and a string value have their spaces escaped
+                string name;
+                string type;
+                string value;
+                unsigned int argType = PERF_MARKER_ARG_STRING;
+                columns >> name >> type >> value;
+                GetPerfMarkerArgType(type.data(), type.length(), argType);
+                writer.WriteArg(UnescapeSpaces(name), argType == PERF_MARKER_ARG_STRING ? UnescapeSpaces(value) : value, argType != PERF_MARKER_ARG_STRING);
+            }
+            else if (tag == "clPerfMarkerColor")
+            {
+                string color;
+                columns >> color;
+                writer.WriteArg("color", "#" + color);
+            }
+            else if (tag == "clPerfMarkerComment")
+            {
+                // the comment is the rest of the line, after the padded tag
+                writer.WriteArg("comment", line.length() > s_TEXT_TAG_WIDTH ? line.substr(s_TEXT_TAG_WIDTH) : string());
+            }
+            else if (tag == "clPerfMarkerDropped")
+            {
+                unsigned long long count = 0;
+                columns >> count;
+
+                // the dropped markers were counted before the next event, whose timestamp they get
+                numDropped += count;
+            }
+        }
+
+        WritePendingBegin(writer, begin, 0);
+        WritePendingDropped(writer, 0, numDropped);
+    }
+
+    return !fin.bad();
+}
+
+/// Helper function to read a part of a file
+/// \param fin the stream of the file
+/// \param offset the offset of the part
+/// \param size the size of the part
+/// \param[out] data the contents of the part
+/// \return false if the part could not be read
+static bool ReadFilePart(istream& fin, unsigned long long offset, unsigned long long size, vector<char>& data)
+{
+    data.resize(static_cast<size_t>(size));
+    fin.clear();
+    fin.seekg(static_cast<streamoff>(offset));
+    fin.read(data.data(), static_cast<streamsize>(size));
+    return static_cast<unsigned long long>(fin.gcount()) == size;
+}
+
+/// Helper function to export a perf marker file in the binary layout, one chunk at a time
+/// \param fin the stream of the perf marker file
+/// \param writer the trace writer
+/// \return false if the file is truncated or malformed
+static bool ExportBinaryPerfMarkerFile(istream& fin, PerfMarkerChromeTraceWriter& writer)
+{
+    vector<char> data;
+    unsigned long long fileSize;
+    unsigned long long indexOffset;
+    vector<PerfMarkerBinaryIndexEntry> entries;
+
+    fin.clear();
+    fin.seekg(0, ios_base::end);
+    fileSize = static_cast<unsigned long long>(fin.tellg());
+
+    // the trailer locates the index of the chunks, which locates the events of the sections
+    if (fileSize < s_PERF_MARKER_BINARY_TRAILER_SIZE ||
+        !ReadFilePart(fin, fileSize - s_PERF_MARKER_BINARY_TRAILER_SIZE, s_PERF_MARKER_BINARY_TRAILER_SIZE, data) ||
+        !PerfMarkerBinaryReader(data.data(), data.size(), fileSize - s_PERF_MARKER_BINARY_TRAILER_SIZE).ReadIndexOffset(indexOffset) ||
+        indexOffset > fileSize ||
+        !ReadFilePart(fin, indexOffset, fileSize - indexOffset, data) ||
+        !PerfMarkerBinaryReader(data.data(), data.size(), indexOffset).ReadIndex(entries))
+    {
+        return false;
+    }
+
+    // the file header ends before the first chunk, or before the index when there is no event
+    PerfMarkerTable markerTable;
+    unsigned long long numSections;
+    unsigned long long offset;
+
+    if (!ReadFilePart(fin, 0, entries.empty() ? indexOffset : entries[0].m_offset, data))
+    {
+        return false;
+    }
+
+    PerfMarkerBinaryReader headerReader(data.data(), data.size());
+
+    if (!headerReader.ReadFileHeader(markerTable, numSections))
+    {
+        return false;
+    }
+
+    offset = headerReader.GetOffset();
+    size_t entry = 0;
+
+    for (unsigned long long i = 0; i < numSections; i++)
+    {
+        string threadId;
+        unsigned long long numEvents;
+        unsigned long long eventsSize;
+        unsigned long long headerSize = indexOffset - offset < s_MAX_SECTION_HEADER_SIZE ? indexOffset - offset : s_MAX_SECTION_HEADER_SIZE;
+
+        if (!ReadFilePart(fin, offset, headerSize, data))
+        {
+            return false;
+        }
+
+        PerfMarkerBinaryReader sectionReader(data.data(), data.size(), offset);
+
+        if (!sectionReader.ReadSectionHeader(threadId, numEvents, eventsSize) || eventsSize > indexOffset - sectionReader.GetOffset())
+        {
+            return false;
+        }
+
+        unsigned long long eventsEnd = sectionReader.GetOffset() + eventsSize;
+        writer.BeginThread(threadId);
+
+        for (; entry < entries.size() && entries[entry].m_section == i; entry++)
+        {
+            // a chunk ends where the next chunk of the section starts, or at the end of the section
+            unsigned long long chunkEnd = entry + 1 < entries.size() && entries[entry + 1].m_section == i ? entries[entry + 1].m_offset : eventsEnd;
+            PerfMarkerEventBuffer events;
+
+            if (entries[entry].m_offset >= chunkEnd || chunkEnd > eventsEnd ||
+                !ReadFilePart(fin, entries[entry].m_offset, chunkEnd - entries[entry].m_offset, data) ||
+                !PerfMarkerBinaryReader(data.data(), data.size(), entries[entry].m_offset).ReadChunk(entries[entry], events))
+            {
+                return false;
+            }
+
+            for (const PerfMarkerEventChunk* pChunk = events.GetFirstChunk(); pChunk != nullptr; pChunk = pChunk->m_pNext)
+            {
+                size_t slot = 0;
+
+                while (slot < pChunk->m_usedSlots)
+                {
+                    const PerfMarkerEvent& event = pChunk->m_pSlots[slot];
+                    writer.WriteEvent(event, markerTable);
+                    slot += event.GetNumSlots();
+                }
+            }
+        }
+
+        offset = eventsEnd;
+    }
+
+    return entry == entries.size();
+}
+
+bool ExportPerfMarkerFileToChromeTrace(const char* szPerfMarkerFileName, const char* szTraceFileName)
+{
+    ifstream fin(szPerfMarkerFileName, ios_base::in | ios_base::binary);
+
+    if (fin.fail())
+    {
+        return false;
+    }
+
+    char magic[sizeof(s_PERF_MARKER_BINARY_MAGIC)];
+    fin.read(magic, sizeof(magic));
+    bool isBinary = PerfMarkerBinaryReader::IsBinaryFile(magic, static_cast<size_t>(fin.gcount()));
+    string fileHeader;
+
+    fin.clear();
+    fin.seekg(0);
+
+    if (!isBinary && (!ReadLine(fin, fileHeader) || fileHeader != "=====Perfmarker Output====="))
+    {
+        return false;
+    }
+
+    ofstream fout(szTraceFileName);
+
+    if (fout.fail())
+    {
+        return false;
+    }
+
+    PerfMarkerChromeTraceWriter writer(fout);
+    writer.Begin();
+
+    bool retVal = isBinary ? ExportBinaryPerfMarkerFile(fin, writer) : ExportTextPerfMarkerFile(fin, writer);
+
+    writer.End();
+    fout.close();
+
+    return retVal && !fout.fail();
+}
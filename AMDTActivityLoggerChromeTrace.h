@@ -0,0 +1,144 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Exports perf marker files to the Chrome trace event JSON format,
+///        read by chrome://tracing and Perfetto
+//==============================================================================
+
+#ifndef _AMDT_ACTIVITY_LOGGER_CHROME_TRACE_H_
+#define _AMDT_ACTIVITY_LOGGER_CHROME_TRACE_H_
+
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "AMDTActivityLoggerEventBuffer.h"
+#include "AMDTActivityLoggerMarkerTable.h"
+
+/// A marker of the current thread whose complete event is not written yet
+struct PerfMarkerChromeTraceSlice
+{
+    unsigned long long m_beginTimestamp;                        ///< the timestamp of the begin in nanoseconds
+    unsigned long long m_endTimestamp;                          ///< the timestamp of the end in nanoseconds, once the marker ended
+    std::string m_markerName;                                   ///< the marker name
+    std::string m_groupName;                                    ///< the group name
+    std::vector<std::pair<std::string, std::string> > m_args;   ///< the names and JSON values of the arguments
+};
+
+/// Writes perf marker events as Chrome trace events, one event at a time, so that a trace of any size
+/// is written in a single pass. Each thread of the perf marker file becomes a thread of the trace,
+/// each marker a complete event nested in the markers opened before it, and each group its category.
+/// The complete event of a marker is written when the marker ends, so that the names given at the end replace
+/// the names given at the begin; only the markers open at the same time are kept in memory.
+class PerfMarkerChromeTraceWriter
+{
+public:
+    /// Constructor
+    /// \param os the stream to write to
+    PerfMarkerChromeTraceWriter(std::ostream& os);
+
+    /// Writes the start of the trace
+    void Begin();
+
+    /// Starts the events of a thread, ending the events of the previous thread
+    /// \param threadId the thread id, in its text form
+    void BeginThread(const std::string& threadId);
+
+    /// Writes the begin of a marker
+    /// \param timestamp the timestamp in nanoseconds
+    /// \param markerName the marker name
+    /// \param groupName the group name
+    /// \param numSamples the number of instances the marker stands for when it was sampled, 0 if it was not sampled
+    void WriteBegin(unsigned long long timestamp, const std::string& markerName, const std::string& groupName, unsigned long long numSamples);
+
+    /// Writes the end of the innermost open marker, ends without an open marker are ignored
+    /// \param timestamp the timestamp in nanoseconds
+    void WriteEnd(unsigned long long timestamp);
+
+    /// Writes the end of the innermost open marker with the names passed to amdtEndMarkerEx, which replace the names given at its begin
+    /// \param timestamp the timestamp in nanoseconds
+    /// \param markerName the marker name
+    /// \param groupName the group name
+    void WriteEnd(unsigned long long timestamp, const std::string& markerName, const std::string& groupName);
+
+    /// Writes the number of instances of a marker which were not recorded
+    /// \param timestamp the timestamp in nanoseconds, 0 to use the timestamp of the previous event of the thread
+    /// \param szReason the name of the instant event, telling why the instances were not recorded
+    /// \param markerName the marker name, empty if the instances were of any marker
+    /// \param groupName the group name
+    /// \param count the number of instances
+    void WriteInstant(unsigned long long timestamp, const char* szReason, const std::string& markerName, const std::string& groupName, unsigned long long count);
+
+    /// Writes an instant marker
+    /// \param timestamp the timestamp in nanoseconds
+    /// \param markerName the marker name
+    /// \param groupName the group name
+    void WriteInstantMarker(unsigned long long timestamp, const std::string& markerName, const std::string& groupName);
+
+    /// Writes a value of a counter, values which are not finite are ignored as JSON cannot represent them
+    /// \param timestamp the timestamp in nanoseconds
+    /// \param counterName the counter name
+    /// \param groupName the group name
+    /// \param value the value, in its text form
+    void WriteCounter(unsigned long long timestamp, const std::string& counterName, const std::string& groupName, const std::string& value);
+
+    /// Adds an argument to the previous event, ignored unless the previous event is the begin or the end of a marker
+    /// \param name the name of the argument
+    /// \param value the value of the argument
+    /// \param isNumber true to write the value as a JSON number, values which are not finite are written as strings
+    void WriteArg(const std::string& name, const std::string& value, bool isNumber = false);
+
+    /// Writes a perf marker event recorded by the activity logger
+    /// \param event the event
+    /// \param markerTable the table holding the names of the event's marker
+    void WriteEvent(const PerfMarkerEvent& event, const PerfMarkerTable& markerTable);
+
+    /// Ends the events of the last thread and writes the end of the trace
+    void End();
+
+private:
+    /// Writes the fields shared by all the events of the current thread, starting a new event
+    /// \param szPhase the phase of the event
+    /// \param timestamp the timestamp in nanoseconds
+    void WriteEventStart(const char* szPhase, unsigned long long timestamp);
+
+    /// Writes a timestamp or a duration in microseconds, with the nanoseconds as fraction
+    /// \param nanos the timestamp or duration in nanoseconds
+    void WriteMicros(unsigned long long nanos);
+
+    /// Writes the complete event of the marker ended by the previous event, if any, once its arguments are known
+    void CloseEvent();
+
+    /// Writes a JSON string
+    /// \param str the string, written with its quotes
+    void WriteString(const std::string& str);
+
+    /// Ends the markers the current thread left open at its last timestamp
+    void EndThread();
+
+    std::ostream& m_os;                     ///< the stream to write to
+    unsigned int m_tid;                     ///< the thread id written in the trace, the index of the thread from 1
+    unsigned long long m_lastTimestamp;     ///< the timestamp of the previous event of the current thread
+    bool m_bFirstEvent;                     ///< flag indicating if no event has been written yet
+    std::vector<PerfMarkerChromeTraceSlice> m_openMarkers; ///< the markers the current thread has open, the innermost last
+    PerfMarkerChromeTraceSlice m_endedMarker;   ///< the marker ended by the previous event, if m_isEndPending
+    bool m_isEndPending;                    ///< flag indicating if the complete event of m_endedMarker is not written yet
+    PerfMarkerChromeTraceSlice* m_pArgsMarker;  ///< the marker receiving the arguments of the previous event, nullptr unless it is a begin or an end
+
+    /// Disabled copy contructor
+    PerfMarkerChromeTraceWriter(const PerfMarkerChromeTraceWriter& obj);
+
+    /// Disabled assignment operator
+    PerfMarkerChromeTraceWriter& operator = (const PerfMarkerChromeTraceWriter& obj);
+};
+
+/// Exports a perf marker file, in the text or the binary layout, to a Chrome trace file.
+/// The perf marker file is read sequentially, a binary file one chunk at a time, so the memory used does not depend on the size of the file.
+/// \param szPerfMarkerFileName the name of the perf marker file
+/// \param szTraceFileName the name of the trace file to write
+/// \return false if the perf marker file could not be read or is malformed, or if the trace file could not be written
+bool ExportPerfMarkerFileToChromeTrace(const char* szPerfMarkerFileName, const char* szTraceFileName);
+
+#endif // _AMDT_ACTIVITY_LOGGER_CHROME_TRACE_H_
@@ -0,0 +1,121 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Converts a binary .amdtperfmarker file to the text layout read by the GPU profiler
+//==============================================================================
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "AMDTActivityLoggerBinaryFormat.h"
+#include "AMDTActivityLoggerTextWriter.h"
+
+using namespace std;
+
+/// Reads a file into memory
+/// \param szFileName the name of the file
+/// \param[out] data the contents of the file
+/// \return true on success
+static bool ReadFile(const char* szFileName, vector<char>& data)
+{
+    ifstream fin(szFileName, ios_base::in | ios_base::binary);
+
+    if (fin.fail())
+    {
+        return false;
+    }
+
+    data.assign(istreambuf_iterator<char>(fin), istreambuf_iterator<char>());
+
+    return !fin.bad();
+}
+
+/// Writes the text layout of a binary file
+/// \param reader the reader of the binary file
+/// \param fout the stream of the text file
+/// \return true on success
+static bool ConvertPerfMarkerFile(PerfMarkerBinaryReader& reader, ofstream& fout)
+{
+    PerfMarkerTable markerTable;
+    unsigned long long numSections;
+
+    if (!reader.ReadFileHeader(markerTable, numSections))
+    {
+        return false;
+    }
+
+    fout << "=====Perfmarker Output=====\n";
+
+    const ios_base::fmtflags initialFlags = fout.flags();
+
+    for (unsigned long long i = 0; i < numSections; i++)
+    {
+        string threadId;
+        PerfMarkerEventBuffer events;
+
+        if (!reader.ReadSection(threadId, events))
+        {
+            return false;
+        }
+
+        // the logger writes each section through its own stream, the adjustment set by a section does not carry over
+        fout.flags(initialFlags);
+        fout << threadId << '\n' << GetPerfMarkerEventBufferNumLines(events) << '\n';
+        WritePerfMarkerEventBufferText(fout, events, markerTable);
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        cerr << "Usage: " << argv[0] << " <binary .amdtperfmarker file> <text .amdtperfmarker file>\n";
+        return 1;
+    }
+
+    vector<char> data;
+
+    if (!ReadFile(argv[1], data))
+    {
+        cerr << "Failed to read " << argv[1] << "\n";
+        return 1;
+    }
+
+    if (!PerfMarkerBinaryReader::IsBinaryFile(data.data(), data.size()))
+    {
+        cerr << argv[1] << " is not a binary .amdtperfmarker file\n";
+        return 1;
+    }
+
+    ofstream fout(argv[2]);
+
+    if (fout.fail())
+    {
+        cerr << "Failed to create " << argv[2] << "\n";
+        return 1;
+    }
+
+    PerfMarkerBinaryReader reader(data.data(), data.size());
+
+    if (!ConvertPerfMarkerFile(reader, fout))
+    {
+        cerr << argv[1] << " is truncated or malformed\n";
+        return 1;
+    }
+
+    fout.close();
+
+    if (fout.fail())
+    {
+        cerr << "Failed to write " << argv[2] << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,287 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Per-thread buffer of fixed-size binary perf marker event records
+//==============================================================================
+
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <utility>
+
+#include "AMDTActivityLoggerEventBuffer.h"
+
+/// number of slots of a chunk of the default size
+static const size_t s_DEFAULT_CHUNK_SLOTS = (PerfMarkerEventBuffer::s_DEFAULT_CHUNK_SIZE - sizeof(PerfMarkerEventChunk)) / sizeof(PerfMarkerEvent);
+
+/// Freed chunks of the default size kept for reuse, so that threads which are repeatedly created
+/// and destroyed, and the chunks written by the background writer, do not reallocate them
+struct PerfMarkerEventChunkPool
+{
+    /// Constructor
+    PerfMarkerEventChunkPool()
+    {
+        m_pFreeChunks = nullptr;
+        m_numFreeChunks = 0;
+    }
+
+    std::mutex m_mtx;                       ///< mutex to protect the free chunks
+    PerfMarkerEventChunk* m_pFreeChunks;    ///< the list of free chunks
+    size_t m_numFreeChunks;                 ///< the number of free chunks
+};
+
+/// Gets the chunk pool. It is never destroyed, so that the buffers of threads exiting after the static objects are destroyed can still be freed
+/// \return the chunk pool
+static PerfMarkerEventChunkPool& GetChunkPool()
+{
+    static PerfMarkerEventChunkPool* s_pPool = new PerfMarkerEventChunkPool();
+    return *s_pPool;
+}
+
+PerfMarkerEventBuffer::PerfMarkerEventBuffer()
+{
+    m_pFirstChunk = nullptr;
+    m_pLastChunk = nullptr;
+    m_numBytes = 0;
+}
+
+PerfMarkerEventBuffer::~PerfMarkerEventBuffer()
+{
+    FreeChunks(m_pFirstChunk);
+}
+
+bool PerfMarkerEventBuffer::AddEvent(PerfMarkerEventType type, unsigned long long timestamp, unsigned int markerHandle, const void* pPayload, size_t payloadSize)
+{
+    size_t payloadSlots = (payloadSize + sizeof(PerfMarkerEvent) - 1) / sizeof(PerfMarkerEvent);
+
+    if (payloadSlots > 0xffff)
+    {
+        return false;
+    }
+
+    PerfMarkerEvent* pEvent = ReserveSlots(1 + payloadSlots);
+
+    if (pEvent == nullptr)
+    {
+        return false;
+    }
+
+    pEvent->m_type = static_cast<unsigned char>(type);
+    pEvent->m_reserved = 0;
+    pEvent->m_payloadSlots = static_cast<unsigned short>(payloadSlots);
+    pEvent->m_markerHandle = markerHandle;
+    pEvent->m_timestamp = timestamp;
+    memcpy(pEvent + 1, pPayload, payloadSize);
+    return true;
+}
+
+bool PerfMarkerEventBuffer::IsEmpty() const
+{
+    for (const PerfMarkerEventChunk* pChunk = m_pFirstChunk; pChunk != nullptr; pChunk = pChunk->m_pNext)
+    {
+        if (pChunk->m_usedSlots != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void PerfMarkerEventBuffer::Clear()
+{
+    if (m_pFirstChunk != nullptr)
+    {
+        // keep the first chunk so that a buffer which is repeatedly cleared does not reallocate it
+        FreeChunks(m_pFirstChunk->m_pNext);
+        m_pFirstChunk->m_pNext = nullptr;
+        m_pFirstChunk->m_usedSlots = 0;
+        m_pLastChunk = m_pFirstChunk;
+        m_numBytes = GetChunkBytes(m_pFirstChunk);
+    }
+}
+
+bool PerfMarkerEventBuffer::Compact()
+{
+    size_t usedSlots = 0;
+
+    for (const PerfMarkerEventChunk* pChunk = m_pFirstChunk; pChunk != nullptr; pChunk = pChunk->m_pNext)
+    {
+        usedSlots += pChunk->m_usedSlots;
+    }
+
+    if (usedSlots == 0)
+    {
+        FreeChunks(m_pFirstChunk);
+        m_pFirstChunk = nullptr;
+        m_pLastChunk = nullptr;
+        m_numBytes = 0;
+        return true;
+    }
+
+    if (m_pFirstChunk == m_pLastChunk && m_pFirstChunk->m_numSlots == usedSlots)
+    {
+        return true;
+    }
+
+    PerfMarkerEventChunk* pCompactChunk = AllocateChunk(usedSlots);
+
+    if (pCompactChunk == nullptr)
+    {
+        return false;
+    }
+
+    // events never span chunks, so the used slots of the chunks can be concatenated
+    for (const PerfMarkerEventChunk* pChunk = m_pFirstChunk; pChunk != nullptr; pChunk = pChunk->m_pNext)
+    {
+        memcpy(pCompactChunk->m_pSlots + pCompactChunk->m_usedSlots, pChunk->m_pSlots, pChunk->m_usedSlots * sizeof(PerfMarkerEvent));
+        pCompactChunk->m_usedSlots += pChunk->m_usedSlots;
+    }
+
+    FreeChunks(m_pFirstChunk);
+    m_pFirstChunk = pCompactChunk;
+    m_pLastChunk = pCompactChunk;
+    m_numBytes = GetChunkBytes(pCompactChunk);
+    return true;
+}
+
+void PerfMarkerEventBuffer::Swap(PerfMarkerEventBuffer& other)
+{
+    std::swap(m_pFirstChunk, other.m_pFirstChunk);
+    std::swap(m_pLastChunk, other.m_pLastChunk);
+    std::swap(m_numBytes, other.m_numBytes);
+}
+
+PerfMarkerEventChunk* PerfMarkerEventBuffer::DetachFullChunks(size_t& numBytes)
+{
+    numBytes = 0;
+
+    if (m_pFirstChunk == m_pLastChunk)
+    {
+        return nullptr;
+    }
+
+    PerfMarkerEventChunk* pFirst = m_pFirstChunk;
+    PerfMarkerEventChunk* pChunk = m_pFirstChunk;
+
+    while (pChunk->m_pNext != m_pLastChunk)
+    {
+        numBytes += GetChunkBytes(pChunk);
+        pChunk = pChunk->m_pNext;
+    }
+
+    numBytes += GetChunkBytes(pChunk);
+    pChunk->m_pNext = nullptr;
+    m_pFirstChunk = m_pLastChunk;
+    m_numBytes -= numBytes;
+
+    return pFirst;
+}
+
+PerfMarkerEventChunk* PerfMarkerEventBuffer::AllocateChunk(size_t numSlots)
+{
+    if (numSlots == s_DEFAULT_CHUNK_SLOTS)
+    {
+        PerfMarkerEventChunkPool& pool = GetChunkPool();
+        std::lock_guard<std::mutex> lock(pool.m_mtx);
+
+        if (pool.m_pFreeChunks != nullptr)
+        {
+            PerfMarkerEventChunk* pChunk = pool.m_pFreeChunks;
+            pool.m_pFreeChunks = pChunk->m_pNext;
+            pool.m_numFreeChunks--;
+            pChunk->m_pNext = nullptr;
+            pChunk->m_usedSlots = 0;
+            return pChunk;
+        }
+    }
+
+    // the slots are allocated in the same block as the chunk header
+    char* pBlock = new(std::nothrow) char[sizeof(PerfMarkerEventChunk) + numSlots * sizeof(PerfMarkerEvent)];
+
+    if (pBlock == nullptr)
+    {
+        return nullptr;
+    }
+
+    PerfMarkerEventChunk* pChunk = reinterpret_cast<PerfMarkerEventChunk*>(pBlock);
+    pChunk->m_pNext = nullptr;
+    pChunk->m_numSlots = numSlots;
+    pChunk->m_usedSlots = 0;
+    pChunk->m_pSlots = reinterpret_cast<PerfMarkerEvent*>(pBlock + sizeof(PerfMarkerEventChunk));
+
+    return pChunk;
+}
+
+void PerfMarkerEventBuffer::FreeChunks(PerfMarkerEventChunk* pChunk)
+{
+    if (pChunk == nullptr)
+    {
+        return;
+    }
+
+    PerfMarkerEventChunkPool& pool = GetChunkPool();
+    std::lock_guard<std::mutex> lock(pool.m_mtx);
+
+    while (pChunk != nullptr)
+    {
+        PerfMarkerEventChunk* pNext = pChunk->m_pNext;
+
+        if (pChunk->m_numSlots == s_DEFAULT_CHUNK_SLOTS && pool.m_numFreeChunks < s_MAX_POOLED_CHUNKS)
+        {
+            pChunk->m_pNext = pool.m_pFreeChunks;
+            pool.m_pFreeChunks = pChunk;
+            pool.m_numFreeChunks++;
+        }
+        else
+        {
+            delete[] reinterpret_cast<char*>(pChunk);
+        }
+
+        pChunk = pNext;
+    }
+}
+
+PerfMarkerEvent* PerfMarkerEventBuffer::AddChunk(size_t numSlots)
+{
+    size_t chunkSlots = s_DEFAULT_CHUNK_SLOTS;
+
+    if (numSlots > chunkSlots)
+    {
+        // oversized chunk for an event with a large payload
+        chunkSlots = numSlots;
+    }
+
+    PerfMarkerEventChunk* pChunk = AllocateChunk(chunkSlots);
+
+    if (pChunk == nullptr)
+    {
+        return nullptr;
+    }
+
+    pChunk->m_usedSlots = numSlots;
+
+    if (m_pLastChunk == nullptr)
+    {
+        m_pFirstChunk = pChunk;
+    }
+    else
+    {
+        m_pLastChunk->m_pNext = pChunk;
+    }
+
+    m_pLastChunk = pChunk;
+    m_numBytes += GetChunkBytes(pChunk);
+    return pChunk->m_pSlots;
+}
+
+void PerfMarkerEventBuffer::LockChunkPoolForFork()
+{
+    GetChunkPool().m_mtx.lock();
+}
+
+void PerfMarkerEventBuffer::UnlockChunkPoolAfterFork()
+{
+    GetChunkPool().m_mtx.unlock();
+}
@@ -0,0 +1,187 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Per-thread buffer of fixed-size binary perf marker event records
+//==============================================================================
+
+#ifndef _AMDT_ACTIVITY_LOGGER_EVENT_BUFFER_H_
+#define _AMDT_ACTIVITY_LOGGER_EVENT_BUFFER_H_
+
+#include <cstddef>
+
+/// The types of the perf marker events
+enum PerfMarkerEventType
+{
+    PERF_MARKER_EVENT_BEGIN = 0,   ///< amdtBeginMarker, written as clBeginPerfMarker
+    PERF_MARKER_EVENT_END = 1,     ///< amdtEndMarker, written as clEndPerfMarker
+    PERF_MARKER_EVENT_END_EX = 2,  ///< amdtEndMarkerEx with a marker name, written as clEndPerfMarkerEx
+    PERF_MARKER_EVENT_SAMPLED_BEGIN = 3, ///< sampled amdtBeginMarker, the payload is the number of instances it represents, written as clBeginPerfMarker and clPerfMarkerSamples
+    PERF_MARKER_EVENT_SKIPPED = 4, ///< instances of a sampled marker skipped after its last sample, the payload is their number, written as clPerfMarkerSkipped
+    PERF_MARKER_EVENT_DROPPED = 5, ///< markers dropped because the memory budget was exceeded, the payload is their number, written as clPerfMarkerDropped
+    PERF_MARKER_EVENT_COUNTER = 6, ///< amdtRecordCounter, the payload is the signed 64-bit value, written as clPerfMarkerCounter
+    PERF_MARKER_EVENT_COUNTER_DOUBLE = 7, ///< amdtRecordCounterDouble, the payload is the double value, written as clPerfMarkerCounter
+    PERF_MARKER_EVENT_INSTANT = 8, ///< amdtInstantMarker, written as clPerfMarkerInstant
+    PERF_MARKER_EVENT_USER_STRING = 9, ///< user string of the previous event of the thread, a begin or an end, the payload is the null terminated string, written as clPerfMarkerColor and clPerfMarkerComment
+    PERF_MARKER_EVENT_ARGS = 10    ///< arguments of the previous event of the thread, a begin, the payload is one PerfMarkerArg per slot, written as clPerfMarkerArg
+};
+
+/// Fixed-size record of a perf marker event
+struct PerfMarkerEvent
+{
+    unsigned char m_type;            ///< the PerfMarkerEventType of the event
+    unsigned char m_reserved;        ///< unused
+    unsigned short m_payloadSlots;   ///< number of slots following the record that hold its payload
+    unsigned int m_markerHandle;     ///< the handle of the marker in the PerfMarkerTable, 0 for events without names
+    unsigned long long m_timestamp;  ///< the timestamp of the event
+
+    /// Gets the number of slots used by the record and its payload
+    /// \return the number of slots
+    size_t GetNumSlots() const { return 1 + static_cast<size_t>(m_payloadSlots); }
+
+    /// Gets the payload of the event, stored in the slots following the record
+    /// \return the payload
+    const void* GetPayload() const { return this + 1; }
+};
+
+/// A chunk of the event buffer
+struct PerfMarkerEventChunk
+{
+    PerfMarkerEventChunk* m_pNext;  ///< the next chunk in the buffer
+    size_t m_numSlots;              ///< the number of slots available in m_pSlots
+    size_t m_usedSlots;             ///< the number of slots used by the recorded events
+    PerfMarkerEvent* m_pSlots;      ///< the slots holding the event records and their payloads
+};
+
+/// Append-only buffer of perf marker events owned by a single thread.
+/// Events are stored in a linked list of fixed-size chunks so that recording never
+/// moves or copies previously recorded events.
+class PerfMarkerEventBuffer
+{
+public:
+    static const size_t s_DEFAULT_CHUNK_SIZE = 64 * 1024; ///< default size in bytes of a chunk
+    static const size_t s_MAX_POOLED_CHUNKS = 64;         ///< maximum number of freed chunks of the default size kept for reuse by all the buffers
+
+    /// Constructor
+    PerfMarkerEventBuffer();
+
+    /// Destructor
+    ~PerfMarkerEventBuffer();
+
+    /// Appends an event to the buffer
+    /// \param type the PerfMarkerEventType of the event
+    /// \param timestamp the timestamp of the event
+    /// \param markerHandle the handle of the marker in the PerfMarkerTable, 0 for events without names
+    /// \return false if the buffer could not be grown to hold the event
+    bool AddEvent(PerfMarkerEventType type, unsigned long long timestamp, unsigned int markerHandle)
+    {
+        PerfMarkerEvent* pEvent = ReserveSlots(1);
+
+        if (pEvent == nullptr)
+        {
+            return false;
+        }
+
+        pEvent->m_type = static_cast<unsigned char>(type);
+        pEvent->m_reserved = 0;
+        pEvent->m_payloadSlots = 0;
+        pEvent->m_markerHandle = markerHandle;
+        pEvent->m_timestamp = timestamp;
+        return true;
+    }
+
+    /// Appends an event with a payload to the buffer
+    /// \param type the PerfMarkerEventType of the event
+    /// \param timestamp the timestamp of the event
+    /// \param markerHandle the handle of the marker in the PerfMarkerTable, 0 for events without names
+    /// \param pPayload the payload, copied to the slots following the event record
+    /// \param payloadSize the size of the payload in bytes
+    /// \return false if the buffer could not be grown to hold the event
+    bool AddEvent(PerfMarkerEventType type, unsigned long long timestamp, unsigned int markerHandle, const void* pPayload, size_t payloadSize);
+
+    /// Gets the first chunk of the buffer
+    /// \return the first chunk, nullptr if no events have been recorded
+    const PerfMarkerEventChunk* GetFirstChunk() const { return m_pFirstChunk; }
+
+    /// Gets the first chunk of the buffer, to update the recorded events in place
+    /// \return the first chunk, nullptr if no events have been recorded
+    PerfMarkerEventChunk* GetFirstChunk() { return m_pFirstChunk; }
+
+    /// Gets the size of the chunks allocated by the buffer
+    /// \return the size in bytes
+    size_t GetNumBytes() const { return m_numBytes; }
+
+    /// Checks whether the buffer holds no events
+    /// \return true if no events are recorded in the chunks of the buffer
+    bool IsEmpty() const;
+
+    /// Removes all the events recorded in the buffer, the first chunk is kept for reuse
+    void Clear();
+
+    /// Replaces the chunks of the buffer by a single chunk of the exact size of the recorded events,
+    /// or frees them if the buffer is empty. Events appended afterwards go to a new chunk.
+    /// \return false if the chunk could not be allocated, the buffer is then left unchanged
+    bool Compact();
+
+    /// Exchanges the events of two buffers
+    /// \param other the other buffer
+    void Swap(PerfMarkerEventBuffer& other);
+
+    /// Removes the chunks which are full from the buffer, keeping the chunk events are appended to
+    /// \param[out] numBytes the size of the removed chunks in bytes
+    /// \return the list of removed chunks, nullptr if the buffer has a single chunk
+    PerfMarkerEventChunk* DetachFullChunks(size_t& numBytes);
+
+    /// Allocates a chunk which is not part of a buffer, chunks of the default size are reused from the freed ones
+    /// \param numSlots the number of slots of the chunk
+    /// \return the chunk, with no used slots, nullptr if it could not be allocated
+    static PerfMarkerEventChunk* AllocateChunk(size_t numSlots);
+
+    /// Gets the size of a chunk
+    /// \param pChunk the chunk
+    /// \return the size in bytes
+    static size_t GetChunkBytes(const PerfMarkerEventChunk* pChunk) { return sizeof(PerfMarkerEventChunk) + pChunk->m_numSlots * sizeof(PerfMarkerEvent); }
+
+    /// Frees a list of chunks, up to s_MAX_POOLED_CHUNKS chunks of the default size are kept for reuse
+    /// \param pChunk the first chunk of the list
+    static void FreeChunks(PerfMarkerEventChunk* pChunk);
+
+    /// Locks the freed chunks before the process forks, so that the child does not inherit a chunk being allocated or freed
+    static void LockChunkPoolForFork();
+
+    /// Unlocks the freed chunks after the process forked, in the parent and in the child
+    static void UnlockChunkPoolAfterFork();
+
+private:
+    /// Disabled copy contructor
+    PerfMarkerEventBuffer(const PerfMarkerEventBuffer& obj);
+
+    /// Disabled assignment operator
+    PerfMarkerEventBuffer& operator = (const PerfMarkerEventBuffer& obj);
+
+    /// Reserves slots at the end of the buffer
+    /// \param numSlots the number of slots to reserve
+    /// \return the first reserved slot, nullptr if a chunk could not be allocated
+    PerfMarkerEvent* ReserveSlots(size_t numSlots)
+    {
+        if (m_pLastChunk == nullptr || m_pLastChunk->m_usedSlots + numSlots > m_pLastChunk->m_numSlots)
+        {
+            return AddChunk(numSlots);
+        }
+
+        PerfMarkerEvent* pSlot = m_pLastChunk->m_pSlots + m_pLastChunk->m_usedSlots;
+        m_pLastChunk->m_usedSlots += numSlots;
+        return pSlot;
+    }
+
+    /// Adds a chunk to the buffer and reserves slots at its start
+    /// \param numSlots the number of slots to reserve
+    /// \return the first reserved slot, nullptr if the chunk could not be allocated
+    PerfMarkerEvent* AddChunk(size_t numSlots);
+
+    PerfMarkerEventChunk* m_pFirstChunk;  ///< the first chunk of the buffer
+    PerfMarkerEventChunk* m_pLastChunk;   ///< the chunk events are currently appended to
+    size_t m_numBytes;                    ///< the size in bytes of the chunks of the buffer
+};
+
+#endif // _AMDT_ACTIVITY_LOGGER_EVENT_BUFFER_H_
@@ -0,0 +1,66 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Typed arguments attached to perf markers
+//==============================================================================
+
+#include <cstring>
+
+#include "AMDTActivityLoggerMarkerArgs.h"
+
+/// The names of the PerfMarkerArgType values in the text layout, indexed by type
+static const char* const s_ARG_TYPE_NAMES[] = { "Int64", "Double", "String" };
+
+const PerfMarkerArg* GetPerfMarkerEventArgs(const PerfMarkerEvent& event, size_t& numArgs)
+{
+    const PerfMarkerArg* pArgs = static_cast<const PerfMarkerArg*>(event.GetPayload());
+
+    // each argument takes exactly one payload slot, the string values start right after the last argument
+    numArgs = event.m_payloadSlots;
+
+    for (size_t i = 0; i < numArgs; i++)
+    {
+        if (pArgs[i].m_type == PERF_MARKER_ARG_STRING && pArgs[i].m_value / sizeof(PerfMarkerArg) < numArgs)
+        {
+            numArgs = static_cast<size_t>(pArgs[i].m_value / sizeof(PerfMarkerArg));
+        }
+    }
+
+    return pArgs;
+}
+
+const char* GetPerfMarkerEventArgString(const PerfMarkerEvent& event, const PerfMarkerArg& arg)
+{
+    return static_cast<const char*>(event.GetPayload()) + arg.m_value;
+}
+
+void AppendPerfMarkerArgString(std::vector<PerfMarkerArg>& payload, size_t& payloadSize, size_t argIndex, const char* pString, size_t length)
+{
+    payload[argIndex].m_value = payloadSize;
+    payload.resize((payloadSize + length + sizeof(PerfMarkerArg)) / sizeof(PerfMarkerArg));
+
+    char* pValue = reinterpret_cast<char*>(payload.data()) + payloadSize;
+    memcpy(pValue, pString, length);
+    pValue[length] = '\0';
+    payloadSize += length + 1;
+}
+
+const char* GetPerfMarkerArgTypeName(unsigned int type)
+{
+    return type < sizeof(s_ARG_TYPE_NAMES) / sizeof(s_ARG_TYPE_NAMES[0]) ? s_ARG_TYPE_NAMES[type] : nullptr;
+}
+
+bool GetPerfMarkerArgType(const char* pName, size_t length, unsigned int& type)
+{
+    for (unsigned int i = 0; i < sizeof(s_ARG_TYPE_NAMES) / sizeof(s_ARG_TYPE_NAMES[0]); i++)
+    {
+        if (strlen(s_ARG_TYPE_NAMES[i]) == length && memcmp(s_ARG_TYPE_NAMES[i], pName, length) == 0)
+        {
+            type = i;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,68 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Typed arguments attached to perf markers
+//==============================================================================
+
+#ifndef _AMDT_ACTIVITY_LOGGER_MARKER_ARGS_H_
+#define _AMDT_ACTIVITY_LOGGER_MARKER_ARGS_H_
+
+#include <vector>
+
+#include "AMDTActivityLoggerEventBuffer.h"
+
+/// The types of the values of marker arguments, the values of amdtArgType
+enum PerfMarkerArgType
+{
+    PERF_MARKER_ARG_INT64 = 0,   ///< signed 64-bit integer, written as Int64
+    PERF_MARKER_ARG_DOUBLE = 1,  ///< double, written as Double
+    PERF_MARKER_ARG_STRING = 2   ///< string, the value is the offset of the string in the payload of the event, written as String
+};
+
+const unsigned int s_MAX_PERF_MARKER_ARGS = 16;        ///< maximum number of arguments of a marker, AL_MAX_MARKER_ARGS
+const char s_PERF_MARKER_ARG_STRING_GROUP[] = "";       ///< the group name of the argument names interned in the PerfMarkerTable, not a valid group name
+
+/// An argument of a marker, as stored in the payload of a PERF_MARKER_EVENT_ARGS event. It is the size of an event slot.
+/// The payload holds the arguments, then the null terminated string values in the order of their arguments,
+/// so that string values take no space in the PerfMarkerTable, whose size is bounded.
+struct PerfMarkerArg
+{
+    unsigned int m_nameHandle;      ///< the handle of the interned argument name, in the PerfMarkerTable
+    unsigned int m_type;            ///< the PerfMarkerArgType of the value
+    unsigned long long m_value;     ///< the bits of the int64 or double value, or the offset in bytes of the string from the start of the payload
+};
+
+/// Gets the arguments carried by a PERF_MARKER_EVENT_ARGS event
+/// \param event the event
+/// \param[out] numArgs the number of arguments
+/// \return the arguments
+const PerfMarkerArg* GetPerfMarkerEventArgs(const PerfMarkerEvent& event, size_t& numArgs);
+
+/// Gets the value of a string argument carried by a PERF_MARKER_EVENT_ARGS event
+/// \param event the event
+/// \param arg the argument, one of the arguments of the event
+/// \return the null terminated string
+const char* GetPerfMarkerEventArgString(const PerfMarkerEvent& event, const PerfMarkerArg& arg);
+
+/// Appends the value of a string argument to the payload of a PERF_MARKER_EVENT_ARGS event being built
+/// \param[in,out] payload the slots of the payload, holding all the arguments then the string values appended so far
+/// \param[in,out] payloadSize the size in bytes of the payload
+/// \param argIndex the index of the string argument, whose value receives the offset of the string
+/// \param pString the string, which does not need to be null terminated
+/// \param length the length of the string
+void AppendPerfMarkerArgString(std::vector<PerfMarkerArg>& payload, size_t& payloadSize, size_t argIndex, const char* pString, size_t length);
+
+/// Gets the name of the type of an argument, as written in the text layout
+/// \param type the PerfMarkerArgType of the argument
+/// \return the name, nullptr if the type is not a PerfMarkerArgType
+const char* GetPerfMarkerArgTypeName(unsigned int type);
+
+/// Gets the type of an argument from its name in the text layout
+/// \param pName the name, which does not need to be null terminated
+/// \param length the length of the name
+/// \param[out] type the PerfMarkerArgType of the argument
+/// \return false if the name is not the name of a type
+bool GetPerfMarkerArgType(const char* pName, size_t length, unsigned int& type);
+
+#endif // _AMDT_ACTIVITY_LOGGER_MARKER_ARGS_H_
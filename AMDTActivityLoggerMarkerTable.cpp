@@ -0,0 +1,299 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Table of the interned marker and group names
+//==============================================================================
+
+#include <cstring>
+#include <new>
+
+#include "AMDTActivityLoggerMarkerTable.h"
+#include "AMDTGPUProfilerDefs.h"
+
+using namespace std;
+
+/// Helper function to replace the spaces in a name with AL_SPACE
+/// \param szName the name
+/// \return the escaped name
+static string EscapeSpaces(const char* szName)
+{
+    string escaped;
+
+    for (const char* p = szName; *p != '\0'; p++)
+    {
+        if (*p == ' ')
+        {
+            escaped.append(AL_SPACE);
+        }
+        else
+        {
+            escaped.push_back(*p);
+        }
+    }
+
+    return escaped;
+}
+
+PerfMarkerTable::PerfMarkerTable()
+{
+    memset(m_pSegments, 0, sizeof(m_pSegments));
+    m_count.store(0);
+    m_newGroupsEnabled = true;
+
+    for (unsigned int i = 0; i < s_MAX_GROUPS / 64; i++)
+    {
+        m_groupDisabledBits[i].store(0);
+    }
+}
+
+PerfMarkerTable::~PerfMarkerTable()
+{
+    for (unsigned int i = 0; i < s_MAX_SEGMENTS; i++)
+    {
+        delete[] m_pSegments[i];
+    }
+}
+
+unsigned int PerfMarkerTable::Register(const char* szMarkerName, const char* szGroupName)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    return RegisterLocked(szMarkerName, szGroupName);
+}
+
+unsigned int PerfMarkerTable::Find(const char* szMarkerName, const char* szGroupName)
+{
+    string key(szMarkerName);
+    key.push_back('\0');
+    key.append(szGroupName);
+
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    unordered_map<string, unsigned int>::const_iterator it = m_handles.find(key);
+
+    return it != m_handles.end() ? it->second : 0;
+}
+
+unsigned int PerfMarkerTable::RegisterLocked(const char* szMarkerName, const char* szGroupName)
+{
+    string key(szMarkerName);
+    key.push_back('\0');
+    key.append(szGroupName);
+
+    unordered_map<string, unsigned int>::const_iterator it = m_handles.find(key);
+
+    if (it != m_handles.end())
+    {
+        return it->second;
+    }
+
+    unsigned int count = m_count.load(memory_order_relaxed);
+    unsigned int segment = count / s_SEGMENT_SIZE;
+    unsigned int groupId;
+
+    if (segment >= s_MAX_SEGMENTS || !GetGroupId(szGroupName, groupId))
+    {
+        return 0;
+    }
+
+    if (m_pSegments[segment] == nullptr)
+    {
+        m_pSegments[segment] = new(nothrow) PerfMarkerInfo[s_SEGMENT_SIZE];
+
+        if (m_pSegments[segment] == nullptr)
+        {
+            return 0;
+        }
+    }
+
+    PerfMarkerInfo& info = m_pSegments[segment][count % s_SEGMENT_SIZE];
+    info.m_markerName = szMarkerName;
+    info.m_groupName = szGroupName;
+    info.m_escapedMarkerName = EscapeSpaces(szMarkerName);
+    info.m_escapedGroupName = EscapeSpaces(szGroupName);
+    info.m_groupId = groupId;
+    info.m_hasMarkerSampling = false;
+    info.m_triggerId.store(0, memory_order_relaxed);
+
+    unordered_map<unsigned int, PerfMarkerGroupSampling>::const_iterator samplingIt = m_groupSampling.find(groupId);
+
+    if (samplingIt != m_groupSampling.end())
+    {
+        info.m_sampleInterval.store(samplingIt->second.m_sampleInterval, memory_order_relaxed);
+        info.m_maxSamplesPerMillisecond.store(samplingIt->second.m_maxSamplesPerMillisecond, memory_order_relaxed);
+    }
+    else
+    {
+        info.m_sampleInterval.store(0, memory_order_relaxed);
+        info.m_maxSamplesPerMillisecond.store(0, memory_order_relaxed);
+    }
+
+    unsigned int handle = count + 1;
+    m_handles.insert(pair<string, unsigned int>(key, handle));
+    m_count.store(handle, memory_order_release);
+
+    return handle;
+}
+
+bool PerfMarkerTable::SetGroupEnabled(const char* szGroupName, bool enabled)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    unsigned int groupId;
+
+    if (!GetGroupId(szGroupName, groupId))
+    {
+        return false;
+    }
+
+    SetGroupBit(groupId, enabled);
+
+    return true;
+}
+
+void PerfMarkerTable::SetAllGroupsEnabled(bool enabled)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    m_newGroupsEnabled = enabled;
+
+    for (unsigned int i = 0; i < s_MAX_GROUPS / 64; i++)
+    {
+        m_groupDisabledBits[i].store(enabled ? 0 : ~0ULL, memory_order_relaxed);
+    }
+}
+
+bool PerfMarkerTable::SetMarkerSampling(const char* szMarkerName, const char* szGroupName, unsigned int sampleInterval, unsigned int maxSamplesPerMillisecond)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    unsigned int handle = RegisterLocked(szMarkerName, szGroupName);
+
+    if (handle == 0)
+    {
+        return false;
+    }
+
+    PerfMarkerInfo& info = m_pSegments[(handle - 1) / s_SEGMENT_SIZE][(handle - 1) % s_SEGMENT_SIZE];
+    info.m_sampleInterval.store(sampleInterval, memory_order_relaxed);
+    info.m_maxSamplesPerMillisecond.store(maxSamplesPerMillisecond, memory_order_relaxed);
+    info.m_hasMarkerSampling = true;
+
+    return true;
+}
+
+bool PerfMarkerTable::SetGroupSampling(const char* szGroupName, unsigned int sampleInterval, unsigned int maxSamplesPerMillisecond)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    unsigned int groupId;
+
+    if (!GetGroupId(szGroupName, groupId))
+    {
+        return false;
+    }
+
+    PerfMarkerGroupSampling sampling = { sampleInterval, maxSamplesPerMillisecond };
+    m_groupSampling[groupId] = sampling;
+
+    unsigned int count = m_count.load(memory_order_relaxed);
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        PerfMarkerInfo& info = m_pSegments[i / s_SEGMENT_SIZE][i % s_SEGMENT_SIZE];
+
+        if (info.m_groupId == groupId && !info.m_hasMarkerSampling)
+        {
+            info.m_sampleInterval.store(sampleInterval, memory_order_relaxed);
+            info.m_maxSamplesPerMillisecond.store(maxSamplesPerMillisecond, memory_order_relaxed);
+        }
+    }
+
+    return true;
+}
+
+bool PerfMarkerTable::GetGroupId(const char* szGroupName, unsigned int& groupId)
+{
+    unordered_map<string, unsigned int>::const_iterator it = m_groupIds.find(szGroupName);
+
+    if (it != m_groupIds.end())
+    {
+        groupId = it->second;
+        return true;
+    }
+
+    if (m_groupIds.size() >= s_MAX_GROUPS)
+    {
+        return false;
+    }
+
+    groupId = static_cast<unsigned int>(m_groupIds.size());
+    m_groupIds.insert(pair<string, unsigned int>(szGroupName, groupId));
+    SetGroupBit(groupId, m_newGroupsEnabled);
+
+    return true;
+}
+
+void PerfMarkerTable::SetGroupBit(unsigned int groupId, bool enabled)
+{
+    unsigned long long bit = 1ULL << (groupId % 64);
+
+    if (enabled)
+    {
+        m_groupDisabledBits[groupId / 64].fetch_and(~bit, memory_order_relaxed);
+    }
+    else
+    {
+        m_groupDisabledBits[groupId / 64].fetch_or(bit, memory_order_relaxed);
+    }
+}
+
+unsigned int PerfMarkerTable::Hash(const char* szMarkerName, const char* szGroupName)
+{
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+
+    for (const char* p = szMarkerName; *p != '\0'; p++)
+    {
+        hash = (hash ^ static_cast<unsigned char>(*p)) * 16777619u;
+    }
+
+    hash = (hash ^ 0xffu) * 16777619u;
+
+    for (const char* p = szGroupName; *p != '\0'; p++)
+    {
+        hash = (hash ^ static_cast<unsigned char>(*p)) * 16777619u;
+    }
+
+    return hash;
+}
+
+PerfMarkerTableCache::PerfMarkerTableCache()
+{
+    memset(m_handles, 0, sizeof(m_handles));
+}
+
+unsigned int PerfMarkerTableCache::GetHandle(PerfMarkerTable& table, const char* szMarkerName, const char* szGroupName)
+{
+    unsigned int& cachedHandle = m_handles[PerfMarkerTable::Hash(szMarkerName, szGroupName) & (s_CACHE_SIZE - 1)];
+
+    if (cachedHandle != 0)
+    {
+        const PerfMarkerInfo& info = table.Get(cachedHandle);
+
+        if (strcmp(info.m_markerName.c_str(), szMarkerName) == 0 && strcmp(info.m_groupName.c_str(), szGroupName) == 0)
+        {
+            return cachedHandle;
+        }
+    }
+
+    unsigned int handle = table.Register(szMarkerName, szGroupName);
+
+    if (handle != 0)
+    {
+        cachedHandle = handle;
+    }
+
+    return handle;
+}
@@ -0,0 +1,189 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Table of the interned marker and group names
+//==============================================================================
+
+#ifndef _AMDT_ACTIVITY_LOGGER_MARKER_TABLE_H_
+#define _AMDT_ACTIVITY_LOGGER_MARKER_TABLE_H_
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/// The names of a registered marker
+struct PerfMarkerInfo
+{
+    std::string m_markerName;         ///< the marker name
+    std::string m_groupName;          ///< the group name
+    std::string m_escapedMarkerName;  ///< the marker name with spaces replaced by AL_SPACE
+    std::string m_escapedGroupName;   ///< the group name with spaces replaced by AL_SPACE
+    unsigned int m_groupId;           ///< the id of the group, used to check whether the group is enabled
+    std::atomic<unsigned int> m_sampleInterval;             ///< only 1 in m_sampleInterval instances is recorded, 0 or 1 to record all instances
+    std::atomic<unsigned int> m_maxSamplesPerMillisecond;   ///< maximum number of instances recorded per millisecond by a thread, 0 for no limit
+    bool m_hasMarkerSampling;         ///< flag indicating if the sampling was set for the marker itself rather than for its group
+    std::atomic<unsigned int> m_triggerId;                  ///< the id of the profiling trigger of the marker in the PerfMarkerTriggerList, 0 for none
+};
+
+/// Sampling settings of a group
+struct PerfMarkerGroupSampling
+{
+    unsigned int m_sampleInterval;              ///< only 1 in m_sampleInterval instances is recorded, 0 or 1 to record all instances
+    unsigned int m_maxSamplesPerMillisecond;    ///< maximum number of instances recorded per millisecond by a thread, 0 for no limit
+};
+
+/// Table of the registered markers, indexed by marker handle.
+/// Registration is serialized by a mutex; validating and looking up a handle takes no lock,
+/// as entries are never moved or removed once registered.
+/// The table also tracks which groups are enabled, as one bit per group id.
+class PerfMarkerTable
+{
+public:
+    /// Constructor
+    PerfMarkerTable();
+
+    /// Destructor
+    ~PerfMarkerTable();
+
+    /// Registers a marker, returning the handle of the existing entry if the names are already registered
+    /// \param szMarkerName the marker name
+    /// \param szGroupName the group name
+    /// \return the marker handle, 0 if the table is full or out of memory
+    unsigned int Register(const char* szMarkerName, const char* szGroupName);
+
+    /// Finds a registered marker
+    /// \param szMarkerName the marker name
+    /// \param szGroupName the group name
+    /// \return the marker handle, 0 if the names are not registered
+    unsigned int Find(const char* szMarkerName, const char* szGroupName);
+
+    /// Gets a registered marker
+    /// \param handle a marker handle returned by Register
+    /// \return the marker names
+    const PerfMarkerInfo& Get(unsigned int handle) const { return m_pSegments[(handle - 1) / s_SEGMENT_SIZE][(handle - 1) % s_SEGMENT_SIZE]; }
+
+    /// Checks whether a value is a handle returned by Register
+    /// \param handle the value to check
+    /// \return true if handle is a valid marker handle
+    bool IsValid(unsigned int handle) const { return handle != 0 && handle <= m_count.load(std::memory_order_acquire); }
+
+    /// Gets the number of registered markers, their handles are 1 to the returned number
+    /// \return the number of markers
+    unsigned int GetNumMarkers() const { return m_count.load(std::memory_order_acquire); }
+
+    /// Checks whether the group of a registered marker is enabled
+    /// \param handle a marker handle returned by Register
+    /// \return true if the markers of the group should be recorded
+    bool IsEnabled(unsigned int handle) const
+    {
+        unsigned int groupId = Get(handle).m_groupId;
+        return (m_groupDisabledBits[groupId / 64].load(std::memory_order_relaxed) & (1ULL << (groupId % 64))) == 0;
+    }
+
+    /// Enables or disables the markers of a group, which does not need to have been used yet
+    /// \param szGroupName the group name
+    /// \param enabled true to record the markers of the group, false to ignore them
+    /// \return false if the table has no room for the group
+    bool SetGroupEnabled(const char* szGroupName, bool enabled);
+
+    /// Enables or disables all groups, including the groups used later
+    /// \param enabled true to record the markers of all groups, false to ignore them
+    void SetAllGroupsEnabled(bool enabled);
+
+    /// Sets the sampling of a marker, registering it if needed. Overrides the sampling of its group.
+    /// \param szMarkerName the marker name
+    /// \param szGroupName the group name
+    /// \param sampleInterval only 1 in sampleInterval instances is recorded, 0 or 1 to record all instances
+    /// \param maxSamplesPerMillisecond maximum number of instances recorded per millisecond by a thread, 0 for no limit
+    /// \return false if the marker could not be registered
+    bool SetMarkerSampling(const char* szMarkerName, const char* szGroupName, unsigned int sampleInterval, unsigned int maxSamplesPerMillisecond);
+
+    /// Sets the sampling of the markers of a group, except the markers with their own sampling
+    /// \param szGroupName the group name
+    /// \param sampleInterval only 1 in sampleInterval instances is recorded, 0 or 1 to record all instances
+    /// \param maxSamplesPerMillisecond maximum number of instances recorded per millisecond by a thread, 0 for no limit
+    /// \return false if the table has no room for the group
+    bool SetGroupSampling(const char* szGroupName, unsigned int sampleInterval, unsigned int maxSamplesPerMillisecond);
+
+    /// Sets the profiling trigger of a registered marker
+    /// \param handle a marker handle returned by Register
+    /// \param triggerId the id of the trigger in the PerfMarkerTriggerList, published after the trigger is added
+    void SetTriggerId(unsigned int handle, unsigned int triggerId)
+    {
+        m_pSegments[(handle - 1) / s_SEGMENT_SIZE][(handle - 1) % s_SEGMENT_SIZE].m_triggerId.store(triggerId, std::memory_order_release);
+    }
+
+    /// Computes the hash of a pair of marker and group names
+    /// \param szMarkerName the marker name
+    /// \param szGroupName the group name
+    /// \return the hash
+    static unsigned int Hash(const char* szMarkerName, const char* szGroupName);
+
+    /// Locks the registration before the process forks, so that the child does not inherit a registration in progress
+    void LockForFork() { m_mtx.lock(); }
+
+    /// Unlocks the registration after the process forked, in the parent and in the child
+    void UnlockAfterFork() { m_mtx.unlock(); }
+
+private:
+    /// Disabled copy contructor
+    PerfMarkerTable(const PerfMarkerTable& obj);
+
+    /// Disabled assignment operator
+    PerfMarkerTable& operator = (const PerfMarkerTable& obj);
+
+    static const unsigned int s_SEGMENT_SIZE = 1024;   ///< number of entries in a segment
+    static const unsigned int s_MAX_SEGMENTS = 1024;   ///< maximum number of segments
+    static const unsigned int s_MAX_GROUPS = 65536;    ///< maximum number of groups
+
+    /// Registers a marker. m_mtx must be held.
+    /// \param szMarkerName the marker name
+    /// \param szGroupName the group name
+    /// \return the marker handle, 0 if the table is full or out of memory
+    unsigned int RegisterLocked(const char* szMarkerName, const char* szGroupName);
+
+    /// Gets the id of a group, assigning the next id if the group is new. m_mtx must be held.
+    /// \param szGroupName the group name
+    /// \param[out] groupId the group id
+    /// \return false if the table has no room for the group
+    bool GetGroupId(const char* szGroupName, unsigned int& groupId);
+
+    /// Sets the enabled bit of a group
+    /// \param groupId the group id
+    /// \param enabled true to enable the group
+    void SetGroupBit(unsigned int groupId, bool enabled);
+
+    std::mutex m_mtx;                                         ///< mutex to serialize registration
+    std::unordered_map<std::string, unsigned int> m_handles;  ///< map from "name\0group" to marker handle
+    std::unordered_map<std::string, unsigned int> m_groupIds; ///< map from group name to group id
+    bool m_newGroupsEnabled;                                  ///< flag indicating if groups seen for the first time are enabled
+    std::unordered_map<unsigned int, PerfMarkerGroupSampling> m_groupSampling; ///< map from group id to the sampling of the group, for the groups with sampling
+    std::atomic<unsigned long long> m_groupDisabledBits[s_MAX_GROUPS / 64]; ///< one bit per group id, set if the group is disabled
+    PerfMarkerInfo* m_pSegments[s_MAX_SEGMENTS];              ///< the segments holding the entries, allocated as needed
+    std::atomic<unsigned int> m_count;                        ///< the number of registered markers, published after the entry is written
+};
+
+/// Per-thread cache of the marker handles of recently used marker and group names.
+/// Lets the string based marker API find the handle of a name without taking the table lock.
+class PerfMarkerTableCache
+{
+public:
+    /// Constructor
+    PerfMarkerTableCache();
+
+    /// Gets the handle of a marker, registering it in the table if needed
+    /// \param table the marker table
+    /// \param szMarkerName the marker name
+    /// \param szGroupName the group name
+    /// \return the marker handle, 0 if it could not be registered
+    unsigned int GetHandle(PerfMarkerTable& table, const char* szMarkerName, const char* szGroupName);
+
+private:
+    static const unsigned int s_CACHE_SIZE = 256;   ///< number of entries in the cache, must be a power of two
+
+    unsigned int m_handles[s_CACHE_SIZE];   ///< the cached handles, 0 for empty entries
+};
+
+#endif // _AMDT_ACTIVITY_LOGGER_MARKER_TABLE_H_
@@ -0,0 +1,287 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Output file supporting concurrent writes at explicit offsets
+//==============================================================================
+
+#include "AMDTActivityLoggerOutputFile.h"
+
+#if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
+    #include "windows.h"
+#else
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+
+const size_t s_COPY_BUFFER_SIZE = 1024 * 1024;          ///< size of the buffer used when a file can't be copied by the kernel
+const size_t s_STREAM_BUFFER_SIZE = 1024 * 1024;        ///< size of the buffer of PerfMarkerOutputFileStreamBuf
+
+PerfMarkerOutputFile::PerfMarkerOutputFile()
+{
+#if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
+    m_hFile = INVALID_HANDLE_VALUE;
+#else
+    m_fd = -1;
+#endif
+}
+
+PerfMarkerOutputFile::~PerfMarkerOutputFile()
+{
+    Close();
+}
+
+bool PerfMarkerOutputFile::Open(const char* szFileName)
+{
+    Close();
+
+#if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
+    m_hFile = CreateFileA(szFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    return m_hFile != INVALID_HANDLE_VALUE;
+#else
+    m_fd = open(szFileName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    return m_fd != -1;
+#endif
+}
+
+void PerfMarkerOutputFile::Close()
+{
+#if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
+
+    if (m_hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+
+#else
+
+    if (m_fd != -1)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+
+#endif
+}
+
+bool PerfMarkerOutputFile::Write(unsigned long long offset, const void* pData, size_t size)
+{
+    const char* pBytes = static_cast<const char*>(pData);
+
+    while (size > 0)
+    {
+#if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD written = 0;
+        DWORD toWrite = size > 0x40000000 ? 0x40000000 : static_cast<DWORD>(size);
+
+        if (!WriteFile(m_hFile, pBytes, toWrite, &written, &overlapped) || written == 0)
+        {
+            return false;
+        }
+
+#else
+        ssize_t written = pwrite(m_fd, pBytes, size, static_cast<off_t>(offset));
+
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        if (written <= 0)
+        {
+            return false;
+        }
+
+#endif
+        pBytes += written;
+        offset += written;
+        size -= written;
+    }
+
+    return true;
+}
+
+bool PerfMarkerOutputFile::CopyFrom(unsigned long long offset, const char* szSourceFileName, unsigned long long size)
+{
+    bool retVal = true;
+
+#if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
+    HANDLE hSource = CreateFileA(szSourceFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (hSource == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    std::vector<char> buffer(s_COPY_BUFFER_SIZE);
+
+    while (retVal && size > 0)
+    {
+        DWORD toRead = size > s_COPY_BUFFER_SIZE ? static_cast<DWORD>(s_COPY_BUFFER_SIZE) : static_cast<DWORD>(size);
+        DWORD read = 0;
+
+        if (!ReadFile(hSource, &buffer[0], toRead, &read, NULL) || read == 0)
+        {
+            retVal = false;
+        }
+        else
+        {
+            retVal = Write(offset, &buffer[0], read);
+            offset += read;
+            size -= read;
+        }
+    }
+
+    CloseHandle(hSource);
+#else
+    int sourceFd = open(szSourceFileName, O_RDONLY);
+
+    if (sourceFd == -1)
+    {
+        return false;
+    }
+
+    loff_t sourceOffset = 0;
+    std::vector<char> buffer;
+#ifdef SYS_copy_file_range
+    bool useKernelCopy = true;
+#endif
+
+    while (retVal && size > 0)
+    {
+        size_t toCopy = size > s_COPY_BUFFER_SIZE ? s_COPY_BUFFER_SIZE : static_cast<size_t>(size);
+        ssize_t copied = -1;
+
+#ifdef SYS_copy_file_range
+
+        if (useKernelCopy)
+        {
+            loff_t targetOffset = static_cast<loff_t>(offset);
+            copied = syscall(SYS_copy_file_range, sourceFd, &sourceOffset, m_fd, &targetOffset, toCopy, 0);
+
+            if (copied < 0)
+            {
+                if (errno != EINTR)
+                {
+                    // not supported by the kernel or across these file systems, fall back to read/write
+                    useKernelCopy = false;
+                }
+
+                continue;
+            }
+        }
+        else
+#endif
+        {
+            buffer.resize(s_COPY_BUFFER_SIZE);
+            copied = pread(sourceFd, &buffer[0], toCopy, static_cast<off_t>(sourceOffset));
+
+            if (copied < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (copied > 0)
+            {
+                retVal = Write(offset, &buffer[0], copied);
+                sourceOffset += copied;
+            }
+        }
+
+        if (copied <= 0)
+        {
+            // read error, or the source file is shorter than expected
+            retVal = false;
+        }
+        else
+        {
+            offset += copied;
+            size -= copied;
+        }
+    }
+
+    close(sourceFd);
+#endif
+
+    return retVal;
+}
+
+bool PerfMarkerOutputFile::GetFileSize(const char* szFileName, unsigned long long& size)
+{
+#if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+    if (!GetFileAttributesExA(szFileName, GetFileExInfoStandard, &attributes))
+    {
+        return false;
+    }
+
+    size = (static_cast<unsigned long long>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+#else
+    struct stat fileStat;
+
+    if (stat(szFileName, &fileStat) != 0)
+    {
+        return false;
+    }
+
+    size = static_cast<unsigned long long>(fileStat.st_size);
+#endif
+
+    return true;
+}
+
+PerfMarkerOutputFileStreamBuf::PerfMarkerOutputFileStreamBuf(PerfMarkerOutputFile& file, unsigned long long offset) :
+    m_file(file),
+    m_offset(offset),
+    m_buffer(s_STREAM_BUFFER_SIZE),
+    m_succeeded(true)
+{
+    setp(&m_buffer[0], &m_buffer[0] + m_buffer.size());
+}
+
+PerfMarkerOutputFileStreamBuf::~PerfMarkerOutputFileStreamBuf()
+{
+    sync();
+}
+
+PerfMarkerOutputFileStreamBuf::int_type PerfMarkerOutputFileStreamBuf::overflow(int_type ch)
+{
+    if (sync() != 0)
+    {
+        return traits_type::eof();
+    }
+
+    if (!traits_type::eq_int_type(ch, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(ch);
+}
+
+int PerfMarkerOutputFileStreamBuf::sync()
+{
+    size_t size = static_cast<size_t>(pptr() - pbase());
+
+    if (size > 0)
+    {
+        if (!m_file.Write(m_offset, pbase(), size))
+        {
+            m_succeeded = false;
+        }
+
+        m_offset += size;
+        setp(&m_buffer[0], &m_buffer[0] + m_buffer.size());
+    }
+
+    return m_succeeded ? 0 : -1;
+}
@@ -0,0 +1,109 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Output file supporting concurrent writes at explicit offsets
+//==============================================================================
+
+#ifndef _AMDT_ACTIVITY_LOGGER_OUTPUT_FILE_H_
+#define _AMDT_ACTIVITY_LOGGER_OUTPUT_FILE_H_
+
+#include <streambuf>
+#include <vector>
+
+#include "AMDTBaseTools/Include/AMDTDefinitions.h"
+
+/// Output file written at explicit offsets, so that independent sections of the file
+/// can be written concurrently by several threads
+class PerfMarkerOutputFile
+{
+public:
+    /// Constructor
+    PerfMarkerOutputFile();
+
+    /// Destructor
+    ~PerfMarkerOutputFile();
+
+    /// Creates the file, truncating it if it already exists
+    /// \param szFileName the name of the file
+    /// \return true on success
+    bool Open(const char* szFileName);
+
+    /// Closes the file
+    void Close();
+
+    /// Writes data at the specified offset of the file
+    /// \param offset the offset in the file
+    /// \param pData the data to write
+    /// \param size the size of the data
+    /// \return true on success
+    bool Write(unsigned long long offset, const void* pData, size_t size);
+
+    /// Copies the contents of another file at the specified offset of the file.
+    /// Uses a kernel-side copy when it is available, so that the data is not read into memory.
+    /// \param offset the offset in the file
+    /// \param szSourceFileName the name of the file to copy
+    /// \param size the number of bytes to copy from the start of the source file
+    /// \return true on success
+    bool CopyFrom(unsigned long long offset, const char* szSourceFileName, unsigned long long size);
+
+    /// Gets the size of a file
+    /// \param szFileName the name of the file
+    /// \param[out] size the size of the file
+    /// \return true on success
+    static bool GetFileSize(const char* szFileName, unsigned long long& size);
+
+private:
+    /// Disabled copy contructor
+    PerfMarkerOutputFile(const PerfMarkerOutputFile& obj);
+
+    /// Disabled assignment operator
+    PerfMarkerOutputFile& operator = (const PerfMarkerOutputFile& obj);
+
+#if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
+    void* m_hFile;  ///< the handle of the file
+#else
+    int m_fd;       ///< the file descriptor of the file
+#endif
+};
+
+/// Stream buffer which writes a section of a PerfMarkerOutputFile through a fixed-size buffer
+class PerfMarkerOutputFileStreamBuf : public std::streambuf
+{
+public:
+    /// Constructor
+    /// \param file the output file
+    /// \param offset the offset in the file of the section written through the stream buffer
+    PerfMarkerOutputFileStreamBuf(PerfMarkerOutputFile& file, unsigned long long offset);
+
+    /// Destructor, writes the buffered data
+    ~PerfMarkerOutputFileStreamBuf();
+
+    /// Checks whether all the writes to the file succeeded
+    /// \return true if no write failed
+    bool Succeeded() const { return m_succeeded; }
+
+protected:
+    /// Writes the buffered data and a character to the file
+    /// \param ch the character that did not fit in the buffer
+    /// \return a value other than EOF on success
+    virtual int_type overflow(int_type ch);
+
+    /// Writes the buffered data to the file
+    /// \return 0 on success
+    virtual int sync();
+
+private:
+    /// Disabled copy contructor
+    PerfMarkerOutputFileStreamBuf(const PerfMarkerOutputFileStreamBuf& obj);
+
+    /// Disabled assignment operator
+    PerfMarkerOutputFileStreamBuf& operator = (const PerfMarkerOutputFileStreamBuf& obj);
+
+    PerfMarkerOutputFile& m_file;   ///< the output file
+    unsigned long long m_offset;    ///< the offset in the file of the buffered data
+    std::vector<char> m_buffer;     ///< the buffer
+    bool m_succeeded;               ///< false if a write failed
+};
+
+#endif // _AMDT_ACTIVITY_LOGGER_OUTPUT_FILE_H_
@@ -5,11 +5,26 @@
 /// \brief  Implementation of the AMDTActivityLogger Profile Control singleton
 //==============================================================================
 
+#include <new>
+
 #include <AMDTOSWrappers/Include/osFilePath.h>
 
 #include "AMDTGPUProfilerDefs.h"
 #include "AMDTActivityLoggerProfileControl.h"
 
+AMDTActivityLoggerProfileControl::AMDTActivityLoggerProfileControl()
+{
+    m_pDispatchTable = nullptr;
+}
+
+AMDTActivityLoggerProfileControl::~AMDTActivityLoggerProfileControl()
+{
+    for (size_t i = 0; i < m_dispatchTables.size(); i++)
+    {
+        delete m_dispatchTables[i];
+    }
+}
+
 bool AMDTActivityLoggerProfileControl::GetHandleForProfilerLib(const wchar_t* pBaseName, osModuleHandle& libHandle)
 {
 
@@ -117,94 +132,128 @@ bool AMDTActivityLoggerProfileControl::GetHandleForProfilerLib(const wchar_t* pB
     return hasHandle;
 }
 
-bool AMDTActivityLoggerProfileControl::CallProfileControlEntryPointFromLibrary(osModuleHandle& libHandle, const wchar_t* pLibName, ProfilingControlProc& profilingControlProc, const char* pProcName)
+void AMDTActivityLoggerProfileControl::GetProfileControlEntryPoints(const wchar_t* pLibName, osProcedureAddress& stopProcAddress, osProcedureAddress& resumeProcAddress)
 {
-    bool retVal = false;
-    bool hasHandle = true;
-
-    if (nullptr == libHandle)
-    {
-        hasHandle = GetHandleForProfilerLib(pLibName, libHandle);
-    }
+    stopProcAddress = nullptr;
+    resumeProcAddress = nullptr;
+    osModuleHandle libHandle = nullptr;
 
-    if (hasHandle && nullptr != libHandle)
+    if (GetHandleForProfilerLib(pLibName, libHandle) && nullptr != libHandle)
     {
-        bool procFound = true;
-
-        if (nullptr == profilingControlProc)
+        if (!osGetProcedureAddress(libHandle, "amdtCodeXLStopProfiling", stopProcAddress))
         {
-            osProcedureAddress procAddress;
-            procFound = osGetProcedureAddress(libHandle, pProcName, procAddress);
-
-            if (procFound)
-            {
-                profilingControlProc = reinterpret_cast<ProfilingControlProc>(procAddress);
-            }
+            stopProcAddress = nullptr;
         }
 
-        if (nullptr != profilingControlProc)
+        if (!osGetProcedureAddress(libHandle, "amdtCodeXLResumeProfiling", resumeProcAddress))
         {
-            profilingControlProc();
-            retVal = true;
+            resumeProcAddress = nullptr;
         }
     }
-
-    return retVal;
 }
 
-bool AMDTActivityLoggerProfileControl::CallProfileControlEntryPointFromLibraryWithMode(osModuleHandle& libHandle, const wchar_t* pLibName, ProfilingControlProcWithMode& profilingControlProc, const char* pProcName, amdtProfilingControlMode mode)
+const AMDTActivityLoggerProfileControl::DispatchTable* AMDTActivityLoggerProfileControl::ResolveDispatchTable()
 {
-    bool retVal = false;
-    bool hasHandle = true;
+    DispatchTable* pTable = new(std::nothrow) DispatchTable();
 
-    if (nullptr == libHandle)
+    if (nullptr == pTable)
     {
-        hasHandle = GetHandleForProfilerLib(pLibName, libHandle);
+        return m_pDispatchTable.load(std::memory_order_acquire);
     }
 
-    if (hasHandle && nullptr != libHandle)
-    {
-        bool procFound = true;
+    osProcedureAddress stopProcAddress;
+    osProcedureAddress resumeProcAddress;
 
-        if (nullptr == profilingControlProc)
-        {
-            osProcedureAddress procAddress;
-            procFound = osGetProcedureAddress(libHandle, pProcName, procAddress);
+    GetProfileControlEntryPoints(AL_CL_TRACE_AGENT_DLL, stopProcAddress, resumeProcAddress);
+    pTable->m_pCLTraceStopProfilingProc = reinterpret_cast<ProfilingControlProc>(stopProcAddress);
+    pTable->m_pCLTraceResumeProfilingProc = reinterpret_cast<ProfilingControlProc>(resumeProcAddress);
 
-            if (procFound)
-            {
-                profilingControlProc = reinterpret_cast<ProfilingControlProcWithMode>(procAddress);
-            }
-        }
+    GetProfileControlEntryPoints(AL_HSA_TRACE_AGENT_DLL, stopProcAddress, resumeProcAddress);
+    pTable->m_pHSATraceStopProfilingProc = reinterpret_cast<ProfilingControlProc>(stopProcAddress);
+    pTable->m_pHSATraceResumeProfilingProc = reinterpret_cast<ProfilingControlProc>(resumeProcAddress);
+
+    GetProfileControlEntryPoints(AL_CL_PROFILE_AGENT_DLL, stopProcAddress, resumeProcAddress);
+    pTable->m_pCLPerfCounterStopProfilingProc = reinterpret_cast<ProfilingControlProc>(stopProcAddress);
+    pTable->m_pCLPerfCounterResumeProfilingProc = reinterpret_cast<ProfilingControlProc>(resumeProcAddress);
+
+    GetProfileControlEntryPoints(AL_HSA_PROFILE_AGENT_DLL, stopProcAddress, resumeProcAddress);
+    pTable->m_pHSAPerfCounterStopProfilingProc = reinterpret_cast<ProfilingControlProc>(stopProcAddress);
+    pTable->m_pHSAPerfCounterResumeProfilingProc = reinterpret_cast<ProfilingControlProc>(resumeProcAddress);
+
+    GetProfileControlEntryPoints(AL_CL_OCCUPANCY_AGENT_DLL, stopProcAddress, resumeProcAddress);
+    pTable->m_pCLOccupancyStopProfilingProc = reinterpret_cast<ProfilingControlProcWithMode>(stopProcAddress);
+    pTable->m_pCLOccupancyResumeProfilingProc = reinterpret_cast<ProfilingControlProcWithMode>(resumeProcAddress);
+
+    m_dispatchTables.push_back(pTable);
+    m_pDispatchTable.store(pTable, std::memory_order_release);
+
+    return pTable;
+}
+
+const AMDTActivityLoggerProfileControl::DispatchTable* AMDTActivityLoggerProfileControl::GetDispatchTable()
+{
+    const DispatchTable* pTable = m_pDispatchTable.load(std::memory_order_acquire);
+
+    if (nullptr == pTable)
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        pTable = m_pDispatchTable.load(std::memory_order_acquire);
 
-        if (nullptr != profilingControlProc)
+        if (nullptr == pTable)
         {
-            profilingControlProc(mode);
-            retVal = true;
+            pTable = ResolveDispatchTable();
         }
     }
 
-    return retVal;
+    return pTable;
+}
+
+bool AMDTActivityLoggerProfileControl::CallProfileControlEntryPoint(ProfilingControlProc profilingControlProc)
+{
+    if (nullptr == profilingControlProc)
+    {
+        return false;
+    }
+
+    profilingControlProc();
+    return true;
+}
+
+bool AMDTActivityLoggerProfileControl::CallProfileControlEntryPointWithMode(ProfilingControlProcWithMode profilingControlProc, amdtProfilingControlMode mode)
+{
+    if (nullptr == profilingControlProc)
+    {
+        return false;
+    }
+
+    profilingControlProc(mode);
+    return true;
 }
 
 int AMDTActivityLoggerProfileControl::StopProfiling(amdtProfilingControlMode profilingControlMode)
 {
     int retVal = AL_FAILED_TO_ATTACH_TO_PROFILER;
     bool procCalled = false;
+    const DispatchTable* pTable = GetDispatchTable();
+
+    if (nullptr == pTable)
+    {
+        return retVal;
+    }
 
     if ((profilingControlMode & AMDT_TRACE_PROFILING) == AMDT_TRACE_PROFILING)
     {
-        procCalled = CallProfileControlEntryPointFromLibrary(m_clTraceAgentHandle, AL_CL_TRACE_AGENT_DLL, m_pCLTraceStopProfilingProc, "amdtCodeXLStopProfiling");
-        procCalled |= CallProfileControlEntryPointFromLibrary(m_hsaTraceAgentHandle, AL_HSA_TRACE_AGENT_DLL, m_pHSATraceStopProfilingProc, "amdtCodeXLStopProfiling");
+        procCalled |= CallProfileControlEntryPoint(pTable->m_pCLTraceStopProfilingProc);
+        procCalled |= CallProfileControlEntryPoint(pTable->m_pHSATraceStopProfilingProc);
     }
 
     if ((profilingControlMode & AMDT_PERF_COUNTER_PROFILING) == AMDT_PERF_COUNTER_PROFILING)
     {
-        procCalled = CallProfileControlEntryPointFromLibrary(m_clProfilingAgentHandle, AL_CL_PROFILE_AGENT_DLL, m_pCLPerfCounterStopProfilingProc, "amdtCodeXLStopProfiling");
-        procCalled |= CallProfileControlEntryPointFromLibrary(m_hsaProfilingAgentHandle, AL_HSA_PROFILE_AGENT_DLL, m_pHSAPerfCounterStopProfilingProc, "amdtCodeXLStopProfiling");
+        procCalled |= CallProfileControlEntryPoint(pTable->m_pCLPerfCounterStopProfilingProc);
+        procCalled |= CallProfileControlEntryPoint(pTable->m_pHSAPerfCounterStopProfilingProc);
     }
 
-    procCalled |= CallProfileControlEntryPointFromLibraryWithMode(m_clOccupancyAgentHandle, AL_CL_OCCUPANCY_AGENT_DLL, m_pCLOccupancyStopProfilingProc, "amdtCodeXLStopProfiling", profilingControlMode);
+    procCalled |= CallProfileControlEntryPointWithMode(pTable->m_pCLOccupancyStopProfilingProc, profilingControlMode);
 
     if (procCalled)
     {
@@ -218,20 +267,26 @@ int AMDTActivityLoggerProfileControl::ResumeProfiling(amdtProfilingControlMode p
 {
     int retVal = AL_FAILED_TO_ATTACH_TO_PROFILER;
     bool procCalled = false;
+    const DispatchTable* pTable = GetDispatchTable();
+
+    if (nullptr == pTable)
+    {
+        return retVal;
+    }
 
     if ((profilingControlMode & AMDT_TRACE_PROFILING) == AMDT_TRACE_PROFILING)
     {
-        procCalled = CallProfileControlEntryPointFromLibrary(m_clTraceAgentHandle, AL_CL_TRACE_AGENT_DLL, m_pCLTraceResumeProfilingProc, "amdtCodeXLResumeProfiling");
-        procCalled |= CallProfileControlEntryPointFromLibrary(m_hsaTraceAgentHandle, AL_HSA_TRACE_AGENT_DLL, m_pHSATraceResumeProfilingProc, "amdtCodeXLResumeProfiling");
+        procCalled |= CallProfileControlEntryPoint(pTable->m_pCLTraceResumeProfilingProc);
+        procCalled |= CallProfileControlEntryPoint(pTable->m_pHSATraceResumeProfilingProc);
     }
 
     if ((profilingControlMode & AMDT_PERF_COUNTER_PROFILING) == AMDT_PERF_COUNTER_PROFILING)
     {
-        procCalled = CallProfileControlEntryPointFromLibrary(m_clProfilingAgentHandle, AL_CL_PROFILE_AGENT_DLL, m_pCLPerfCounterResumeProfilingProc, "amdtCodeXLResumeProfiling");
-        procCalled |= CallProfileControlEntryPointFromLibrary(m_hsaProfilingAgentHandle, AL_HSA_PROFILE_AGENT_DLL, m_pHSAPerfCounterResumeProfilingProc, "amdtCodeXLResumeProfiling");
+        procCalled |= CallProfileControlEntryPoint(pTable->m_pCLPerfCounterResumeProfilingProc);
+        procCalled |= CallProfileControlEntryPoint(pTable->m_pHSAPerfCounterResumeProfilingProc);
     }
 
-    procCalled |= CallProfileControlEntryPointFromLibraryWithMode(m_clOccupancyAgentHandle, AL_CL_OCCUPANCY_AGENT_DLL, m_pCLOccupancyResumeProfilingProc, "amdtCodeXLResumeProfiling", profilingControlMode);
+    procCalled |= CallProfileControlEntryPointWithMode(pTable->m_pCLOccupancyResumeProfilingProc, profilingControlMode);
 
     if (procCalled)
     {
@@ -240,3 +295,35 @@ int AMDTActivityLoggerProfileControl::ResumeProfiling(amdtProfilingControlMode p
 
     return retVal;
 }
+
+int AMDTActivityLoggerProfileControl::Refresh()
+{
+    const DispatchTable* pTable;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+        pTable = ResolveDispatchTable();
+    }
+
+    if (nullptr == pTable)
+    {
+        return AL_FAILED_TO_ATTACH_TO_PROFILER;
+    }
+
+    const ProfilingControlProc procs[] =
+    {
+        pTable->m_pCLTraceStopProfilingProc, pTable->m_pCLTraceResumeProfilingProc,
+        pTable->m_pHSATraceStopProfilingProc, pTable->m_pHSATraceResumeProfilingProc,
+        pTable->m_pCLPerfCounterStopProfilingProc, pTable->m_pCLPerfCounterResumeProfilingProc,
+        pTable->m_pHSAPerfCounterStopProfilingProc, pTable->m_pHSAPerfCounterResumeProfilingProc
+    };
+
+    bool agentFound = nullptr != pTable->m_pCLOccupancyStopProfilingProc || nullptr != pTable->m_pCLOccupancyResumeProfilingProc;
+
+    for (size_t i = 0; i < sizeof(procs) / sizeof(procs[0]); i++)
+    {
+        agentFound |= nullptr != procs[i];
+    }
+
+    return agentFound ? AL_SUCCESS : AL_FAILED_TO_ATTACH_TO_PROFILER;
+}
@@ -8,6 +8,10 @@
 #ifndef _AMDT_ACTIVITY_LOGGER_PROFILE_CONTROL_H_
 #define _AMDT_ACTIVITY_LOGGER_PROFILE_CONTROL_H_
 
+#include <atomic>
+#include <mutex>
+#include <vector>
+
 #include "TSingleton.h"
 
 #include <AMDTOSWrappers/Include/osModule.h>
@@ -21,10 +25,19 @@ typedef void(*ProfilingControlProc)();
 /// function typedef for the profiling control functions exported from the agent libraries -- this version passes the mode being started/stopped
 typedef void(*ProfilingControlProcWithMode)(amdtProfilingControlMode);
 
-/// Singleton class to interact with agents to stop/resume profiling
+/// Singleton class to interact with agents to stop/resume profiling.
+/// The entry points of the agent libraries are resolved once, the first time profiling is stopped or resumed,
+/// including the agents which are not loaded, and published atomically so that any thread can use them without locking.
+/// Refresh resolves them again, for agent libraries loaded later.
 class AMDTActivityLoggerProfileControl : public TSingleton <AMDTActivityLoggerProfileControl>
 {
 public:
+    /// Constructor
+    AMDTActivityLoggerProfileControl();
+
+    /// Destructor
+    ~AMDTActivityLoggerProfileControl();
+
     /// Tell the profiler to stop profiling
     /// \param profilingControlMode the profiling mode being stopped
     /// \return AL_SUCCESS if at least one of the profiling agents is loaded and the the Stop Profiling entry point is called, AL_FAILED_TO_ATTACH_TO_PROFILER otherwise
@@ -35,48 +48,74 @@ public:
     /// \return AL_SUCCESS if at least one of the profiling agents is loaded and the the Resume Profiling entry point is called, AL_FAILED_TO_ATTACH_TO_PROFILER otherwise
     int ResumeProfiling(amdtProfilingControlMode profilingControlMode);
 
+    /// Resolves the entry points of the agent libraries again, for agent libraries loaded since they were resolved
+    /// \return AL_SUCCESS if at least one of the profiling agents is loaded, AL_FAILED_TO_ATTACH_TO_PROFILER otherwise
+    int Refresh();
+
+    /// Locks the resolution of the entry points before the process forks, so that the child does not inherit a resolution in progress
+    void LockForFork() { m_mtx.lock(); }
+
+    /// Unlocks the resolution of the entry points after the process forked, in the parent and in the child
+    void UnlockAfterFork() { m_mtx.unlock(); }
+
 private:
+    /// The stop and resume entry points of the agent libraries, nullptr for the agents which are not loaded
+    struct DispatchTable
+    {
+        ProfilingControlProc m_pCLTraceStopProfilingProc;               ///< Pointer to the CL StopTracing entry point
+        ProfilingControlProc m_pCLTraceResumeProfilingProc;             ///< Pointer to the CL ResumeTracing entry point
+        ProfilingControlProc m_pCLPerfCounterStopProfilingProc;         ///< Pointer to the CL StopProfiling entry point
+        ProfilingControlProc m_pCLPerfCounterResumeProfilingProc;       ///< Pointer to the CL ResumeProfiling entry point
+
+        ProfilingControlProc m_pHSATraceStopProfilingProc;              ///< Pointer to the HSA StopTracing entry point
+        ProfilingControlProc m_pHSATraceResumeProfilingProc;            ///< Pointer to the HSA ResumeTracing entry point
+        ProfilingControlProc m_pHSAPerfCounterStopProfilingProc;        ///< Pointer to the HSA StopProfiling entry point
+        ProfilingControlProc m_pHSAPerfCounterResumeProfilingProc;      ///< Pointer to the HSA ResumeProfiling entry point
+
+        ProfilingControlProcWithMode m_pCLOccupancyStopProfilingProc;   ///< Pointer to the CL Occupancy StopProfiling entry point
+        ProfilingControlProcWithMode m_pCLOccupancyResumeProfilingProc; ///< Pointer to the CL Occupancy ResumeProfiling entry point
+    };
+
+    /// Disabled copy contructor
+    AMDTActivityLoggerProfileControl(const AMDTActivityLoggerProfileControl& obj);
+
+    /// Disabled assignment operator
+    AMDTActivityLoggerProfileControl& operator = (const AMDTActivityLoggerProfileControl& obj);
+
     /// Helper function to get the handle for the specified profiler library
     /// \param pBaseName the base name of the profiler lib whose handle is needed
     /// \param[out] libHandle the handle of the library, if it is already loaded in the current process
     /// \return true if the profiler lib was loaded in the current process
     bool GetHandleForProfilerLib(const wchar_t* pBaseName, osModuleHandle& libHandle);
 
-    /// Helper function to initialize lib handles and function pointers, and to call the specified function pointer
-    /// \param[in,out] libHandle the handle of the library to initialize the entry point from
-    /// \param[in] pLibName the name of the library to initialize the entry point from
-    /// \param[in,out] profilingControlProc the function pointer for the entry point
-    /// \param[in] pProcName the name of the entry point
-    /// \return true on success, false otherwise
-    bool CallProfileControlEntryPointFromLibrary(osModuleHandle& libHandle, const wchar_t* pLibName, ProfilingControlProc& profilingControlProc, const char* pProcName);
-
-    /// Helper function to initialize lib handles and function pointers, and to call the specified function pointer -- this method passes the mode param to the agent
-    /// \param[in,out] libHandle the handle of the library to initialize the entry point from
-    /// \param[in] pLibName the name of the library to initialize the entry point from
-    /// \param[in,out] profilingControlProc the function pointer for the entry point
-    /// \param[in] pProcName the name of the entry point
-    /// \param[in] mode the profiling mode being stopped or resumed
-    /// \return true on success, false otherwise
-    bool CallProfileControlEntryPointFromLibraryWithMode(osModuleHandle& libHandle, const wchar_t* pLibName, ProfilingControlProcWithMode& profilingControlProc, const char* pProcName, amdtProfilingControlMode mode);
-
-    osModuleHandle           m_clTraceAgentHandle = nullptr;                  ///< handle to the CL Tracing Agent module
-    osModuleHandle           m_hsaTraceAgentHandle = nullptr;                 ///< handle to the HSA Tracing Agent module
-    osModuleHandle           m_clProfilingAgentHandle = nullptr;              ///< handle to the CL Profiling Agent module
-    osModuleHandle           m_hsaProfilingAgentHandle = nullptr;             ///< handle to the HSA Profiling Agent module
-    osModuleHandle           m_clOccupancyAgentHandle = nullptr;              ///< handle to the CL Occupancy Agent module
-
-    ProfilingControlProc m_pCLTraceStopProfilingProc = nullptr;               ///< Pointer to the CL StopTracing entry point
-    ProfilingControlProc m_pCLTraceResumeProfilingProc = nullptr;             ///< Pointer to the CL ResumeTracing entry point
-    ProfilingControlProc m_pCLPerfCounterStopProfilingProc = nullptr;         ///< Pointer to the CL StopProfiling entry point
-    ProfilingControlProc m_pCLPerfCounterResumeProfilingProc = nullptr;       ///< Pointer to the CL ResumeProfiling entry point
-
-    ProfilingControlProc m_pHSATraceStopProfilingProc = nullptr;              ///< Pointer to the HSA StopTracing entry point
-    ProfilingControlProc m_pHSATraceResumeProfilingProc = nullptr;            ///< Pointer to the HSA ResumeTracing entry point
-    ProfilingControlProc m_pHSAPerfCounterStopProfilingProc = nullptr;        ///< Pointer to the HSA StopProfiling entry point
-    ProfilingControlProc m_pHSAPerfCounterResumeProfilingProc = nullptr;      ///< Pointer to the HSA ResumeProfiling entry point
-
-    ProfilingControlProcWithMode m_pCLOccupancyStopProfilingProc = nullptr;   ///< Pointer to the CL Occupancy StopProfiling entry point
-    ProfilingControlProcWithMode m_pCLOccupancyResumeProfilingProc = nullptr; ///< Pointer to the CL Occupancy ResumeProfiling entry point
+    /// Helper function to get the stop and resume entry points of a profiler library
+    /// \param[in] pLibName the name of the library to get the entry points from
+    /// \param[out] stopProcAddress the address of the Stop Profiling entry point, nullptr if the library is not loaded or does not export it
+    /// \param[out] resumeProcAddress the address of the Resume Profiling entry point, nullptr if the library is not loaded or does not export it
+    void GetProfileControlEntryPoints(const wchar_t* pLibName, osProcedureAddress& stopProcAddress, osProcedureAddress& resumeProcAddress);
+
+    /// Resolves the entry points of all the agent libraries and publishes them, called with m_mtx locked
+    /// \return the published dispatch table
+    const DispatchTable* ResolveDispatchTable();
+
+    /// Gets the published dispatch table, resolving it the first time
+    /// \return the dispatch table, nullptr if it could not be allocated
+    const DispatchTable* GetDispatchTable();
+
+    /// Helper function to call an entry point
+    /// \param profilingControlProc the entry point, nullptr if its agent is not loaded
+    /// \return true if the entry point was called
+    static bool CallProfileControlEntryPoint(ProfilingControlProc profilingControlProc);
+
+    /// Helper function to call an entry point -- this version passes the mode param to the agent
+    /// \param profilingControlProc the entry point, nullptr if its agent is not loaded
+    /// \param mode the profiling mode being stopped or resumed
+    /// \return true if the entry point was called
+    static bool CallProfileControlEntryPointWithMode(ProfilingControlProcWithMode profilingControlProc, amdtProfilingControlMode mode);
+
+    std::atomic<const DispatchTable*> m_pDispatchTable;   ///< the published dispatch table, nullptr until it is first resolved
+    std::vector<DispatchTable*> m_dispatchTables;         ///< all the resolved dispatch tables, the replaced ones are kept as other threads may still be calling through them
+    std::mutex m_mtx;                                     ///< mutex to serialize the resolutions of the dispatch table
 };
 
 #endif // _AMDT_ACTIVITY_LOGGER_PROFILE_CONTROL_H_
@@ -0,0 +1,897 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Reads perf marker files, in the text or the binary layout, and
+///        reconstructs and summarizes the markers of their threads
+//==============================================================================
+
+#include <cstdlib>
+#include <cstring>
+
+#include "AMDTActivityLoggerReader.h"
+#include "AMDTActivityLoggerTextWriter.h"
+#include "AMDTActivityLoggerWorkerPool.h"
+#include "AMDTGPUProfilerDefs.h"
+
+#if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
+    #include "windows.h"
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define AMDT_PERF_MARKER_READER_SSE2
+    #include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+using namespace std;
+
+const char s_TEXT_FILE_HEADER[] = "=====Perfmarker Output=====";    ///< the first line of a perf marker file in the text layout
+
+/// A marker opened by a thread and not yet closed, while reading a section
+struct PerfMarkerReaderStackEntry
+{
+    unsigned int m_markerHandle;        ///< the handle of the marker
+    unsigned long long m_beginNanos;    ///< the timestamp of the begin
+    unsigned long long m_childNanos;    ///< the sum of the durations of the markers directly nested in the marker
+    size_t m_firstArg;                  ///< the index of the first argument of the marker in the arguments of the open markers
+    size_t m_numArgs;                   ///< the number of arguments of the marker
+};
+
+PerfMarkerMappedFile::PerfMarkerMappedFile()
+{
+    m_pData = nullptr;
+    m_size = 0;
+#if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_hMapping = NULL;
+#endif
+}
+
+PerfMarkerMappedFile::~PerfMarkerMappedFile()
+{
+    Close();
+}
+
+bool PerfMarkerMappedFile::Open(const char* szFileName)
+{
+    Close();
+
+#if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
+    m_hFile = CreateFileA(szFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+    if (m_hFile == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(m_hFile, &size))
+    {
+        Close();
+        return false;
+    }
+
+    m_size = static_cast<size_t>(size.QuadPart);
+
+    if (m_size == 0)
+    {
+        return true;
+    }
+
+    m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    m_pData = m_hMapping != NULL ? static_cast<const char*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+    int fd = open(szFileName, O_RDONLY);
+
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    struct stat fileStat;
+
+    if (fstat(fd, &fileStat) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    m_size = static_cast<size_t>(fileStat.st_size);
+
+    if (m_size == 0)
+    {
+        close(fd);
+        return true;
+    }
+
+    // the mapping stays valid once the file is closed
+    void* pData = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (pData != MAP_FAILED)
+    {
+        madvise(pData, m_size, MADV_SEQUENTIAL);
+        m_pData = static_cast<const char*>(pData);
+    }
+
+#endif
+
+    if (m_pData == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void PerfMarkerMappedFile::Close()
+{
+#if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
+
+    if (m_pData != nullptr)
+    {
+        UnmapViewOfFile(m_pData);
+    }
+
+    if (m_hMapping != NULL)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = NULL;
+    }
+
+    if (m_hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+
+#else
+
+    if (m_pData != nullptr)
+    {
+        munmap(const_cast<char*>(m_pData), m_size);
+    }
+
+#endif
+
+    m_pData = nullptr;
+    m_size = 0;
+}
+
+/// Helper function to get the index of the lowest bit set in a mask
+/// \param mask the mask, must not be 0
+/// \return the index of the bit
+static unsigned int GetLowestBit(unsigned int mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned int>(index);
+#else
+    return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+}
+
+/// Helper function to find the next newline
+/// \param p the first character to check
+/// \param pEnd the end of the data
+/// \return the newline, pEnd if there is none
+static const char* FindNewline(const char* p, const char* pEnd)
+{
+#ifdef AMDT_PERF_MARKER_READER_SSE2
+    const __m128i newlines = _mm_set1_epi8('\n');
+
+    for (; pEnd - p >= 16; p += 16)
+    {
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), newlines)));
+
+        if (mask != 0)
+        {
+            return p + GetLowestBit(mask);
+        }
+    }
+
+#endif
+
+    const void* pNewline = memchr(p, '\n', pEnd - p);
+    return pNewline != nullptr ? static_cast<const char*>(pNewline) : pEnd;
+}
+
+/// Helper function to skip lines
+/// \param p the start of the first line
+/// \param pEnd the end of the data
+/// \param numLines the number of lines to skip
+/// \return the start of the line following the skipped lines, nullptr if the data has fewer lines
+static const char* SkipLines(const char* p, const char* pEnd, unsigned long long numLines)
+{
+#ifdef AMDT_PERF_MARKER_READER_SSE2
+    const __m128i newlines = _mm_set1_epi8('\n');
+
+    // count the newlines 16 bytes at a time, the lines are much longer than 16 bytes
+    for (; numLines != 0 && pEnd - p >= 16; p += 16)
+    {
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), newlines)));
+
+        while (mask != 0)
+        {
+            if (--numLines == 0)
+            {
+                return p + GetLowestBit(mask) + 1;
+            }
+
+            mask &= mask - 1;
+        }
+    }
+
+#endif
+
+    for (; numLines != 0; numLines--)
+    {
+        const char* pNewline = FindNewline(p, pEnd);
+
+        if (pNewline == pEnd)
+        {
+            return nullptr;
+        }
+
+        p = pNewline + 1;
+    }
+
+    return p;
+}
+
+/// Helper function to skip the spaces padding a column
+/// \param p the first character to check
+/// \param pEnd the end of the line
+/// \return the first character which is not a space, pEnd if there is none
+static const char* SkipSpaces(const char* p, const char* pEnd)
+{
+#ifdef AMDT_PERF_MARKER_READER_SSE2
+    const __m128i spaces = _mm_set1_epi8(' ');
+
+    for (; pEnd - p >= 16; p += 16)
+    {
+        unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), spaces))) ^ 0xffff;
+
+        if (mask != 0)
+        {
+            return p + GetLowestBit(mask);
+        }
+    }
+
+#endif
+
+    while (p < pEnd && *p == ' ')
+    {
+        p++;
+    }
+
+    return p;
+}
+
+/// Helper function to find the end of a column which holds no space
+/// \param p the start of the column
+/// \param pEnd the end of the line
+/// \return the first space, pEnd if there is none
+static const char* FindSpace(const char* p, const char* pEnd)
+{
+    while (p < pEnd && *p != ' ')
+    {
+        p++;
+    }
+
+    return p;
+}
+
+/// Helper function to parse a decimal column
+/// \param p the start of the column, after its padding
+/// \param pEnd the end of the line
+/// \param[out] value the value
+/// \return the end of the column
+static const char* ParseDecimal(const char* p, const char* pEnd, unsigned long long& value)
+{
+    value = 0;
+
+    for (; p < pEnd && static_cast<unsigned int>(*p - '0') < 10; p++)
+    {
+        value = value * 10 + static_cast<unsigned int>(*p - '0');
+    }
+
+    return p;
+}
+
+/// Helper function to get a name of the text layout, replacing the AL_SPACE sequences of escaped names with spaces
+/// \param p the start of the name
+/// \param pEnd the end of the name
+/// \param[out] name the name
+static void GetName(const char* p, const char* pEnd, string& name)
+{
+    name.assign(p, pEnd);
+
+    if (memchr(p, '&', pEnd - p) == nullptr)
+    {
+        return;
+    }
+
+    const size_t escapeLength = strlen(AL_SPACE);
+    size_t pos;
+
+    while ((pos = name.find(AL_SPACE)) != string::npos)
+    {
+        name.replace(pos, escapeLength, 1, ' ');
+    }
+}
+
+/// Helper function to trim the spaces ending a column
+/// \param p the start of the column
+/// \param pEnd the end of the column
+/// \return the end of the column without its trailing spaces
+static const char* TrimSpaces(const char* p, const char* pEnd)
+{
+    while (pEnd > p && pEnd[-1] == ' ')
+    {
+        pEnd--;
+    }
+
+    return pEnd;
+}
+
+/// Helper function to parse the value column of an argument of the text layout
+/// \param p the start of the value
+/// \param pEnd the end of the line
+/// \param markerTable the table interning the string values
+/// \param markerTableCache the cache of the handles of the table
+/// \param[in,out] arg the argument, with its type, receiving its value
+/// \return false if the value is malformed
+static bool ParseArgValue(const char* p, const char* pEnd, PerfMarkerTable& markerTable, PerfMarkerTableCache& markerTableCache, PerfMarkerArg& arg)
+{
+    const char* pValueEnd = FindSpace(p, pEnd);
+
+    if (arg.m_type == PERF_MARKER_ARG_STRING)
+    {
+        string value;
+        GetName(p, pValueEnd, value);
+        arg.m_value = markerTableCache.GetHandle(markerTable, value.c_str(), s_PERF_MARKER_ARG_STRING_GROUP);
+        return arg.m_value != 0;
+    }
+
+    if (arg.m_type == PERF_MARKER_ARG_DOUBLE)
+    {
+        // strtod needs a null terminated string
+        string text(p, pValueEnd);
+        char* pParsedEnd;
+        double value = strtod(text.c_str(), &pParsedEnd);
+        memcpy(&arg.m_value, &value, sizeof(value));
+        return !text.empty() && *pParsedEnd == '\0';
+    }
+
+    const char* pDigits = p < pValueEnd && *p == '-' ? p + 1 : p;
+    unsigned long long magnitude;
+
+    if (pDigits == pValueEnd || ParseDecimal(pDigits, pValueEnd, magnitude) != pValueEnd)
+    {
+        return false;
+    }
+
+    arg.m_value = pDigits != p ? 0ULL - magnitude : magnitude;
+    return true;
+}
+
+/// Helper function to open a marker of a thread
+/// \param[in,out] stack the markers opened by the thread
+/// \param args the arguments of the markers opened by the thread
+/// \param markerHandle the handle of the marker
+/// \param beginNanos the timestamp of the begin
+static void BeginMarker(vector<PerfMarkerReaderStackEntry>& stack, const vector<PerfMarkerArg>& args, unsigned int markerHandle, unsigned long long beginNanos)
+{
+    PerfMarkerReaderStackEntry entry;
+    entry.m_markerHandle = markerHandle;
+    entry.m_beginNanos = beginNanos;
+    entry.m_childNanos = 0;
+    entry.m_firstArg = args.size();
+    entry.m_numArgs = 0;
+    stack.push_back(entry);
+}
+
+/// Helper function to add an argument to the innermost marker of a thread, the arguments follow the begin of their marker
+/// \param[in,out] stack the markers opened by the thread
+/// \param[in,out] args the arguments of the markers opened by the thread
+/// \param arg the argument
+static void AddMarkerArg(vector<PerfMarkerReaderStackEntry>& stack, vector<PerfMarkerArg>& args, const PerfMarkerArg& arg)
+{
+    if (!stack.empty() && stack.back().m_firstArg + stack.back().m_numArgs == args.size())
+    {
+        args.push_back(arg);
+        stack.back().m_numArgs++;
+    }
+}
+
+/// Helper function to close the innermost marker of a thread
+/// \param[in,out] stack the markers opened by the thread
+/// \param[in,out] args the arguments of the markers opened by the thread, the arguments of the marker are removed
+/// \param markerHandle the handle of the name given at the end, 0 to keep the name given at the begin
+/// \param endNanos the timestamp of the end
+/// \param callback the function called with the marker instance
+/// \param[in,out] counts the counts of the events which are not complete marker instances
+static void EndMarker(vector<PerfMarkerReaderStackEntry>& stack, vector<PerfMarkerArg>& args, unsigned int markerHandle, unsigned long long endNanos,
+                      const function<void(const PerfMarkerInstance&)>& callback, PerfMarkerSectionCounts& counts)
+{
+    if (stack.empty())
+    {
+        counts.m_numUnbalanced++;
+        return;
+    }
+
+    const PerfMarkerReaderStackEntry& entry = stack.back();
+    PerfMarkerInstance instance;
+    unsigned long long duration = endNanos > entry.m_beginNanos ? endNanos - entry.m_beginNanos : 0;
+
+    instance.m_markerHandle = markerHandle != 0 ? markerHandle : entry.m_markerHandle;
+    instance.m_depth = static_cast<unsigned int>(stack.size() - 1);
+    instance.m_beginNanos = entry.m_beginNanos;
+    instance.m_endNanos = endNanos;
+    instance.m_selfNanos = duration > entry.m_childNanos ? duration - entry.m_childNanos : 0;
+    instance.m_pArgs = entry.m_numArgs != 0 ? &args[entry.m_firstArg] : nullptr;
+    instance.m_numArgs = entry.m_numArgs;
+
+    size_t firstArg = entry.m_firstArg;
+    stack.pop_back();
+
+    if (!stack.empty())
+    {
+        stack.back().m_childNanos += duration;
+    }
+
+    callback(instance);
+    args.resize(firstArg);
+}
+
+PerfMarkerFileReader::PerfMarkerFileReader()
+{
+    m_isBinary = false;
+}
+
+bool PerfMarkerFileReader::Open(const char* szFileName)
+{
+    m_sections.clear();
+    m_chunks.clear();
+
+    if (!m_file.Open(szFileName))
+    {
+        return false;
+    }
+
+    m_isBinary = PerfMarkerBinaryReader::IsBinaryFile(m_file.GetData(), m_file.GetSize());
+
+    return m_isBinary ? LocateBinarySections() : LocateTextSections();
+}
+
+bool PerfMarkerFileReader::LocateTextSections()
+{
+    const char* pData = m_file.GetData();
+    const char* pEnd = pData + m_file.GetSize();
+    const size_t headerLength = sizeof(s_TEXT_FILE_HEADER) - 1;
+
+    if (m_file.GetSize() < headerLength || memcmp(pData, s_TEXT_FILE_HEADER, headerLength) != 0)
+    {
+        return false;
+    }
+
+    const char* p = FindNewline(pData, pEnd);
+
+    // each section is a thread id line, a number of lines line and the marker lines
+    while (p < pEnd && ++p < pEnd && *p != '\n' && *p != '\r')
+    {
+        Section section;
+        const char* pThreadIdEnd = FindNewline(p, pEnd);
+        const char* pCountEnd = pThreadIdEnd < pEnd ? FindNewline(pThreadIdEnd + 1, pEnd) : pEnd;
+        unsigned long long numLines;
+
+        if (pCountEnd == pEnd || ParseDecimal(pThreadIdEnd + 1, pCountEnd, numLines) == pThreadIdEnd + 1)
+        {
+            return false;
+        }
+
+        section.m_threadId.assign(p, TrimSpaces(p, pThreadIdEnd[-1] == '\r' ? pThreadIdEnd - 1 : pThreadIdEnd));
+        section.m_begin = pCountEnd + 1 - pData;
+        section.m_firstChunk = 0;
+        section.m_endChunk = 0;
+
+        const char* pSectionEnd = SkipLines(pCountEnd + 1, pEnd, numLines);
+
+        if (pSectionEnd == nullptr)
+        {
+            return false;
+        }
+
+        section.m_end = pSectionEnd - pData;
+        m_sections.push_back(section);
+
+        // p is left on the newline ending the section
+        p = pSectionEnd - 1;
+    }
+
+    return true;
+}
+
+bool PerfMarkerFileReader::LocateBinarySections()
+{
+    const char* pData = m_file.GetData();
+    size_t size = m_file.GetSize();
+    PerfMarkerBinaryReader reader(pData, size);
+    unsigned long long numSections;
+
+    if (!reader.ReadFileHeader(m_markerTable, numSections) || !PerfMarkerBinaryReader(pData, size).ReadIndex(m_chunks))
+    {
+        return false;
+    }
+
+    unsigned long long offset = reader.GetOffset();
+    size_t chunk = 0;
+
+    for (unsigned long long i = 0; i < numSections; i++)
+    {
+        PerfMarkerBinaryReader sectionReader(pData + offset, static_cast<size_t>(size - offset), offset);
+        Section section;
+        unsigned long long numEvents;
+        unsigned long long eventsSize;
+
+        if (!sectionReader.ReadSectionHeader(section.m_threadId, numEvents, eventsSize) || eventsSize > size - sectionReader.GetOffset())
+        {
+            return false;
+        }
+
+        section.m_begin = static_cast<size_t>(sectionReader.GetOffset());
+        section.m_end = static_cast<size_t>(section.m_begin + eventsSize);
+        section.m_firstChunk = chunk;
+
+        while (chunk < m_chunks.size() && m_chunks[chunk].m_section == i)
+        {
+            chunk++;
+        }
+
+        section.m_endChunk = chunk;
+        m_sections.push_back(section);
+        offset = section.m_end;
+    }
+
+    return chunk == m_chunks.size();
+}
+
+bool PerfMarkerFileReader::ReadSection(size_t section, const function<void(const PerfMarkerInstance&)>& callback, PerfMarkerSectionCounts& counts)
+{
+    counts.m_numSkipped = 0;
+    counts.m_numDropped = 0;
+    counts.m_numUnbalanced = 0;
+
+    return m_isBinary ? ReadBinarySection(m_sections[section], callback, counts) : ReadTextSection(m_sections[section], callback, counts);
+}
+
+bool PerfMarkerFileReader::ReadTextSection(const Section& section, const function<void(const PerfMarkerInstance&)>& callback, PerfMarkerSectionCounts& counts)
+{
+    const char* pData = m_file.GetData();
+    const char* p = pData + section.m_begin;
+    const char* pSectionEnd = pData + section.m_end;
+    vector<PerfMarkerReaderStackEntry> stack;
+    vector<PerfMarkerArg> args;
+    PerfMarkerTableCache markerTableCache;
+    string markerName;
+    string groupName;
+    const char* pLastName = "";
+    const char* pLastGroup = "";
+    size_t lastNameLength = 0;
+    size_t lastGroupLength = 0;
+    unsigned int lastMarkerHandle = 0;
+
+    while (p < pSectionEnd)
+    {
+        const char* pLine = p;
+        const char* pLineEnd = FindNewline(p, pSectionEnd);
+        p = pLineEnd + 1;
+
+        if (pLineEnd > pLine && pLineEnd[-1] == '\r')
+        {
+            pLineEnd--;
+        }
+
+        // the tags have distinct lengths, except clBeginPerfMarker and clEndPerfMarkerEx and the clPerfMarker... tags
+        const char* pTagEnd = FindSpace(pLine, pLineEnd);
+        size_t tagLength = pTagEnd - pLine;
+        unsigned long long value;
+
+        if (tagLength == 17 && memcmp(pLine, "clBeginPerfMarker", 17) == 0)
+        {
+            // tag, marker name, timestamp and group name columns, the names have their spaces escaped
+            const char* pName = SkipSpaces(pTagEnd, pLineEnd);
+            const char* pNameEnd = FindSpace(pName, pLineEnd);
+            const char* pGroup = ParseDecimal(SkipSpaces(pNameEnd, pLineEnd), pLineEnd, value);
+            pGroup = SkipSpaces(pGroup, pLineEnd);
+            const char* pGroupEnd = FindSpace(pGroup, pLineEnd);
+
+            // loops begin the same marker over and over, its names are compared in place before being looked up
+            if (static_cast<size_t>(pNameEnd - pName) != lastNameLength || static_cast<size_t>(pGroupEnd - pGroup) != lastGroupLength ||
+                memcmp(pName, pLastName, lastNameLength) != 0 || memcmp(pGroup, pLastGroup, lastGroupLength) != 0)
+            {
+                GetName(pName, pNameEnd, markerName);
+                GetName(pGroup, pGroupEnd, groupName);
+                lastMarkerHandle = markerTableCache.GetHandle(m_markerTable, markerName.c_str(), groupName.c_str());
+
+                if (lastMarkerHandle == 0)
+                {
+                    return false;
+                }
+
+                pLastName = pName;
+                pLastGroup = pGroup;
+                lastNameLength = pNameEnd - pName;
+                lastGroupLength = pGroupEnd - pGroup;
+            }
+
+            BeginMarker(stack, args, lastMarkerHandle, value);
+        }
+        else if (tagLength == 15 && memcmp(pLine, "clEndPerfMarker", 15) == 0)
+        {
+            ParseDecimal(SkipSpaces(pTagEnd, pLineEnd), pLineEnd, value);
+            EndMarker(stack, args, 0, value, callback, counts);
+        }
+        else if (tagLength == 15 && memcmp(pLine, "clPerfMarkerArg", 15) == 0)
+        {
+            // argument name, type and value columns, the name and a string value have their spaces escaped
+            const char* pName = SkipSpaces(pTagEnd, pLineEnd);
+            const char* pNameEnd = FindSpace(pName, pLineEnd);
+            const char* pType = SkipSpaces(pNameEnd, pLineEnd);
+            const char* pTypeEnd = FindSpace(pType, pLineEnd);
+            const char* pValue = SkipSpaces(pTypeEnd, pLineEnd);
+            PerfMarkerArg arg;
+
+            GetName(pName, pNameEnd, markerName);
+            arg.m_nameHandle = markerTableCache.GetHandle(m_markerTable, markerName.c_str(), s_PERF_MARKER_ARG_STRING_GROUP);
+
+            if (arg.m_nameHandle == 0 || !GetPerfMarkerArgType(pType, pTypeEnd - pType, arg.m_type) || !ParseArgValue(pValue, pLineEnd, m_markerTable, markerTableCache, arg))
+            {
+                return false;
+            }
+
+            AddMarkerArg(stack, args, arg);
+        }
+        else if (tagLength == 17 && memcmp(pLine, "clEndPerfMarkerEx", 17) == 0)
+        {
+            ParseDecimal(SkipSpaces(pTagEnd, pLineEnd), pLineEnd, value);
+
+            unsigned int markerHandle = 0;
+
+            if (ParsePerfMarkerEndExNames(pLine, pLineEnd - pLine, markerName, groupName))
+            {
+                markerHandle = markerTableCache.GetHandle(m_markerTable, markerName.c_str(), groupName.c_str());
+            }
+
+            EndMarker(stack, args, markerHandle, value, callback, counts);
+        }
+        else if (tagLength == 19 && memcmp(pLine, "clPerfMarkerSkipped", 19) == 0)
+        {
+            // the layout of clBeginPerfMarker with the count as value
+            const char* pNameEnd = FindSpace(SkipSpaces(pTagEnd, pLineEnd), pLineEnd);
+            ParseDecimal(SkipSpaces(pNameEnd, pLineEnd), pLineEnd, value);
+            counts.m_numSkipped += value;
+        }
+        else if (tagLength == 19 && memcmp(pLine, "clPerfMarkerDropped", 19) == 0)
+        {
+            ParseDecimal(SkipSpaces(pTagEnd, pLineEnd), pLineEnd, value);
+            counts.m_numDropped += value;
+        }
+
+        // clPerfMarkerSamples lines only tell how many instances a sampled begin stands for
+    }
+
+    counts.m_numUnbalanced += stack.size();
+
+    return true;
+}
+
+bool PerfMarkerFileReader::ReadBinarySection(const Section& section, const function<void(const PerfMarkerInstance&)>& callback, PerfMarkerSectionCounts& counts)
+{
+    PerfMarkerBinaryReader reader(m_file.GetData(), m_file.GetSize());
+    vector<PerfMarkerReaderStackEntry> stack;
+    vector<PerfMarkerArg> args;
+    PerfMarkerTableCache markerTableCache;
+
+    for (size_t chunk = section.m_firstChunk; chunk < section.m_endChunk; chunk++)
+    {
+        // the events of a section are decoded one chunk at a time
+        PerfMarkerEventBuffer events;
+
+        if (!reader.ReadChunk(m_chunks[chunk], events))
+        {
+            return false;
+        }
+
+        for (const PerfMarkerEventChunk* pChunk = events.GetFirstChunk(); pChunk != nullptr; pChunk = pChunk->m_pNext)
+        {
+            size_t slot = 0;
+
+            while (slot < pChunk->m_usedSlots)
+            {
+                const PerfMarkerEvent& event = pChunk->m_pSlots[slot];
+                unsigned long long count = 0;
+
+                if (event.GetNumSlots() > 1)
+                {
+                    memcpy(&count, event.GetPayload(), sizeof(count));
+                }
+
+                switch (event.m_type)
+                {
+                    case PERF_MARKER_EVENT_BEGIN:
+                    case PERF_MARKER_EVENT_SAMPLED_BEGIN:
+                        BeginMarker(stack, args, event.m_markerHandle, event.m_timestamp);
+                        break;
+
+                    case PERF_MARKER_EVENT_END:
+                        EndMarker(stack, args, 0, event.m_timestamp, callback, counts);
+                        break;
+
+                    case PERF_MARKER_EVENT_END_EX:
+                        EndMarker(stack, args, event.m_markerHandle, event.m_timestamp, callback, counts);
+                        break;
+
+                    case PERF_MARKER_EVENT_ARGS:
+                    {
+                        size_t numArgs;
+                        const PerfMarkerArg* pArgs = GetPerfMarkerEventArgs(event, numArgs);
+
+                        for (size_t i = 0; i < numArgs; i++)
+                        {
+                            // the instances refer to the string values by their handle in the reader's marker table
+                            PerfMarkerArg arg = pArgs[i];
+
+                            if (arg.m_type == PERF_MARKER_ARG_STRING)
+                            {
+                                arg.m_value = markerTableCache.GetHandle(m_markerTable, GetPerfMarkerEventArgString(event, pArgs[i]), s_PERF_MARKER_ARG_STRING_GROUP);
+
+                                if (arg.m_value == 0)
+                                {
+                                    return false;
+                                }
+                            }
+
+                            AddMarkerArg(stack, args, arg);
+                        }
+
+                        break;
+                    }
+
+                    case PERF_MARKER_EVENT_SKIPPED:
+                        counts.m_numSkipped += count;
+                        break;
+
+                    case PERF_MARKER_EVENT_DROPPED:
+                        counts.m_numDropped += count;
+                        break;
+
+                    default:
+                        break;
+                }
+
+                slot += event.GetNumSlots();
+            }
+        }
+    }
+
+    counts.m_numUnbalanced += stack.size();
+
+    return true;
+}
+
+unsigned int PerfMarkerFileReader::GetGroupByArgHandle(const PerfMarkerInstance& instance, const char* szGroupByArg, unsigned int& groupByArgHandle, PerfMarkerTableCache& markerTableCache)
+{
+    for (size_t i = 0; i < instance.m_numArgs; i++)
+    {
+        const PerfMarkerArg& arg = instance.m_pArgs[i];
+
+        // the name is only compared until its handle is known, the table registers a name once
+        if (groupByArgHandle == 0 && m_markerTable.Get(arg.m_nameHandle).m_markerName == szGroupByArg)
+        {
+            groupByArgHandle = arg.m_nameHandle;
+        }
+
+        if (arg.m_nameHandle == groupByArgHandle)
+        {
+            const PerfMarkerInfo& info = m_markerTable.Get(instance.m_markerHandle);
+            string value;
+
+            if (arg.m_type == PERF_MARKER_ARG_STRING)
+            {
+                value = m_markerTable.Get(static_cast<unsigned int>(arg.m_value)).m_markerName;
+            }
+            else
+            {
+                char number[s_PERF_MARKER_COUNTER_VALUE_MAX_LENGTH];
+                value.assign(number, FormatPerfMarkerArgNumber(arg, number));
+            }
+
+            string name = info.m_markerName + "[" + szGroupByArg + "=" + value + "]";
+            return markerTableCache.GetHandle(m_markerTable, name.c_str(), info.m_groupName.c_str());
+        }
+    }
+
+    return instance.m_markerHandle;
+}
+
+bool PerfMarkerFileReader::Summarize(map<unsigned int, PerfMarkerDurationSummary>& summaries, PerfMarkerSectionCounts& counts, size_t maxThreads, const char* szGroupByArg)
+{
+    vector<PerfMarkerStatisticsList*> statistics(m_sections.size(), nullptr);
+    vector<vector<unsigned long long> > selfNanos(m_sections.size());
+    vector<PerfMarkerSectionCounts> sectionCounts(m_sections.size());
+    vector<char> succeeded(m_sections.size(), 0);
+
+    RunPerfMarkerTasks(m_sections.size(), [&](size_t i)
+    {
+        PerfMarkerStatisticsList* pList = new PerfMarkerStatisticsList;
+        vector<unsigned long long>& self = selfNanos[i];
+        bool outOfMemory = false;
+        unsigned int groupByArgHandle = 0;
+        PerfMarkerTableCache markerTableCache;
+
+        statistics[i] = pList;
+        succeeded[i] = ReadSection(i, [this, pList, &self, &outOfMemory, szGroupByArg, &groupByArgHandle, &markerTableCache](const PerfMarkerInstance& instance)
+        {
+            unsigned int markerHandle = instance.m_markerHandle;
+
+            if (szGroupByArg != nullptr && instance.m_numArgs != 0)
+            {
+                markerHandle = GetGroupByArgHandle(instance, szGroupByArg, groupByArgHandle, markerTableCache);
+            }
+
+            PerfMarkerStatistics* pStatistics = markerHandle != 0 ? pList->Get(markerHandle) : nullptr;
+
+            if (pStatistics == nullptr)
+            {
+                outOfMemory = true;
+                return;
+            }
+
+            if (self.size() < markerHandle)
+            {
+                self.resize(markerHandle, 0);
+            }
+
+            pStatistics->Add(instance.m_endNanos > instance.m_beginNanos ? instance.m_endNanos - instance.m_beginNanos : 0);
+            self[markerHandle - 1] += instance.m_selfNanos;
+        }, sectionCounts[i]) && !outOfMemory;
+    }, maxThreads);
+
+    bool retVal = true;
+
+    counts.m_numSkipped = 0;
+    counts.m_numDropped = 0;
+    counts.m_numUnbalanced = 0;
+
+    for (size_t i = 0; i < m_sections.size(); i++)
+    {
+        for (const PerfMarkerStatistics* pStatistics = statistics[i]->GetFirst(); pStatistics != nullptr; pStatistics = pStatistics->m_pNext)
+        {
+            PerfMarkerDurationSummary& summary = summaries[pStatistics->m_markerHandle];
+            summary.m_statistics.Merge(*pStatistics);
+            summary.m_selfNanos += selfNanos[i][pStatistics->m_markerHandle - 1];
+        }
+
+        counts.m_numSkipped += sectionCounts[i].m_numSkipped;
+        counts.m_numDropped += sectionCounts[i].m_numDropped;
+        counts.m_numUnbalanced += sectionCounts[i].m_numUnbalanced;
+        retVal &= succeeded[i] != 0;
+        delete statistics[i];
+    }
+
+    return retVal;
+}
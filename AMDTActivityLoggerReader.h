@@ -0,0 +1,197 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Reads perf marker files, in the text or the binary layout, and
+///        reconstructs and summarizes the markers of their threads
+//==============================================================================
+
+#ifndef _AMDT_ACTIVITY_LOGGER_READER_H_
+#define _AMDT_ACTIVITY_LOGGER_READER_H_
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "AMDTBaseTools/Include/AMDTDefinitions.h"
+
+#include "AMDTActivityLoggerBinaryFormat.h"
+#include "AMDTActivityLoggerMarkerArgs.h"
+#include "AMDTActivityLoggerMarkerTable.h"
+#include "AMDTActivityLoggerStatistics.h"
+
+/// Read-only memory mapping of a file
+class PerfMarkerMappedFile
+{
+public:
+    /// Constructor
+    PerfMarkerMappedFile();
+
+    /// Destructor
+    ~PerfMarkerMappedFile();
+
+    /// Maps a file
+    /// \param szFileName the name of the file
+    /// \return false if the file could not be opened or mapped
+    bool Open(const char* szFileName);
+
+    /// Unmaps the file
+    void Close();
+
+    /// Gets the contents of the file
+    /// \return the contents, nullptr if no file is mapped or if it is empty
+    const char* GetData() const { return m_pData; }
+
+    /// Gets the size of the file
+    /// \return the size in bytes
+    size_t GetSize() const { return m_size; }
+
+private:
+    /// Disabled copy contructor
+    PerfMarkerMappedFile(const PerfMarkerMappedFile& obj);
+
+    /// Disabled assignment operator
+    PerfMarkerMappedFile& operator = (const PerfMarkerMappedFile& obj);
+
+    const char* m_pData;    ///< the mapped contents of the file
+    size_t m_size;          ///< the size of the file
+#if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
+    void* m_hFile;          ///< the handle of the file
+    void* m_hMapping;       ///< the handle of the file mapping
+#endif
+};
+
+/// A marker instance reconstructed from the begin and end events of a thread
+struct PerfMarkerInstance
+{
+    unsigned int m_markerHandle;        ///< the handle of the marker in the reader's marker table, the name given at the end replaces the name given at the begin
+    unsigned int m_depth;               ///< the number of markers enclosing the marker
+    unsigned long long m_beginNanos;    ///< the timestamp of the begin
+    unsigned long long m_endNanos;      ///< the timestamp of the end
+    unsigned long long m_selfNanos;     ///< the duration minus the durations of the markers directly nested in the marker
+    const PerfMarkerArg* m_pArgs;       ///< the arguments passed to amdtBeginMarkerArgs, only valid during the callback, their names and string values are in the reader's marker table
+    size_t m_numArgs;                   ///< the number of arguments
+};
+
+/// Counts of a thread's events which are not complete marker instances
+struct PerfMarkerSectionCounts
+{
+    unsigned long long m_numSkipped;    ///< number of instances not recorded because of sampling
+    unsigned long long m_numDropped;    ///< number of instances dropped because the memory budget was exceeded
+    unsigned long long m_numUnbalanced; ///< number of begins without an end and of ends without a begin
+};
+
+/// Summary of the durations of a marker over all the threads of a file
+struct PerfMarkerDurationSummary
+{
+    /// Constructor
+    PerfMarkerDurationSummary() { m_selfNanos = 0; }
+
+    PerfMarkerStatisticsSummary m_statistics;   ///< the count, total, minimum, maximum and histogram of the durations
+    unsigned long long m_selfNanos;             ///< the sum of the self times of the instances
+};
+
+/// Reader of a memory mapped perf marker file.
+/// Open locates the sections of the threads, in the text layout by counting the lines of each section,
+/// so that the sections can then be read concurrently.
+class PerfMarkerFileReader
+{
+public:
+    /// Constructor
+    PerfMarkerFileReader();
+
+    /// Maps a perf marker file and locates its sections
+    /// \param szFileName the name of the file
+    /// \return false if the file could not be mapped or is malformed
+    bool Open(const char* szFileName);
+
+    /// Gets the size of the file
+    /// \return the size in bytes
+    size_t GetFileSize() const { return m_file.GetSize(); }
+
+    /// Gets the number of sections of the file, one per thread
+    /// \return the number of sections
+    size_t GetNumSections() const { return m_sections.size(); }
+
+    /// Gets the thread id of a section
+    /// \param section the index of the section
+    /// \return the thread id, in its text form
+    const std::string& GetThreadId(size_t section) const { return m_sections[section].m_threadId; }
+
+    /// Gets the table of the markers read so far
+    /// \return the table
+    PerfMarkerTable& GetMarkerTable() { return m_markerTable; }
+
+    /// Reads the markers of a section, can be called concurrently for different sections
+    /// \param section the index of the section
+    /// \param callback the function called with each marker instance, in the order of the ends
+    /// \param[out] counts the counts of the events which are not complete marker instances
+    /// \return false if the section is malformed
+    bool ReadSection(size_t section, const std::function<void(const PerfMarkerInstance&)>& callback, PerfMarkerSectionCounts& counts);
+
+    /// Reads all the sections concurrently and summarizes the durations of the markers
+    /// \param[out] summaries the summaries keyed by marker handle
+    /// \param[out] counts the counts of the events which are not complete marker instances, over all the sections
+    /// \param maxThreads the maximum number of threads reading sections, 0 to use the number of hardware threads
+    /// \param szGroupByArg the name of an argument to summarize the instances of a marker separately for each value of the argument,
+    ///        nullptr to summarize all the instances of a marker together. The instances with a value are summarized under the
+    ///        marker "name[argument=value]" of the same group, registered in the reader's marker table.
+    /// \return false if a section is malformed
+    bool Summarize(std::map<unsigned int, PerfMarkerDurationSummary>& summaries, PerfMarkerSectionCounts& counts, size_t maxThreads = 0, const char* szGroupByArg = nullptr);
+
+private:
+    /// Disabled copy contructor
+    PerfMarkerFileReader(const PerfMarkerFileReader& obj);
+
+    /// Disabled assignment operator
+    PerfMarkerFileReader& operator = (const PerfMarkerFileReader& obj);
+
+    /// A thread's section of the file
+    struct Section
+    {
+        std::string m_threadId;         ///< the thread id
+        size_t m_begin;                 ///< offset of the first marker line, or of the events in the binary layout
+        size_t m_end;                   ///< offset after the last marker line, or after the events in the binary layout
+        size_t m_firstChunk;            ///< index in m_chunks of the first chunk of the section, in the binary layout
+        size_t m_endChunk;              ///< index in m_chunks after the last chunk of the section, in the binary layout
+    };
+
+    /// Locates the sections of a file in the text layout
+    /// \return false if the file is malformed
+    bool LocateTextSections();
+
+    /// Locates the sections of a file in the binary layout and registers its markers
+    /// \return false if the file is malformed
+    bool LocateBinarySections();
+
+    /// Reads the markers of a section in the text layout
+    /// \param section the section
+    /// \param callback the function called with each marker instance
+    /// \param[out] counts the counts of the events which are not complete marker instances
+    /// \return false if the section is malformed
+    bool ReadTextSection(const Section& section, const std::function<void(const PerfMarkerInstance&)>& callback, PerfMarkerSectionCounts& counts);
+
+    /// Reads the markers of a section in the binary layout
+    /// \param section the section
+    /// \param callback the function called with each marker instance
+    /// \param[out] counts the counts of the events which are not complete marker instances
+    /// \return false if the section is malformed
+    bool ReadBinarySection(const Section& section, const std::function<void(const PerfMarkerInstance&)>& callback, PerfMarkerSectionCounts& counts);
+
+    /// Gets the handle under which an instance is summarized when the instances are summarized by the values of an argument
+    /// \param instance the marker instance
+    /// \param szGroupByArg the name of the argument
+    /// \param[in,out] groupByArgHandle the handle of the argument name, 0 until an instance with the argument is found
+    /// \param markerTableCache the cache of the handles of the reader's marker table
+    /// \return the handle of the marker "name[argument=value]", the handle of the instance's marker if it does not have the argument, 0 if out of memory
+    unsigned int GetGroupByArgHandle(const PerfMarkerInstance& instance, const char* szGroupByArg, unsigned int& groupByArgHandle, PerfMarkerTableCache& markerTableCache);
+
+    PerfMarkerMappedFile m_file;                        ///< the mapped file
+    bool m_isBinary;                                    ///< flag indicating if the file is in the binary layout
+    std::vector<Section> m_sections;                    ///< the sections of the file
+    std::vector<PerfMarkerBinaryIndexEntry> m_chunks;   ///< the index of the chunks, in the binary layout
+    PerfMarkerTable m_markerTable;                      ///< the markers of the file, registered as they are read in the text layout
+};
+
+#endif // _AMDT_ACTIVITY_LOGGER_READER_H_
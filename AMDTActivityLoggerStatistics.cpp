@@ -0,0 +1,253 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Per-thread aggregated statistics of the marker durations
+//==============================================================================
+
+#include <fstream>
+#include <iomanip>
+#include <new>
+
+#include "AMDTActivityLoggerStatistics.h"
+
+using namespace std;
+
+const size_t s_MARKER_NAME_WIDTH = 50;  ///< width of the marker name column of the statistics file
+const size_t s_COLUMN_WIDTH = 20;       ///< width of the other columns of the statistics file
+
+unsigned long long PerfMarkerHistogramBuckets::GetLowerBound(unsigned int index)
+{
+    if (index < s_NUM_SUB_BUCKETS)
+    {
+        return index;
+    }
+
+    unsigned int msb = index / s_NUM_SUB_BUCKETS + s_SUB_BUCKET_BITS - 1;
+    unsigned long long subBucket = index % s_NUM_SUB_BUCKETS + s_NUM_SUB_BUCKETS;
+    return subBucket << (msb - s_SUB_BUCKET_BITS);
+}
+
+unsigned long long PerfMarkerHistogramBuckets::GetUpperBound(unsigned int index)
+{
+    if (index < s_NUM_SUB_BUCKETS)
+    {
+        return index;
+    }
+
+    unsigned int msb = index / s_NUM_SUB_BUCKETS + s_SUB_BUCKET_BITS - 1;
+    return GetLowerBound(index) + ((1ULL << (msb - s_SUB_BUCKET_BITS)) - 1);
+}
+
+PerfMarkerStatistics::PerfMarkerStatistics(unsigned int markerHandle)
+{
+    m_markerHandle = markerHandle;
+    m_count = 0;
+    m_totalNanos = 0;
+    m_minNanos = ~0ULL;
+    m_maxNanos = 0;
+    m_pNext = nullptr;
+
+    for (unsigned int i = 0; i < PerfMarkerHistogramBuckets::s_NUM_RANGES; i++)
+    {
+        m_pRanges[i].store(nullptr, memory_order_relaxed);
+    }
+}
+
+PerfMarkerStatistics::~PerfMarkerStatistics()
+{
+    for (unsigned int i = 0; i < PerfMarkerHistogramBuckets::s_NUM_RANGES; i++)
+    {
+        delete[] m_pRanges[i].load(memory_order_relaxed);
+    }
+}
+
+atomic<unsigned long long>* PerfMarkerStatistics::AddRange(unsigned int range)
+{
+    atomic<unsigned long long>* pRange = new(nothrow) atomic<unsigned long long>[PerfMarkerHistogramBuckets::s_NUM_SUB_BUCKETS];
+
+    if (pRange == nullptr)
+    {
+        return nullptr;
+    }
+
+    for (unsigned int i = 0; i < PerfMarkerHistogramBuckets::s_NUM_SUB_BUCKETS; i++)
+    {
+        pRange[i].store(0, memory_order_relaxed);
+    }
+
+    m_pRanges[range].store(pRange, memory_order_release);
+
+    return pRange;
+}
+
+PerfMarkerStatisticsList::PerfMarkerStatisticsList()
+{
+    m_pFirst = nullptr;
+}
+
+PerfMarkerStatisticsList::~PerfMarkerStatisticsList()
+{
+    PerfMarkerStatistics* pStatistics = m_pFirst.load();
+
+    while (pStatistics != nullptr)
+    {
+        PerfMarkerStatistics* pNext = pStatistics->m_pNext;
+        delete pStatistics;
+        pStatistics = pNext;
+    }
+}
+
+PerfMarkerStatistics* PerfMarkerStatisticsList::Add(unsigned int markerHandle)
+{
+    PerfMarkerStatistics* pStatistics = new(nothrow) PerfMarkerStatistics(markerHandle);
+
+    if (pStatistics == nullptr)
+    {
+        return nullptr;
+    }
+
+    if (m_index.size() < markerHandle)
+    {
+        m_index.resize(markerHandle, nullptr);
+    }
+
+    m_index[markerHandle - 1] = pStatistics;
+
+    // only the owning thread adds statistics, readers see the list from the published head
+    pStatistics->m_pNext = m_pFirst.load(memory_order_relaxed);
+    m_pFirst.store(pStatistics, memory_order_release);
+
+    return pStatistics;
+}
+
+PerfMarkerStatisticsSummary::PerfMarkerStatisticsSummary()
+{
+    m_count = 0;
+    m_totalNanos = 0;
+    m_minNanos = ~0ULL;
+    m_maxNanos = 0;
+}
+
+void PerfMarkerStatisticsSummary::Merge(const PerfMarkerStatistics& statistics)
+{
+    m_count += statistics.m_count.load(memory_order_relaxed);
+    m_totalNanos += statistics.m_totalNanos.load(memory_order_relaxed);
+
+    unsigned long long minNanos = statistics.m_minNanos.load(memory_order_relaxed);
+    unsigned long long maxNanos = statistics.m_maxNanos.load(memory_order_relaxed);
+
+    if (minNanos < m_minNanos)
+    {
+        m_minNanos = minNanos;
+    }
+
+    if (maxNanos > m_maxNanos)
+    {
+        m_maxNanos = maxNanos;
+    }
+
+    for (unsigned int range = 0; range < PerfMarkerHistogramBuckets::s_NUM_RANGES; range++)
+    {
+        const atomic<unsigned long long>* pRange = statistics.GetRange(range);
+
+        if (pRange == nullptr)
+        {
+            continue;
+        }
+
+        for (unsigned int i = 0; i < PerfMarkerHistogramBuckets::s_NUM_SUB_BUCKETS; i++)
+        {
+            unsigned long long count = pRange[i].load(memory_order_relaxed);
+
+            if (count != 0)
+            {
+                m_buckets[range * PerfMarkerHistogramBuckets::s_NUM_SUB_BUCKETS + i] += count;
+            }
+        }
+    }
+}
+
+unsigned long long PerfMarkerStatisticsSummary::GetPercentile(double fraction) const
+{
+    unsigned long long numBucketed = 0;
+
+    for (map<unsigned int, unsigned long long>::const_iterator it = m_buckets.begin(); it != m_buckets.end(); ++it)
+    {
+        numBucketed += it->second;
+    }
+
+    if (numBucketed == 0)
+    {
+        return 0;
+    }
+
+    // rank of the percentile among the durations, starting at 1
+    unsigned long long rank = static_cast<unsigned long long>(fraction * numBucketed + 0.5);
+    rank = rank < 1 ? 1 : (rank > numBucketed ? numBucketed : rank);
+
+    unsigned long long numBelow = 0;
+
+    for (map<unsigned int, unsigned long long>::const_iterator it = m_buckets.begin(); it != m_buckets.end(); ++it)
+    {
+        numBelow += it->second;
+
+        if (numBelow >= rank)
+        {
+            unsigned long long lower = PerfMarkerHistogramBuckets::GetLowerBound(it->first);
+            unsigned long long nanos = lower + (PerfMarkerHistogramBuckets::GetUpperBound(it->first) - lower) / 2;
+            nanos = nanos < m_minNanos ? m_minNanos : nanos;
+            return nanos > m_maxNanos ? m_maxNanos : nanos;
+        }
+    }
+
+    return m_maxNanos;
+}
+
+void MergePerfMarkerStatistics(const PerfMarkerStatisticsList& list, map<unsigned int, PerfMarkerStatisticsSummary>& summaries)
+{
+    for (const PerfMarkerStatistics* pStatistics = list.GetFirst(); pStatistics != nullptr; pStatistics = pStatistics->m_pNext)
+    {
+        summaries[pStatistics->m_markerHandle].Merge(*pStatistics);
+    }
+}
+
+bool WritePerfMarkerStatisticsFile(const char* szFileName, const map<unsigned int, PerfMarkerStatisticsSummary>& summaries, const PerfMarkerTable& markerTable)
+{
+    ofstream fout(szFileName);
+
+    if (fout.fail())
+    {
+        return false;
+    }
+
+    fout << "=====PerfMarker Statistics=====" << endl;
+    fout << summaries.size() << endl;
+    fout << left << setw(s_MARKER_NAME_WIDTH) << "MarkerName" << "   " << setw(s_MARKER_NAME_WIDTH) << "GroupName";
+    fout << setw(s_COLUMN_WIDTH) << "Count" << setw(s_COLUMN_WIDTH) << "TotalNs" << setw(s_COLUMN_WIDTH) << "MinNs" << setw(s_COLUMN_WIDTH) << "MaxNs";
+    fout << setw(s_COLUMN_WIDTH) << "MeanNs" << setw(s_COLUMN_WIDTH) << "P50Ns" << setw(s_COLUMN_WIDTH) << "P90Ns" << setw(s_COLUMN_WIDTH) << "P99Ns" << endl;
+
+    for (map<unsigned int, PerfMarkerStatisticsSummary>::const_iterator it = summaries.begin(); it != summaries.end(); ++it)
+    {
+        const PerfMarkerInfo& info = markerTable.Get(it->first);
+        const PerfMarkerStatisticsSummary& summary = it->second;
+        unsigned long long meanNanos = summary.m_count == 0 ? 0 : summary.m_totalNanos / summary.m_count;
+        unsigned long long minNanos = summary.m_count == 0 ? 0 : summary.m_minNanos;
+        // names are escaped so that each column is a single word
+        fout << setw(s_MARKER_NAME_WIDTH) << info.m_escapedMarkerName << "   " << setw(s_MARKER_NAME_WIDTH) << info.m_escapedGroupName;
+        fout << setw(s_COLUMN_WIDTH) << summary.m_count << setw(s_COLUMN_WIDTH) << summary.m_totalNanos << setw(s_COLUMN_WIDTH) << minNanos << setw(s_COLUMN_WIDTH) << summary.m_maxNanos;
+        fout << setw(s_COLUMN_WIDTH) << meanNanos << setw(s_COLUMN_WIDTH) << summary.GetPercentile(0.5) << setw(s_COLUMN_WIDTH) << summary.GetPercentile(0.9) << setw(s_COLUMN_WIDTH) << summary.GetPercentile(0.99) << endl;
+
+        // histogram: number of non-empty buckets, then the bounds and count of each of them
+        fout << "   Histogram   " << summary.m_buckets.size() << endl;
+
+        for (map<unsigned int, unsigned long long>::const_iterator bucket = summary.m_buckets.begin(); bucket != summary.m_buckets.end(); ++bucket)
+        {
+            fout << "   " << setw(s_COLUMN_WIDTH) << PerfMarkerHistogramBuckets::GetLowerBound(bucket->first) << setw(s_COLUMN_WIDTH) << PerfMarkerHistogramBuckets::GetUpperBound(bucket->first) << bucket->second << endl;
+        }
+    }
+
+    fout.close();
+
+    return !fout.fail();
+}
@@ -0,0 +1,237 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Per-thread aggregated statistics of the marker durations
+//==============================================================================
+
+#ifndef _AMDT_ACTIVITY_LOGGER_STATISTICS_H_
+#define _AMDT_ACTIVITY_LOGGER_STATISTICS_H_
+
+#include <atomic>
+#include <map>
+#include <vector>
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
+#include "AMDTActivityLoggerMarkerTable.h"
+
+/// Log-linear histogram buckets of durations in nanoseconds.
+/// Durations below s_NUM_SUB_BUCKETS have their own bucket; above, each power of two range is split
+/// into s_NUM_SUB_BUCKETS buckets of equal width, so a bucket's width is at most 1/16 of its values.
+class PerfMarkerHistogramBuckets
+{
+public:
+    static const unsigned int s_SUB_BUCKET_BITS = 4;                                   ///< log2 of the number of buckets per power of two
+    static const unsigned int s_NUM_SUB_BUCKETS = 1 << s_SUB_BUCKET_BITS;              ///< number of buckets per power of two
+    static const unsigned int s_NUM_RANGES = 64 - s_SUB_BUCKET_BITS + 1;               ///< number of ranges of s_NUM_SUB_BUCKETS buckets covering all 64-bit durations
+    static const unsigned int s_NUM_BUCKETS = s_NUM_RANGES * s_NUM_SUB_BUCKETS;        ///< number of buckets covering all 64-bit durations
+
+    /// Gets the bucket of a duration
+    /// \param nanos the duration in nanoseconds
+    /// \return the index of the bucket
+    static unsigned int GetIndex(unsigned long long nanos)
+    {
+        if (nanos < s_NUM_SUB_BUCKETS)
+        {
+            return static_cast<unsigned int>(nanos);
+        }
+
+        unsigned int msb = GetMostSignificantBit(nanos);
+        unsigned int shift = msb - s_SUB_BUCKET_BITS;
+        return (msb - s_SUB_BUCKET_BITS + 1) * s_NUM_SUB_BUCKETS + static_cast<unsigned int>(nanos >> shift) - s_NUM_SUB_BUCKETS;
+    }
+
+    /// Gets the smallest duration of a bucket
+    /// \param index the index of the bucket
+    /// \return the duration in nanoseconds
+    static unsigned long long GetLowerBound(unsigned int index);
+
+    /// Gets the largest duration of a bucket
+    /// \param index the index of the bucket
+    /// \return the duration in nanoseconds
+    static unsigned long long GetUpperBound(unsigned int index);
+
+private:
+    /// Gets the index of the most significant bit set in a value
+    /// \param value the value, must not be 0
+    /// \return the index of the bit
+    static unsigned int GetMostSignificantBit(unsigned long long value)
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanReverse64(&index, value);
+        return static_cast<unsigned int>(index);
+#elif defined(_MSC_VER)
+        unsigned long index;
+
+        if (_BitScanReverse(&index, static_cast<unsigned long>(value >> 32)))
+        {
+            return static_cast<unsigned int>(index) + 32;
+        }
+
+        _BitScanReverse(&index, static_cast<unsigned long>(value));
+        return static_cast<unsigned int>(index);
+#else
+        return 63 - static_cast<unsigned int>(__builtin_clzll(value));
+#endif
+    }
+};
+
+/// Statistics of the durations of a marker recorded by one thread.
+/// Only the owning thread updates them, with plain loads and stores of the atomic fields, so that
+/// other threads can read consistent values at any time without locks or atomic read-modify-writes.
+/// The histogram buckets are allocated one range at a time, when a duration first falls in the range,
+/// since the durations of a marker usually span a few powers of two.
+class PerfMarkerStatistics
+{
+public:
+    /// Constructor
+    /// \param markerHandle the handle of the marker in the PerfMarkerTable
+    PerfMarkerStatistics(unsigned int markerHandle);
+
+    /// Destructor
+    ~PerfMarkerStatistics();
+
+    /// Adds a duration, called by the owning thread only
+    /// \param nanos the duration in nanoseconds
+    void Add(unsigned long long nanos)
+    {
+        m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_totalNanos.store(m_totalNanos.load(std::memory_order_relaxed) + nanos, std::memory_order_relaxed);
+
+        if (nanos < m_minNanos.load(std::memory_order_relaxed))
+        {
+            m_minNanos.store(nanos, std::memory_order_relaxed);
+        }
+
+        if (nanos > m_maxNanos.load(std::memory_order_relaxed))
+        {
+            m_maxNanos.store(nanos, std::memory_order_relaxed);
+        }
+
+        unsigned int index = PerfMarkerHistogramBuckets::GetIndex(nanos);
+        std::atomic<unsigned long long>* pRange = m_pRanges[index / PerfMarkerHistogramBuckets::s_NUM_SUB_BUCKETS].load(std::memory_order_relaxed);
+
+        if (pRange == nullptr)
+        {
+            // the duration is counted but not bucketed if the range could not be allocated
+            pRange = AddRange(index / PerfMarkerHistogramBuckets::s_NUM_SUB_BUCKETS);
+        }
+
+        if (pRange != nullptr)
+        {
+            std::atomic<unsigned long long>& bucket = pRange[index % PerfMarkerHistogramBuckets::s_NUM_SUB_BUCKETS];
+            bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    /// Gets the buckets of a range, to read them from any thread
+    /// \param range the index of the range
+    /// \return the s_NUM_SUB_BUCKETS buckets of the range, nullptr if no duration has fallen in the range
+    const std::atomic<unsigned long long>* GetRange(unsigned int range) const { return m_pRanges[range].load(std::memory_order_acquire); }
+
+    unsigned int m_markerHandle;                                                    ///< the handle of the marker
+    std::atomic<unsigned long long> m_count;                                        ///< number of durations
+    std::atomic<unsigned long long> m_totalNanos;                                   ///< sum of the durations
+    std::atomic<unsigned long long> m_minNanos;                                     ///< shortest duration
+    std::atomic<unsigned long long> m_maxNanos;                                     ///< longest duration
+    PerfMarkerStatistics* m_pNext;                                                  ///< the statistics of the next marker of the thread
+
+private:
+    /// Disabled copy contructor
+    PerfMarkerStatistics(const PerfMarkerStatistics& obj);
+
+    /// Disabled assignment operator
+    PerfMarkerStatistics& operator = (const PerfMarkerStatistics& obj);
+
+    /// Allocates the buckets of a range and publishes them to the readers
+    /// \param range the index of the range
+    /// \return the buckets of the range, nullptr if they could not be allocated
+    std::atomic<unsigned long long>* AddRange(unsigned int range);
+
+    std::atomic<std::atomic<unsigned long long>*> m_pRanges[PerfMarkerHistogramBuckets::s_NUM_RANGES]; ///< number of durations in each histogram bucket, by range
+};
+
+/// The statistics of all the markers of a thread
+class PerfMarkerStatisticsList
+{
+public:
+    /// Constructor
+    PerfMarkerStatisticsList();
+
+    /// Destructor
+    ~PerfMarkerStatisticsList();
+
+    /// Gets the statistics of a marker, called by the owning thread only.
+    /// The statistics of a marker are allocated the first time the thread uses the marker.
+    /// \param markerHandle the handle of the marker
+    /// \return the statistics, nullptr if they could not be allocated
+    PerfMarkerStatistics* Get(unsigned int markerHandle)
+    {
+        if (markerHandle <= m_index.size() && m_index[markerHandle - 1] != nullptr)
+        {
+            return m_index[markerHandle - 1];
+        }
+
+        return Add(markerHandle);
+    }
+
+    /// Gets the statistics of the first marker, to read the statistics from any thread
+    /// \return the statistics, nullptr if the thread has not used any marker
+    const PerfMarkerStatistics* GetFirst() const { return m_pFirst.load(std::memory_order_acquire); }
+
+private:
+    /// Disabled copy contructor
+    PerfMarkerStatisticsList(const PerfMarkerStatisticsList& obj);
+
+    /// Disabled assignment operator
+    PerfMarkerStatisticsList& operator = (const PerfMarkerStatisticsList& obj);
+
+    /// Allocates the statistics of a marker and publishes them to the readers
+    /// \param markerHandle the handle of the marker
+    /// \return the statistics, nullptr if they could not be allocated
+    PerfMarkerStatistics* Add(unsigned int markerHandle);
+
+    std::vector<PerfMarkerStatistics*> m_index;        ///< the statistics of the markers indexed by marker handle - 1, only used by the owning thread
+    std::atomic<PerfMarkerStatistics*> m_pFirst;       ///< the list of the statistics of the markers, the most recently used marker first
+};
+
+/// Statistics of a marker merged from the statistics of several threads
+class PerfMarkerStatisticsSummary
+{
+public:
+    /// Constructor
+    PerfMarkerStatisticsSummary();
+
+    /// Adds the statistics of a thread
+    /// \param statistics the statistics of the thread
+    void Merge(const PerfMarkerStatistics& statistics);
+
+    /// Gets the estimated duration below which a fraction of the durations fall
+    /// \param fraction the fraction, between 0 and 1
+    /// \return the duration in nanoseconds, the midpoint of the bucket holding the percentile
+    unsigned long long GetPercentile(double fraction) const;
+
+    unsigned long long m_count;                 ///< number of durations
+    unsigned long long m_totalNanos;            ///< sum of the durations
+    unsigned long long m_minNanos;              ///< shortest duration
+    unsigned long long m_maxNanos;              ///< longest duration
+    std::map<unsigned int, unsigned long long> m_buckets;  ///< number of durations in each non-empty histogram bucket
+};
+
+/// Merges the statistics of a thread into summaries keyed by marker handle
+/// \param list the statistics of the thread
+/// \param[in,out] summaries the summaries
+void MergePerfMarkerStatistics(const PerfMarkerStatisticsList& list, std::map<unsigned int, PerfMarkerStatisticsSummary>& summaries);
+
+/// Writes the summaries of the markers to a text file
+/// \param szFileName the name of the file
+/// \param summaries the summaries keyed by marker handle
+/// \param markerTable the table holding the names of the markers
+/// \return true on success
+bool WritePerfMarkerStatisticsFile(const char* szFileName, const std::map<unsigned int, PerfMarkerStatisticsSummary>& summaries, const PerfMarkerTable& markerTable);
+
+#endif // _AMDT_ACTIVITY_LOGGER_STATISTICS_H_
@@ -0,0 +1,94 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Prints the per-marker summaries of a .amdtperfmarker file
+//==============================================================================
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "AMDTActivityLoggerReader.h"
+
+using namespace std;
+
+const size_t s_MARKER_NAME_WIDTH = 50;  ///< width of the marker and group name columns
+const size_t s_COLUMN_WIDTH = 16;       ///< width of the other columns
+
+/// Helper function to order summaries by decreasing total duration
+/// \param a the first summary
+/// \param b the second summary
+/// \return true if a comes before b
+static bool CompareTotalNanos(const pair<unsigned int, const PerfMarkerDurationSummary*>& a, const pair<unsigned int, const PerfMarkerDurationSummary*>& b)
+{
+    return a.second->m_statistics.m_totalNanos > b.second->m_statistics.m_totalNanos;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || argc > 4)
+    {
+        cerr << "Usage: " << argv[0] << " <.amdtperfmarker file> [number of threads, 0 for all [argument name to summarize by]]\n";
+        return 1;
+    }
+
+    size_t maxThreads = argc >= 3 ? static_cast<size_t>(strtoul(argv[2], nullptr, 10)) : 0;
+    const char* szGroupByArg = argc == 4 ? argv[3] : nullptr;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    PerfMarkerFileReader reader;
+
+    if (!reader.Open(argv[1]))
+    {
+        cerr << "Failed to read " << argv[1] << ", or it is not a .amdtperfmarker file\n";
+        return 1;
+    }
+
+    map<unsigned int, PerfMarkerDurationSummary> summaries;
+    PerfMarkerSectionCounts counts;
+
+    if (!reader.Summarize(summaries, counts, maxThreads, szGroupByArg))
+    {
+        cerr << argv[1] << " is truncated or malformed\n";
+        return 1;
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // the markers with the most time first
+    vector<pair<unsigned int, const PerfMarkerDurationSummary*> > sorted;
+
+    for (map<unsigned int, PerfMarkerDurationSummary>::const_iterator it = summaries.begin(); it != summaries.end(); ++it)
+    {
+        sorted.push_back(make_pair(it->first, &it->second));
+    }
+
+    stable_sort(sorted.begin(), sorted.end(), CompareTotalNanos);
+
+    cout << left << setw(s_MARKER_NAME_WIDTH) << "MarkerName" << "   " << setw(s_MARKER_NAME_WIDTH) << "GroupName";
+    cout << right << setw(s_COLUMN_WIDTH) << "Count" << setw(s_COLUMN_WIDTH) << "TotalNs" << setw(s_COLUMN_WIDTH) << "SelfNs" << setw(s_COLUMN_WIDTH) << "MinNs" << setw(s_COLUMN_WIDTH) << "MaxNs";
+    cout << setw(s_COLUMN_WIDTH) << "MeanNs" << setw(s_COLUMN_WIDTH) << "P50Ns" << setw(s_COLUMN_WIDTH) << "P90Ns" << setw(s_COLUMN_WIDTH) << "P99Ns" << '\n';
+
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        const PerfMarkerInfo& info = reader.GetMarkerTable().Get(sorted[i].first);
+        const PerfMarkerStatisticsSummary& statistics = sorted[i].second->m_statistics;
+
+        // the summary is read by people rather than parsed, the names keep their spaces
+        cout << left << setw(s_MARKER_NAME_WIDTH) << info.m_markerName << "   " << setw(s_MARKER_NAME_WIDTH) << info.m_groupName;
+        cout << right << setw(s_COLUMN_WIDTH) << statistics.m_count << setw(s_COLUMN_WIDTH) << statistics.m_totalNanos << setw(s_COLUMN_WIDTH) << sorted[i].second->m_selfNanos;
+        cout << setw(s_COLUMN_WIDTH) << statistics.m_minNanos << setw(s_COLUMN_WIDTH) << statistics.m_maxNanos << setw(s_COLUMN_WIDTH) << statistics.m_totalNanos / statistics.m_count;
+        cout << setw(s_COLUMN_WIDTH) << statistics.GetPercentile(0.5) << setw(s_COLUMN_WIDTH) << statistics.GetPercentile(0.9) << setw(s_COLUMN_WIDTH) << statistics.GetPercentile(0.99) << '\n';
+    }
+
+    cout << '\n' << reader.GetNumSections() << " threads, " << counts.m_numSkipped << " skipped, " << counts.m_numDropped << " dropped, " << counts.m_numUnbalanced << " unbalanced markers\n";
+
+    cerr << "Read " << reader.GetFileSize() << " bytes in " << fixed << setprecision(3) << seconds << " s ("
+         << (seconds > 0 ? reader.GetFileSize() / seconds / 1e9 : 0.0) << " GB/s)\n";
+
+    return 0;
+}
@@ -0,0 +1,837 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Writes perf marker events in the .amdtperfmarker text layout
+//==============================================================================
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "AMDTActivityLoggerTextWriter.h"
+#include "AMDTActivityLoggerUserString.h"
+#include "AMDTGPUProfilerDefs.h"
+
+using namespace std;
+
+const size_t s_DEFAULT_MARKER_NAME_WIDTH = 50; ///< default marker name width
+const size_t s_COLUMN_WIDTH = 20;              ///< width of the event type and timestamp columns
+const size_t s_SEPARATOR_LENGTH = 3;           ///< length of the separator between unpadded columns
+const size_t s_OUTPUT_BUFFER_SIZE = 256 * 1024; ///< size of the buffer the lines of a list of chunks are formatted into
+
+/// Helper function to get the number of decimal digits of a timestamp
+/// \param timestamp the timestamp
+/// \return the number of digits
+static size_t GetNumDigits(unsigned long long timestamp)
+{
+    size_t numDigits = 1;
+
+    while (timestamp >= 10)
+    {
+        timestamp /= 10;
+        numDigits++;
+    }
+
+    return numDigits;
+}
+
+/// Helper function to get the number of instances carried by a sampled begin, skipped or dropped event
+/// \param event the event
+/// \return the number of instances
+static unsigned long long GetEventCount(const PerfMarkerEvent& event)
+{
+    unsigned long long count;
+    memcpy(&count, event.GetPayload(), sizeof(count));
+    return count;
+}
+
+/// Helper function to format a decimal number
+/// \param[out] pBuffer the buffer receiving the digits, at least GetNumDigits(value) bytes
+/// \param value the number
+/// \return the end of the digits
+static char* FormatDecimal(char* pBuffer, unsigned long long value)
+{
+    static const char s_DIGIT_PAIRS[] =
+        "0001020304050607080910111213141516171819"
+        "2021222324252627282930313233343536373839"
+        "4041424344454647484950515253545556575859"
+        "6061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    // the digits are written from the end, two at a time
+    char* pEnd = pBuffer + GetNumDigits(value);
+    char* p = pEnd;
+
+    while (value >= 100)
+    {
+        const char* pPair = s_DIGIT_PAIRS + (value % 100) * 2;
+        value /= 100;
+        *--p = pPair[1];
+        *--p = pPair[0];
+    }
+
+    if (value >= 10)
+    {
+        *--p = s_DIGIT_PAIRS[value * 2 + 1];
+        *--p = s_DIGIT_PAIRS[value * 2];
+    }
+    else
+    {
+        *--p = static_cast<char>('0' + value);
+    }
+
+    return pEnd;
+}
+
+/// Helper function to append spaces
+/// \param p where to append the spaces
+/// \param numSpaces the number of spaces
+/// \return the end of the spaces
+static char* AppendSpaces(char* p, size_t numSpaces)
+{
+    memset(p, ' ', numSpaces);
+    return p + numSpaces;
+}
+
+/// Helper function to append a string padded to a column like os << left << setw(width) << str
+/// \param p where to append the string
+/// \param pStr the string
+/// \param length the length of the string
+/// \param width the width of the column
+/// \return the end of the column
+static char* AppendLeft(char* p, const char* pStr, size_t length, size_t width)
+{
+    memcpy(p, pStr, length);
+    return length < width ? AppendSpaces(p + length, width - length) : p + length;
+}
+
+/// Helper function to append a number padded to a column like os << setw(width) << value
+/// \param p where to append the number
+/// \param value the number
+/// \param width the width of the column
+/// \param isLeftAdjusted true if the stream being emulated has the left adjustment, false to pad the number on its left
+/// \return the end of the column
+static char* AppendDecimal(char* p, unsigned long long value, size_t width, bool isLeftAdjusted)
+{
+    size_t numDigits = GetNumDigits(value);
+
+    if (numDigits >= width)
+    {
+        return FormatDecimal(p, value);
+    }
+
+    if (isLeftAdjusted)
+    {
+        return AppendSpaces(FormatDecimal(p, value), width - numDigits);
+    }
+
+    return FormatDecimal(AppendSpaces(p, width - numDigits), value);
+}
+
+/// Helper function to append a string
+/// \param p where to append the string
+/// \param str the string
+/// \return the end of the string
+static char* AppendString(char* p, const string& str)
+{
+    memcpy(p, str.data(), str.length());
+    return p + str.length();
+}
+
+/// Helper function to append a string with its spaces replaced by AL_SPACE, like the names of the PerfMarkerTable
+/// \param p where to append the string
+/// \param szStr the string
+/// \return the end of the escaped string
+static char* AppendEscapedString(char* p, const char* szStr)
+{
+    const size_t escapeLength = strlen(AL_SPACE);
+
+    for (const char* pStr = szStr; *pStr != '\0'; pStr++)
+    {
+        if (*pStr == ' ')
+        {
+            memcpy(p, AL_SPACE, escapeLength);
+            p += escapeLength;
+        }
+        else
+        {
+            *p++ = *pStr;
+        }
+    }
+
+    return p;
+}
+
+/// Helper function to get the length of a string with its spaces replaced by AL_SPACE
+/// \param szStr the string
+/// \return the length of the escaped string
+static size_t GetEscapedStringLength(const char* szStr)
+{
+    size_t length = 0;
+
+    for (const char* pStr = szStr; *pStr != '\0'; pStr++)
+    {
+        length += *pStr == ' ' ? strlen(AL_SPACE) : 1;
+    }
+
+    return length;
+}
+
+/// Helper function to format a signed decimal number
+/// \param pBuffer the buffer receiving the number
+/// \param value the number
+/// \return the end of the number
+static char* FormatSignedDecimal(char* pBuffer, long long value)
+{
+    if (value < 0)
+    {
+        pBuffer[0] = '-';
+        return FormatDecimal(pBuffer + 1, 0ULL - static_cast<unsigned long long>(value));
+    }
+
+    return FormatDecimal(pBuffer, static_cast<unsigned long long>(value));
+}
+
+/// Helper function to format a double so that it reads back as the same value and cannot be taken for an integer
+/// \param pBuffer the buffer receiving the number, s_PERF_MARKER_COUNTER_VALUE_MAX_LENGTH bytes
+/// \param value the number
+/// \return the end of the number
+static char* FormatDouble(char* pBuffer, double value)
+{
+    // enough digits to read the same value back, at most 24 characters
+    size_t length = static_cast<size_t>(snprintf(pBuffer, s_PERF_MARKER_COUNTER_VALUE_MAX_LENGTH, "%.17g", value));
+
+    for (size_t i = 0; i < length; i++)
+    {
+        // the decimal point of the application's locale
+        if (pBuffer[i] == ',')
+        {
+            pBuffer[i] = '.';
+        }
+    }
+
+    // a double always has a decimal point, an exponent, or is inf or nan, to tell it from an integer
+    if (strpbrk(pBuffer, ".en") == nullptr)
+    {
+        pBuffer[length++] = '.';
+        pBuffer[length++] = '0';
+    }
+
+    return pBuffer + length;
+}
+
+/// Helper function to get the length of a column holding a name, padded to the marker name column or followed by a separator
+/// \param nameLength the length of the name
+/// \return the length of the column
+static size_t GetNameColumnLength(size_t nameLength)
+{
+    return nameLength < s_DEFAULT_MARKER_NAME_WIDTH ? s_DEFAULT_MARKER_NAME_WIDTH : nameLength + s_SEPARATOR_LENGTH;
+}
+
+/// Helper function to format the line of an argument of a marker: the tag, the argument name in the marker name column,
+/// the type padded to the timestamp column width and the value, the string values have their spaces escaped like the names
+/// \param p where to format the line
+/// \param event the PERF_MARKER_EVENT_ARGS event holding the string values
+/// \param arg the argument
+/// \param markerTable the table holding the interned argument names
+/// \return the end of the line
+static char* FormatArgLine(char* p, const PerfMarkerEvent& event, const PerfMarkerArg& arg, const PerfMarkerTable& markerTable)
+{
+    const string& name = markerTable.Get(arg.m_nameHandle).m_escapedMarkerName;
+    const char* szTypeName = GetPerfMarkerArgTypeName(arg.m_type);
+
+    p = AppendLeft(p, "clPerfMarkerArg", 15, s_COLUMN_WIDTH);
+    p = AppendLeft(p, name.data(), name.length(), GetNameColumnLength(name.length()));
+    p = AppendLeft(p, szTypeName, strlen(szTypeName), s_COLUMN_WIDTH);
+
+    if (arg.m_type == PERF_MARKER_ARG_STRING)
+    {
+        p = AppendEscapedString(p, GetPerfMarkerEventArgString(event, arg));
+    }
+    else
+    {
+        p += FormatPerfMarkerArgNumber(arg, p);
+    }
+
+    *p++ = '\n';
+    return p;
+}
+
+/// Helper function to format a line made of a tag, a marker name, a value and a group name, in the layout of clBeginPerfMarker
+/// \param p where to format the line
+/// \param szTag the tag of the line, at most 19 characters
+/// \param info the names of the marker
+/// \param value the value, the timestamp for clBeginPerfMarker
+/// \param[in,out] isLeftAdjusted the adjustment of the stream being emulated, the short layout sets the left adjustment
+/// \return the end of the line, before its newline
+static char* FormatMarkerLine(char* p, const char* szTag, const PerfMarkerInfo& info, unsigned long long value, bool& isLeftAdjusted)
+{
+    p = AppendLeft(p, szTag, strlen(szTag), s_COLUMN_WIDTH);
+
+    if (info.m_escapedMarkerName.length() < s_DEFAULT_MARKER_NAME_WIDTH)
+    {
+        p = AppendLeft(p, info.m_escapedMarkerName.data(), info.m_escapedMarkerName.length(), s_DEFAULT_MARKER_NAME_WIDTH);
+        p = AppendDecimal(p, value, s_COLUMN_WIDTH, true);
+        isLeftAdjusted = true;
+    }
+    else
+    {
+        // super long marker name -- the tag is padded without changing the adjustment of the stream
+        p = AppendString(p, info.m_escapedMarkerName);
+        p = AppendSpaces(p, s_SEPARATOR_LENGTH);
+        p = FormatDecimal(p, value);
+    }
+
+    p = AppendSpaces(p, s_SEPARATOR_LENGTH);
+    p = AppendString(p, info.m_escapedGroupName);
+    return p;
+}
+
+/// Helper function to format a line made of a tag and a number
+/// \param p where to format the line
+/// \param szTag the tag of the line, at most 19 characters
+/// \param value the number
+/// \return the end of the line
+static char* FormatValueLine(char* p, const char* szTag, unsigned long long value)
+{
+    p = AppendLeft(p, szTag, strlen(szTag), s_COLUMN_WIDTH);
+    p = AppendDecimal(p, value, s_COLUMN_WIDTH, true);
+    *p++ = '\n';
+    return p;
+}
+
+/// Helper function to format a perf marker event as lines of the .amdtperfmarker text output.
+/// The lines are the ones the stream operators used to write, including the padding of the timestamp
+/// of the long clEndPerfMarkerEx lines which depends on the adjustment left by the previous lines.
+/// \param p where to format the lines, at least GetMaxPerfMarkerEventTextLength bytes
+/// \param event the event
+/// \param markerTable the table holding the names of the event's marker
+/// \param[in,out] isLeftAdjusted the adjustment of the stream being emulated
+/// \return the end of the lines
+static char* FormatPerfMarkerEventText(char* p, const PerfMarkerEvent& event, const PerfMarkerTable& markerTable, bool& isLeftAdjusted)
+{
+    switch (event.m_type)
+    {
+        case PERF_MARKER_EVENT_BEGIN:
+            p = FormatMarkerLine(p, "clBeginPerfMarker", markerTable.Get(event.m_markerHandle), event.m_timestamp, isLeftAdjusted);
+            *p++ = '\n';
+            break;
+
+        case PERF_MARKER_EVENT_SAMPLED_BEGIN:
+            p = FormatMarkerLine(p, "clBeginPerfMarker", markerTable.Get(event.m_markerHandle), event.m_timestamp, isLeftAdjusted);
+            *p++ = '\n';
+            p = FormatValueLine(p, "clPerfMarkerSamples", GetEventCount(event));
+            isLeftAdjusted = true;
+            break;
+
+        case PERF_MARKER_EVENT_SKIPPED:
+            p = FormatMarkerLine(p, "clPerfMarkerSkipped", markerTable.Get(event.m_markerHandle), GetEventCount(event), isLeftAdjusted);
+            *p++ = '\n';
+            break;
+
+        case PERF_MARKER_EVENT_COUNTER:
+        case PERF_MARKER_EVENT_COUNTER_DOUBLE:
+            // the layout of clBeginPerfMarker followed by the value
+            p = FormatMarkerLine(p, "clPerfMarkerCounter", markerTable.Get(event.m_markerHandle), event.m_timestamp, isLeftAdjusted);
+            p = AppendSpaces(p, s_SEPARATOR_LENGTH);
+            p += FormatPerfMarkerCounterValue(event, p);
+            *p++ = '\n';
+            break;
+
+        case PERF_MARKER_EVENT_ARGS:
+        {
+            // the lines follow the lines of the begin the arguments were passed with
+            size_t numArgs;
+            const PerfMarkerArg* pArgs = GetPerfMarkerEventArgs(event, numArgs);
+
+            for (size_t i = 0; i < numArgs; i++)
+            {
+                p = FormatArgLine(p, event, pArgs[i], markerTable);
+            }
+
+            isLeftAdjusted = true;
+            break;
+        }
+
+        case PERF_MARKER_EVENT_INSTANT:
+            p = FormatMarkerLine(p, "clPerfMarkerInstant", markerTable.Get(event.m_markerHandle), event.m_timestamp, isLeftAdjusted);
+            *p++ = '\n';
+            break;
+
+        case PERF_MARKER_EVENT_USER_STRING:
+        {
+            // the user string is only parsed now, the lines follow the lines of the begin or end it was passed to
+            PerfMarkerUserString userString;
+            size_t length;
+            const char* pUserString = GetPerfMarkerEventUserString(event, length);
+
+            if (ParsePerfMarkerUserString(pUserString, length, userString))
+            {
+                if (!userString.m_color.empty())
+                {
+                    p = AppendLeft(p, "clPerfMarkerColor", 17, s_COLUMN_WIDTH);
+                    p = AppendString(p, userString.m_color);
+                    *p++ = '\n';
+                }
+
+                if (!userString.m_comment.empty())
+                {
+                    p = AppendLeft(p, "clPerfMarkerComment", 19, s_COLUMN_WIDTH);
+                    p = AppendString(p, userString.m_comment);
+                    *p++ = '\n';
+                }
+
+                isLeftAdjusted = true;
+            }
+
+            break;
+        }
+
+        case PERF_MARKER_EVENT_DROPPED:
+            p = FormatValueLine(p, "clPerfMarkerDropped", GetEventCount(event));
+            isLeftAdjusted = true;
+            break;
+
+        case PERF_MARKER_EVENT_END:
+            p = FormatValueLine(p, "clEndPerfMarker", event.m_timestamp);
+            isLeftAdjusted = true;
+            break;
+
+        case PERF_MARKER_EVENT_END_EX:
+        {
+            // the names passed to amdtEndMarkerEx are written without escaping the spaces
+            const PerfMarkerInfo& info = markerTable.Get(event.m_markerHandle);
+            p = AppendLeft(p, "clEndPerfMarkerEx", 17, s_COLUMN_WIDTH);
+
+            if (info.m_markerName.length() < s_DEFAULT_MARKER_NAME_WIDTH)
+            {
+                p = AppendDecimal(p, event.m_timestamp, s_COLUMN_WIDTH, true);
+                p = AppendLeft(p, info.m_markerName.data(), info.m_markerName.length(), s_DEFAULT_MARKER_NAME_WIDTH);
+                isLeftAdjusted = true;
+            }
+            else
+            {
+                // super long marker name -- note the adjustment of the timestamp depends on the previous lines written to the stream
+                p = AppendDecimal(p, event.m_timestamp, s_COLUMN_WIDTH, isLeftAdjusted);
+                p = AppendSpaces(p, s_SEPARATOR_LENGTH);
+                p = AppendString(p, info.m_markerName);
+            }
+
+            p = AppendSpaces(p, s_SEPARATOR_LENGTH);
+            p = AppendString(p, info.m_groupName);
+            *p++ = '\n';
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    return p;
+}
+
+/// Helper function to get a bound of the length of the lines of an event, cheaper than GetPerfMarkerEventTextLength
+/// \param event the event
+/// \param markerTable the table holding the names of the event's marker
+/// \return the bound
+static size_t GetMaxPerfMarkerEventTextLength(const PerfMarkerEvent& event, const PerfMarkerTable& markerTable)
+{
+    if (event.m_type == PERF_MARKER_EVENT_ARGS)
+    {
+        // the names are found through the arguments
+        return GetPerfMarkerEventTextLength(event, markerTable);
+    }
+
+    // the padded columns and separators of the longest layouts, a sampled begin or a counter, and the names
+    size_t length = 4 * s_COLUMN_WIDTH + s_DEFAULT_MARKER_NAME_WIDTH + 2 * s_SEPARATOR_LENGTH + s_PERF_MARKER_COUNTER_VALUE_MAX_LENGTH + 2;
+
+    if (event.m_markerHandle != 0)
+    {
+        const PerfMarkerInfo& info = markerTable.Get(event.m_markerHandle);
+        length += info.m_escapedMarkerName.length() + info.m_escapedGroupName.length();
+    }
+
+    // the comment of a user string, which is at most as long as the user string
+    return length + event.m_payloadSlots * sizeof(PerfMarkerEvent);
+}
+
+/// Helper function to get the adjustment of a stream
+/// \param os the stream
+/// \return true if the stream has the left adjustment
+static bool IsLeftAdjusted(const ostream& os)
+{
+    return (os.flags() & ios_base::adjustfield) == ios_base::left;
+}
+
+/// Helper function to set the adjustment the formatted lines leave to a stream
+/// \param os the stream
+/// \param isLeftAdjusted the adjustment after the lines
+static void SetLeftAdjusted(ostream& os, bool isLeftAdjusted)
+{
+    // the lines only ever set the left adjustment
+    if (isLeftAdjusted && !IsLeftAdjusted(os))
+    {
+        os.setf(ios_base::left, ios_base::adjustfield);
+    }
+}
+
+/// Helper function to get the length of a line formatted by FormatMarkerLine
+/// \param info the names of the marker
+/// \param value the value
+/// \return the length of the line, including the newline
+static size_t GetMarkerLineLength(const PerfMarkerInfo& info, unsigned long long value)
+{
+    size_t numDigits = GetNumDigits(value);
+    size_t length;
+
+    if (info.m_escapedMarkerName.length() < s_DEFAULT_MARKER_NAME_WIDTH)
+    {
+        length = s_COLUMN_WIDTH + s_DEFAULT_MARKER_NAME_WIDTH + (numDigits < s_COLUMN_WIDTH ? s_COLUMN_WIDTH : numDigits);
+    }
+    else
+    {
+        length = s_COLUMN_WIDTH + info.m_escapedMarkerName.length() + s_SEPARATOR_LENGTH + numDigits;
+    }
+
+    return length + s_SEPARATOR_LENGTH + info.m_escapedGroupName.length() + 1;
+}
+
+size_t FormatPerfMarkerCounterValue(const PerfMarkerEvent& event, char* pBuffer)
+{
+    if (event.m_type == PERF_MARKER_EVENT_COUNTER_DOUBLE)
+    {
+        double value;
+        memcpy(&value, event.GetPayload(), sizeof(value));
+        return FormatDouble(pBuffer, value) - pBuffer;
+    }
+
+    long long value;
+    memcpy(&value, event.GetPayload(), sizeof(value));
+    return FormatSignedDecimal(pBuffer, value) - pBuffer;
+}
+
+size_t FormatPerfMarkerArgNumber(const PerfMarkerArg& arg, char* pBuffer)
+{
+    if (arg.m_type == PERF_MARKER_ARG_DOUBLE)
+    {
+        double value;
+        memcpy(&value, &arg.m_value, sizeof(value));
+        return FormatDouble(pBuffer, value) - pBuffer;
+    }
+
+    if (arg.m_type == PERF_MARKER_ARG_INT64)
+    {
+        return FormatSignedDecimal(pBuffer, static_cast<long long>(arg.m_value)) - pBuffer;
+    }
+
+    return 0;
+}
+
+string GetPerfMarkerArgValueText(const PerfMarkerEvent& event, const PerfMarkerArg& arg)
+{
+    if (arg.m_type == PERF_MARKER_ARG_STRING)
+    {
+        return GetPerfMarkerEventArgString(event, arg);
+    }
+
+    char value[s_PERF_MARKER_COUNTER_VALUE_MAX_LENGTH];
+    return string(value, FormatPerfMarkerArgNumber(arg, value));
+}
+
+bool ParsePerfMarkerEndExNames(const char* pLine, size_t length, string& markerName, string& groupName)
+{
+    const size_t nameColumn = 2 * s_COLUMN_WIDTH;
+    const char* pLineEnd = pLine + length;
+
+    if (length < nameColumn + s_DEFAULT_MARKER_NAME_WIDTH + s_SEPARATOR_LENGTH)
+    {
+        return false;
+    }
+
+    const char* pName = pLine + nameColumn;
+    const char* pNameEnd;
+    const char* pGroup;
+
+    if (*pName != ' ')
+    {
+        // the padding of a short marker name is trimmed
+        pNameEnd = pName + s_DEFAULT_MARKER_NAME_WIDTH;
+        pGroup = pNameEnd + s_SEPARATOR_LENGTH;
+
+        while (pNameEnd > pName && pNameEnd[-1] == ' ')
+        {
+            pNameEnd--;
+        }
+    }
+    else
+    {
+        // the separator ending a long marker name is the first one after its first s_DEFAULT_MARKER_NAME_WIDTH characters
+        pName += s_SEPARATOR_LENGTH;
+        pNameEnd = pName + s_DEFAULT_MARKER_NAME_WIDTH;
+
+        while (pNameEnd + s_SEPARATOR_LENGTH <= pLineEnd && memcmp(pNameEnd, "   ", s_SEPARATOR_LENGTH) != 0)
+        {
+            pNameEnd++;
+        }
+
+        pGroup = pNameEnd + s_SEPARATOR_LENGTH;
+    }
+
+    if (pGroup > pLineEnd)
+    {
+        return false;
+    }
+
+    markerName.assign(pName, pNameEnd);
+    groupName.assign(pGroup, pLineEnd);
+    return true;
+}
+
+void WritePerfMarkerEventText(ostream& os, const PerfMarkerEvent& event, const PerfMarkerTable& markerTable)
+{
+    const size_t s_LINE_BUFFER_SIZE = 512;
+    char lineBuffer[s_LINE_BUFFER_SIZE];
+    size_t maxLength = GetMaxPerfMarkerEventTextLength(event, markerTable);
+    vector<char> longLineBuffer;
+    char* pBuffer = lineBuffer;
+
+    if (maxLength > s_LINE_BUFFER_SIZE)
+    {
+        longLineBuffer.resize(maxLength);
+        pBuffer = longLineBuffer.data();
+    }
+
+    bool isLeftAdjusted = IsLeftAdjusted(os);
+    char* pEnd = FormatPerfMarkerEventText(pBuffer, event, markerTable, isLeftAdjusted);
+    os.write(pBuffer, pEnd - pBuffer);
+    SetLeftAdjusted(os, isLeftAdjusted);
+}
+
+void WritePerfMarkerEventChunksText(ostream& os, const PerfMarkerEventChunk* pFirstChunk, const PerfMarkerTable& markerTable)
+{
+    vector<char> buffer(s_OUTPUT_BUFFER_SIZE);
+    char* p = buffer.data();
+    bool isLeftAdjusted = IsLeftAdjusted(os);
+
+    for (const PerfMarkerEventChunk* pChunk = pFirstChunk; pChunk != nullptr; pChunk = pChunk->m_pNext)
+    {
+        size_t slot = 0;
+
+        while (slot < pChunk->m_usedSlots)
+        {
+            const PerfMarkerEvent& event = pChunk->m_pSlots[slot];
+            size_t maxLength = GetMaxPerfMarkerEventTextLength(event, markerTable);
+
+            if (maxLength > static_cast<size_t>(buffer.data() + buffer.size() - p))
+            {
+                os.write(buffer.data(), p - buffer.data());
+                p = buffer.data();
+
+                if (maxLength > buffer.size())
+                {
+                    buffer.resize(maxLength);
+                    p = buffer.data();
+                }
+            }
+
+            p = FormatPerfMarkerEventText(p, event, markerTable, isLeftAdjusted);
+            slot += event.GetNumSlots();
+        }
+    }
+
+    os.write(buffer.data(), p - buffer.data());
+    SetLeftAdjusted(os, isLeftAdjusted);
+}
+
+void WritePerfMarkerEventBufferText(ostream& os, const PerfMarkerEventBuffer& buffer, const PerfMarkerTable& markerTable)
+{
+    WritePerfMarkerEventChunksText(os, buffer.GetFirstChunk(), markerTable);
+}
+
+size_t GetPerfMarkerEventTextLength(const PerfMarkerEvent& event, const PerfMarkerTable& markerTable)
+{
+    size_t numDigits = GetNumDigits(event.m_timestamp);
+    size_t paddedTimestampLength = numDigits < s_COLUMN_WIDTH ? s_COLUMN_WIDTH : numDigits;
+    size_t length = 0;
+
+    switch (event.m_type)
+    {
+        case PERF_MARKER_EVENT_BEGIN:
+            length = GetMarkerLineLength(markerTable.Get(event.m_markerHandle), event.m_timestamp);
+            break;
+
+        case PERF_MARKER_EVENT_SAMPLED_BEGIN:
+        {
+            size_t numCountDigits = GetNumDigits(GetEventCount(event));
+            length = GetMarkerLineLength(markerTable.Get(event.m_markerHandle), event.m_timestamp);
+            length += s_COLUMN_WIDTH + (numCountDigits < s_COLUMN_WIDTH ? s_COLUMN_WIDTH : numCountDigits) + 1;
+            break;
+        }
+
+        case PERF_MARKER_EVENT_SKIPPED:
+            length = GetMarkerLineLength(markerTable.Get(event.m_markerHandle), GetEventCount(event));
+            break;
+
+        case PERF_MARKER_EVENT_COUNTER:
+        case PERF_MARKER_EVENT_COUNTER_DOUBLE:
+        {
+            char value[s_PERF_MARKER_COUNTER_VALUE_MAX_LENGTH];
+            length = GetMarkerLineLength(markerTable.Get(event.m_markerHandle), event.m_timestamp) + s_SEPARATOR_LENGTH + FormatPerfMarkerCounterValue(event, value);
+            break;
+        }
+
+        case PERF_MARKER_EVENT_INSTANT:
+            length = GetMarkerLineLength(markerTable.Get(event.m_markerHandle), event.m_timestamp);
+            break;
+
+        case PERF_MARKER_EVENT_USER_STRING:
+        {
+            PerfMarkerUserString userString;
+            size_t userStringLength;
+            const char* pUserString = GetPerfMarkerEventUserString(event, userStringLength);
+
+            if (ParsePerfMarkerUserString(pUserString, userStringLength, userString))
+            {
+                length += userString.m_color.empty() ? 0 : s_COLUMN_WIDTH + userString.m_color.length() + 1;
+                length += userString.m_comment.empty() ? 0 : s_COLUMN_WIDTH + userString.m_comment.length() + 1;
+            }
+
+            break;
+        }
+
+        case PERF_MARKER_EVENT_ARGS:
+        {
+            size_t numArgs;
+            const PerfMarkerArg* pArgs = GetPerfMarkerEventArgs(event, numArgs);
+
+            for (size_t i = 0; i < numArgs; i++)
+            {
+                size_t typeLength = strlen(GetPerfMarkerArgTypeName(pArgs[i].m_type));
+                char value[s_PERF_MARKER_COUNTER_VALUE_MAX_LENGTH];
+                size_t valueLength = pArgs[i].m_type == PERF_MARKER_ARG_STRING ?
+                                     GetEscapedStringLength(GetPerfMarkerEventArgString(event, pArgs[i])) : FormatPerfMarkerArgNumber(pArgs[i], value);
+
+                length += s_COLUMN_WIDTH + GetNameColumnLength(markerTable.Get(pArgs[i].m_nameHandle).m_escapedMarkerName.length());
+                length += (typeLength < s_COLUMN_WIDTH ? s_COLUMN_WIDTH : typeLength) + valueLength + 1;
+            }
+
+            break;
+        }
+
+        case PERF_MARKER_EVENT_DROPPED:
+        {
+            size_t numCountDigits = GetNumDigits(GetEventCount(event));
+            length = s_COLUMN_WIDTH + (numCountDigits < s_COLUMN_WIDTH ? s_COLUMN_WIDTH : numCountDigits) + 1;
+            break;
+        }
+
+        case PERF_MARKER_EVENT_END:
+            length = s_COLUMN_WIDTH + paddedTimestampLength + 1;
+            break;
+
+        case PERF_MARKER_EVENT_END_EX:
+        {
+            const PerfMarkerInfo& info = markerTable.Get(event.m_markerHandle);
+            length = s_COLUMN_WIDTH + paddedTimestampLength;
+
+            if (info.m_markerName.length() < s_DEFAULT_MARKER_NAME_WIDTH)
+            {
+                length += s_DEFAULT_MARKER_NAME_WIDTH;
+            }
+            else
+            {
+                length += s_SEPARATOR_LENGTH + info.m_markerName.length();
+            }
+
+            length += s_SEPARATOR_LENGTH + info.m_groupName.length() + 1;
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    return length;
+}
+
+unsigned long long GetPerfMarkerEventChunksTextLength(const PerfMarkerEventChunk* pFirstChunk, const PerfMarkerTable& markerTable)
+{
+    unsigned long long length = 0;
+
+    for (const PerfMarkerEventChunk* pChunk = pFirstChunk; pChunk != nullptr; pChunk = pChunk->m_pNext)
+    {
+        size_t slot = 0;
+
+        while (slot < pChunk->m_usedSlots)
+        {
+            const PerfMarkerEvent& event = pChunk->m_pSlots[slot];
+            length += GetPerfMarkerEventTextLength(event, markerTable);
+            slot += event.GetNumSlots();
+        }
+    }
+
+    return length;
+}
+
+unsigned long long GetPerfMarkerEventBufferTextLength(const PerfMarkerEventBuffer& buffer, const PerfMarkerTable& markerTable)
+{
+    return GetPerfMarkerEventChunksTextLength(buffer.GetFirstChunk(), markerTable);
+}
+
+size_t GetPerfMarkerEventNumLines(const PerfMarkerEvent& event)
+{
+    switch (event.m_type)
+    {
+        case PERF_MARKER_EVENT_SAMPLED_BEGIN:
+            return 2;
+
+        case PERF_MARKER_EVENT_USER_STRING:
+        {
+            PerfMarkerUserString userString;
+            size_t length;
+            const char* pUserString = GetPerfMarkerEventUserString(event, length);
+
+            if (!ParsePerfMarkerUserString(pUserString, length, userString))
+            {
+                return 0;
+            }
+
+            return (userString.m_color.empty() ? 0 : 1) + (userString.m_comment.empty() ? 0 : 1);
+        }
+
+        case PERF_MARKER_EVENT_ARGS:
+        {
+            size_t numArgs;
+            GetPerfMarkerEventArgs(event, numArgs);
+            return numArgs;
+        }
+
+        default:
+            return 1;
+    }
+}
+
+unsigned long long GetPerfMarkerEventChunksNumLines(const PerfMarkerEventChunk* pFirstChunk)
+{
+    unsigned long long numLines = 0;
+
+    for (const PerfMarkerEventChunk* pChunk = pFirstChunk; pChunk != nullptr; pChunk = pChunk->m_pNext)
+    {
+        size_t slot = 0;
+
+        while (slot < pChunk->m_usedSlots)
+        {
+            const PerfMarkerEvent& event = pChunk->m_pSlots[slot];
+            numLines += GetPerfMarkerEventNumLines(event);
+            slot += event.GetNumSlots();
+        }
+    }
+
+    return numLines;
+}
+
+unsigned long long GetPerfMarkerEventBufferNumLines(const PerfMarkerEventBuffer& buffer)
+{
+    return GetPerfMarkerEventChunksNumLines(buffer.GetFirstChunk());
+}
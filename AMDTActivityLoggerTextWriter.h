@@ -0,0 +1,100 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Writes perf marker events in the .amdtperfmarker text layout
+//==============================================================================
+
+#ifndef _AMDT_ACTIVITY_LOGGER_TEXT_WRITER_H_
+#define _AMDT_ACTIVITY_LOGGER_TEXT_WRITER_H_
+
+#include <ostream>
+
+#include <string>
+
+#include "AMDTActivityLoggerEventBuffer.h"
+#include "AMDTActivityLoggerMarkerArgs.h"
+#include "AMDTActivityLoggerMarkerTable.h"
+
+const size_t s_PERF_MARKER_COUNTER_VALUE_MAX_LENGTH = 32; ///< size of the buffer passed to FormatPerfMarkerCounterValue
+
+/// Formats the value of a counter event as it is written in the .amdtperfmarker text output: a decimal
+/// integer for amdtRecordCounter, a number with a decimal point or an exponent for amdtRecordCounterDouble
+/// \param event the PERF_MARKER_EVENT_COUNTER or PERF_MARKER_EVENT_COUNTER_DOUBLE event
+/// \param[out] pBuffer the buffer receiving the value, s_PERF_MARKER_COUNTER_VALUE_MAX_LENGTH bytes
+/// \return the length of the value, which is not null terminated
+size_t FormatPerfMarkerCounterValue(const PerfMarkerEvent& event, char* pBuffer);
+
+/// Formats the value of an int64 or double argument of a marker like the value of a counter
+/// \param arg the argument
+/// \param[out] pBuffer the buffer receiving the value, s_PERF_MARKER_COUNTER_VALUE_MAX_LENGTH bytes
+/// \return the length of the value, which is not null terminated, 0 for a string argument
+size_t FormatPerfMarkerArgNumber(const PerfMarkerArg& arg, char* pBuffer);
+
+/// Gets the value of an argument of a marker as text, without escaping
+/// \param event the PERF_MARKER_EVENT_ARGS event holding the string values
+/// \param arg the argument, one of the arguments of the event
+/// \return the value, the string itself for a string argument
+std::string GetPerfMarkerArgValueText(const PerfMarkerEvent& event, const PerfMarkerArg& arg);
+
+/// Gets the names of a clEndPerfMarkerEx line of the .amdtperfmarker text output. The names are not escaped:
+/// a short marker name is padded to its column, a long one follows the timestamp column and a separator.
+/// \param pLine the line, which does not need to be null terminated
+/// \param length the length of the line, without its line end
+/// \param[out] markerName the marker name
+/// \param[out] groupName the group name
+/// \return false if the line has no names
+bool ParsePerfMarkerEndExNames(const char* pLine, size_t length, std::string& markerName, std::string& groupName);
+
+/// Writes a perf marker event as lines of the .amdtperfmarker text output
+/// \param os the stream to write to, all the events of a thread must be written to the same stream
+/// \param event the event to write
+/// \param markerTable the table holding the names of the event's marker
+void WritePerfMarkerEventText(std::ostream& os, const PerfMarkerEvent& event, const PerfMarkerTable& markerTable);
+
+/// Writes all the events of an event buffer as lines of the .amdtperfmarker text output
+/// \param os the stream to write to, all the events of a thread must be written to the same stream
+/// \param buffer the buffer holding the events of a thread
+/// \param markerTable the table holding the names of the events' markers
+void WritePerfMarkerEventBufferText(std::ostream& os, const PerfMarkerEventBuffer& buffer, const PerfMarkerTable& markerTable);
+
+/// Writes all the events of a list of event buffer chunks as lines of the .amdtperfmarker text output
+/// \param os the stream to write to, all the events of a thread must be written to the same stream
+/// \param pFirstChunk the first chunk of the list
+/// \param markerTable the table holding the names of the events' markers
+void WritePerfMarkerEventChunksText(std::ostream& os, const PerfMarkerEventChunk* pFirstChunk, const PerfMarkerTable& markerTable);
+
+/// Gets the length of the lines written by WritePerfMarkerEventText for an event
+/// \param event the event
+/// \param markerTable the table holding the names of the event's marker
+/// \return the length of the lines, including the newlines
+size_t GetPerfMarkerEventTextLength(const PerfMarkerEvent& event, const PerfMarkerTable& markerTable);
+
+/// Gets the number of bytes written by WritePerfMarkerEventBufferText for an event buffer
+/// \param buffer the buffer holding the events of a thread
+/// \param markerTable the table holding the names of the events' markers
+/// \return the number of bytes
+unsigned long long GetPerfMarkerEventBufferTextLength(const PerfMarkerEventBuffer& buffer, const PerfMarkerTable& markerTable);
+
+/// Gets the number of bytes written by WritePerfMarkerEventChunksText for a list of event buffer chunks
+/// \param pFirstChunk the first chunk of the list
+/// \param markerTable the table holding the names of the events' markers
+/// \return the number of bytes
+unsigned long long GetPerfMarkerEventChunksTextLength(const PerfMarkerEventChunk* pFirstChunk, const PerfMarkerTable& markerTable);
+
+/// Gets the number of lines written by WritePerfMarkerEventText for an event
+/// \param event the event
+/// \return the number of lines
+size_t GetPerfMarkerEventNumLines(const PerfMarkerEvent& event);
+
+/// Gets the number of lines written by WritePerfMarkerEventBufferText for an event buffer
+/// \param buffer the buffer holding the events of a thread
+/// \return the number of lines
+unsigned long long GetPerfMarkerEventBufferNumLines(const PerfMarkerEventBuffer& buffer);
+
+/// Gets the number of lines written by WritePerfMarkerEventChunksText for a list of event buffer chunks
+/// \param pFirstChunk the first chunk of the list
+/// \return the number of lines
+unsigned long long GetPerfMarkerEventChunksNumLines(const PerfMarkerEventChunk* pFirstChunk);
+
+#endif // _AMDT_ACTIVITY_LOGGER_TEXT_WRITER_H_
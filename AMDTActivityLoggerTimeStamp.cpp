@@ -6,14 +6,91 @@
 ///        This matches the timestamps used by the GPU Profiler
 //==============================================================================
 
+#include <algorithm>
+
 #include "AMDTActivityLoggerTimeStamp.h"
 
 #if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
     #include "windows.h"
 #endif
 
+#if defined(AL_HAS_TICK_COUNTER) && defined(__GNUC__) && !defined(__aarch64__)
+    #include <cpuid.h>
+#endif
+
+const unsigned long long s_INITIAL_CALIBRATION_NANOS = 10ULL * 1000ULL * 1000ULL;     ///< time between the first two calibration points
+const unsigned long long s_CALIBRATION_PERIOD_NANOS = 1000ULL * 1000ULL * 1000ULL;     ///< time between the periodic calibration points
+const int s_CALIBRATION_ATTEMPTS = 5;                                                  ///< number of clock reads used to take a calibration point
+
+/// Checks whether the CPU has a tick counter running at a constant rate in all power states
+/// \return true if the tick counter is invariant
+static bool HasInvariantTickCounter()
+{
+#if defined(AL_HAS_TICK_COUNTER) && defined(_MSC_VER)
+    int regs[4];
+    __cpuid(regs, 0x80000000);
+
+    if (static_cast<unsigned int>(regs[0]) < 0x80000007)
+    {
+        return false;
+    }
+
+    __cpuid(regs, 0x80000007);
+    return (regs[3] & (1 << 8)) != 0;
+#elif defined(AL_HAS_TICK_COUNTER) && defined(__aarch64__)
+    // the virtual counter runs at the fixed frequency reported by cntfrq_el0
+    return true;
+#elif defined(AL_HAS_TICK_COUNTER)
+    unsigned int eax, ebx, ecx, edx;
+
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0)
+    {
+        return false;
+    }
+
+    return (edx & (1 << 8)) != 0;
+#else
+    return false;
+#endif
+}
+
+/// Helper function to order calibration points by tick counter value
+/// \param left the left point
+/// \param right the right point
+/// \return true if the left point was taken before the right point
+static bool CompareCalibrationPointTicks(const TimeStampCalibrationPoint& left, const TimeStampCalibrationPoint& right)
+{
+    return left.m_ticks < right.m_ticks;
+}
+
+TimeStampConverter::TimeStampConverter()
+{
+    m_upper = 1;
+    m_nanosPerTick = 0;
+}
+
+void TimeStampConverter::FindCalibrationPoints(unsigned long long timeStamp)
+{
+    TimeStampCalibrationPoint key = { timeStamp, 0 };
+    size_t upper = std::upper_bound(m_calibrationPoints.begin(), m_calibrationPoints.end(), key, CompareCalibrationPointTicks) - m_calibrationPoints.begin();
+    size_t last = m_calibrationPoints.size() - 1;
+
+    m_upper = upper < 1 ? 1 : (upper > last ? last : upper);
+
+    const TimeStampCalibrationPoint& p0 = m_calibrationPoints[m_upper - 1];
+    const TimeStampCalibrationPoint& p1 = m_calibrationPoints[m_upper];
+    m_nanosPerTick = static_cast<double>(p1.m_nanos - p0.m_nanos) / static_cast<double>(p1.m_ticks - p0.m_ticks);
+}
+
 AMDTActivityLoggerTimeStamp::AMDTActivityLoggerTimeStamp()
 {
+    m_useTickCounter = false;
+    m_nextCalibrationTicks = ~0ULL;
+    m_calibrationPeriodTicks = 0;
+    m_timeStampsPerMillisecond = 1000ULL * 1000ULL;
+    m_nanosPerTick = 1.0;
+    m_numCalibrationPoints = 0;
+
 #if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
     LARGE_INTEGER freq;
     QueryPerformanceFrequency(&freq);
@@ -35,3 +112,115 @@ unsigned long long AMDTActivityLoggerTimeStamp::GetTimeNanos()
         static_cast<unsigned long long>(tp.tv_nsec);
 #endif
 }
+
+bool AMDTActivityLoggerTimeStamp::EnableTickCounter()
+{
+    std::lock_guard<std::mutex> lock(m_calibrationMtx);
+
+    if (m_useTickCounter)
+    {
+        return true;
+    }
+
+    if (!HasInvariantTickCounter())
+    {
+        return false;
+    }
+
+    // two calibration points are needed to convert ticks as soon as they are recorded
+    TimeStampCalibrationPoint first = TakeCalibrationPoint();
+
+    while (GetTimeNanos() - first.m_nanos < s_INITIAL_CALIBRATION_NANOS)
+    {
+    }
+
+    TimeStampCalibrationPoint second = TakeCalibrationPoint();
+
+    if (second.m_ticks <= first.m_ticks)
+    {
+        return false;
+    }
+
+    double ticksPerNano = static_cast<double>(second.m_ticks - first.m_ticks) / static_cast<double>(second.m_nanos - first.m_nanos);
+    m_calibrationPeriodTicks = static_cast<unsigned long long>(ticksPerNano * s_CALIBRATION_PERIOD_NANOS);
+    m_timeStampsPerMillisecond = static_cast<unsigned long long>(ticksPerNano * 1000.0 * 1000.0);
+    m_nanosPerTick = 1.0 / ticksPerNano;
+    m_calibrationPoints.push_back(first);
+    m_calibrationPoints.push_back(second);
+    m_numCalibrationPoints.store(m_calibrationPoints.size());
+    m_nextCalibrationTicks.store(second.m_ticks + m_calibrationPeriodTicks);
+    m_useTickCounter = true;
+
+    return true;
+}
+
+void AMDTActivityLoggerTimeStamp::AddCalibrationPoint()
+{
+    if (m_useTickCounter)
+    {
+        Calibrate(true);
+    }
+}
+
+void AMDTActivityLoggerTimeStamp::GetConverter(TimeStampConverter& converter)
+{
+    std::lock_guard<std::mutex> lock(m_calibrationMtx);
+
+    if (converter.m_calibrationPoints.size() != m_calibrationPoints.size())
+    {
+        converter.m_calibrationPoints = m_calibrationPoints;
+
+        if (!m_calibrationPoints.empty())
+        {
+            converter.FindCalibrationPoints(m_calibrationPoints.back().m_ticks);
+        }
+    }
+}
+
+void AMDTActivityLoggerTimeStamp::Calibrate(bool wait)
+{
+    std::unique_lock<std::mutex> lock(m_calibrationMtx, std::defer_lock);
+
+    if (wait)
+    {
+        lock.lock();
+    }
+    else if (!lock.try_lock() || GetTicks() < m_nextCalibrationTicks.load())
+    {
+        // another thread is adding, or has just added, the calibration point
+        return;
+    }
+
+    TimeStampCalibrationPoint point = TakeCalibrationPoint();
+
+    if (point.m_ticks > m_calibrationPoints.back().m_ticks && point.m_nanos > m_calibrationPoints.back().m_nanos)
+    {
+        m_calibrationPoints.push_back(point);
+        m_numCalibrationPoints.store(m_calibrationPoints.size());
+    }
+
+    m_nextCalibrationTicks.store(point.m_ticks + m_calibrationPeriodTicks);
+}
+
+TimeStampCalibrationPoint AMDTActivityLoggerTimeStamp::TakeCalibrationPoint()
+{
+    // the clock is read between two reads of the tick counter, keep the attempt with the tightest bracket
+    TimeStampCalibrationPoint point = { 0, 0 };
+    unsigned long long bestBracket = ~0ULL;
+
+    for (int i = 0; i < s_CALIBRATION_ATTEMPTS; i++)
+    {
+        unsigned long long before = GetTicks();
+        unsigned long long nanos = GetTimeNanos();
+        unsigned long long after = GetTicks();
+
+        if (after - before < bestBracket)
+        {
+            bestBracket = after - before;
+            point.m_ticks = before + (after - before) / 2;
+            point.m_nanos = nanos;
+        }
+    }
+
+    return point;
+}
@@ -9,11 +9,84 @@
 #ifndef _AMDT_ACTIVITY_LOGGER_TIME_STAMP_H_
 #define _AMDT_ACTIVITY_LOGGER_TIME_STAMP_H_
 
+#include <atomic>
+#include <mutex>
+#include <vector>
+
 #include "AMDTBaseTools/Include/AMDTDefinitions.h"
 
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+    #include <intrin.h>
+    #define AL_HAS_TICK_COUNTER
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+    #include <x86intrin.h>
+    #define AL_HAS_TICK_COUNTER
+#elif defined(__GNUC__) && defined(__aarch64__)
+    #define AL_HAS_TICK_COUNTER
+#endif
+
 #include "TSingleton.h"
 
+/// A tick counter value and the matching time in nanoseconds
+struct TimeStampCalibrationPoint
+{
+    unsigned long long m_ticks;   ///< the tick counter value
+    unsigned long long m_nanos;   ///< the time in nanoseconds
+};
+
+/// Converts the timestamps returned by AMDTActivityLoggerTimeStamp::GetTimeStamp to nanoseconds,
+/// using a copy of the calibration points taken so far so that conversions take no lock
+class TimeStampConverter
+{
+public:
+    /// Constructor
+    TimeStampConverter();
+
+    /// Converts a timestamp to nanoseconds.
+    /// Converting increasing timestamps, such as the timestamps of a thread, is the fastest.
+    /// \param timeStamp the timestamp
+    /// \return the timestamp in nanoseconds
+    unsigned long long ConvertToNanos(unsigned long long timeStamp)
+    {
+        if (m_calibrationPoints.empty())
+        {
+            return timeStamp;
+        }
+
+        if (timeStamp < m_calibrationPoints[m_upper - 1].m_ticks || (timeStamp >= m_calibrationPoints[m_upper].m_ticks && m_upper + 1 < m_calibrationPoints.size()))
+        {
+            FindCalibrationPoints(timeStamp);
+        }
+
+        const TimeStampCalibrationPoint& p0 = m_calibrationPoints[m_upper - 1];
+        double deltaTicks = timeStamp >= p0.m_ticks ? static_cast<double>(timeStamp - p0.m_ticks) : -static_cast<double>(p0.m_ticks - timeStamp);
+        double nanos = static_cast<double>(p0.m_nanos) + deltaTicks * m_nanosPerTick;
+
+        return nanos > 0 ? static_cast<unsigned long long>(nanos + 0.5) : 0;
+    }
+
+    /// Gets the number of calibration points used by the converter
+    /// \return the number of calibration points
+    size_t GetNumCalibrationPoints() const { return m_calibrationPoints.size(); }
+
+private:
+    friend class AMDTActivityLoggerTimeStamp;
+
+    /// Finds the calibration points around a timestamp, extrapolating from the first or last two points
+    /// \param timeStamp the timestamp
+    void FindCalibrationPoints(unsigned long long timeStamp);
+
+    std::vector<TimeStampCalibrationPoint> m_calibrationPoints;   ///< the calibration points, in increasing order, empty if timestamps are in nanoseconds
+    size_t m_upper;                                               ///< index of the calibration point after the last converted timestamp
+    double m_nanosPerTick;                                        ///< the slope between the calibration points at m_upper - 1 and m_upper
+};
+
 /// Singleton class to retrieve CPU timestamps in nanoseconds
+///
+/// Optionally, timestamps can be recorded as raw ticks of the CPU's invariant time stamp counter
+/// (the virtual counter on ARM), which is much cheaper to read than the OS clock. The tick
+/// counter is calibrated against the clock used by GetTimeNanos when it is enabled and then
+/// periodically, and ticks are converted to nanoseconds when the markers are written out.
 class AMDTActivityLoggerTimeStamp : public TSingleton<AMDTActivityLoggerTimeStamp>
 {
 public:
@@ -24,8 +97,93 @@ public:
     /// \return current CPU timestamp in nanoseconds
     unsigned long long GetTimeNanos();
 
-#if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
+    /// Use the tick counter for the timestamps returned by GetTimeStamp
+    /// \return true if the CPU has an invariant tick counter, false if GetTimeStamp keeps returning nanoseconds
+    bool EnableTickCounter();
+
+    /// Get the current timestamp to record, in ticks if the tick counter is enabled, in nanoseconds otherwise.
+    /// Use a TimeStampConverter to convert the returned value to nanoseconds.
+    /// \return the current timestamp
+    unsigned long long GetTimeStamp()
+    {
+        if (m_useTickCounter)
+        {
+            unsigned long long ticks = GetTicks();
+
+            if (ticks >= m_nextCalibrationTicks.load(std::memory_order_relaxed))
+            {
+                Calibrate(false);
+            }
+
+            return ticks;
+        }
+
+        return GetTimeNanos();
+    }
+
+    /// Gets the number of timestamp units returned by GetTimeStamp per millisecond
+    /// \return the number of ticks per millisecond if the tick counter is enabled, 1000000 otherwise
+    unsigned long long GetTimeStampsPerMillisecond() const { return m_timeStampsPerMillisecond; }
+
+    /// Converts the difference between two timestamps returned by GetTimeStamp to nanoseconds
+    /// \param duration the difference between the timestamps
+    /// \return the duration in nanoseconds
+    unsigned long long ConvertDurationToNanos(unsigned long long duration) const
+    {
+        return m_useTickCounter ? static_cast<unsigned long long>(static_cast<double>(duration) * m_nanosPerTick) : duration;
+    }
+
+    /// Adds a calibration point, so that timestamps recorded up to now are converted as accurately as possible
+    void AddCalibrationPoint();
+
+    /// Gets the number of calibration points taken so far
+    /// \return the number of calibration points, 0 if the tick counter is not used
+    size_t GetNumCalibrationPoints() const { return m_numCalibrationPoints.load(std::memory_order_relaxed); }
+
+    /// Updates a converter with the calibration points taken so far
+    /// \param[out] converter the converter
+    void GetConverter(TimeStampConverter& converter);
+
+    /// Locks the calibration points before the process forks, so that the child does not inherit a calibration in progress
+    void LockForFork() { m_calibrationMtx.lock(); }
+
+    /// Unlocks the calibration points after the process forked, in the parent and in the child
+    void UnlockAfterFork() { m_calibrationMtx.unlock(); }
+
+    /// Reads the tick counter
+    /// \return the current value of the tick counter
+    static unsigned long long GetTicks()
+    {
+#if defined(AL_HAS_TICK_COUNTER) && defined(__aarch64__)
+        unsigned long long ticks;
+        __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+        return ticks;
+#elif defined(AL_HAS_TICK_COUNTER)
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
 private:
+    /// Adds a calibration point
+    /// \param wait true to wait for a concurrent calibration to complete, false to skip adding the point in that case
+    void Calibrate(bool wait);
+
+    /// Takes a calibration point
+    /// \return the calibration point
+    TimeStampCalibrationPoint TakeCalibrationPoint();
+
+    bool m_useTickCounter;                                      ///< flag indicating if GetTimeStamp returns ticks
+    std::atomic<unsigned long long> m_nextCalibrationTicks;     ///< the tick counter value after which GetTimeStamp adds a calibration point
+    unsigned long long m_calibrationPeriodTicks;                ///< number of ticks between calibration points
+    unsigned long long m_timeStampsPerMillisecond;              ///< number of timestamp units returned by GetTimeStamp per millisecond
+    double m_nanosPerTick;                                      ///< duration of a tick in nanoseconds, measured when the tick counter is enabled
+    std::mutex m_calibrationMtx;                                ///< mutex to protect m_calibrationPoints
+    std::vector<TimeStampCalibrationPoint> m_calibrationPoints; ///< the calibration points, in increasing order
+    std::atomic<size_t> m_numCalibrationPoints;                 ///< the number of calibration points
+
+#if (AMDT_BUILD_TARGET == AMDT_WINDOWS_OS)
     double m_invFrequency; ///< the inverse of the CPU frequency
 #endif
 };
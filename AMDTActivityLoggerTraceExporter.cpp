@@ -0,0 +1,29 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Exports a .amdtperfmarker file to a Chrome trace file, read by chrome://tracing and Perfetto
+//==============================================================================
+
+#include <iostream>
+
+#include "AMDTActivityLoggerChromeTrace.h"
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        cerr << "Usage: " << argv[0] << " <.amdtperfmarker file> <Chrome trace .json file>\n";
+        return 1;
+    }
+
+    if (!ExportPerfMarkerFileToChromeTrace(argv[1], argv[2]))
+    {
+        cerr << "Failed to export " << argv[1] << " to " << argv[2] << "\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,284 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Profiling triggers resuming the profiling agents around marker instances
+//==============================================================================
+
+#include "AMDTActivityLoggerProfileControl.h"
+#include "AMDTActivityLoggerTriggers.h"
+
+using namespace std;
+
+PerfMarkerTriggerList::PerfMarkerTriggerList()
+{
+    m_count = 0;
+    m_nextDeadline = s_NO_DEADLINE;
+    m_isRefreshed = false;
+
+    for (unsigned int i = 0; i < s_NUM_MODES; i++)
+    {
+        m_modes[i].m_numOpenWindows = 0;
+        m_modes[i].m_hasTrigger = false;
+        m_modes[i].m_isResumed = true;
+        m_modes[i].m_isApplying = false;
+    }
+}
+
+unsigned int PerfMarkerTriggerList::Add(const PerfMarkerTriggerSettings& settings)
+{
+    std::lock_guard<std::mutex> lock(m_mtx);
+
+    unsigned int count = m_count.load(memory_order_relaxed);
+
+    if (count == s_MAX_TRIGGERS)
+    {
+        return 0;
+    }
+
+    PerfMarkerTrigger& trigger = m_triggers[count];
+    trigger.m_settings = settings;
+    trigger.m_state = PERF_MARKER_TRIGGER_IDLE;
+    trigger.m_numInstances = 0;
+    trigger.m_windowInstance = 0;
+    trigger.m_numWindows = 0;
+    trigger.m_deadline = 0;
+    trigger.m_isCounted = false;
+
+    for (unsigned int i = 0; i < s_NUM_MODES; i++)
+    {
+        if ((settings.m_profilingControlMode & (1 << i)) != 0)
+        {
+            m_modes[i].m_hasTrigger = true;
+        }
+    }
+
+    m_count.store(count + 1, memory_order_release);
+
+    return count + 1;
+}
+
+unsigned long long PerfMarkerTriggerList::OnBegin(unsigned int triggerId, unsigned long long timeStamp)
+{
+    unsigned long long instance;
+    unsigned long long windowInstance = 0;
+    bool isOpened = false;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+
+        PerfMarkerTrigger& trigger = m_triggers[triggerId - 1];
+        instance = ++trigger.m_numInstances;
+
+        // the windows of a trigger do not overlap, the instances which begin while the trigger is armed or open are only counted
+        if (trigger.m_state == PERF_MARKER_TRIGGER_IDLE && instance >= trigger.m_settings.m_startInstance &&
+            (trigger.m_settings.m_maxWindows == 0 || trigger.m_numWindows < trigger.m_settings.m_maxWindows))
+        {
+            trigger.m_windowInstance = instance;
+            windowInstance = instance;
+
+            if (trigger.m_settings.m_minDuration != 0)
+            {
+                // only the instances which last longer than the minimum duration open a window
+                trigger.m_state = PERF_MARKER_TRIGGER_ARMED;
+                trigger.m_deadline = timeStamp + trigger.m_settings.m_minDuration;
+                UpdateNextDeadline();
+            }
+            else
+            {
+                OpenWindow(trigger, timeStamp);
+                isOpened = true;
+            }
+        }
+    }
+
+    // the first instance stops the profiling of the modes of the trigger, if none of their windows is open
+    if (isOpened || instance == 1)
+    {
+        ApplyWindows();
+    }
+
+    return windowInstance;
+}
+
+void PerfMarkerTriggerList::OnEnd(unsigned int triggerId, unsigned long long instance)
+{
+    bool wasOpen;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mtx);
+
+        PerfMarkerTrigger& trigger = m_triggers[triggerId - 1];
+
+        if (trigger.m_windowInstance != instance)
+        {
+            // the window was closed at its deadline
+            return;
+        }
+
+        wasOpen = trigger.m_state == PERF_MARKER_TRIGGER_OPEN;
+        CloseWindow(trigger);
+        UpdateNextDeadline();
+    }
+
+    if (wasOpen)
+    {
+        ApplyWindows();
+    }
+}
+
+void PerfMarkerTriggerList::CheckDeadlines(unsigned long long timeStamp)
+{
+    if (timeStamp < m_nextDeadline.load(memory_order_relaxed))
+    {
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_mtx, std::try_to_lock);
+
+        if (!lock.owns_lock())
+        {
+            // another thread is updating the triggers
+            return;
+        }
+
+        unsigned int count = m_count.load(memory_order_relaxed);
+
+        for (unsigned int i = 0; i < count; i++)
+        {
+            PerfMarkerTrigger& trigger = m_triggers[i];
+
+            if (trigger.m_deadline == 0 || timeStamp < trigger.m_deadline)
+            {
+                continue;
+            }
+
+            if (trigger.m_state == PERF_MARKER_TRIGGER_ARMED)
+            {
+                OpenWindow(trigger, timeStamp);
+            }
+            else if (trigger.m_state == PERF_MARKER_TRIGGER_OPEN)
+            {
+                // the end of the instance no longer closes a window
+                CloseWindow(trigger);
+            }
+        }
+
+        UpdateNextDeadline();
+    }
+
+    ApplyWindows();
+}
+
+void PerfMarkerTriggerList::OpenWindow(PerfMarkerTrigger& trigger, unsigned long long timeStamp)
+{
+    trigger.m_state = PERF_MARKER_TRIGGER_OPEN;
+    trigger.m_numWindows++;
+    trigger.m_deadline = trigger.m_settings.m_maxDuration != 0 ? timeStamp + trigger.m_settings.m_maxDuration : 0;
+    UpdateNextDeadline();
+}
+
+void PerfMarkerTriggerList::CloseWindow(PerfMarkerTrigger& trigger)
+{
+    trigger.m_state = PERF_MARKER_TRIGGER_IDLE;
+    trigger.m_windowInstance = 0;
+    trigger.m_deadline = 0;
+}
+
+void PerfMarkerTriggerList::ApplyWindows()
+{
+    // the agent libraries may have been loaded after the entry points were first resolved
+    if (!m_isRefreshed.load(memory_order_relaxed) && !m_isRefreshed.exchange(true))
+    {
+        AMDTActivityLoggerProfileControl::Instance()->Refresh();
+    }
+
+    std::unique_lock<std::mutex> lock(m_mtx);
+
+    unsigned int count = m_count.load(memory_order_relaxed);
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        PerfMarkerTrigger& trigger = m_triggers[i];
+        bool isOpen = trigger.m_state == PERF_MARKER_TRIGGER_OPEN;
+
+        if (trigger.m_isCounted == isOpen)
+        {
+            continue;
+        }
+
+        for (unsigned int j = 0; j < s_NUM_MODES; j++)
+        {
+            if ((trigger.m_settings.m_profilingControlMode & (1 << j)) != 0)
+            {
+                if (isOpen)
+                {
+                    m_modes[j].m_numOpenWindows++;
+                }
+                else
+                {
+                    m_modes[j].m_numOpenWindows--;
+                }
+            }
+        }
+
+        trigger.m_isCounted = isOpen;
+    }
+
+    for (;;)
+    {
+        unsigned int mode = s_NUM_MODES;
+
+        for (unsigned int j = 0; j < s_NUM_MODES && mode == s_NUM_MODES; j++)
+        {
+            // a mode being applied by another thread is applied again by that thread if its windows changed meanwhile
+            if (m_modes[j].m_hasTrigger && !m_modes[j].m_isApplying && m_modes[j].m_isResumed != (m_modes[j].m_numOpenWindows != 0))
+            {
+                mode = j;
+            }
+        }
+
+        if (mode == s_NUM_MODES)
+        {
+            return;
+        }
+
+        PerfMarkerTriggerModeState& modeState = m_modes[mode];
+        bool resume = !modeState.m_isResumed;
+        modeState.m_isApplying = true;
+
+        // the agents are called without holding the lock, so that their latency does not block the threads beginning and ending
+        // the triggered markers, and a marker recorded by an agent entry point does not deadlock
+        lock.unlock();
+
+        if (resume)
+        {
+            AMDTActivityLoggerProfileControl::Instance()->ResumeProfiling(static_cast<amdtProfilingControlMode>(1 << mode));
+        }
+        else
+        {
+            AMDTActivityLoggerProfileControl::Instance()->StopProfiling(static_cast<amdtProfilingControlMode>(1 << mode));
+        }
+
+        lock.lock();
+        modeState.m_isResumed = resume;
+        modeState.m_isApplying = false;
+    }
+}
+
+void PerfMarkerTriggerList::UpdateNextDeadline()
+{
+    unsigned long long nextDeadline = s_NO_DEADLINE;
+    unsigned int count = m_count.load(memory_order_relaxed);
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        if (m_triggers[i].m_deadline != 0 && m_triggers[i].m_deadline < nextDeadline)
+        {
+            nextDeadline = m_triggers[i].m_deadline;
+        }
+    }
+
+    m_nextDeadline.store(nextDeadline, memory_order_relaxed);
+}
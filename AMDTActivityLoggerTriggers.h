@@ -0,0 +1,133 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Profiling triggers resuming the profiling agents around marker instances
+//==============================================================================
+
+#ifndef _AMDT_ACTIVITY_LOGGER_TRIGGERS_H_
+#define _AMDT_ACTIVITY_LOGGER_TRIGGERS_H_
+
+#include <atomic>
+#include <mutex>
+
+#include "CXLActivityLogger.h"
+
+/// Settings of a profiling trigger, the durations are in timestamp units
+struct PerfMarkerTriggerSettings
+{
+    amdtProfilingControlMode m_profilingControlMode;    ///< the profiling modes resumed during a window
+    unsigned long long m_startInstance;                 ///< the instance of the marker, counted from 1 across all threads, from which windows open
+    unsigned int m_maxWindows;                          ///< the maximum number of windows, 0 for no limit
+    unsigned long long m_minDuration;                   ///< a window opens once its instance has lasted this long, 0 to open it at the begin of the instance
+    unsigned long long m_maxDuration;                   ///< a window closes this long after it opened if its instance has not ended, 0 to close it at the end of the instance only
+};
+
+/// The state of a profiling trigger
+enum PerfMarkerTriggerState
+{
+    PERF_MARKER_TRIGGER_IDLE = 0,   ///< waiting for an instance of the marker to begin
+    PERF_MARKER_TRIGGER_ARMED = 1,  ///< an instance began, the window opens at the deadline if the instance has not ended
+    PERF_MARKER_TRIGGER_OPEN = 2    ///< profiling is resumed until the instance ends or the deadline
+};
+
+/// A profiling trigger and its state
+struct PerfMarkerTrigger
+{
+    PerfMarkerTriggerSettings m_settings;   ///< the settings of the trigger
+    PerfMarkerTriggerState m_state;         ///< the state of the trigger
+    unsigned long long m_numInstances;      ///< number of instances of the marker which began
+    unsigned long long m_windowInstance;    ///< the instance which armed the trigger or opened the window
+    unsigned int m_numWindows;              ///< number of windows opened
+    unsigned long long m_deadline;          ///< timestamp at which the armed window opens or the open window closes, 0 for none
+    bool m_isCounted;                       ///< flag indicating if the open window is counted in the open windows of the modes
+};
+
+/// The open windows of a profiling mode, shared by the triggers of the mode
+struct PerfMarkerTriggerModeState
+{
+    unsigned int m_numOpenWindows;  ///< number of open windows of the triggers resuming the mode
+    bool m_hasTrigger;              ///< flag indicating if a trigger resumes the mode
+    bool m_isResumed;               ///< flag indicating if the agents were last told to resume the profiling of the mode, true until they are first told to stop it
+    bool m_isApplying;              ///< flag indicating that a thread is calling the agents for the mode, without holding the lock
+};
+
+/// List of the profiling triggers. A trigger resumes the profiling agents while an instance of its marker runs,
+/// so that the agents only collect the intervals of interest. The windows of the triggers may overlap, the profiling of a mode
+/// is resumed when the first window of its triggers opens and stopped when the last one closes.
+/// Markers refer to their trigger by its id, the 1-based index of the trigger in the list. Triggers are never removed.
+class PerfMarkerTriggerList
+{
+public:
+    static const unsigned int s_MAX_TRIGGERS = 64; ///< maximum number of triggers
+
+    /// Constructor
+    PerfMarkerTriggerList();
+
+    /// Adds a trigger. The profiling of its modes is stopped when the first instance of its marker begins, so that only its windows are profiled,
+    /// and the agents are not resolved before they are loaded
+    /// \param settings the settings of the trigger
+    /// \return the id of the trigger, 0 if the list is full
+    unsigned int Add(const PerfMarkerTriggerSettings& settings);
+
+    /// Counts an instance of the marker of a trigger which begins, and arms the trigger or opens a window
+    /// \param triggerId the id of the trigger
+    /// \param timeStamp the timestamp of the begin
+    /// \return the instance number if the instance armed the trigger or opened a window, to pass to OnEnd, 0 otherwise
+    unsigned long long OnBegin(unsigned int triggerId, unsigned long long timeStamp);
+
+    /// Closes the window opened by an instance which ends, or disarms the trigger if the window did not open yet
+    /// \param triggerId the id of the trigger
+    /// \param instance the instance number returned by OnBegin
+    void OnEnd(unsigned int triggerId, unsigned long long instance);
+
+    /// Checks whether a trigger has a deadline
+    /// \return true if CheckDeadlines needs to be called
+    bool HasDeadline() const { return m_nextDeadline.load(std::memory_order_relaxed) != s_NO_DEADLINE; }
+
+    /// Opens the armed windows and closes the open windows whose deadline has passed
+    /// \param timeStamp the current timestamp
+    void CheckDeadlines(unsigned long long timeStamp);
+
+    /// Locks the states of the triggers before the process forks, so that the child does not inherit a window being opened or closed
+    void LockForFork() { m_mtx.lock(); }
+
+    /// Unlocks the states of the triggers after the process forked, in the parent and in the child
+    void UnlockAfterFork() { m_mtx.unlock(); }
+
+private:
+    /// Disabled copy contructor
+    PerfMarkerTriggerList(const PerfMarkerTriggerList& obj);
+
+    /// Disabled assignment operator
+    PerfMarkerTriggerList& operator = (const PerfMarkerTriggerList& obj);
+
+    static const unsigned long long s_NO_DEADLINE = ~0ULL; ///< the value of m_nextDeadline when no trigger has a deadline
+    static const unsigned int s_NUM_MODES = 3;             ///< number of profiling modes, the bits of amdtProfilingControlMode
+
+    /// Opens a window of a trigger, ApplyWindows then resumes the profiling of its modes which had no open window. m_mtx must be held.
+    /// \param trigger the trigger
+    /// \param timeStamp the timestamp at which the window opens
+    void OpenWindow(PerfMarkerTrigger& trigger, unsigned long long timeStamp);
+
+    /// Closes the window of a trigger, or disarms it, ApplyWindows then stops the profiling of its modes which have no other open window. m_mtx must be held.
+    /// \param trigger the trigger
+    void CloseWindow(PerfMarkerTrigger& trigger);
+
+    /// Counts the windows of the triggers which opened or closed in the open windows of their modes,
+    /// and tells the agents to resume the modes whose first window opened and to stop the modes whose last window closed.
+    /// The entry points of the agents are resolved again the first time. m_mtx must not be held, it is released while the agents are called.
+    void ApplyWindows();
+
+    /// Updates m_nextDeadline from the deadlines of the triggers. m_mtx must be held.
+    void UpdateNextDeadline();
+
+    std::mutex m_mtx;                                   ///< mutex to protect the states of the triggers and of the modes
+    PerfMarkerTrigger m_triggers[s_MAX_TRIGGERS];       ///< the triggers
+    PerfMarkerTriggerModeState m_modes[s_NUM_MODES];    ///< the open windows of the profiling modes, indexed by the bit of the mode
+    std::atomic<bool> m_isRefreshed;                    ///< flag indicating if the entry points of the agents were resolved again by ApplyWindows
+    std::atomic<unsigned int> m_count;                  ///< the number of triggers, published after the trigger is written
+    std::atomic<unsigned long long> m_nextDeadline;     ///< the earliest deadline of the triggers, s_NO_DEADLINE if none
+};
+
+#endif // _AMDT_ACTIVITY_LOGGER_TRIGGERS_H_
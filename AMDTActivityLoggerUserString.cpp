@@ -0,0 +1,256 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Parses the user strings attached to perf markers
+//==============================================================================
+
+#include <cstring>
+
+#include "AMDTActivityLoggerUserString.h"
+
+using namespace std;
+
+/// Helper function to check whether a character is XML white space
+/// \param c the character
+/// \return true if c is white space
+static bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/// Helper function to skip white space
+/// \param p the first character
+/// \param pEnd the end of the text
+/// \return the first character which is not white space, pEnd if there is none
+static const char* SkipSpaces(const char* p, const char* pEnd)
+{
+    while (p < pEnd && IsSpace(*p))
+    {
+        p++;
+    }
+
+    return p;
+}
+
+/// Helper function to find the end of an element, skipping the quoted attribute values which may hold a '>'
+/// \param p the character after the '<' starting the element
+/// \param pEnd the end of the text
+/// \return the '>' ending the element, pEnd if the element is not terminated
+static const char* FindElementEnd(const char* p, const char* pEnd)
+{
+    char quote = '\0';
+
+    for (; p < pEnd; p++)
+    {
+        if (quote != '\0')
+        {
+            quote = *p == quote ? '\0' : quote;
+        }
+        else if (*p == '"' || *p == '\'')
+        {
+            quote = *p;
+        }
+        else if (*p == '>')
+        {
+            return p;
+        }
+    }
+
+    return pEnd;
+}
+
+/// Helper function to decode the predefined XML entities of an attribute value, other '&' are kept as is
+/// \param p the start of the value
+/// \param pEnd the end of the value
+/// \return the decoded value
+static string DecodeEntities(const char* p, const char* pEnd)
+{
+    static const char* const s_ENTITIES[] = { "&quot;", "\"", "&apos;", "'", "&lt;", "<", "&gt;", ">", "&amp;", "&" };
+    string value;
+
+    while (p < pEnd)
+    {
+        bool decoded = false;
+
+        if (*p == '&')
+        {
+            for (size_t i = 0; i < sizeof(s_ENTITIES) / sizeof(s_ENTITIES[0]); i += 2)
+            {
+                size_t length = strlen(s_ENTITIES[i]);
+
+                if (static_cast<size_t>(pEnd - p) >= length && memcmp(p, s_ENTITIES[i], length) == 0)
+                {
+                    value.append(s_ENTITIES[i + 1]);
+                    p += length;
+                    decoded = true;
+                    break;
+                }
+            }
+        }
+
+        if (!decoded)
+        {
+            value.push_back(*p++);
+        }
+    }
+
+    return value;
+}
+
+/// Helper function to find an attribute of an element
+/// \param p the first character after the element name
+/// \param pEnd the end of the attributes of the element
+/// \param szName the attribute name
+/// \param[out] value the decoded value of the attribute
+/// \return false if the element does not have the attribute or if its attributes are malformed
+static bool FindAttribute(const char* p, const char* pEnd, const char* szName, string& value)
+{
+    size_t nameLength = strlen(szName);
+
+    while ((p = SkipSpaces(p, pEnd)) < pEnd)
+    {
+        const char* pName = p;
+
+        while (p < pEnd && *p != '=' && !IsSpace(*p))
+        {
+            p++;
+        }
+
+        const char* pNameEnd = p;
+        p = SkipSpaces(p, pEnd);
+
+        if (p == pEnd || *p != '=')
+        {
+            return false;
+        }
+
+        p = SkipSpaces(p + 1, pEnd);
+
+        if (p == pEnd || (*p != '"' && *p != '\''))
+        {
+            return false;
+        }
+
+        const char* pValue = p + 1;
+        const char* pValueEnd = static_cast<const char*>(memchr(pValue, *p, pEnd - pValue));
+
+        if (pValueEnd == nullptr)
+        {
+            return false;
+        }
+
+        if (static_cast<size_t>(pNameEnd - pName) == nameLength && memcmp(pName, szName, nameLength) == 0)
+        {
+            value = DecodeEntities(pValue, pValueEnd);
+            return true;
+        }
+
+        p = pValueEnd + 1;
+    }
+
+    return false;
+}
+
+/// Helper function to validate a color and convert it to uppercase hex digits
+/// \param[in,out] color the Hex attribute of a Color element, with or without a leading '#'
+/// \return false if the color is not made of 6 or 8 hex digits
+static bool NormalizeColor(string& color)
+{
+    if (!color.empty() && color[0] == '#')
+    {
+        color.erase(0, 1);
+    }
+
+    if (color.length() != 6 && color.length() != 8)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < color.length(); i++)
+    {
+        char c = color[i];
+
+        if (c >= 'a' && c <= 'f')
+        {
+            color[i] = static_cast<char>(c - 'a' + 'A');
+        }
+        else if (!((c >= '0' && c <= '9') || (c >= 'A' && c <= 'F')))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/// Helper function to replace the control characters of a comment with spaces, so that it is written on a single line
+/// \param[in,out] comment the comment
+static void ReplaceControlCharacters(string& comment)
+{
+    for (size_t i = 0; i < comment.length(); i++)
+    {
+        if (static_cast<unsigned char>(comment[i]) < 0x20 || comment[i] == 0x7f)
+        {
+            comment[i] = ' ';
+        }
+    }
+}
+
+bool ParsePerfMarkerUserString(const char* pUserString, size_t length, PerfMarkerUserString& userString)
+{
+    const char* pEnd = pUserString + length;
+    const char* p = SkipSpaces(pUserString, pEnd);
+
+    userString.m_color.clear();
+    userString.m_comment.clear();
+
+    if (p < pEnd && *p != '<')
+    {
+        // not XML, e.g. a request id, the whole string is the comment
+        userString.m_comment.assign(pUserString, length);
+    }
+
+    while (p < pEnd && *p == '<')
+    {
+        const char* pName = p + 1;
+        const char* pElementEnd = FindElementEnd(pName, pEnd);
+        const char* pNameEnd = pName;
+
+        while (pNameEnd < pElementEnd && !IsSpace(*pNameEnd) && *pNameEnd != '/')
+        {
+            pNameEnd++;
+        }
+
+        const char* pAttributesEnd = pElementEnd > pNameEnd && pElementEnd[-1] == '/' ? pElementEnd - 1 : pElementEnd;
+        string name(pName, pNameEnd);
+        string value;
+
+        if (name == "Color" && FindAttribute(pNameEnd, pAttributesEnd, "Hex", value) && NormalizeColor(value))
+        {
+            userString.m_color = value;
+        }
+        else if (name == "UserComment" && FindAttribute(pNameEnd, pAttributesEnd, "Comment", value))
+        {
+            userString.m_comment = value;
+        }
+
+        p = pElementEnd < pEnd ? pElementEnd + 1 : pEnd;
+        p = SkipSpaces(p, pEnd);
+    }
+
+    ReplaceControlCharacters(userString.m_comment);
+
+    return !userString.m_color.empty() || !userString.m_comment.empty();
+}
+
+const char* GetPerfMarkerEventUserString(const PerfMarkerEvent& event, size_t& length)
+{
+    // the user string is recorded with its null terminator, the rest of the last payload slot is not initialized
+    const char* pUserString = static_cast<const char*>(event.GetPayload());
+    size_t payloadSize = event.m_payloadSlots * sizeof(PerfMarkerEvent);
+    const char* pTerminator = static_cast<const char*>(memchr(pUserString, '\0', payloadSize));
+
+    length = pTerminator != nullptr ? static_cast<size_t>(pTerminator - pUserString) : payloadSize;
+    return pUserString;
+}
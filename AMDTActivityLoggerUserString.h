@@ -0,0 +1,36 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Parses the user strings attached to perf markers
+//==============================================================================
+
+#ifndef _AMDT_ACTIVITY_LOGGER_USER_STRING_H_
+#define _AMDT_ACTIVITY_LOGGER_USER_STRING_H_
+
+#include <string>
+
+#include "AMDTActivityLoggerEventBuffer.h"
+
+/// The settings of a marker read from the user string passed to amdtBeginMarker or amdtEndMarkerEx
+struct PerfMarkerUserString
+{
+    std::string m_color;    ///< the Hex attribute of the Color element, 6 or 8 uppercase hex digits, empty if there is no valid Color element
+    std::string m_comment;  ///< the Comment attribute of the UserComment element, or the whole user string if it is not XML, with control characters replaced by spaces
+};
+
+/// Parses a user string. The user string is recorded as is by the marker entrypoints, and only parsed when the events are written.
+/// Elements other than Color and UserComment, and malformed elements, are ignored.
+/// \param pUserString the user string, which does not need to be null terminated
+/// \param length the length of the user string
+/// \param[out] userString the settings of the marker
+/// \return false if the user string has neither a valid color nor a comment
+bool ParsePerfMarkerUserString(const char* pUserString, size_t length, PerfMarkerUserString& userString);
+
+/// Gets the user string carried by a PERF_MARKER_EVENT_USER_STRING event
+/// \param event the event
+/// \param[out] length the length of the user string
+/// \return the user string
+const char* GetPerfMarkerEventUserString(const PerfMarkerEvent& event, size_t& length);
+
+#endif // _AMDT_ACTIVITY_LOGGER_USER_STRING_H_
@@ -0,0 +1,57 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Runs independent tasks concurrently on a pool of worker threads
+//==============================================================================
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "AMDTActivityLoggerWorkerPool.h"
+
+/// Runs tasks until there are none left
+/// \param pNextTask the index of the next task to run
+/// \param numTasks the number of tasks
+/// \param pTask the function running a task
+static void RunTasks(std::atomic<size_t>* pNextTask, size_t numTasks, const std::function<void(size_t)>* pTask)
+{
+    for (size_t i = pNextTask->fetch_add(1); i < numTasks; i = pNextTask->fetch_add(1))
+    {
+        (*pTask)(i);
+    }
+}
+
+void RunPerfMarkerTasks(size_t numTasks, const std::function<void(size_t)>& task, size_t maxThreads)
+{
+    if (maxThreads == 0)
+    {
+        maxThreads = std::thread::hardware_concurrency();
+    }
+
+    size_t numThreads = numTasks < maxThreads ? numTasks : maxThreads;
+    std::atomic<size_t> nextTask(0);
+    std::vector<std::thread> workers;
+
+    // the calling thread is one of the workers
+    for (size_t i = 1; i < numThreads; i++)
+    {
+        try
+        {
+            workers.push_back(std::thread(RunTasks, &nextTask, numTasks, &task));
+        }
+        catch (...)
+        {
+            // failing to create a worker only reduces the concurrency
+            break;
+        }
+    }
+
+    RunTasks(&nextTask, numTasks, &task);
+
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+}
@@ -0,0 +1,20 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Runs independent tasks concurrently on a pool of worker threads
+//==============================================================================
+
+#ifndef _AMDT_ACTIVITY_LOGGER_WORKER_POOL_H_
+#define _AMDT_ACTIVITY_LOGGER_WORKER_POOL_H_
+
+#include <cstddef>
+#include <functional>
+
+/// Runs tasks concurrently, the calling thread takes part in running the tasks
+/// \param numTasks the number of tasks
+/// \param task the function running a task, called once with each index in [0, numTasks)
+/// \param maxThreads the maximum number of threads running the tasks, 0 to use the number of hardware threads
+void RunPerfMarkerTasks(size_t numTasks, const std::function<void(size_t)>& task, size_t maxThreads = 0);
+
+#endif // _AMDT_ACTIVITY_LOGGER_WORKER_POOL_H_
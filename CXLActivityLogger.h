@@ -31,6 +31,9 @@ extern "C" {
 #define AL_WARN_PROFILE_ALREADY_RESUMED       -10
 #define AL_WARN_PROFILE_ALREADY_PAUSED        -11
 #define AL_GPU_PROFILER_MISMATCH              -12
+#define AL_INVALID_MARKER_HANDLE              -13
+#define AL_STATISTICS_NOT_ENABLED             -14
+#define AL_INVALID_ARGUMENT                   -15
 
 #if defined(_WIN32) || defined(__CYGWIN__)
 #define AL_API_CALL __stdcall
@@ -38,6 +41,16 @@ extern "C" {
 #define AL_API_CALL __attribute__((visibility("default")))
 #endif
 
+#if defined(_WIN32) || defined(__CYGWIN__)
+#if defined(AL_BUILD_ACTIVITY_LOGGER)
+#define AL_API_DATA
+#else
+#define AL_API_DATA __declspec(dllimport)
+#endif
+#else
+#define AL_API_DATA __attribute__((visibility("default")))
+#endif
+
 #ifdef __GNUC__
 #define AL_DEPRECATED_PREFIX
 #define AL_DEPRECATED_SUFFIX __attribute__((deprecated))
@@ -66,13 +79,50 @@ extern int AL_API_CALL amdtInitializeActivityLogger();
 /// \param szGroupName Group name, Optional, Pass in NULL to use default group name
 ///        If group name is specified, additional sub-branch will be created under PerfMarker branch
 ///        in Timeline and all markers that belong to the group will be displayed in the group branch.
-/// \param szUserString Currently ignored -- reserved for future use (see below for one expected future use)
-///        User string, Optional, Pass in NULL to use default color and no user specific string.
-///        If User string is specified it should be formatted as a XML string. Optional tag is Color, as in the following example
+/// \param szUserString User string, Optional, Pass in NULL to use default color and no user specific string.
+///        If User string is specified it should be formatted as a XML string. Optional tags are Color and UserComment, as in the following example
 ///        amdtBeginMarker("MyMarker", "MyGroup", "<Color Hex="FF0000"/>\n<UserComment Comment="Starting major calulcation"/>")
+///        A User string which is not XML is used as the comment. The User string is copied when the marker is recorded
+///        and only parsed when the markers are written, as clPerfMarkerColor and clPerfMarkerComment lines.
 /// \return status code
 extern int AL_API_CALL amdtBeginMarker(const char* szMarkerName, const char* szGroupName, const char* szUserString);
 
+/// Types of the values of the arguments of a marker
+typedef enum
+{
+    AL_ARG_INT64 = 0,   ///< signed 64-bit integer, in m_value.m_int64
+    AL_ARG_DOUBLE = 1,  ///< double, in m_value.m_double
+    AL_ARG_STRING = 2   ///< string, in m_value.m_szString
+} amdtArgType;
+
+/// Maximum number of arguments of a marker
+#define AL_MAX_MARKER_ARGS 16
+
+/// Typed argument of a marker, see amdtBeginMarkerArgs
+typedef struct
+{
+    const char* m_szName;           ///< argument name
+    amdtArgType m_type;             ///< type of the value
+    union
+    {
+        long long m_int64;          ///< value of an AL_ARG_INT64 argument
+        double m_double;            ///< value of an AL_ARG_DOUBLE argument
+        const char* m_szString;     ///< value of an AL_ARG_STRING argument
+    } m_value;                      ///< value of the argument
+} amdtArg;
+
+/// Begin AMDTActivityLogger block with typed arguments, such as a batch size or a shard index, so that the
+/// instances of a marker can be grouped by their arguments when the output is analyzed.
+/// The arguments are recorded in binary form with the begin of the marker and written by amdtFinalizeActivityLogger
+/// as clPerfMarkerArg lines following the clBeginPerfMarker line. The argument names are interned like the marker
+/// names, the string values are copied with each begin like user strings. The block is ended with amdtEndMarker or amdtEndMarkerEx.
+/// \param szMarkerName Marker name
+/// \param szGroupName Group name, Optional, Pass in NULL to use default group name
+/// \param pArgs the arguments, Optional if numArgs is 0
+/// \param numArgs the number of arguments, at most AL_MAX_MARKER_ARGS
+/// \return status code, AL_INVALID_ARGUMENT if an argument has no name, an unknown type or a NULL string value
+extern int AL_API_CALL amdtBeginMarkerArgs(const char* szMarkerName, const char* szGroupName, const amdtArg* pArgs, unsigned int numArgs);
+
 /// End AMDTActivityLogger block
 /// \return status code
 extern int AL_API_CALL amdtEndMarker();
@@ -82,12 +132,148 @@ extern int AL_API_CALL amdtEndMarker();
 /// \param szGroupName Group name, Optional, Pass in NULL to use default group name
 ///        If group name is specified, additional sub-branch will be created under PerfMarker branch
 ///        in Timeline and all markers that belong to the group will be displayed in the group branch.
-/// \param szUserString Currently ignored -- reserved for future use (see amdtBeginMarker for more info)
+/// \param szUserString User string, Optional, Pass in NULL for none (see amdtBeginMarker for more info)
 /// \return status code -- it is not valid to pass in a non-empty szGroupName with an empty szMarkerName
 extern int AL_API_CALL amdtEndMarkerEx(const char* szMarkerName, const char* szGroupName, const char* szUserString);
 
+/// Handle of a marker registered with amdtRegisterMarker
+typedef unsigned int amdtMarkerHandle;
+
+/// Value of a marker handle that does not refer to a registered marker
+#define AL_NULL_MARKER_HANDLE 0
+
+/// Register a marker and group name pair for use with amdtBeginMarkerById and amdtEndMarkerById.
+/// The names are copied and prepared for output once, so markers emitted through their handle
+/// do not copy or process strings. Registering the same names again returns the same handle.
+/// Markers can be registered before amdtInitializeActivityLogger is called.
+/// \param szMarkerName Marker name
+/// \param szGroupName Group name, Optional, Pass in NULL to use default group name
+/// \param[out] pMarkerHandle the handle of the marker, AL_NULL_MARKER_HANDLE on failure
+/// \return status code
+extern int AL_API_CALL amdtRegisterMarker(const char* szMarkerName, const char* szGroupName, amdtMarkerHandle* pMarkerHandle);
+
+/// Begin AMDTActivityLogger block using a marker registered with amdtRegisterMarker
+/// \param markerHandle the handle of the marker
+/// \return status code
+extern int AL_API_CALL amdtBeginMarkerById(amdtMarkerHandle markerHandle);
+
+/// End AMDTActivityLogger block started with amdtBeginMarkerById
+/// \param markerHandle the handle of the marker, pass in the handle used to begin the block
+/// \return status code
+extern int AL_API_CALL amdtEndMarkerById(amdtMarkerHandle markerHandle);
+
+/// Record a value of a counter, such as a queue depth or a number of bytes in flight, displayed on the
+/// timeline with the markers. The value is recorded by the current thread like a marker, it is ignored
+/// when the counter's group is disabled and in statistics mode.
+/// \param szCounterName Counter name
+/// \param szGroupName Group name, Optional, Pass in NULL to use default group name
+/// \param value the value of the counter
+/// \return status code
+extern int AL_API_CALL amdtRecordCounter(const char* szCounterName, const char* szGroupName, long long value);
+
+/// Record a floating point value of a counter, see amdtRecordCounter.
+/// \param szCounterName Counter name
+/// \param szGroupName Group name, Optional, Pass in NULL to use default group name
+/// \param value the value of the counter
+/// \return status code
+extern int AL_API_CALL amdtRecordCounterDouble(const char* szCounterName, const char* szGroupName, double value);
+
+/// Record a marker without duration, for events such as a cache flush or a dropped frame.
+/// It does not open a block and does not need to be ended. It is ignored when its group is disabled
+/// and in statistics mode.
+/// \param szMarkerName Marker name
+/// \param szGroupName Group name, Optional, Pass in NULL to use default group name
+/// \return status code
+extern int AL_API_CALL amdtInstantMarker(const char* szMarkerName, const char* szGroupName);
+
+/// Enable or disable the recording of the markers of a group.
+/// All groups are enabled by default. The profiler can also enable or disable groups at startup.
+/// Markers of a disabled group are ignored, and markers opened while their group was enabled are
+/// still closed normally. Groups can be enabled or disabled before amdtInitializeActivityLogger is called.
+/// \param szGroupName Group name, Pass in NULL to enable or disable the default group
+/// \param bEnabled non-zero to record the markers of the group, 0 to ignore them
+/// \return status code
+extern int AL_API_CALL amdtSetGroupEnabled(const char* szGroupName, int bEnabled);
+
+/// Record only a sample of the instances of a marker, for markers in hot loops.
+/// The decision is made by each thread for its own instances. Each recorded instance is followed in
+/// the output by the number of instances it represents, i.e. itself and the instances skipped since
+/// the previous recorded one; the instances skipped after the last recorded one are reported when
+/// amdtFinalizeActivityLogger is called. Overrides the sampling set with amdtSetGroupSampling.
+/// \param szMarkerName Marker name
+/// \param szGroupName Group name, Optional, Pass in NULL to use default group name
+/// \param sampleInterval Record 1 in sampleInterval instances, Pass in 0 or 1 to record all instances
+/// \param maxSamplesPerMillisecond Record at most maxSamplesPerMillisecond instances per millisecond and per thread, Pass in 0 for no limit
+/// \return status code
+extern int AL_API_CALL amdtSetMarkerSampling(const char* szMarkerName, const char* szGroupName, unsigned int sampleInterval, unsigned int maxSamplesPerMillisecond);
+
+/// Record only a sample of the instances of the markers of a group, see amdtSetMarkerSampling.
+/// \param szGroupName Group name, Pass in NULL to set the sampling of the default group
+/// \param sampleInterval Record 1 in sampleInterval instances of each marker, Pass in 0 or 1 to record all instances
+/// \param maxSamplesPerMillisecond Record at most maxSamplesPerMillisecond instances of each marker per millisecond and per thread, Pass in 0 for no limit
+/// \return status code
+extern int AL_API_CALL amdtSetGroupSampling(const char* szGroupName, unsigned int sampleInterval, unsigned int maxSamplesPerMillisecond);
+
+/// Aggregated statistics of the durations of a marker, in nanoseconds
+typedef struct
+{
+    unsigned long long m_count;       ///< number of completed instances of the marker
+    unsigned long long m_totalNanos;  ///< total duration of the instances
+    unsigned long long m_minNanos;    ///< shortest duration
+    unsigned long long m_maxNanos;    ///< longest duration
+    unsigned long long m_meanNanos;   ///< mean duration
+    unsigned long long m_p50Nanos;    ///< estimated median duration
+    unsigned long long m_p90Nanos;    ///< estimated 90th percentile of the durations
+    unsigned long long m_p99Nanos;    ///< estimated 99th percentile of the durations
+} amdtMarkerStatistics;
+
+/// Get the statistics of a marker, merged from all the threads, when the profiler runs AMDTActivityLogger
+/// in statistics mode. In this mode the duration of each marker is added to per-thread histograms when
+/// the marker ends instead of being written to the output file, and the statistics of all the markers
+/// are written to a summary file by amdtFinalizeActivityLogger. The percentiles are estimated within 1/16
+/// of their value. Can be called at any time after amdtInitializeActivityLogger, including after
+/// amdtFinalizeActivityLogger.
+/// \param szMarkerName Marker name
+/// \param szGroupName Group name, Optional, Pass in NULL to use default group name
+/// \param[out] pStatistics the statistics of the marker, all 0 if the marker has not completed yet
+/// \return status code, AL_STATISTICS_NOT_ENABLED if AMDTActivityLogger is not in statistics mode
+extern int AL_API_CALL amdtGetMarkerStatistics(const char* szMarkerName, const char* szGroupName, amdtMarkerStatistics* pStatistics);
+
+/// Counters of the overhead of AMDTActivityLogger itself, for all the threads or for one thread
+typedef struct
+{
+    unsigned long long m_threadId;              ///< id of the thread, 0 for the totals of all the threads
+    unsigned long long m_numRecordedMarkers;    ///< number of markers whose begin was recorded
+    unsigned long long m_numRecordedEvents;     ///< number of recorded events: begins and ends of markers, counter values and instant markers
+    unsigned long long m_numBufferedBytes;      ///< memory holding the events which are not yet written, in bytes
+    unsigned long long m_numSpilledBytes;       ///< size of the events written to the temp files, in timeout mode or when the events are spilled to disk
+    unsigned long long m_numDroppedMarkers;     ///< number of markers dropped because the memory budget was exceeded
+    unsigned long long m_numSampledOutMarkers;  ///< number of instances of sampled markers which were not recorded
+    unsigned long long m_numBeginCalls;         ///< number of calls to amdtBeginMarker, amdtBeginMarkerArgs and amdtBeginMarkerById
+    unsigned long long m_beginNanos;            ///< estimated time spent in the begin calls
+    unsigned long long m_numEndCalls;           ///< number of calls to amdtEndMarker, amdtEndMarkerEx and amdtEndMarkerById
+    unsigned long long m_endNanos;              ///< estimated time spent in the end calls
+    unsigned long long m_numLockContentions;    ///< number of times a thread waited for a lock held by another thread of AMDTActivityLogger
+    unsigned long long m_lockWaitNanos;         ///< time spent waiting for those locks
+    unsigned long long m_finalizeNanos;         ///< time spent in amdtFinalizeActivityLogger, only set in the totals
+} amdtActivityLoggerStats;
+
+/// Get the counters of the overhead of AMDTActivityLogger, so that an application can check how much time and memory
+/// the recording of its markers costs. The counters are kept by each thread and only added up by this call.
+/// To keep the counters cheap, 1 in 16 begin and end calls of each thread is timed and the time spent in the
+/// calls is estimated from them. Can be called at any time after amdtInitializeActivityLogger, including after
+/// amdtFinalizeActivityLogger.
+/// \param[out] pStats the totals of all the threads
+/// \param[out] pThreadStats the counters of each thread which recorded markers, Optional, Pass in NULL to only get the totals
+/// \param[in,out] pNumThreadStats the number of elements of pThreadStats on input, the number of threads which recorded
+///        markers on output, Optional if pThreadStats is NULL. Only the first elements are set if there are more threads.
+/// \return status code
+extern int AL_API_CALL amdtGetActivityLoggerStats(amdtActivityLoggerStats* pStats, amdtActivityLoggerStats* pThreadStats, unsigned int* pNumThreadStats);
+
 /// Finalize AMDTActivityLogger, Save collected data in specified output file.
-/// Failed to call the function will result in no AMDTActivityLogger file is generated.
+/// If the function is not called, it is called when the process exits normally or the library is unloaded.
+/// On Linux, a child process forked after initialization records its own markers and saves them in its own
+/// output file, whose name has the pid of the child inserted before the extension.
 /// \return status code
 extern int AL_API_CALL amdtFinalizeActivityLogger();
 
@@ -128,33 +314,156 @@ extern int AL_API_CALL amdtStopProfilingEx(void);
 /// \return status code
 extern int AL_API_CALL amdtResumeProfilingEx(void);
 
+/// A profiling trigger, which resumes profiling while instances of a marker run so that the profiler only collects
+/// the intervals of interest. The profiling modes of the trigger are stopped when the first instance of the marker begins.
+/// The windows of different triggers may overlap, a mode is resumed while at least one window of its triggers is open.
+typedef struct
+{
+    amdtProfilingControlMode m_profilingControlMode;  ///< the profiling mode (or modes) resumed during a window
+    unsigned long long m_startInstance;               ///< the instance of the marker, counted from 1 across all threads, from which windows open, 0 or 1 for the first one
+    unsigned int m_maxWindows;                        ///< the maximum number of windows, 0 for no limit. Windows do not overlap, the instances beginning during a window are skipped
+    unsigned int m_minDurationMs;                     ///< a window opens once its instance has lasted this long, to profile only the slow instances, 0 to open it when the instance begins
+    unsigned int m_maxDurationMs;                     ///< a window closes this long after it opened if its instance has not ended, 0 to close it when the instance ends only
+} amdtProfilingTrigger;
+
+/// Add a profiling trigger to a marker. The durations are checked when markers begin or end.
+/// The marker and group names can also be passed to the PerfMarkerTrigger parameter of the profiler:
+/// "MarkerName,GroupName,Modes,StartInstance,MaxWindows,MinDurationMs,MaxDurationMs", with the modes
+/// separated by '|' among Trace, PerfCounter, CPU and All, and the trailing numbers optional.
+/// \param szMarkerName the marker name
+/// \param szGroupName the group name, NULL or empty for the default group
+/// \param pTrigger the trigger
+/// \return status code, AL_INVALID_ARGUMENT if the marker already has a trigger
+extern int AL_API_CALL amdtAddProfilingTrigger(const char* szMarkerName, const char* szGroupName, const amdtProfilingTrigger* pTrigger);
+
+/// Instruct AMDTActivityLogger to look up the profiler agents again. The agents are looked up the first time profiling
+/// is stopped or resumed, including the agents which are not loaded. Call this function after loading an agent later.
+/// \return AL_SUCCESS if at least one of the profiling agents is loaded, AL_FAILED_TO_ATTACH_TO_PROFILER otherwise
+extern int AL_API_CALL amdtRefreshProfilingControl(void);
+
+/// Flag that is non-zero while AMDTActivityLogger records markers, i.e. after amdtInitializeActivityLogger
+/// has attached to the profiler and until amdtFinalizeActivityLogger is called.
+/// The AL_* marker macros below test it inline, so that an application which is not being profiled does
+/// not call into the library for each marker. The marker entrypoints still do their own checks.
+/// The macros read it with a relaxed atomic load with GCC and Clang, and as a volatile int otherwise, which MSVC
+/// loads atomically. No ordering is needed: a marker racing with amdtInitializeActivityLogger or
+/// amdtFinalizeActivityLogger is accepted or rejected by the entrypoint, which synchronizes with them itself.
+extern AL_API_DATA volatile int amdtActivityLoggerEnabled;
+
 #ifdef __cplusplus
 }
 #endif
 
+//-----------------------------------------------------------------------------
+/// Marker macros. They only call the entrypoints above while amdtActivityLoggerEnabled is set,
+/// and return AL_UNINITIALIZED_ACTIVITY_LOGGER otherwise.
+/// Define AL_DISABLE_ACTIVITY_LOGGER before including this file to compile all of them, and
+/// amdtScopedMarker, to nothing. Their arguments are then not evaluated and the application does
+/// not need to link with AMDTActivityLogger.
+//-----------------------------------------------------------------------------
+
+#define AL_CONCAT_INTERNAL(a, b) a##b
+#define AL_CONCAT(a, b) AL_CONCAT_INTERNAL(a, b)
+
+#ifdef AL_DISABLE_ACTIVITY_LOGGER
+
+#define AL_IS_ACTIVITY_LOGGER_ENABLED() 0
+#define AL_INITIALIZE_ACTIVITY_LOGGER() (AL_GPU_PROFILER_NOT_DETECTED)
+#define AL_BEGIN_MARKER(szMarkerName, szGroupName, szUserString) (AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_BEGIN_MARKER_ARGS(szMarkerName, szGroupName, pArgs, numArgs) (AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_END_MARKER() (AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_END_MARKER_EX(szMarkerName, szGroupName, szUserString) (AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_REGISTER_MARKER(szMarkerName, szGroupName, pMarkerHandle) (*(pMarkerHandle) = AL_NULL_MARKER_HANDLE, AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_BEGIN_MARKER_BY_ID(markerHandle) (AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_END_MARKER_BY_ID(markerHandle) (AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_RECORD_COUNTER(szCounterName, szGroupName, value) (AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_RECORD_COUNTER_DOUBLE(szCounterName, szGroupName, value) (AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_INSTANT_MARKER(szMarkerName, szGroupName) (AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_SET_GROUP_ENABLED(szGroupName, bEnabled) (AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_SET_MARKER_SAMPLING(szMarkerName, szGroupName, sampleInterval, maxSamplesPerMillisecond) (AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_SET_GROUP_SAMPLING(szGroupName, sampleInterval, maxSamplesPerMillisecond) (AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_FINALIZE_ACTIVITY_LOGGER() (AL_UNINITIALIZED_ACTIVITY_LOGGER)
+
+#else
+
+#ifdef __GNUC__
+#define AL_IS_ACTIVITY_LOGGER_ENABLED() (__atomic_load_n(&amdtActivityLoggerEnabled, __ATOMIC_RELAXED) != 0)
+#else
+#define AL_IS_ACTIVITY_LOGGER_ENABLED() (amdtActivityLoggerEnabled != 0)
+#endif
+#define AL_INITIALIZE_ACTIVITY_LOGGER() amdtInitializeActivityLogger()
+#define AL_BEGIN_MARKER(szMarkerName, szGroupName, szUserString) \
+    (AL_IS_ACTIVITY_LOGGER_ENABLED() ? amdtBeginMarker(szMarkerName, szGroupName, szUserString) : AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_BEGIN_MARKER_ARGS(szMarkerName, szGroupName, pArgs, numArgs) \
+    (AL_IS_ACTIVITY_LOGGER_ENABLED() ? amdtBeginMarkerArgs(szMarkerName, szGroupName, pArgs, numArgs) : AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_END_MARKER() \
+    (AL_IS_ACTIVITY_LOGGER_ENABLED() ? amdtEndMarker() : AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_END_MARKER_EX(szMarkerName, szGroupName, szUserString) \
+    (AL_IS_ACTIVITY_LOGGER_ENABLED() ? amdtEndMarkerEx(szMarkerName, szGroupName, szUserString) : AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_REGISTER_MARKER(szMarkerName, szGroupName, pMarkerHandle) amdtRegisterMarker(szMarkerName, szGroupName, pMarkerHandle)
+#define AL_BEGIN_MARKER_BY_ID(markerHandle) \
+    (AL_IS_ACTIVITY_LOGGER_ENABLED() ? amdtBeginMarkerById(markerHandle) : AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_END_MARKER_BY_ID(markerHandle) \
+    (AL_IS_ACTIVITY_LOGGER_ENABLED() ? amdtEndMarkerById(markerHandle) : AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_RECORD_COUNTER(szCounterName, szGroupName, value) \
+    (AL_IS_ACTIVITY_LOGGER_ENABLED() ? amdtRecordCounter(szCounterName, szGroupName, value) : AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_RECORD_COUNTER_DOUBLE(szCounterName, szGroupName, value) \
+    (AL_IS_ACTIVITY_LOGGER_ENABLED() ? amdtRecordCounterDouble(szCounterName, szGroupName, value) : AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_INSTANT_MARKER(szMarkerName, szGroupName) \
+    (AL_IS_ACTIVITY_LOGGER_ENABLED() ? amdtInstantMarker(szMarkerName, szGroupName) : AL_UNINITIALIZED_ACTIVITY_LOGGER)
+#define AL_SET_GROUP_ENABLED(szGroupName, bEnabled) amdtSetGroupEnabled(szGroupName, bEnabled)
+#define AL_SET_MARKER_SAMPLING(szMarkerName, szGroupName, sampleInterval, maxSamplesPerMillisecond) \
+    amdtSetMarkerSampling(szMarkerName, szGroupName, sampleInterval, maxSamplesPerMillisecond)
+#define AL_SET_GROUP_SAMPLING(szGroupName, sampleInterval, maxSamplesPerMillisecond) \
+    amdtSetGroupSampling(szGroupName, sampleInterval, maxSamplesPerMillisecond)
+#define AL_FINALIZE_ACTIVITY_LOGGER() amdtFinalizeActivityLogger()
+
+#endif // AL_DISABLE_ACTIVITY_LOGGER
+
 #ifdef __cplusplus
 
 /// A utility class that opens a marker in the constructor and closes it in the destructor
 /// This saves the user the need to explicitly call amdtEndMarker and also handles user code
 /// with exceptions and multiple exit points correctly.
+/// No library call is made when amdtActivityLoggerEnabled is not set, and the marker is only
+/// closed if it was opened.
 class amdtScopedMarker
 {
 public:
+#ifdef AL_DISABLE_ACTIVITY_LOGGER
+    amdtScopedMarker(const char*, const char*, const char*) {}
+
+    amdtScopedMarker(const char*, const char*) {}
+#else
     amdtScopedMarker(const char* szMarkerName, const char* szGroupName, const char* szUserString)
     {
-        amdtBeginMarker(szMarkerName, szGroupName, szUserString);
+        m_bStarted = AL_BEGIN_MARKER(szMarkerName, szGroupName, szUserString) == AL_SUCCESS;
     }
 
     amdtScopedMarker(const char* szMarkerName, const char* szGroupName)
     {
-        amdtBeginMarker(szMarkerName, szGroupName, nullptr);
+        m_bStarted = AL_BEGIN_MARKER(szMarkerName, szGroupName, nullptr) == AL_SUCCESS;
     }
 
     ~amdtScopedMarker()
     {
-        amdtEndMarker();
+        if (m_bStarted)
+        {
+            amdtEndMarker();
+        }
     }
+
+private:
+    bool m_bStarted; ///< flag indicating if the marker was opened
+#endif
 };
+
+/// Declares an amdtScopedMarker for the rest of the enclosing scope
+#ifdef AL_DISABLE_ACTIVITY_LOGGER
+#define AL_SCOPED_MARKER(szMarkerName, szGroupName)
+#else
+#define AL_SCOPED_MARKER(szMarkerName, szGroupName) amdtScopedMarker AL_CONCAT(alScopedMarker, __LINE__)(szMarkerName, szGroupName)
+#endif
 #endif
 
 #endif // _CXL_ACTIVITY_LOGGER_H_
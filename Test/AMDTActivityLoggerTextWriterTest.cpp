@@ -0,0 +1,181 @@
+//==============================================================================
+// Copyright (c) 2017 Advanced Micro Devices, Inc. All rights reserved.
+/// \author AMD Developer Tools Team
+/// \file
+/// \brief Golden test of the perf marker text writer. The golden files were written by the iostream based
+///        logger the text writer replaced, with a clock returning the timestamps of s_GOLDEN_EVENTS,
+///        for the calls listed in s_GOLDEN_EVENTS. The test writes the same events and compares the bytes.
+//==============================================================================
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+#include "AMDTActivityLoggerTextWriter.h"
+
+using namespace std;
+
+/// An event recorded by a call of the golden run
+struct GoldenEvent
+{
+    PerfMarkerEventType m_type;         ///< the type of the event
+    const char* m_szMarkerName;         ///< the marker name, nullptr for PERF_MARKER_EVENT_END
+    const char* m_szGroupName;          ///< the group name, nullptr for PERF_MARKER_EVENT_END
+    unsigned long long m_timestamp;     ///< the timestamp the clock returned for the call
+};
+
+#define GOLDEN_NAME_50 "ThisMarkerNameIsExactlyFiftyCharactersLongXXXXXXXX"
+#define GOLDEN_NAME_49 "ThisMarkerNameIsFortyNineCharactersLong.XXXXXXXXX"
+#define GOLDEN_NAME_70 "A Marker Name With Spaces That Is Seventy Characters Long And Then Some"
+
+/// The events recorded by the golden run, in the order of the calls
+static const GoldenEvent s_GOLDEN_EVENTS[] =
+{
+    // a long name on a stream which has not been left adjusted yet pads the clEndPerfMarkerEx timestamp on its left
+    { PERF_MARKER_EVENT_BEGIN, GOLDEN_NAME_50, "Long Group", 1000ULL },                     // amdtBeginMarker(GOLDEN_NAME_50, "Long Group", NULL)
+    { PERF_MARKER_EVENT_END_EX, GOLDEN_NAME_50, "Long Group", 1250ULL },                    // amdtEndMarkerEx(GOLDEN_NAME_50, "Long Group", NULL)
+    // amdtEndMarker() and amdtEndMarkerEx("Short", "G", NULL) are unbalanced here, they return AL_UNBALANCED_MARKER and write nothing
+    { PERF_MARKER_EVENT_BEGIN, "Short Marker", "Default", 98765ULL },                       // amdtBeginMarker("Short Marker", NULL, NULL)
+    { PERF_MARKER_EVENT_BEGIN, GOLDEN_NAME_49, "G", 1234567ULL },                           // amdtBeginMarker(GOLDEN_NAME_49, "G", NULL)
+    { PERF_MARKER_EVENT_BEGIN, GOLDEN_NAME_70, "Group Two", 99999999ULL },                  // amdtBeginMarker(GOLDEN_NAME_70, "Group Two", NULL)
+    { PERF_MARKER_EVENT_END_EX, GOLDEN_NAME_70, "Group Two", 123456789012ULL },             // amdtEndMarkerEx(GOLDEN_NAME_70, "Group Two", NULL)
+    { PERF_MARKER_EVENT_END_EX, "Renamed", "G", 123456789013ULL },                          // amdtEndMarkerEx("Renamed", "G", NULL)
+    { PERF_MARKER_EVENT_END_EX, GOLDEN_NAME_49, "Default", 4000000000ULL },                 // amdtEndMarkerEx(GOLDEN_NAME_49, NULL, NULL)
+    { PERF_MARKER_EVENT_BEGIN, "Inner", "G", 9999999999999999999ULL },                      // amdtBeginMarker("Inner", "G", NULL)
+    { PERF_MARKER_EVENT_END, nullptr, nullptr, 18446744073709551615ULL },                   // amdtEndMarker()
+    // the marker is not ended before amdtFinalizeActivityLogger
+    { PERF_MARKER_EVENT_BEGIN, "Unended", "Default", 7ULL },                                // amdtBeginMarker("Unended", "", NULL)
+};
+
+/// Reads a file into a string
+/// \param fileName the name of the file
+/// \param[out] contents the contents of the file
+/// \return true on success
+static bool ReadFile(const string& fileName, string& contents)
+{
+    ifstream fin(fileName.c_str(), ios_base::in | ios_base::binary);
+
+    if (fin.fail())
+    {
+        return false;
+    }
+
+    contents.assign(istreambuf_iterator<char>(fin), istreambuf_iterator<char>());
+
+    return !fin.bad();
+}
+
+/// Writes the golden events as the text output of a thread
+/// \param isTimeoutMode true to write the events one at a time, as the timeout mode flushes them, false to write the whole buffer
+/// \param threadId the thread id of the section
+/// \param[out] output the text output
+/// \return false if the length of the text differs from the length computed by GetPerfMarkerEventBufferTextLength
+static bool WriteGoldenEvents(bool isTimeoutMode, const string& threadId, string& output)
+{
+    PerfMarkerTable markerTable;
+    PerfMarkerEventBuffer events;
+
+    for (size_t i = 0; i < sizeof(s_GOLDEN_EVENTS) / sizeof(s_GOLDEN_EVENTS[0]); i++)
+    {
+        const GoldenEvent& event = s_GOLDEN_EVENTS[i];
+        unsigned int markerHandle = event.m_szMarkerName != nullptr ? markerTable.Register(event.m_szMarkerName, event.m_szGroupName) : 0;
+        events.AddEvent(event.m_type, event.m_timestamp, markerHandle);
+    }
+
+    // the stream of the thread starts with the default adjustment, as the stream of each thread of the logger
+    stringstream content;
+
+    if (isTimeoutMode)
+    {
+        for (const PerfMarkerEventChunk* pChunk = events.GetFirstChunk(); pChunk != nullptr; pChunk = pChunk->m_pNext)
+        {
+            for (size_t slot = 0; slot < pChunk->m_usedSlots; slot += pChunk->m_pSlots[slot].GetNumSlots())
+            {
+                WritePerfMarkerEventText(content, pChunk->m_pSlots[slot], markerTable);
+            }
+        }
+    }
+    else
+    {
+        WritePerfMarkerEventBufferText(content, events, markerTable);
+    }
+
+    string text = content.str();
+
+    stringstream file;
+    file << "=====Perfmarker Output=====\n" << threadId << '\n' << GetPerfMarkerEventBufferNumLines(events) << '\n' << text;
+    output = file.str();
+
+    return text.size() == GetPerfMarkerEventBufferTextLength(events, markerTable);
+}
+
+/// Compares the output of the text writer with a golden file
+/// \param goldenDir the directory of the golden files
+/// \param szFileName the name of the golden file
+/// \param isTimeoutMode true if the golden file was written in timeout mode
+/// \return true if the output matches the golden file
+static bool CheckGoldenFile(const string& goldenDir, const char* szFileName, bool isTimeoutMode)
+{
+    string golden;
+
+    if (!ReadFile(goldenDir + "/" + szFileName, golden))
+    {
+        cerr << "FAILED " << szFileName << ": cannot read the golden file\n";
+        return false;
+    }
+
+    // the thread id of the golden run is the second line
+    size_t idBegin = golden.find('\n') + 1;
+    size_t idEnd = golden.find('\n', idBegin);
+
+    if (idBegin == 0 || idEnd == string::npos)
+    {
+        cerr << "FAILED " << szFileName << ": malformed golden file\n";
+        return false;
+    }
+
+    string output;
+
+    if (!WriteGoldenEvents(isTimeoutMode, golden.substr(idBegin, idEnd - idBegin), output))
+    {
+        cerr << "FAILED " << szFileName << ": GetPerfMarkerEventBufferTextLength does not match the length of the output\n";
+        return false;
+    }
+
+    if (output != golden)
+    {
+        size_t offset = 0;
+
+        while (offset < output.size() && offset < golden.size() && output[offset] == golden[offset])
+        {
+            offset++;
+        }
+
+        size_t lineBegin = golden.rfind('\n', offset == 0 ? 0 : offset - 1);
+        lineBegin = lineBegin == string::npos ? 0 : lineBegin + 1;
+
+        cerr << "FAILED " << szFileName << ": the output differs at byte " << offset << "\n";
+        cerr << "expected: " << golden.substr(lineBegin, golden.find('\n', lineBegin) - lineBegin) << "\n";
+        cerr << "actual:   " << output.substr(lineBegin, output.find('\n', lineBegin) - lineBegin) << "\n";
+        return false;
+    }
+
+    cout << "PASSED " << szFileName << "\n";
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        cerr << "Usage: " << argv[0] << " <directory of the golden .amdtperfmarker files>\n";
+        return 1;
+    }
+
+    bool passed = CheckGoldenFile(argv[1], "TextWriterTimeOutFalse.amdtperfmarker", false);
+    passed &= CheckGoldenFile(argv[1], "TextWriterTimeOutTrue.amdtperfmarker", true);
+
+    return passed ? 0 : 1;
+}